@@ -0,0 +1,396 @@
+// Hot path benchmarks: replays a u-blox byte capture through the parser and
+// the CGPSInfo conversion, then times mic2::find() and the gps_info() and
+// try_gps_info() FFI round-trips. Every run prints throughput and p50/p99
+// latency.
+//
+// Usage: benchmark_cpp [--capture path] [--rate reads_per_second]
+//                      [--chunk bytes] [--epochs count] [--iterations count]
+//                      [--device | --replay-only]
+//
+// --capture  Raw bytes recorded with CNeoVIMIC::gps_raw_tap_start(parse,
+//            path). Without it a synthetic 1 Hz NMEA and UBX stream is used.
+// --rate     Pushes per second, like a receiver trickling bytes in. 0, the
+//            default, replays as fast as possible.
+// --chunk    Bytes per push, 64 by default like a USB CDC read.
+// --epochs   Navigation epochs in the synthetic stream, 1000 by default.
+// --iterations  Calls timed for the find() and gps_info() benchmarks.
+// --device   Also time gps_info() on the first neoVI MIC2 with a GPS. Exits
+//            with 77, reported as skipped by ctest, if there is none or the
+//            USB bus can't be enumerated.
+// --replay-only  Only the parser benchmarks, nothing touches libusb.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mic2.hpp>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// Nothing was measured, see SKIP_RETURN_CODE in CMakeLists.txt.
+constexpr int exit_skipped = 77;
+
+struct Options {
+  std::string capture;
+  double rate = 0.0;
+  size_t chunk = 64;
+  size_t epochs = 1000;
+  size_t iterations = 1000;
+  bool device = false;
+  bool replay_only = false;
+};
+
+// Nanoseconds per sample, sorted once for the percentiles.
+class Latencies {
+public:
+  void reserve(size_t count) { samples.reserve(count); }
+  void add(Clock::duration duration) {
+    samples.push_back(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count()));
+  }
+  auto percentile(double p) -> uint64_t {
+    if (samples.empty()) {
+      return 0;
+    }
+    if (!sorted) {
+      std::sort(samples.begin(), samples.end());
+      sorted = true;
+    }
+    auto index = static_cast<size_t>(
+        p / 100.0 * static_cast<double>(samples.size() - 1) + 0.5);
+    return samples[index];
+  }
+  // Prints "name: count calls, p50 ns, p99 ns, max ns".
+  void report(const char *name) {
+    size_t count = samples.size();
+    uint64_t p50 = percentile(50.0);
+    uint64_t p99 = percentile(99.0);
+    uint64_t max = samples.empty() ? 0 : samples.back();
+    std::printf("%-22s %10zu calls  p50 %9llu ns  p99 %9llu ns  max %9llu ns\n",
+                name, count, static_cast<unsigned long long>(p50),
+                static_cast<unsigned long long>(p99),
+                static_cast<unsigned long long>(max));
+  }
+
+private:
+  std::vector<uint64_t> samples;
+  bool sorted = false;
+};
+
+auto seconds(Clock::duration duration) -> double {
+  return std::chrono::duration<double>(duration).count();
+}
+
+void append(std::vector<uint8_t> &bytes, const std::string &text) {
+  bytes.insert(bytes.end(), text.begin(), text.end());
+}
+
+// Appends "$body*CS\r\n" with the NMEA XOR checksum.
+void append_nmea(std::vector<uint8_t> &bytes, const std::string &body) {
+  uint8_t checksum = 0;
+  for (char c : body) {
+    checksum = static_cast<uint8_t>(checksum ^ static_cast<uint8_t>(c));
+  }
+  char trailer[8];
+  std::snprintf(trailer, sizeof(trailer), "*%02X\r\n", checksum);
+  append(bytes, "$" + body + trailer);
+}
+
+void put_le(std::vector<uint8_t> &payload, size_t offset, uint32_t value) {
+  for (size_t i = 0; i < 4; i++) {
+    payload[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+// Appends a UBX-NAV-PVT packet for second of 12:30 on 2024-06-15.
+void append_nav_pvt(std::vector<uint8_t> &bytes, uint8_t second) {
+  std::vector<uint8_t> payload(92, 0);
+  payload[4] = 2024 & 0xFF;
+  payload[5] = 2024 >> 8;
+  const uint8_t date_time[] = {6, 15, 12, 30, second};
+  std::memcpy(&payload[6], date_time, sizeof(date_time));
+  // validDate | validTime, 3D fix, gnssFixOK, 9 satellites used
+  payload[11] = 0x03;
+  payload[20] = 3;
+  payload[21] = 0x01;
+  payload[23] = 9;
+  put_le(payload, 24, static_cast<uint32_t>(-833'913'000));
+  put_le(payload, 28, 423'456'000);
+  put_le(payload, 32, 250'500);
+  put_le(payload, 40, 1'500);
+  put_le(payload, 60, 10'000);
+
+  std::vector<uint8_t> packet = {0xB5, 0x62, 0x01, 0x07,
+                                 static_cast<uint8_t>(payload.size()),
+                                 static_cast<uint8_t>(payload.size() >> 8)};
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  // 8-bit Fletcher over class, id, length and payload
+  uint8_t ck_a = 0;
+  uint8_t ck_b = 0;
+  for (size_t i = 2; i < packet.size(); i++) {
+    ck_a = static_cast<uint8_t>(ck_a + packet[i]);
+    ck_b = static_cast<uint8_t>(ck_b + ck_a);
+  }
+  packet.push_back(ck_a);
+  packet.push_back(ck_b);
+  bytes.insert(bytes.end(), packet.begin(), packet.end());
+}
+
+// One epoch per second of what a receiver with both protocols enabled sends:
+// PUBX00 position, PUBX03 satellites, PUBX04 time and a UBX-NAV-PVT.
+auto synthetic_capture(size_t epochs) -> std::vector<uint8_t> {
+  std::vector<uint8_t> bytes;
+  for (size_t epoch = 0; epoch < epochs; epoch++) {
+    auto second = static_cast<uint8_t>(epoch % 60);
+    char time[16];
+    std::snprintf(time, sizeof(time), "1230%02u.00",
+                  static_cast<unsigned>(second));
+    append_nmea(bytes, std::string("PUBX,00,") + time +
+                           ",4717.11321,N,00833.91518,E,546.589,G3,2.1,2.0,"
+                           "0.007,77.52,0.007,,0.92,1.19,0.77,9,0,0");
+    append_nmea(bytes, "PUBX,03,06,2,U,137,37,24,000,8,U,053,52,28,064,9,U,"
+                       "202,12,21,000,14,-,,,22,000,27,-,049,16,,000,81,-,,,"
+                       "08,000");
+    append_nmea(bytes, std::string("PUBX,04,") + time +
+                           ",150624,473731.00,1196,15D,1930035,-2660.664,43,");
+    append_nav_pvt(bytes, second);
+  }
+  return bytes;
+}
+
+auto read_capture(const std::string &path) -> std::vector<uint8_t> {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+// Pushes capture in chunks of options.chunk, paced at options.rate, and
+// converts to CGPSInfo after every push that completed an update.
+auto bench_replay(const Options &options, std::span<const uint8_t> capture)
+    -> bool {
+  auto parser = mic2::GPSParser::create();
+  if (!parser) {
+    std::cerr << "Failed to create parser: " << mic2::error_string(parser.error())
+              << "\n";
+    return false;
+  }
+  Latencies push_latencies;
+  Latencies convert_latencies;
+  push_latencies.reserve(capture.size() / options.chunk + 1);
+  uint64_t updates = 0;
+  Clock::duration busy{};
+  auto interval = options.rate > 0.0
+                      ? std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double>(1.0 / options.rate))
+                      : Clock::duration{};
+  auto next_push = Clock::now();
+  for (size_t offset = 0; offset < capture.size(); offset += options.chunk) {
+    if (interval.count() > 0) {
+      std::this_thread::sleep_until(next_push);
+      next_push += interval;
+    }
+    auto chunk = capture.subspan(
+        offset, std::min(options.chunk, capture.size() - offset));
+    auto start = Clock::now();
+    auto pushed = parser->push(chunk);
+    auto pushed_at = Clock::now();
+    if (!pushed) {
+      std::cerr << "Failed to push: " << mic2::error_string(pushed.error())
+                << "\n";
+      return false;
+    }
+    push_latencies.add(pushed_at - start);
+    busy += pushed_at - start;
+    if (*pushed > 0) {
+      updates += *pushed;
+      auto info = parser->info();
+      auto converted_at = Clock::now();
+      if (!info) {
+        std::cerr << "Failed to convert: " << mic2::error_string(info.error())
+                  << "\n";
+        return false;
+      }
+      convert_latencies.add(converted_at - pushed_at);
+      busy += converted_at - pushed_at;
+    }
+  }
+
+  auto stats = parser->stats();
+  std::printf("replay: %zu bytes in %zu byte chunks, %llu updates",
+              capture.size(), options.chunk,
+              static_cast<unsigned long long>(updates));
+  if (stats) {
+    std::printf(" (%llu NMEA, %llu UBX, %llu fixes, %llu invalid)",
+                static_cast<unsigned long long>(stats->nmea_sentences),
+                static_cast<unsigned long long>(stats->ubx_messages),
+                static_cast<unsigned long long>(stats->fixes),
+                static_cast<unsigned long long>(stats->invalid_frames));
+  }
+  std::printf("\n");
+  if (seconds(busy) > 0.0) {
+    std::printf("throughput: %.2f MB/s, %.0f updates/s\n",
+                static_cast<double>(capture.size()) / seconds(busy) / 1e6,
+                static_cast<double>(updates) / seconds(busy));
+  }
+  push_latencies.report("push");
+  convert_latencies.report("CGPSInfo conversion");
+  return updates > 0;
+}
+
+// CGPSInfo copy across the FFI without a device, the floor of gps_info().
+void bench_parser_info(const Options &options) {
+  auto parser = mic2::GPSParser::create();
+  if (!parser) {
+    return;
+  }
+  Latencies latencies;
+  latencies.reserve(options.iterations);
+  for (size_t i = 0; i < options.iterations; i++) {
+    auto start = Clock::now();
+    auto info = parser->info();
+    latencies.add(Clock::now() - start);
+  }
+  latencies.report("parser info()");
+}
+
+// Enumerates whatever is on the bus, with no neoVI MIC2 attached this is the
+// cost of walking the USB topology. nullopt if finding failed.
+auto bench_find(const Options &options)
+    -> std::optional<std::vector<mic2::CNeoVIMIC>> {
+  Latencies latencies;
+  std::vector<mic2::CNeoVIMIC> devices;
+  size_t iterations = std::max<size_t>(options.iterations / 100, 1);
+  for (size_t i = 0; i < iterations; i++) {
+    auto start = Clock::now();
+    auto found = mic2::find();
+    latencies.add(Clock::now() - start);
+    if (!found) {
+      std::cerr << "Failed to find devices: "
+                << mic2::error_string(found.error()) << "\n";
+      return std::nullopt;
+    }
+    devices = std::move(*found);
+  }
+  std::printf("find: %zu neoVI MIC2(s)\n", devices.size());
+  latencies.report("find()");
+  return devices;
+}
+
+// gps_info() on a live device, the reader thread updates it concurrently.
+// Returns the exit code, exit_skipped without a neoVI MIC2 with a GPS.
+auto bench_device_info(const Options &options,
+                       const std::vector<mic2::CNeoVIMIC> &devices) -> int {
+  auto device = std::find_if(devices.begin(), devices.end(), [](auto &d) {
+    return d.has_gps().value_or(false);
+  });
+  if (device == devices.end()) {
+    std::printf("gps_info(): no neoVI MIC2 with a GPS, skipped\n");
+    return exit_skipped;
+  }
+  if (auto opened = device->gps_open(); !opened) {
+    std::cerr << "Failed to open GPS: " << mic2::error_string(opened.error())
+              << "\n";
+    return 1;
+  }
+  (void)device->gps_wait_for_fix(std::chrono::seconds(5));
+  Latencies latencies;
+  latencies.reserve(options.iterations);
+  for (size_t i = 0; i < options.iterations; i++) {
+    auto start = Clock::now();
+    auto info = device->gps_info();
+    latencies.add(Clock::now() - start);
+  }
+  latencies.report("device gps_info()");
+  // Same copy without the std::expected, inlined from the header-only build.
+  Latencies try_latencies;
+  try_latencies.reserve(options.iterations);
+  CGPSInfo info = {};
+  for (size_t i = 0; i < options.iterations; i++) {
+    auto start = Clock::now();
+    auto err = device->try_gps_info(info);
+    try_latencies.add(Clock::now() - start);
+    if (err != NeoVIMICErrTypeSuccess) {
+      break;
+    }
+  }
+  (void)device->gps_close();
+  try_latencies.report("device try_gps_info()");
+  return 0;
+}
+
+auto parse_options(int argc, char *argv[], Options &options) -> bool {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--device") {
+      options.device = true;
+      continue;
+    }
+    if (arg == "--replay-only") {
+      options.replay_only = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value for " << arg << "\n";
+      return false;
+    }
+    std::string value = argv[++i];
+    if (arg == "--capture") {
+      options.capture = value;
+    } else if (arg == "--rate") {
+      options.rate = std::stod(value);
+    } else if (arg == "--chunk") {
+      options.chunk = std::max<size_t>(std::stoul(value), 1);
+    } else if (arg == "--epochs") {
+      options.epochs = std::stoul(value);
+    } else if (arg == "--iterations") {
+      options.iterations = std::max<size_t>(std::stoul(value), 1);
+    } else {
+      std::cerr << "Unknown option " << arg << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    return 1;
+  }
+  auto capture = options.capture.empty() ? synthetic_capture(options.epochs)
+                                         : read_capture(options.capture);
+  if (capture.empty()) {
+    std::cerr << "Capture is empty\n";
+    return 1;
+  }
+  if (!bench_replay(options, capture)) {
+    std::cerr << "Replay produced no GPS updates\n";
+    return 1;
+  }
+  bench_parser_info(options);
+  if (options.replay_only) {
+    return 0;
+  }
+  auto devices = bench_find(options);
+  if (!devices) {
+    // Without libusb access there is no device to time either
+    return options.device ? exit_skipped : 1;
+  }
+  if (options.device) {
+    return bench_device_info(options, *devices);
+  }
+  return 0;
+}
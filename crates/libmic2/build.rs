@@ -27,11 +27,13 @@ fn main() {
     println!("cargo:rerun-if-changed=src/lib.rs");
     println!("cargo:rerun-if-changed=src/mic2.hpp");
     println!("cargo:rerun-if-changed=src/mic2.cpp");
+    println!("cargo:rerun-if-changed=src/mic2_impl.hpp");
     println!("cargo:rerun-if-changed=../../Cargo.lock");
 
     // Copy the C++ files
     std::fs::copy("src/mic2.cpp", lib_path.join("mic2.cpp")).unwrap();
     std::fs::copy("src/mic2.hpp", lib_path.join("mic2.hpp")).unwrap();
+    std::fs::copy("src/mic2_impl.hpp", lib_path.join("mic2_impl.hpp")).unwrap();
 
     // Debugging paths:
     println!("cargo:warning=OUT_PATH:{:#?}", env::var("OUT_DIR").unwrap());
@@ -1,31 +1,81 @@
 use core::slice;
 use mic2::{
-    mic,
-    nmea::types::{GPSInfo, GPSSatInfo, GpsNavigationStatus, GPSDMS},
+    analysis::{self, AnalysisConfig, AudioLevel, TriggerEdge},
+    audio::AudioChunk,
+    fixlog,
+    gps::{GPSParser, GpsConfig, GpsMessage, GpsProtocol},
+    hotplug::{HotplugEvent, HotplugMonitor},
+    io::{ButtonEdge, ButtonEvent, IOBitMode},
+    metrics::{FixMetrics, MetricsConfig},
+    mic::{self, Subsystem},
+    nmea::types::{
+        self as nmea_types, GPSClockMapping, GPSFix, GPSInfo, GPSSatInfo, GpsNavigationStatus,
+        GPSDMS,
+    },
+    reactor::Reactor,
+    ring::{self, RingConsumer},
+    stats::{
+        self as mic2_stats, AudioStatsSnapshot, GPSStatsSnapshot, HistogramSnapshot,
+        IOStatsSnapshot,
+    },
+    types::{self as mic2_types, monotonic_time_ns},
+    ubx,
 };
 use std::{
     ffi::{c_void, CStr, CString},
     os::raw::c_char,
-    rc::Rc,
-    sync::Mutex,
+    sync::{
+        atomic::{AtomicU32, Ordering},
+        Arc, Mutex,
+    },
+    time::Duration,
 };
 
 // Version of the API in use. This will allow forward compatibility without having to recompile your application, unless otherwise specified.
-pub const MIC2_API_VERSION: u32 = 0x1;
+// Bumped in the same change as any struct shared with C changing layout. History:
+//   0x1: initial release.
+//   0x2: CGPSInfo::monotonic_time_ns, current_time_ns, time_monotonic_ns and sequence,
+//        CAudioChunk::monotonic_time_ns. These landed over several changes before the bump.
+//   0x3: CGPSStats::fix_log_errors, bumped with the field.
+pub const MIC2_API_VERSION: u32 = 0x3;
 
+// Number of GPS updates buffered for mic2_gps_drain() before new ones are dropped.
+const GPS_RING_CAPACITY: usize = 128;
+// Number of audio levels buffered for mic2_audio_levels_drain(), 10 seconds of 20ms chunks.
+const AUDIO_LEVEL_RING_CAPACITY: usize = 512;
+// Number of trigger edges buffered for mic2_audio_triggers_drain().
+const AUDIO_TRIGGER_RING_CAPACITY: usize = 64;
+
+/// Filled by the audio capture thread once mic2_audio_analysis_start() was called.
+#[derive(Debug)]
+struct AudioLevelRings {
+    levels: RingConsumer<CAudioLevel>,
+    triggers: RingConsumer<CAudioLevel>,
+}
+
+/// Shared by every copy of a NeoVIMIC struct. mic::NeoVIMIC locks each subsystem on its own, so
+/// calls from different threads only wait on each other when they use the same subsystem.
 #[derive(Debug, Clone)]
 pub struct NeoVIMICHandle {
-    inner: Rc<Mutex<mic::NeoVIMIC>>,
+    inner: Arc<mic::NeoVIMIC>,
+    // Filled by the GPS reader thread once mic2_gps_drain() was called, kept outside of inner so
+    // draining never waits on the device.
+    gps_ring: Arc<Mutex<Option<RingConsumer<CGPSInfo>>>>,
+    audio_rings: Arc<Mutex<Option<AudioLevelRings>>>,
 }
 
 impl NeoVIMICHandle {
     pub fn from(neovi_mic: mic::NeoVIMIC) -> Self {
         Self {
-            inner: Rc::new(Mutex::new(neovi_mic)),
+            inner: Arc::new(neovi_mic),
+            gps_ring: Arc::new(Mutex::new(None)),
+            audio_rings: Arc::new(Mutex::new(None)),
         }
     }
 }
 
+/// A neoVI MIC2 found by mic2_find(). Functions taking a NeoVIMIC are safe to call from multiple
+/// threads at once, IO, GPS and audio are locked separately.
 #[repr(C)]
 #[derive(Debug)]
 pub struct NeoVIMIC {
@@ -54,6 +104,10 @@ pub enum NeoVIMICErrType {
     NeoVIMICErrTypeVersionMismatch,
     // Size mismatch. See NeoVIMICHandle::size.
     NeoVIMICErrTypeSizeMismatch,
+    // Not supported by the device or this build of libmic2, ie. a subsystem the device doesn't have.
+    NeoVIMICErrTypeNotSupported,
+    // Timed out, ie. the GPS receiver didn't acknowledge its configuration.
+    NeoVIMICErrTypeTimedOut,
 }
 
 impl From<u32> for NeoVIMICErrType {
@@ -65,7 +119,27 @@ impl From<u32> for NeoVIMICErrType {
             3 => NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
             4 => NeoVIMICErrType::NeoVIMICErrTypeVersionMismatch,
             5 => NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch,
-            _ => panic!("Unknown NeoVIMICErrType type: {}", error_type),
+            6 => NeoVIMICErrType::NeoVIMICErrTypeNotSupported,
+            7 => NeoVIMICErrType::NeoVIMICErrTypeTimedOut,
+            // Codes from a newer or corrupt caller, never panic across the C ABI
+            _ => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+        }
+    }
+}
+
+impl From<&mic2_types::Error> for NeoVIMICErrType {
+    fn from(error: &mic2_types::Error) -> Self {
+        match error {
+            mic2_types::Error::InvalidDevice(_) | mic2_types::Error::NotSupported(_) => {
+                NeoVIMICErrType::NeoVIMICErrTypeNotSupported
+            }
+            mic2_types::Error::IOError(std::io::ErrorKind::InvalidInput) => {
+                NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+            }
+            mic2_types::Error::IOError(std::io::ErrorKind::TimedOut) => {
+                NeoVIMICErrType::NeoVIMICErrTypeTimedOut
+            }
+            _ => NeoVIMICErrType::NeoVIMICErrTypeFailure,
         }
     }
 }
@@ -149,6 +223,161 @@ impl CGpsNavigationStatus {
     }
 }
 
+/// Relates the host monotonic clock (see mic2_monotonic_time_ns()) to GPS UTC time so host
+/// timestamps like CAudioChunk::monotonic_time_ns can be converted to UTC with
+/// mic2_gps_utc_time_ns_at(). See mic2_gps_clock_mapping().
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct CGPSClockMapping {
+    /// UTC time of the navigation epoch as unix timestamp in nanoseconds.
+    pub utc_time_ns: i64,
+    /// Host monotonic time the epoch was received (ns).
+    pub monotonic_time_ns: u64,
+    /// Receiver clock bias (ns), already corrected for in utc_time_ns. Only valid if clock_bias_valid is true.
+    pub clock_bias_ns: f64,
+    pub clock_bias_valid: bool,
+    /// Quantization error of the receiver time (ns), host receive latency comes on top of this.
+    /// Only valid if uncertainty_valid is true.
+    pub uncertainty_ns: f64,
+    pub uncertainty_valid: bool,
+}
+
+impl From<GPSClockMapping> for CGPSClockMapping {
+    fn from(mapping: GPSClockMapping) -> Self {
+        Self {
+            utc_time_ns: mapping
+                .utc_time
+                .and_utc()
+                .timestamp_nanos_opt()
+                .unwrap_or(0),
+            monotonic_time_ns: mapping.monotonic_time_ns,
+            clock_bias_ns: mapping.clock_bias_ns.unwrap_or(0.0),
+            clock_bias_valid: mapping.clock_bias_ns.is_some(),
+            uncertainty_ns: mapping.uncertainty_ns.unwrap_or(0.0),
+            uncertainty_valid: mapping.uncertainty_ns.is_some(),
+        }
+    }
+}
+
+/// Output protocol configured on the GPS receiver, see mic2_gps_open_protocol().
+#[repr(u32)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum CGpsProtocol {
+    /// Text PUBX,00/03/04 sentences at 1 Hz. Default used by mic2_gps_open().
+    CGpsProtocolNmea = 0,
+    /// Binary UBX-NAV-PVT/DOP/CLOCK at 10 Hz and UBX-NAV-SAT at 1 Hz.
+    CGpsProtocolUbx,
+}
+
+impl TryFrom<u32> for CGpsProtocol {
+    type Error = NeoVIMICErrType;
+
+    /// Protocols come from C as a plain integer, anything out of range is rejected.
+    fn try_from(protocol: u32) -> Result<Self, Self::Error> {
+        match protocol {
+            0 => Ok(CGpsProtocol::CGpsProtocolNmea),
+            1 => Ok(CGpsProtocol::CGpsProtocolUbx),
+            _ => Err(NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter),
+        }
+    }
+}
+
+impl From<CGpsProtocol> for GpsProtocol {
+    fn from(protocol: CGpsProtocol) -> Self {
+        match protocol {
+            CGpsProtocol::CGpsProtocolNmea => GpsProtocol::Nmea,
+            CGpsProtocol::CGpsProtocolUbx => GpsProtocol::Ubx,
+        }
+    }
+}
+
+// Messages for CGpsConfig::messages, combine with bitwise OR.
+// PUBX,00 Lat/Long position data
+pub const MIC2_GPS_MESSAGE_PUBX_POSITION: u32 = 0x01;
+// PUBX,03 Satellite status
+pub const MIC2_GPS_MESSAGE_PUBX_SVSTATUS: u32 = 0x02;
+// PUBX,04 Time of day and clock information
+pub const MIC2_GPS_MESSAGE_PUBX_TIME: u32 = 0x04;
+// UBX-NAV-PVT Navigation position velocity time solution
+pub const MIC2_GPS_MESSAGE_NAV_PVT: u32 = 0x08;
+// UBX-NAV-DOP Dilution of precision
+pub const MIC2_GPS_MESSAGE_NAV_DOP: u32 = 0x10;
+// UBX-NAV-CLOCK Clock solution
+pub const MIC2_GPS_MESSAGE_NAV_CLOCK: u32 = 0x20;
+// UBX-NAV-SAT Satellite information, output once a second
+pub const MIC2_GPS_MESSAGE_NAV_SAT: u32 = 0x40;
+// Keep in sync with mic2::gps::GpsMessage
+const _: () = assert!(
+    MIC2_GPS_MESSAGE_PUBX_POSITION == GpsMessage::PubxPosition as u32
+        && MIC2_GPS_MESSAGE_PUBX_SVSTATUS == GpsMessage::PubxSvStatus as u32
+        && MIC2_GPS_MESSAGE_PUBX_TIME == GpsMessage::PubxTime as u32
+        && MIC2_GPS_MESSAGE_NAV_PVT == GpsMessage::NavPvt as u32
+        && MIC2_GPS_MESSAGE_NAV_DOP == GpsMessage::NavDop as u32
+        && MIC2_GPS_MESSAGE_NAV_CLOCK == GpsMessage::NavClock as u32
+        && MIC2_GPS_MESSAGE_NAV_SAT == GpsMessage::NavSat as u32
+);
+
+// IO lines for mic2_io_read_state() and mic2_io_write_state(), combine with bitwise OR.
+// Buzzer output, set is on
+pub const MIC2_IO_BUZZER: u8 = 0x01;
+// Button input, set is pressed
+pub const MIC2_IO_BUTTON: u8 = 0x02;
+// GPS LED output, set is on
+pub const MIC2_IO_GPSLED: u8 = 0x04;
+// Keep in sync with mic2::io::IOBitMode
+const _: () = assert!(
+    MIC2_IO_BUZZER == IOBitMode::Buzzer as u8
+        && MIC2_IO_BUTTON == IOBitMode::Button as u8
+        && MIC2_IO_GPSLED == IOBitMode::GPSLed as u8
+);
+
+// Subsystems for mic2_open_all(), combine with bitwise OR.
+// FTDI IO, see mic2_io_open()
+pub const MIC2_SUBSYSTEM_IO: u8 = 0x01;
+// GPS receiver, see mic2_gps_open_config()
+pub const MIC2_SUBSYSTEM_GPS: u8 = 0x02;
+// Keep in sync with mic2::mic::Subsystem
+const _: () =
+    assert!(MIC2_SUBSYSTEM_IO == Subsystem::Io as u8 && MIC2_SUBSYSTEM_GPS == Subsystem::Gps as u8);
+
+/// GPS receiver setup, see mic2_gps_config_default() and mic2_gps_open_config().
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CGpsConfig {
+    /// Time between GNSS measurements in milliseconds, minimum 25.
+    pub measurement_rate_ms: u16,
+    /// Number of measurements per navigation solution, 1 to 127.
+    pub navigation_rate: u16,
+    /// Baud rate of the host serial port.
+    pub baud_rate: u32,
+    /// Output messages, bitwise OR of MIC2_GPS_MESSAGE_* values. Everything else is disabled.
+    pub messages: u32,
+}
+
+impl From<GpsConfig> for CGpsConfig {
+    fn from(config: GpsConfig) -> Self {
+        Self {
+            measurement_rate_ms: config.measurement_rate_ms,
+            navigation_rate: config.navigation_rate,
+            baud_rate: config.baud_rate,
+            messages: config.messages.bits() as u32,
+        }
+    }
+}
+
+impl TryFrom<CGpsConfig> for GpsConfig {
+    type Error = mic2::types::Error;
+
+    fn try_from(config: CGpsConfig) -> Result<Self, Self::Error> {
+        Ok(Self {
+            measurement_rate_ms: config.measurement_rate_ms,
+            navigation_rate: config.navigation_rate,
+            baud_rate: config.baud_rate,
+            messages: GpsMessage::from_bits(config.messages)?,
+        })
+    }
+}
+
 #[repr(C)]
 #[derive(Debug, Clone, Copy, PartialEq)]
 pub struct CGPSDMS {
@@ -213,10 +442,19 @@ pub struct CGPSInfo {
     pub clock_drift: f64,
     /// Timepulse Granularity, The quantization error of the Timepulse pin (ns). -1 means invalid.
     pub timepulse_granularity: f64,
+    /// Host monotonic time this update was received (ns), see mic2_monotonic_time_ns(). Zero means invalid.
+    pub monotonic_time_ns: u64,
+    /// UTC Time as unix timestamp in nanoseconds, current_time with sub-second precision. Zero means invalid.
+    pub current_time_ns: i64,
+    /// Host monotonic time the message carrying current_time was received (ns). Zero means invalid.
+    /// Together with current_time_ns this maps host timestamps to UTC, see CGPSClockMapping.
+    pub time_monotonic_ns: u64,
+    /// Incremented on every update applied, zero means nothing has been received yet. See mic2_gps_info_if_newer().
+    pub sequence: u64,
 }
 
-impl From<GPSInfo> for CGPSInfo {
-    fn from(gps_info: GPSInfo) -> Self {
+impl From<&GPSInfo> for CGPSInfo {
+    fn from(gps_info: &GPSInfo) -> Self {
         let (lat_dms, lat_dir, lat_valid) = match gps_info.latitude {
             Some((dms, dir)) => (dms, dir as c_char, true),
             None => (
@@ -269,19 +507,626 @@ impl From<GPSInfo> for CGPSInfo {
             vdop: gps_info.vdop.unwrap_or(-1.0),
             tdop: gps_info.tdop.unwrap_or(-1.0),
             satellites: Default::default(),
-            satellites_count: gps_info.satellites.len() as u8,
+            satellites_count: 0,
             clock_bias: gps_info.clock_bias.unwrap_or(-1.0),
             clock_drift: gps_info.clock_drift.unwrap_or(-1.0),
             timepulse_granularity: gps_info.timepulse_granularity.unwrap_or(-1.0),
+            monotonic_time_ns: gps_info.monotonic_time_ns,
+            current_time_ns: gps_info
+                .current_time
+                .and_then(|current_time| current_time.and_utc().timestamp_nanos_opt())
+                .unwrap_or(0),
+            time_monotonic_ns: gps_info.time_monotonic_ns,
+            sequence: gps_info.sequence,
         };
-        // Copy all the satellites into the C struct
-        for (i, sat) in gps_info.satellites.into_iter().enumerate() {
-            info.satellites[i] = sat.into();
+        // Copy all the satellites into the C struct, UBX-NAV-SAT can report more than fit
+        for (c_sat, sat) in info.satellites.iter_mut().zip(gps_info.satellites.iter()) {
+            *c_sat = (*sat).into();
+            info.satellites_count += 1;
         }
         info
     }
 }
 
+impl From<GPSInfo> for CGPSInfo {
+    fn from(gps_info: GPSInfo) -> Self {
+        Self::from(&gps_info)
+    }
+}
+
+/// Position, velocity and DOP without the satellites, see mic2_gps_fix(). Much smaller than
+/// CGPSInfo for consumers storing or shipping every update. Use mic2_gps_satellites() for the
+/// satellites in view.
+#[repr(C)]
+pub struct CGPSFix {
+    /// UTC Time as unix timestamp in nanoseconds. Zero means invalid.
+    pub current_time_ns: i64,
+    /// Host monotonic time this update was received (ns), see mic2_monotonic_time_ns(). Zero means invalid.
+    pub monotonic_time_ns: u64,
+    /// Latitude in decimal degrees, negative is south. Only valid if position_valid is true.
+    pub latitude: f64,
+    /// Longitude in decimal degrees, negative is west. Only valid if position_valid is true.
+    pub longitude: f64,
+    /// Altitude above user datum ellipsoid (m). -1 means invalid.
+    pub altitude: f64,
+    /// Horizontal accuracy estimate. -1 means invalid.
+    pub h_acc: f64,
+    /// Vertical accuracy estimate. -1 means invalid.
+    pub v_acc: f64,
+    /// Speed over ground (km/h). -1 means invalid.
+    pub sog_kmh: f64,
+    /// Course over ground (degrees). -1 means invalid.
+    pub cog: f64,
+    /// Vertical velocity, positive = downward (m/s). -1 means invalid.
+    pub vvel: f64,
+    /// HDOP, Horizontal Dilution of Precision. -1 means invalid.
+    pub hdop: f64,
+    /// VDOP, Vertical dilution of precision. -1 means invalid.
+    pub vdop: f64,
+    /// TDOP, Time dilution of precision. -1 means invalid.
+    pub tdop: f64,
+    /// Navigation Status. See [GpsNavigationStatus] for more details
+    pub nav_stat: CGpsNavigationStatus,
+    /// Number of satellites in view, see mic2_gps_satellites().
+    pub satellites_count: u16,
+    /// Number of satellites used in the solution.
+    pub satellites_used: u16,
+    /// Both latitude and longitude are valid.
+    pub position_valid: bool,
+}
+
+impl From<GPSFix> for CGPSFix {
+    fn from(fix: GPSFix) -> Self {
+        let (latitude, longitude, position_valid) = match (fix.latitude, fix.longitude) {
+            (Some(latitude), Some(longitude)) => (latitude, longitude, true),
+            _ => (0.0, 0.0, false),
+        };
+        Self {
+            current_time_ns: fix
+                .current_time
+                .and_then(|current_time| current_time.and_utc().timestamp_nanos_opt())
+                .unwrap_or(0),
+            monotonic_time_ns: fix.monotonic_time_ns,
+            latitude,
+            longitude,
+            altitude: fix.altitude.unwrap_or(-1.0),
+            h_acc: fix.h_acc.unwrap_or(-1.0),
+            v_acc: fix.v_acc.unwrap_or(-1.0),
+            sog_kmh: fix.sog_kmh.unwrap_or(-1.0),
+            cog: fix.cog.unwrap_or(-1.0),
+            vvel: fix.vvel.unwrap_or(-1.0),
+            hdop: fix.hdop.unwrap_or(-1.0),
+            vdop: fix.vdop.unwrap_or(-1.0),
+            tdop: fix.tdop.unwrap_or(-1.0),
+            nav_stat: CGpsNavigationStatus::from(
+                fix.nav_stat.unwrap_or(GpsNavigationStatus::NoFix),
+            ),
+            satellites_count: fix.satellites_count,
+            satellites_used: fix.satellites_used,
+            position_valid,
+        }
+    }
+}
+
+// Fix log file format written by mic2_gps_fix_log_start(). Records are CGPSFix structs in
+// little-endian byte order starting at the header_length stored in the header. The header
+// stores MIC2_FIX_LOG_BYTE_ORDER little-endian at offset 16 and the UTC time in ns of
+// monotonic_time_ns 0 at offset 24.
+pub const MIC2_FIX_LOG_VERSION: u16 = 2;
+pub const MIC2_FIX_LOG_HEADER_LENGTH: u32 = 32;
+pub const MIC2_FIX_LOG_BYTE_ORDER: u32 = 0x01020304;
+// Keep in sync with mic2::fixlog, records are used in place as CGPSFix
+const _: () = assert!(
+    MIC2_FIX_LOG_VERSION == fixlog::FIX_LOG_VERSION
+        && MIC2_FIX_LOG_HEADER_LENGTH as usize == fixlog::FIX_LOG_HEADER_LENGTH
+        && MIC2_FIX_LOG_BYTE_ORDER == fixlog::FIX_LOG_BYTE_ORDER
+        && std::mem::size_of::<CGPSFix>() == fixlog::FIX_LOG_RECORD_LENGTH
+        && std::mem::offset_of!(CGPSFix, monotonic_time_ns) == 8
+        && std::mem::offset_of!(CGPSFix, latitude) == 16
+        && std::mem::offset_of!(CGPSFix, tdop) == 96
+        && std::mem::offset_of!(CGPSFix, nav_stat) == 104
+        && std::mem::offset_of!(CGPSFix, satellites_count) == 108
+        && std::mem::offset_of!(CGPSFix, satellites_used) == 110
+        && std::mem::offset_of!(CGPSFix, position_valid) == 112
+);
+
+// Satellite flags reported by mic2_gps_satellites(), combine with bitwise OR.
+// Satellite is used in the solution
+pub const MIC2_GPS_SAT_USED: u8 = 0x01;
+// azimuth is valid
+pub const MIC2_GPS_SAT_AZIMUTH_VALID: u8 = 0x02;
+// elevation is valid
+pub const MIC2_GPS_SAT_ELEVATION_VALID: u8 = 0x04;
+// snr is valid
+pub const MIC2_GPS_SAT_SNR_VALID: u8 = 0x08;
+// Keep in sync with mic2::nmea::types::GPS_SAT_*
+const _: () = assert!(
+    MIC2_GPS_SAT_USED == nmea_types::GPS_SAT_USED
+        && MIC2_GPS_SAT_AZIMUTH_VALID == nmea_types::GPS_SAT_AZIMUTH_VALID
+        && MIC2_GPS_SAT_ELEVATION_VALID == nmea_types::GPS_SAT_ELEVATION_VALID
+        && MIC2_GPS_SAT_SNR_VALID == nmea_types::GPS_SAT_SNR_VALID
+);
+
+// Number of buckets in a CHistogram.
+pub const MIC2_STATS_HISTOGRAM_BUCKETS: usize = 24;
+// Keep in sync with mic2::stats
+const _: () = assert!(MIC2_STATS_HISTOGRAM_BUCKETS == mic2_stats::HISTOGRAM_BUCKETS);
+
+/// Log2 histogram of durations in microseconds. buckets[0] counts durations under 1us,
+/// buckets[i] counts [2^(i-1), 2^i) us and the last bucket everything from 2^22 us (about 4 s) up.
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CHistogram {
+    pub buckets: [u64; MIC2_STATS_HISTOGRAM_BUCKETS],
+    /// Number of durations recorded
+    pub count: u64,
+    /// Sum of all durations recorded (us)
+    pub sum_us: u64,
+    /// Longest duration recorded (us)
+    pub max_us: u64,
+}
+
+impl From<HistogramSnapshot> for CHistogram {
+    fn from(histogram: HistogramSnapshot) -> Self {
+        Self {
+            buckets: histogram.buckets,
+            count: histogram.count,
+            sum_us: histogram.sum_us,
+            max_us: histogram.max_us,
+        }
+    }
+}
+
+/// GPS reader thread counters, see mic2_stats().
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CGPSStats {
+    /// Bytes read from the serial port
+    pub bytes_read: u64,
+    /// Reads that returned data
+    pub reads: u64,
+    /// Reads that timed out without data
+    pub read_timeouts: u64,
+    /// Reads that ended inside a frame, the rest of it is reassembled from the next read
+    pub partial_reads: u64,
+    /// NMEA sentences framed
+    pub nmea_sentences: u64,
+    /// UBX packets framed
+    pub ubx_messages: u64,
+    /// Framed messages that were dropped because they aren't supported or failed to parse
+    pub unsupported: u64,
+    /// Frames dropped by the framer, ie. bad checksums or oversized frames
+    pub invalid_frames: u64,
+    /// Position updates, PUBX00 or UBX-NAV-PVT
+    pub fixes: u64,
+    /// Time the reader thread waited for readers of the GPS info to release it (ns)
+    pub lock_wait_ns: u64,
+    /// Failed writes of mic2_gps_raw_tap_file(), the bytes are lost
+    pub tap_write_errors: u64,
+    /// Failed writes of mic2_gps_fix_log_start(), each one stops the log
+    pub fix_log_errors: u64,
+    /// Time between position updates
+    pub fix_interval: CHistogram,
+    /// Time from a read returning to its frames being parsed and published, subscriber callbacks included
+    pub parse_latency: CHistogram,
+}
+
+impl From<GPSStatsSnapshot> for CGPSStats {
+    fn from(stats: GPSStatsSnapshot) -> Self {
+        Self {
+            bytes_read: stats.bytes_read,
+            reads: stats.reads,
+            read_timeouts: stats.read_timeouts,
+            partial_reads: stats.partial_reads,
+            nmea_sentences: stats.nmea_sentences,
+            ubx_messages: stats.ubx_messages,
+            unsupported: stats.unsupported,
+            invalid_frames: stats.invalid_frames,
+            fixes: stats.fixes,
+            lock_wait_ns: stats.lock_wait_ns,
+            tap_write_errors: stats.tap_write_errors,
+            fix_log_errors: stats.fix_log_errors,
+            fix_interval: stats.fix_interval.into(),
+            parse_latency: stats.parse_latency.into(),
+        }
+    }
+}
+
+/// IO transfer counters, see mic2_stats().
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CIOStats {
+    /// libftdi calls made
+    pub transfers: u64,
+    /// Time spent waiting for another thread's transfer to finish (ns)
+    pub lock_wait_ns: u64,
+}
+
+impl From<IOStatsSnapshot> for CIOStats {
+    fn from(stats: IOStatsSnapshot) -> Self {
+        Self {
+            transfers: stats.transfers,
+            lock_wait_ns: stats.lock_wait_ns,
+        }
+    }
+}
+
+/// Audio capture counters, see mic2_stats().
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CAudioStats {
+    /// Samples received from the capture device while streaming or recording
+    pub samples: u64,
+    /// Chunks handed to the stream callback
+    pub chunks: u64,
+    /// Chunks dropped because writing a recording to disk fell behind
+    pub dropped_chunks: u64,
+}
+
+impl From<AudioStatsSnapshot> for CAudioStats {
+    fn from(stats: AudioStatsSnapshot) -> Self {
+        Self {
+            samples: stats.samples,
+            chunks: stats.chunks,
+            dropped_chunks: stats.dropped_chunks,
+        }
+    }
+}
+
+/// Counters of every subsystem, see mic2_stats(). A subsystem's counters are zero if its valid flag is false.
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CDeviceStats {
+    pub gps: CGPSStats,
+    pub gps_valid: bool,
+    pub io: CIOStats,
+    pub io_valid: bool,
+    pub audio: CAudioStats,
+    pub audio_valid: bool,
+}
+
+/// Compact state of one device, see mic2_snapshot().
+#[repr(C)]
+pub struct CDeviceStatus {
+    /// Latest position. Zeroed with position_valid false while gps_open is false.
+    pub fix: CGPSFix,
+    pub gps_open: bool,
+    pub gps_has_lock: bool,
+    pub io_open: bool,
+    /// Bitwise OR of the MIC2_IO_* lines last known to be high, only lines in io_known are meaningful.
+    pub io_state: u8,
+    /// Bitwise OR of the MIC2_IO_* lines whose level is known without a USB transfer: the outputs once written or
+    /// read since mic2_io_open() and MIC2_IO_BUTTON while mic2_io_button_monitor_start() runs.
+    pub io_known: u8,
+}
+
+/// Outcome of opening one device, see mic2_open_all(). NeoVIMICErrTypeSuccess for subsystems that weren't requested.
+/// A failed subsystem reports why: NeoVIMICErrTypeNotSupported if the device doesn't have it,
+/// NeoVIMICErrTypeTimedOut if the GPS receiver didn't acknowledge its configuration, NeoVIMICErrTypeFailure otherwise.
+#[repr(C)]
+pub struct COpenResult {
+    pub io: NeoVIMICErrType,
+    pub gps: NeoVIMICErrType,
+}
+
+impl From<mic::OpenResult> for COpenResult {
+    fn from(result: mic::OpenResult) -> Self {
+        let err_type = |error: Option<&mic2_types::Error>| match error {
+            Some(error) => error.into(),
+            None => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        };
+        Self {
+            io: err_type(result.io.as_ref().and_then(|io| io.as_ref().err())),
+            gps: err_type(result.gps.as_ref().and_then(|gps| gps.as_ref().err())),
+        }
+    }
+}
+
+impl From<mic::DeviceStatus> for CDeviceStatus {
+    fn from(status: mic::DeviceStatus) -> Self {
+        const IO_LINES: u8 = MIC2_IO_BUZZER | MIC2_IO_BUTTON | MIC2_IO_GPSLED;
+        Self {
+            fix: status.gps_fix.unwrap_or_default().into(),
+            gps_open: status.gps_open,
+            gps_has_lock: status.gps_has_lock,
+            io_open: status.io_open,
+            io_state: status.io_state & IO_LINES,
+            io_known: status.io_known & IO_LINES,
+        }
+    }
+}
+
+/// Callback invoked from the GPS reader thread after every PUBX00/03/04 or UBX-NAV update.
+///
+/// @param info         Pointer to the updated CGPSInfo. Only valid for the duration of the call.
+/// @param user_data    user_data pointer passed to mic2_gps_subscribe().
+pub type CGPSInfoCallback =
+    Option<unsafe extern "C" fn(info: *const CGPSInfo, user_data: *mut c_void)>;
+
+/// Called once when user_data isn't needed anymore so the caller can release it. That is when
+/// the subscription is removed, the stream stops or the call taking user_data fails.
+///
+/// @param user_data    user_data pointer passed to mic2_gps_subscribe() or mic2_audio_stream_start().
+pub type CUserDataFree = Option<unsafe extern "C" fn(user_data: *mut c_void)>;
+
+/// Release user_data when a function that takes ownership of it fails early.
+fn free_user_data(user_data: *mut c_void, user_data_free: CUserDataFree) {
+    if let Some(user_data_free) = user_data_free {
+        unsafe { user_data_free(user_data) };
+    }
+}
+
+/// Owns the C callback and user_data of a subscription. user_data is released through
+/// user_data_free when the subscription is dropped.
+struct CGPSInfoSubscriber {
+    callback: unsafe extern "C" fn(info: *const CGPSInfo, user_data: *mut c_void),
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+}
+
+// The caller is responsible for user_data being usable from the GPS reader thread.
+unsafe impl Send for CGPSInfoSubscriber {}
+
+impl CGPSInfoSubscriber {
+    fn call(&self, gps_info: &GPSInfo) {
+        let info = CGPSInfo::from(gps_info);
+        unsafe { (self.callback)(&info, self.user_data) };
+    }
+}
+
+impl Drop for CGPSInfoSubscriber {
+    fn drop(&mut self) {
+        if let Some(user_data_free) = self.user_data_free {
+            unsafe { user_data_free(self.user_data) };
+        }
+    }
+}
+
+/// Raw GPS serial bytes, see mic2_gps_raw_tap_start().
+///
+/// @param data         Bytes exactly as read from the serial port. Only valid for the duration of the call.
+/// @param length       Number of bytes in data.
+/// @param user_data    user_data pointer passed to mic2_gps_raw_tap_start().
+pub type CRawTapCallback =
+    Option<unsafe extern "C" fn(data: *const u8, length: usize, user_data: *mut c_void)>;
+
+/// Owns the C callback and user_data of a raw tap, see [CGPSInfoSubscriber].
+struct CRawTapSubscriber {
+    callback: unsafe extern "C" fn(data: *const u8, length: usize, user_data: *mut c_void),
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+}
+
+// The caller is responsible for user_data being usable from the GPS reader thread.
+unsafe impl Send for CRawTapSubscriber {}
+
+impl CRawTapSubscriber {
+    fn call(&self, bytes: &[u8]) {
+        unsafe { (self.callback)(bytes.as_ptr(), bytes.len(), self.user_data) };
+    }
+}
+
+impl Drop for CRawTapSubscriber {
+    fn drop(&mut self) {
+        free_user_data(self.user_data, self.user_data_free);
+    }
+}
+
+/// Debounced button change, see mic2_io_button_monitor_start().
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct CButtonEvent {
+    /// true when the button was pressed, false when released.
+    pub pressed: bool,
+    /// Host monotonic time of the first sample in the new state (ns), see mic2_monotonic_time_ns().
+    pub monotonic_time_ns: u64,
+}
+
+impl From<ButtonEvent> for CButtonEvent {
+    fn from(event: ButtonEvent) -> Self {
+        Self {
+            pressed: event.edge == ButtonEdge::Pressed,
+            monotonic_time_ns: event.monotonic_time_ns,
+        }
+    }
+}
+
+/// Button monitor callback, see mic2_io_button_monitor_start().
+pub type CButtonEventCallback =
+    Option<unsafe extern "C" fn(event: *const CButtonEvent, user_data: *mut c_void)>;
+
+/// Owns the C callback and user_data of a button monitor, see CGPSInfoSubscriber.
+struct CButtonEventSubscriber {
+    callback: unsafe extern "C" fn(event: *const CButtonEvent, user_data: *mut c_void),
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+}
+
+// The caller is responsible for user_data being usable from the button monitor thread.
+unsafe impl Send for CButtonEventSubscriber {}
+
+impl CButtonEventSubscriber {
+    fn call(&self, event: ButtonEvent) {
+        let event = CButtonEvent::from(event);
+        unsafe { (self.callback)(&event, self.user_data) };
+    }
+}
+
+impl Drop for CButtonEventSubscriber {
+    fn drop(&mut self) {
+        free_user_data(self.user_data, self.user_data_free);
+    }
+}
+
+/// Block of captured audio, see mic2_audio_stream_start().
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct CAudioChunk {
+    /// Mono 16-bit PCM samples, only valid for the duration of the callback.
+    pub samples: *const i16,
+    /// Number of samples, always the chunk_length passed to mic2_audio_stream_start().
+    pub samples_count: u32,
+    /// Sample rate in Hz
+    pub sample_rate: u32,
+    /// Number of chunks delivered before this one since the stream started.
+    pub sequence: u64,
+    /// Host monotonic time the first sample was captured (ns), same clock as
+    /// CGPSInfo::monotonic_time_ns. See mic2_gps_clock_mapping() to convert it to UTC.
+    pub monotonic_time_ns: u64,
+}
+
+impl From<&AudioChunk<'_>> for CAudioChunk {
+    fn from(chunk: &AudioChunk) -> Self {
+        Self {
+            samples: chunk.samples.as_ptr(),
+            samples_count: chunk.samples.len() as u32,
+            sample_rate: chunk.sample_rate,
+            sequence: chunk.sequence,
+            monotonic_time_ns: chunk.monotonic_time_ns,
+        }
+    }
+}
+
+/// Called from the audio capture thread with every chunk, see mic2_audio_stream_start().
+///
+/// @param chunk        Pointer to the chunk, only valid for the duration of the call.
+/// @param user_data    user_data pointer passed to mic2_audio_stream_start().
+pub type CAudioChunkCallback =
+    Option<unsafe extern "C" fn(chunk: *const CAudioChunk, user_data: *mut c_void)>;
+
+/// Owns the C callback and user_data of an audio stream. user_data is released through
+/// user_data_free when the stream stops.
+struct CAudioChunkSubscriber {
+    callback: unsafe extern "C" fn(chunk: *const CAudioChunk, user_data: *mut c_void),
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+}
+
+// The caller is responsible for user_data being usable from the audio capture thread.
+unsafe impl Send for CAudioChunkSubscriber {}
+
+impl CAudioChunkSubscriber {
+    fn call(&self, chunk: &AudioChunk) {
+        let chunk = CAudioChunk::from(chunk);
+        unsafe { (self.callback)(&chunk, self.user_data) };
+    }
+}
+
+impl Drop for CAudioChunkSubscriber {
+    fn drop(&mut self) {
+        if let Some(user_data_free) = self.user_data_free {
+            unsafe { user_data_free(self.user_data) };
+        }
+    }
+}
+
+/// Tuning of the audio analysis, see mic2_audio_analysis_config_default() and mic2_audio_analysis_start().
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CAnalysisConfig {
+    /// Split between the low and mid band (Hz)
+    pub low_cutoff_hz: f32,
+    /// Split between the mid and high band (Hz). The mid band defaults to the speech band.
+    pub high_cutoff_hz: f32,
+    /// Chunks at or above this level always trigger (dBFS)
+    pub threshold_dbfs: f32,
+    /// Chunks with the mid band this far above its noise floor trigger (dB)
+    pub snr_db: f32,
+    /// How long the trigger stays active after the last chunk that triggered (ms)
+    pub hang_ms: u32,
+}
+
+impl From<AnalysisConfig> for CAnalysisConfig {
+    fn from(config: AnalysisConfig) -> Self {
+        Self {
+            low_cutoff_hz: config.low_cutoff_hz,
+            high_cutoff_hz: config.high_cutoff_hz,
+            threshold_dbfs: config.threshold_dbfs,
+            snr_db: config.snr_db,
+            hang_ms: config.hang.as_millis() as u32,
+        }
+    }
+}
+
+impl From<CAnalysisConfig> for AnalysisConfig {
+    fn from(config: CAnalysisConfig) -> Self {
+        Self {
+            low_cutoff_hz: config.low_cutoff_hz,
+            high_cutoff_hz: config.high_cutoff_hz,
+            threshold_dbfs: config.threshold_dbfs,
+            snr_db: config.snr_db,
+            hang: Duration::from_millis(config.hang_ms.into()),
+        }
+    }
+}
+
+/// Edge of the audio trigger, see CAudioLevel::trigger.
+#[repr(u32)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum CTriggerEdge {
+    /// CAudioLevel::active didn't change
+    CTriggerEdgeNone = 0,
+    /// The chunk is the first one of an event
+    CTriggerEdgeStart,
+    /// The chunk is the first one after an event, the hang ran out
+    CTriggerEdgeStop,
+}
+
+impl From<Option<TriggerEdge>> for CTriggerEdge {
+    fn from(edge: Option<TriggerEdge>) -> Self {
+        match edge {
+            None => CTriggerEdge::CTriggerEdgeNone,
+            Some(TriggerEdge::Start) => CTriggerEdge::CTriggerEdgeStart,
+            Some(TriggerEdge::Stop) => CTriggerEdge::CTriggerEdgeStop,
+        }
+    }
+}
+
+/// Number of bands in CAudioLevel::bands_dbfs: low, mid and high.
+pub const MIC2_AUDIO_BANDS: usize = 3;
+// Keep in sync with mic2::analysis::AUDIO_BANDS
+const _: () = assert!(MIC2_AUDIO_BANDS == analysis::AUDIO_BANDS);
+
+/// Level of one audio chunk, see mic2_audio_levels_drain().
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CAudioLevel {
+    /// CAudioChunk::sequence of the chunk
+    pub sequence: u64,
+    /// CAudioChunk::monotonic_time_ns of the chunk
+    pub monotonic_time_ns: u64,
+    /// Number of samples in the chunk
+    pub samples: u32,
+    /// Root mean square level (dBFS), -120 for silence
+    pub rms_dbfs: f32,
+    /// Largest sample (dBFS)
+    pub peak_dbfs: f32,
+    /// Root mean square level of the low, mid and high band (dBFS)
+    pub bands_dbfs: [f32; MIC2_AUDIO_BANDS],
+    /// Background level of the mid band the trigger compares against (dBFS)
+    pub noise_floor_dbfs: f32,
+    /// The chunk is part of an event, including the hang after it
+    pub active: bool,
+    /// Set on the chunks where active changes
+    pub trigger: CTriggerEdge,
+}
+
+impl From<&AudioLevel> for CAudioLevel {
+    fn from(level: &AudioLevel) -> Self {
+        Self {
+            sequence: level.sequence,
+            monotonic_time_ns: level.monotonic_time_ns,
+            samples: level.samples,
+            rms_dbfs: level.rms_dbfs,
+            peak_dbfs: level.peak_dbfs,
+            bands_dbfs: level.bands_dbfs,
+            noise_floor_dbfs: level.noise_floor_dbfs,
+            active: level.active,
+            trigger: level.trigger.into(),
+        }
+    }
+}
+
 #[no_mangle]
 extern "C" fn mic2_error_string(
     error_type: u32,
@@ -292,13 +1137,18 @@ extern "C" fn mic2_error_string(
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
     // Get the error string
+    let known = error_type <= NeoVIMICErrType::NeoVIMICErrTypeTimedOut as u32;
     let error_msg = match NeoVIMICErrType::from(error_type) {
+        // Same text as mic2::error_string_view() for codes it doesn't know
+        _ if !known => "Unknown Error",
         NeoVIMICErrType::NeoVIMICErrTypeSuccess => "Success",
         NeoVIMICErrType::NeoVIMICErrTypeFailure => "Failure",
         NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter => "Invalid Parameter",
         NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex => "Invalid Index",
         NeoVIMICErrType::NeoVIMICErrTypeVersionMismatch => "Version Mismatch",
         NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch => "Size Mismatch",
+        NeoVIMICErrType::NeoVIMICErrTypeNotSupported => "Not Supported",
+        NeoVIMICErrType::NeoVIMICErrTypeTimedOut => "Timed Out",
     };
     // Convert the buffer to a slice
     let buffer_length = unsafe { *length as usize };
@@ -319,62 +1169,194 @@ extern "C" fn mic2_error_string(
 
     NeoVIMICErrType::NeoVIMICErrTypeSuccess
 }
-/// Find all neovi MIC2s.
-///
-/// @param devices    Pointer to an array of NeoVIMIC structs. These need to be allocated by the caller.
-///                   Unused devices should be freed using mic2_free() to avoid memory leaks.
-///                   Although this parameter is const, it is still modifed by the function. This is a convinience so all the other
-///                   function calls don't need a const cast.
-/// @param length     Length of devices. Must not be null, returns NeoVIMICErrTypeInvalidParameter if it is. Set to how many devices are found.
-///
-/// @return           NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
-#[no_mangle]
-extern "C" fn mic2_find(
-    devices: *const NeoVIMIC,
-    length: *mut u32,
-    api_version: u32,
-    neovi_mic_size: u32,
-) -> NeoVIMICErrType {
-    if devices.is_null() || length.is_null() {
-        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
-    }
-    // Check if the version is compatible
+// Devices found by mic2_find_count() that mic2_find_fill() hasn't handed out yet.
+static FIND_CACHE: Mutex<Option<std::collections::VecDeque<NeoVIMICHandle>>> = Mutex::new(None);
+
+// Handles are shared between C threads, see NeoVIMICHandle.
+const _: fn() = || {
+    fn assert_send_sync<T: Send + Sync>() {}
+    assert_send_sync::<NeoVIMICHandle>();
+};
+
+/// Check the api version and struct size passed to the mic2_find*() functions.
+fn check_find_version(api_version: u32, neovi_mic_size: u32) -> Result<(), NeoVIMICErrType> {
+    // Check if the version is compatible
     if api_version != MIC2_API_VERSION {
-        return NeoVIMICErrType::NeoVIMICErrTypeVersionMismatch;
+        return Err(NeoVIMICErrType::NeoVIMICErrTypeVersionMismatch);
     }
     // make sure we have enough space
     if neovi_mic_size < std::mem::size_of::<NeoVIMIC>() as u32 {
-        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+        return Err(NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch);
     }
-    // Find all the attached neovi MIC2s
-    let mut found_devices = match mic::find_neovi_mics() {
-        Ok(d) => d
-            .into_iter()
-            .map(NeoVIMICHandle::from)
-            .collect::<Vec<NeoVIMICHandle>>(),
-        Err(_e) => return NeoVIMICErrType::NeoVIMICErrTypeFailure,
-    };
-    // Set the length of the devices array
-    let length = unsafe { &mut *length };
-    *length = std::cmp::min(*length, found_devices.len() as u32);
-    // Convert the devices array to a mutable slice
-    let devices = unsafe { slice::from_raw_parts_mut(devices as *mut NeoVIMIC, *length as usize) };
+    Ok(())
+}
+
+/// Find all the attached neovi MIC2s in discovery order.
+fn find_handles() -> Result<std::collections::VecDeque<NeoVIMICHandle>, NeoVIMICErrType> {
+    match mic::find_neovi_mics() {
+        Ok(d) => Ok(d.into_iter().map(NeoVIMICHandle::from).collect()),
+        Err(_e) => Err(NeoVIMICErrType::NeoVIMICErrTypeFailure),
+    }
+}
+
+/// Null terminated copy of serial_number, truncated to fit.
+fn copy_serial_number(buffer: &mut [c_char], serial_number: &str) {
+    buffer.fill(0);
+    let sn = CString::new(serial_number).unwrap_or_default();
+    let sn_len = std::cmp::min(sn.as_bytes_with_nul().len(), buffer.len() - 1);
+    unsafe {
+        buffer[..sn_len].copy_from_slice(slice::from_raw_parts(sn.as_ptr(), sn_len));
+    }
+}
+
+/// Hand found_device over to device, it is released by mic2_free().
+fn write_device(
+    device: &mut NeoVIMIC,
+    found_device: NeoVIMICHandle,
+    api_version: u32,
+    neovi_mic_size: u32,
+) {
+    device.version = api_version;
+    device.size = neovi_mic_size;
+    // Copy the serial number over
+    let serial_number = found_device.inner.get_serial_number();
+    copy_serial_number(device.serial_number.as_mut_slice(), &serial_number);
+    // Copy the handle over
+    device.handle = Box::into_raw(Box::new(found_device)) as *mut _;
+}
+
+/// The caller's array of `length` devices, null is accepted when `length` is zero.
+///
+/// # Safety
+/// Unless null, `devices` must point to `length` writable NeoVIMIC structs.
+unsafe fn devices_slice<'a>(devices: *const NeoVIMIC, length: u32) -> &'a mut [NeoVIMIC] {
+    if devices.is_null() || length == 0 {
+        return &mut [];
+    }
+    slice::from_raw_parts_mut(devices as *mut NeoVIMIC, length as usize)
+}
+
+/// Move found devices into the caller's array, returns how many were written. Devices that
+/// don't fit are left in found_devices.
+fn fill_devices(
+    devices: &mut [NeoVIMIC],
+    found_devices: &mut std::collections::VecDeque<NeoVIMICHandle>,
+    api_version: u32,
+    neovi_mic_size: u32,
+) -> u32 {
+    let mut count = 0;
     for device in devices.iter_mut() {
         // remove the device
-        let found_device = found_devices.pop().unwrap();
-        device.version = api_version;
-        device.size = neovi_mic_size;
-        // Copy the serial number over
-        device.serial_number.fill(0);
-        let sn = CString::new(found_device.inner.lock().unwrap().get_serial_number()).unwrap();
-        let sn_len = std::cmp::min(sn.as_bytes_with_nul().len(), device.serial_number.len() - 1);
-        let serial_number_slice = device.serial_number.as_mut_slice();
-        unsafe {
-            serial_number_slice[..sn_len]
-                .copy_from_slice(slice::from_raw_parts(sn.as_ptr(), sn_len));
-        }
-        // Copy the handle over
-        device.handle = Box::into_raw(Box::new(found_device)) as *mut _;
+        let Some(found_device) = found_devices.pop_front() else {
+            break;
+        };
+        write_device(device, found_device, api_version, neovi_mic_size);
+        count += 1;
+    }
+    count
+}
+
+/// Find all neovi MIC2s.
+///
+/// @param devices    Pointer to an array of NeoVIMIC structs. These need to be allocated by the caller. May be null if
+///                   length is 0, returns NeoVIMICErrTypeInvalidParameter otherwise.
+///                   Unused devices should be freed using mic2_free() to avoid memory leaks.
+///                   Although this parameter is const, it is still modifed by the function. This is a convinience so all the other
+///                   function calls don't need a const cast.
+/// @param length     Length of devices. Must not be null, returns NeoVIMICErrTypeInvalidParameter if it is. Set to how many devices are found.
+///                   Devices that don't fit are dropped, see mic2_find_count() to size the array first.
+///
+/// @return           NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_find(
+    devices: *const NeoVIMIC,
+    length: *mut u32,
+    api_version: u32,
+    neovi_mic_size: u32,
+) -> NeoVIMICErrType {
+    if length.is_null() || (devices.is_null() && unsafe { *length } != 0) {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if let Err(e) = check_find_version(api_version, neovi_mic_size) {
+        return e;
+    }
+    // Find all the attached neovi MIC2s
+    let mut found_devices = match find_handles() {
+        Ok(d) => d,
+        Err(e) => return e,
+    };
+    // Convert the devices array to a mutable slice
+    let length = unsafe { &mut *length };
+    let devices = unsafe { devices_slice(devices, *length) };
+    *length = fill_devices(devices, &mut found_devices, api_version, neovi_mic_size);
+
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Find all neovi MIC2s and keep them for mic2_find_fill(). Together these allow any number of
+/// devices without scanning the USB bus more than once:
+///
+/// ```c
+/// uint32_t count = 0;
+/// mic2_find_count(&count);
+/// NeoVIMIC* devices = calloc(count, sizeof(NeoVIMIC));
+/// mic2_find_fill(devices, &count, MIC2_API_VERSION, sizeof(NeoVIMIC));
+/// ```
+///
+/// Calling this again replaces devices that haven't been filled yet.
+///
+/// @param count      Pointer to a uint32_t. Set to the number of devices found. Returns NeoVIMICErrTypeInvalidParameter if nullptr.
+///
+/// @return           NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_find_count(count: *mut u32) -> NeoVIMICErrType {
+    if count.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let found_devices = match find_handles() {
+        Ok(d) => d,
+        Err(e) => return e,
+    };
+    unsafe { *count = found_devices.len() as u32 };
+    // Nothing to fill, a later mic2_find_fill() scans again
+    *FIND_CACHE.lock().unwrap() = Some(found_devices).filter(|d| !d.is_empty());
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Fill devices with the neovi MIC2s found by mic2_find_count(). Finds them now if mic2_find_count()
+/// wasn't called first.
+///
+/// @param devices    Pointer to an array of NeoVIMIC structs, see mic2_find(). May be null if length is 0, returns
+///                   NeoVIMICErrTypeInvalidParameter otherwise.
+/// @param length     Length of devices. Must not be null, returns NeoVIMICErrTypeInvalidParameter if it is. Set to how many devices
+///                   were written. Devices that don't fit are returned by the next mic2_find_fill() call.
+///
+/// @return           NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_find_fill(
+    devices: *const NeoVIMIC,
+    length: *mut u32,
+    api_version: u32,
+    neovi_mic_size: u32,
+) -> NeoVIMICErrType {
+    if length.is_null() || (devices.is_null() && unsafe { *length } != 0) {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if let Err(e) = check_find_version(api_version, neovi_mic_size) {
+        return e;
+    }
+    let mut found_devices = match FIND_CACHE.lock().unwrap().take() {
+        Some(d) => d,
+        None => match find_handles() {
+            Ok(d) => d,
+            Err(e) => return e,
+        },
+    };
+    let length = unsafe { &mut *length };
+    let devices = unsafe { devices_slice(devices, *length) };
+    *length = fill_devices(devices, &mut found_devices, api_version, neovi_mic_size);
+    if !found_devices.is_empty() {
+        *FIND_CACHE.lock().unwrap() = Some(found_devices);
     }
 
     NeoVIMICErrType::NeoVIMICErrTypeSuccess
@@ -396,7 +1378,7 @@ extern "C" fn mic2_has_gps(device: *const NeoVIMIC, has_gps: *mut bool) -> NeoVI
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     unsafe { *has_gps = neovi_mic.has_gps() };
     NeoVIMICErrType::NeoVIMICErrTypeSuccess
@@ -415,7 +1397,7 @@ extern "C" fn mic2_io_open(device: *const NeoVIMIC) -> NeoVIMICErrType {
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_open() {
         Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
@@ -436,7 +1418,7 @@ extern "C" fn mic2_io_close(device: *const NeoVIMIC) -> NeoVIMICErrType {
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_close() {
         Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
@@ -460,7 +1442,7 @@ extern "C" fn mic2_io_is_open(device: *const NeoVIMIC, is_open: *mut bool) -> Ne
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_is_open() {
         Ok(b) => {
@@ -485,7 +1467,7 @@ extern "C" fn mic2_io_buzzer_enable(device: *const NeoVIMIC, enable: bool) -> Ne
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_buzzer_enable(enable) {
         Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
@@ -512,7 +1494,7 @@ extern "C" fn mic2_io_buzzer_is_enabled(
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_buzzer_is_enabled() {
         Ok(b) => {
@@ -537,7 +1519,7 @@ extern "C" fn mic2_io_gpsled_enable(device: *const NeoVIMIC, enable: bool) -> Ne
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_gpsled_enable(enable) {
         Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
@@ -564,7 +1546,7 @@ extern "C" fn mic2_io_gpsled_is_enabled(
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_gpsled_is_enabled() {
         Ok(b) => {
@@ -594,7 +1576,7 @@ extern "C" fn mic2_io_button_is_pressed(
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
     match neovi_mic.io_button_is_pressed() {
         Ok(b) => {
@@ -605,229 +1587,2576 @@ extern "C" fn mic2_io_button_is_pressed(
     }
 }
 
-/// Starts recording audio on the device asynchronously. Call mic2_audio_stop() to stop recording.
+/// mic2_io_buzzer_is_enabled() and mic2_io_gpsled_is_enabled() answer from the last state written
+/// without a USB transfer. Set how old that state can get before the pins are read again, in case
+/// something else drives the lines.
 ///
-/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
-/// @param sample_rate   Sample rate in Hz, typically 44100 or 48000
+/// @param device        Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param interval_ms   Milliseconds before the pins are read again. 0, the default, never reads them again until reopened.
 ///
-/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+/// @return              NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-unsafe extern "C" fn mic2_audio_start(
+extern "C" fn mic2_io_set_revalidate_interval(
     device: *const NeoVIMIC,
-    sample_rate: u32,
+    interval_ms: u32,
 ) -> NeoVIMICErrType {
     if device.is_null() {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
+    let interval = (interval_ms > 0).then(|| Duration::from_millis(interval_ms as u64));
 
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-
-    if neovi_mic.audio_start(sample_rate).is_ok() {
-        NeoVIMICErrType::NeoVIMICErrTypeSuccess
-    } else {
-        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    match neovi_mic.io_set_revalidate_interval(interval) {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Stops recording audio on the device. Call mic2_audio_start() before calling this.
+/// Read the state of all IO lines with a single USB transfer.
 ///
 /// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param state     Pointer to a uint8_t. Set to a bitwise OR of the MIC2_IO_* lines that are high. Returns NeoVIMICErrTypeInvalidParameter if nullptr
 ///
 /// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-unsafe extern "C" fn mic2_audio_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
-    if device.is_null() {
+extern "C" fn mic2_io_read_state(device: *const NeoVIMIC, state: *mut u8) -> NeoVIMICErrType {
+    if device.is_null() || state.is_null() {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
+    unsafe { *state = 0 };
 
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-
-    if neovi_mic.audio_stop().is_ok() {
-        NeoVIMICErrType::NeoVIMICErrTypeSuccess
-    } else {
-        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    match neovi_mic.io_read_state() {
+        Ok(pins) => {
+            unsafe { *state = pins.bits() };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Saves recording from the device asynchronously. Typically called after mic2_audio_stop() to save to disk.
+/// Set several outputs with a single USB transfer. Outputs not in mask are turned off, same as
+/// mic2_io_buzzer_enable() does for the GPS LED.
 ///
 /// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
-/// @param path      filepath to save to. File extension determines format. (ie. .wav, .mp3, .ogg, etc)
+/// @param mask      Outputs to drive, bitwise OR of MIC2_IO_BUZZER and MIC2_IO_GPSLED. Returns NeoVIMICErrTypeInvalidParameter for any other line.
+/// @param values    Bitwise OR of the outputs in mask to turn on.
 ///
 /// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-unsafe extern "C" fn mic2_audio_save(
+extern "C" fn mic2_io_write_state(
     device: *const NeoVIMIC,
-    path: *const c_char,
+    mask: u8,
+    values: u8,
 ) -> NeoVIMICErrType {
-    if device.is_null() {
+    if device.is_null() || mask & !(MIC2_IO_BUZZER | MIC2_IO_GPSLED) != 0 {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
-
-    let path = CStr::from_ptr(path).to_str().unwrap();
+    let (Ok(mask), Ok(values)) = (IOBitMode::from_bits(mask), IOBitMode::from_bits(values)) else {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    };
 
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-
-    if neovi_mic.audio_save(path).is_ok() {
-        NeoVIMICErrType::NeoVIMICErrTypeSuccess
-    } else {
-        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    match neovi_mic.io_write_state(mask, values) {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Open the GPS interface on the device.
+/// Sample the button on a background thread and call callback for every press and release that
+/// holds for debounce_ms, so short presses aren't missed without polling mic2_io_button_is_pressed().
+/// The IO must be open, mic2_io_close() stops the monitor. Starting again replaces a running monitor.
 ///
-/// @param device    Pointer to a NeoVIMIC struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param device               Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param sample_interval_ms   Milliseconds between samples, each is a USB transfer. Returns NeoVIMICErrTypeInvalidParameter if 0
+/// @param debounce_ms          Milliseconds the button has to hold a new state before it is reported.
+/// @param callback             Called from the monitor thread with every edge. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param user_data            Passed through to callback and user_data_free untouched. Okay to pass a nullptr.
+/// @param user_data_free       Called once with user_data when the monitor stops, or before returning if this fails. Okay to pass a nullptr.
 ///
-/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+/// @return                     NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-extern "C" fn mic2_gps_open(device: *const NeoVIMIC) -> NeoVIMICErrType {
-    if device.is_null() {
-        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
-    }
+extern "C" fn mic2_io_button_monitor_start(
+    device: *const NeoVIMIC,
+    sample_interval_ms: u32,
+    debounce_ms: u32,
+    callback: CButtonEventCallback,
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+) -> NeoVIMICErrType {
+    let callback = match callback {
+        Some(callback) if !device.is_null() && sample_interval_ms != 0 => callback,
+        _ => {
+            free_user_data(user_data, user_data_free);
+            return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+        }
+    };
+    let subscriber = CButtonEventSubscriber {
+        callback,
+        user_data,
+        user_data_free,
+    };
+
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-    match neovi_mic.gps_open() {
-        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+    match neovi_mic.io_button_monitor_start(
+        Duration::from_millis(sample_interval_ms as u64),
+        Duration::from_millis(debounce_ms as u64),
+        move |event| subscriber.call(event),
+    ) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
         Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Close the GPS interface on the device.
+/// Stop the button monitor started with mic2_io_button_monitor_start(). callback isn't called
+/// anymore once this returns.
 ///
 /// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
 ///
 /// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-extern "C" fn mic2_gps_close(device: *const NeoVIMIC) -> NeoVIMICErrType {
+extern "C" fn mic2_io_button_monitor_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
     if device.is_null() {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-    match neovi_mic.gps_close() {
-        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+    match neovi_mic.io_button_monitor_stop() {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
         Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Check if the GPS interface on the device is open.
+/// Starts recording audio on the device asynchronously. Call mic2_audio_stop() to stop recording.
 ///
 /// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
-/// @param is_open   Pointer to a bool. Set to true if open, false if not. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param sample_rate   Sample rate in Hz, typically 44100 or 48000
 ///
 /// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-extern "C" fn mic2_gps_is_open(device: *const NeoVIMIC, is_open: *mut bool) -> NeoVIMICErrType {
-    if device.is_null() || is_open.is_null() {
+unsafe extern "C" fn mic2_audio_start(
+    device: *const NeoVIMIC,
+    sample_rate: u32,
+) -> NeoVIMICErrType {
+    if device.is_null() {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
-    unsafe { *is_open = false };
 
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-    match neovi_mic.gps_is_open() {
-        Ok(b) => {
-            unsafe { *is_open = b };
-            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+
+    if neovi_mic.audio_start(sample_rate).is_ok() {
+        NeoVIMICErrType::NeoVIMICErrTypeSuccess
+    } else {
+        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    }
+}
+
+/// Starts streaming audio from the device. Instead of buffering the whole recording like
+/// mic2_audio_start(), callback is called from the capture thread every chunk_length samples.
+/// Call mic2_audio_stream_stop() to stop streaming.
+///
+/// @param device           Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param sample_rate      Sample rate in Hz, typically 44100 or 48000
+/// @param chunk_length     Number of samples per chunk. Returns NeoVIMICErrTypeInvalidParameter if 0
+/// @param callback         Called with every chunk, should return quickly. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param user_data        Passed through to callback and user_data_free untouched. Okay to pass a nullptr.
+/// @param user_data_free   Called once with user_data when the stream stops, or before returning if this fails. Okay to pass a nullptr.
+///
+/// @return                 NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+unsafe extern "C" fn mic2_audio_stream_start(
+    device: *const NeoVIMIC,
+    sample_rate: u32,
+    chunk_length: u32,
+    callback: CAudioChunkCallback,
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+) -> NeoVIMICErrType {
+    let callback = match callback {
+        Some(callback) if !device.is_null() && sample_rate != 0 && chunk_length != 0 => callback,
+        _ => {
+            free_user_data(user_data, user_data_free);
+            return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
         }
+    };
+    let subscriber = CAudioChunkSubscriber {
+        callback,
+        user_data,
+        user_data_free,
+    };
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+
+    match neovi_mic.audio_stream_start(sample_rate, chunk_length as usize, move |chunk| {
+        subscriber.call(chunk)
+    }) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
         Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Check if the GPS interface has a lock.
+/// Stops streaming audio started with mic2_audio_stream_start(). callback isn't called
+/// anymore once this returns.
 ///
 /// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
-/// @param has_lock   Pointer to a bool. Set to true if has lock, false if not. Returns NeoVIMICErrTypeInvalidParameter if nullptr
 ///
 /// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-extern "C" fn mic2_gps_has_lock(device: *const NeoVIMIC, has_lock: *mut bool) -> NeoVIMICErrType {
-    if device.is_null() || has_lock.is_null() {
+unsafe extern "C" fn mic2_audio_stream_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
-    unsafe { *has_lock = false };
 
     let neovi_mic = unsafe {
         let device = &*device;
         let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*handle.inner
     };
-    match neovi_mic.gps_has_lock() {
-        Ok(b) => {
-            unsafe { *has_lock = b };
-            NeoVIMICErrType::NeoVIMICErrTypeSuccess
-        }
-        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+
+    if neovi_mic.audio_stream_stop().is_ok() {
+        NeoVIMICErrType::NeoVIMICErrTypeSuccess
+    } else {
+        NeoVIMICErrType::NeoVIMICErrTypeFailure
     }
 }
 
-/// Retrieve the current GPS info.
+/// Get the default audio analysis tuning, used as a starting point for mic2_audio_analysis_start().
+///
+/// @param config    Pointer to a CAnalysisConfig that is filled in. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidParameter if not
+#[no_mangle]
+extern "C" fn mic2_audio_analysis_config_default(config: *mut CAnalysisConfig) -> NeoVIMICErrType {
+    if config.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    unsafe { *config = AnalysisConfig::default().into() };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Meter every streamed chunk on the capture thread: RMS and peak level, a low/mid/high band
+/// split and a voice activity trigger. Runs whenever a stream from mic2_audio_stream_start(),
+/// mic2_audio_record_start() or mic2_audio_trigger_record_start() does. Levels are read with
+/// mic2_audio_levels_drain() and trigger edges with mic2_audio_triggers_drain(). Calling it
+/// again changes the tuning and empties both buffers.
 ///
 /// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
-/// @param info      Pointer to a CGPSInfo struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
-/// @param info_size Size of the CGPSInfo struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+/// @param config    Pointer to a CAnalysisConfig, nullptr for mic2_audio_analysis_config_default(). Returns NeoVIMICErrTypeInvalidParameter if the cutoffs aren't ascending or the levels aren't finite
 ///
 /// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-extern "C" fn mic2_gps_info(
+extern "C" fn mic2_audio_analysis_start(
     device: *const NeoVIMIC,
-    info: *mut CGPSInfo,
-    info_size: usize,
+    config: *const CAnalysisConfig,
 ) -> NeoVIMICErrType {
-    if device.is_null() || info.is_null() {
+    if device.is_null() {
         return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
-    if info_size < std::mem::size_of::<CGPSInfo>() {
-        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    let config = if config.is_null() {
+        AnalysisConfig::default()
+    } else {
+        AnalysisConfig::from(unsafe { *config })
+    };
+    if config.validate().is_err() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
-    let neovi_mic = unsafe {
+    let handle = unsafe {
         let device = &*device;
-        let handle = &*(device.handle as *mut NeoVIMICHandle);
-        handle.inner.lock().unwrap()
+        &*(device.handle as *mut NeoVIMICHandle)
     };
-    match neovi_mic.gps_info() {
-        Ok(gps_info) => {
-            unsafe { *info = gps_info.into() };
-            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+    let (mut levels, levels_consumer) = ring::channel(AUDIO_LEVEL_RING_CAPACITY);
+    let (mut triggers, triggers_consumer) = ring::channel(AUDIO_TRIGGER_RING_CAPACITY);
+    // Swapped before the callback so the new consumers never miss the first levels
+    *handle.audio_rings.lock().unwrap() = Some(AudioLevelRings {
+        levels: levels_consumer,
+        triggers: triggers_consumer,
+    });
+    match handle.inner.audio_analysis_start(config, move |level| {
+        let level = CAudioLevel::from(level);
+        if level.trigger != CTriggerEdge::CTriggerEdgeNone {
+            triggers.push(level);
         }
+        levels.push(level);
+    }) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
         Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
     }
 }
 
-/// Free the NeoVIMIC object. This must be called when finished otherwise a memory leak will occur.
+/// Stop the audio analysis, a running mic2_audio_trigger_record_start() finishes its event and
+/// stops writing. Levels still buffered can be drained afterwards.
 ///
-/// @param device    Pointer to a NeoVIMIC structs. Okay to pass a nullptr.
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
 ///
-/// @return          None
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidIndex if the analysis wasn't started, NeoVIMICErrTypeFailure if not
 #[no_mangle]
-unsafe extern "C" fn mic2_free(device: *const NeoVIMIC) {
+extern "C" fn mic2_audio_analysis_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
     if device.is_null() {
-        return;
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
     }
-    unsafe {
+    let neovi_mic = unsafe {
         let device = &*device;
-        std::mem::drop(Box::from_raw(device.handle as *mut NeoVIMICHandle))
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.audio_analysis_stop() {
+        Ok(true) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Ok(false) => NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Copy levels from one of the rings of mic2_audio_analysis_start() into levels, oldest first.
+fn drain_audio_levels(
+    device: *const NeoVIMIC,
+    levels: *mut CAudioLevel,
+    length: *mut u32,
+    level_size: usize,
+    select: impl Fn(&mut AudioLevelRings) -> &mut RingConsumer<CAudioLevel>,
+) -> NeoVIMICErrType {
+    if device.is_null() || levels.is_null() || length.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if level_size < std::mem::size_of::<CAudioLevel>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let length = unsafe { &mut *length };
+    let capacity = *length as usize;
+    *length = 0;
+    let handle = unsafe {
+        let device = &*device;
+        &*(device.handle as *mut NeoVIMICHandle)
     };
+    let mut audio_rings = handle.audio_rings.lock().unwrap();
+    let Some(audio_rings) = audio_rings.as_mut() else {
+        return NeoVIMICErrType::NeoVIMICErrTypeFailure;
+    };
+    let ring = select(audio_rings);
+    for i in 0..capacity {
+        match ring.pop() {
+            // Elements are level_size apart in case the caller's CAudioLevel is newer than ours
+            Some(level) => unsafe { levels.byte_add(i * level_size).write_unaligned(level) },
+            None => break,
+        }
+        *length += 1;
+    }
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Copy the level of every chunk analyzed since the last call into levels, oldest first. Levels
+/// are buffered from the capture thread, about 10 seconds of 20ms chunks fit before new ones
+/// are dropped. Only one thread should drain a device at a time.
+///
+/// @param device        Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param levels        Pointer to an array of CAudioLevel structs allocated by the caller. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param length        Length of levels. Must not be null, returns NeoVIMICErrTypeInvalidParameter if it is. Set to how many levels were copied.
+/// @param level_size    Size of the CAudioLevel struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return              NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if the analysis was never started
+#[no_mangle]
+extern "C" fn mic2_audio_levels_drain(
+    device: *const NeoVIMIC,
+    levels: *mut CAudioLevel,
+    length: *mut u32,
+    level_size: usize,
+) -> NeoVIMICErrType {
+    drain_audio_levels(device, levels, length, level_size, |rings| {
+        &mut rings.levels
+    })
+}
+
+/// Same as mic2_audio_levels_drain() but only copies the levels where CAudioLevel::trigger is
+/// set. Buffered separately so trigger edges aren't lost while levels aren't drained.
+///
+/// @param device        Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param levels        Pointer to an array of CAudioLevel structs allocated by the caller. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param length        Length of levels. Must not be null, returns NeoVIMICErrTypeInvalidParameter if it is. Set to how many levels were copied.
+/// @param level_size    Size of the CAudioLevel struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return              NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if the analysis was never started
+#[no_mangle]
+extern "C" fn mic2_audio_triggers_drain(
+    device: *const NeoVIMIC,
+    levels: *mut CAudioLevel,
+    length: *mut u32,
+    level_size: usize,
+) -> NeoVIMICErrType {
+    drain_audio_levels(device, levels, length, level_size, |rings| {
+        &mut rings.triggers
+    })
+}
+
+/// Starts recording only the audio around events found by the analysis of
+/// mic2_audio_analysis_start(), each to its own WAV file named "<path stem>_0000.wav",
+/// "<path stem>_0001.wav", etc. Every file starts with up to pre_trigger_ms of audio from before
+/// the trigger. Nothing is written while it's quiet. Call mic2_audio_stop() to stop.
+///
+/// @param device           Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param sample_rate      Sample rate in Hz, typically 44100 or 48000
+/// @param path             WAV filepath the event files are named after. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param pre_trigger_ms   Audio kept from before each trigger (ms)
+///
+/// @return                 NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not or the analysis isn't started
+#[no_mangle]
+unsafe extern "C" fn mic2_audio_trigger_record_start(
+    device: *const NeoVIMIC,
+    sample_rate: u32,
+    path: *const c_char,
+    pre_trigger_ms: u32,
+) -> NeoVIMICErrType {
+    if device.is_null() || path.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let Ok(path) = CStr::from_ptr(path).to_str() else {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    };
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+
+    match neovi_mic.audio_trigger_record_start(
+        sample_rate,
+        path,
+        Duration::from_millis(pre_trigger_ms.into()),
+    ) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Stops recording audio on the device. Call mic2_audio_start(), mic2_audio_record_start() or mic2_audio_trigger_record_start() before calling this.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+unsafe extern "C" fn mic2_audio_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+
+    if neovi_mic.audio_stop().is_ok() {
+        NeoVIMICErrType::NeoVIMICErrTypeSuccess
+    } else {
+        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    }
+}
+
+/// Starts recording audio on the device straight to a WAV file. Samples are written from a
+/// background thread while recording instead of being kept in memory until mic2_audio_save().
+/// Call mic2_audio_stop() to stop recording and finish the file.
+///
+/// @param device           Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param sample_rate      Sample rate in Hz, typically 44100 or 48000
+/// @param path             WAV filepath to write to. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param segment_seconds  Start a new file every segment_seconds, named "<path stem>_0000.wav", "<path stem>_0001.wav", etc. 0 to write a single file.
+///
+/// @return                 NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+unsafe extern "C" fn mic2_audio_record_start(
+    device: *const NeoVIMIC,
+    sample_rate: u32,
+    path: *const c_char,
+    segment_seconds: u32,
+) -> NeoVIMICErrType {
+    if device.is_null() || path.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let Ok(path) = CStr::from_ptr(path).to_str() else {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    };
+    let segment_length = match segment_seconds {
+        0 => None,
+        seconds => Some(Duration::from_secs(seconds.into())),
+    };
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+
+    if neovi_mic
+        .audio_record_start(sample_rate, path, segment_length)
+        .is_ok()
+    {
+        NeoVIMICErrType::NeoVIMICErrTypeSuccess
+    } else {
+        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    }
+}
+
+/// Saves recording from the device asynchronously. Typically called after mic2_audio_stop() to save to disk.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param path      filepath to save to. File extension determines format. (ie. .wav, .mp3, .ogg, etc)
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+unsafe extern "C" fn mic2_audio_save(
+    device: *const NeoVIMIC,
+    path: *const c_char,
+) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+
+    let path = CStr::from_ptr(path).to_str().unwrap();
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+
+    if neovi_mic.audio_save(path).is_ok() {
+        NeoVIMICErrType::NeoVIMICErrTypeSuccess
+    } else {
+        NeoVIMICErrType::NeoVIMICErrTypeFailure
+    }
+}
+
+/// Open the GPS interface on the device.
+///
+/// @param device    Pointer to a NeoVIMIC struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_open(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_open() {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Open the GPS interface on the device using a specific output protocol. The binary
+/// CGpsProtocolUbx protocol uses less bandwidth and parsing time and updates at a higher rate.
+///
+/// @param device    Pointer to a NeoVIMIC struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param protocol  Output protocol, see CGpsProtocol. Returns NeoVIMICErrTypeInvalidParameter if unknown
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_open_protocol(device: *const NeoVIMIC, protocol: u32) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let protocol = match CGpsProtocol::try_from(protocol) {
+        Ok(protocol) => protocol,
+        Err(e) => return e,
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_open_with_protocol(protocol.into()) {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Get the default GPS receiver setup for an output protocol, used as a starting point for
+/// mic2_gps_open_config().
+///
+/// @param protocol  Output protocol, see CGpsProtocol. Returns NeoVIMICErrTypeInvalidParameter if unknown
+/// @param config    Pointer to a CGpsConfig that is filled in. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidParameter if not
+#[no_mangle]
+extern "C" fn mic2_gps_config_default(protocol: u32, config: *mut CGpsConfig) -> NeoVIMICErrType {
+    if config.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let protocol = match CGpsProtocol::try_from(protocol) {
+        Ok(protocol) => protocol,
+        Err(e) => return e,
+    };
+    unsafe { *config = GpsConfig::from(GpsProtocol::from(protocol)).into() };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Open the GPS interface on the device and apply a receiver setup. Every setting has to be
+/// acknowledged by the receiver or the open fails.
+///
+/// @param device    Pointer to a NeoVIMIC struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param config    Pointer to a CGpsConfig, see mic2_gps_config_default(). Returns NeoVIMICErrTypeInvalidParameter if nullptr or out of range
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_open_config(
+    device: *const NeoVIMIC,
+    config: *const CGpsConfig,
+) -> NeoVIMICErrType {
+    if device.is_null() || config.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let config = match GpsConfig::try_from(unsafe { *config }) {
+        Ok(config) if config.validate().is_ok() => config,
+        _ => return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter,
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_open_with_config(&config) {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Open the GPS interface on the device, apply a receiver setup and then send every message of transaction in a
+/// single write. Fails if the setup isn't accepted or any message of transaction isn't answered, see
+/// mic2_ubx_transaction_states() for the ones the receiver rejected. Nothing is sent if the GPS is already open.
+///
+/// @param device       Pointer to a NeoVIMIC struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param config       Pointer to a CGpsConfig, see mic2_gps_config_default(). Returns NeoVIMICErrTypeInvalidParameter if nullptr or out of range
+/// @param transaction  Transaction from mic2_ubx_transaction_new(). Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return             NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_open_transaction(
+    device: *const NeoVIMIC,
+    config: *const CGpsConfig,
+    transaction: *mut CUbxTransaction,
+) -> NeoVIMICErrType {
+    if device.is_null() || config.is_null() || transaction.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let config = match GpsConfig::try_from(unsafe { *config }) {
+        Ok(config) if config.validate().is_ok() => config,
+        _ => return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter,
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    let transaction = unsafe { &mut (*transaction).transaction };
+    match neovi_mic.gps_open_with_transaction(&config, transaction) {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Close the GPS interface on the device.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_close(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_close() {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Check if the GPS interface on the device is open.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param is_open   Pointer to a bool. Set to true if open, false if not. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_is_open(device: *const NeoVIMIC, is_open: *mut bool) -> NeoVIMICErrType {
+    if device.is_null() || is_open.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    unsafe { *is_open = false };
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_is_open() {
+        Ok(b) => {
+            unsafe { *is_open = b };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Check if the GPS interface has a lock.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param has_lock   Pointer to a bool. Set to true if has lock, false if not. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_has_lock(device: *const NeoVIMIC, has_lock: *mut bool) -> NeoVIMICErrType {
+    if device.is_null() || has_lock.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    unsafe { *has_lock = false };
+
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_has_lock() {
+        Ok(b) => {
+            unsafe { *has_lock = b };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Block until the GPS has a lock or the timeout expires. The device isn't locked while waiting
+/// so other calls can be made from other threads in the meantime.
+///
+/// @param device       Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param timeout_ms   Maximum time to wait in milliseconds.
+/// @param has_lock     Pointer to a bool. Set to true if locked, false on timeout. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return             NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if GPS isn't open or closed while waiting
+#[no_mangle]
+extern "C" fn mic2_gps_wait_for_lock(
+    device: *const NeoVIMIC,
+    timeout_ms: u32,
+    has_lock: *mut bool,
+) -> NeoVIMICErrType {
+    if device.is_null() || has_lock.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    unsafe { *has_lock = false };
+
+    let waiter = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        handle.inner.gps_waiter()
+    };
+    match waiter.and_then(|w| w.wait_for_lock(Duration::from_millis(timeout_ms.into()))) {
+        Ok(b) => {
+            unsafe { *has_lock = b };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Block until the next GPS position update is received or the timeout expires. The device isn't
+/// locked while waiting so other calls can be made from other threads in the meantime.
+///
+/// @param device       Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param timeout_ms   Maximum time to wait in milliseconds.
+/// @param received     Pointer to a bool. Set to true if an update was received, false on timeout. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return             NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if GPS isn't open or closed while waiting
+#[no_mangle]
+extern "C" fn mic2_gps_wait_for_fix(
+    device: *const NeoVIMIC,
+    timeout_ms: u32,
+    received: *mut bool,
+) -> NeoVIMICErrType {
+    if device.is_null() || received.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    unsafe { *received = false };
+
+    let waiter = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        handle.inner.gps_waiter()
+    };
+    match waiter.and_then(|w| w.wait_for_fix(Duration::from_millis(timeout_ms.into()))) {
+        Ok(b) => {
+            unsafe { *received = b };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Retrieve the current GPS info.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param info      Pointer to a CGPSInfo struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param info_size Size of the CGPSInfo struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_info(
+    device: *const NeoVIMIC,
+    info: *mut CGPSInfo,
+    info_size: usize,
+) -> NeoVIMICErrType {
+    if device.is_null() || info.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if info_size < std::mem::size_of::<CGPSInfo>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    // Convert under the read lock instead of cloning the satellites first
+    match neovi_mic.gps_with_info(|gps_info| CGPSInfo::from(gps_info)) {
+        Ok(gps_info) => {
+            unsafe { *info = gps_info };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Retrieve the current GPS info only if it changed since the update numbered last_sequence, see
+/// CGPSInfo::sequence. An unchanged info costs one atomic load and info isn't written, so pollers
+/// can call this at any rate. Pass 0 to get the first update.
+///
+/// @param device        Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param last_sequence CGPSInfo::sequence of the info the caller already has
+/// @param info          Pointer to a CGPSInfo struct, only written if updated is set to true. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param info_size     Size of the CGPSInfo struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+/// @param updated       Pointer to a bool. Set to true if info was written. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return              NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_info_if_newer(
+    device: *const NeoVIMIC,
+    last_sequence: u64,
+    info: *mut CGPSInfo,
+    info_size: usize,
+    updated: *mut bool,
+) -> NeoVIMICErrType {
+    if device.is_null() || info.is_null() || updated.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if info_size < std::mem::size_of::<CGPSInfo>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    // Convert straight into the caller's struct, CGPSInfo is large
+    let write = |gps_info: &GPSInfo| unsafe { *info = gps_info.into() };
+    match neovi_mic.gps_with_info_if_newer(last_sequence, write) {
+        Ok(written) => {
+            unsafe { *updated = written.is_some() };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Retrieve CGPSInfo::sequence of the latest GPS update without copying anything.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param sequence  Pointer to a uint64_t. Set to 0 until the first update. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_sequence(device: *const NeoVIMIC, sequence: *mut u64) -> NeoVIMICErrType {
+    if device.is_null() || sequence.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_sequence() {
+        Ok(value) => {
+            unsafe { *sequence = value };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Retrieve the current position, velocity and DOP without the satellites. See CGPSFix.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param fix       Pointer to a CGPSFix struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param fix_size  Size of the CGPSFix struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_fix(
+    device: *const NeoVIMIC,
+    fix: *mut CGPSFix,
+    fix_size: usize,
+) -> NeoVIMICErrType {
+    if device.is_null() || fix.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if fix_size < std::mem::size_of::<CGPSFix>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_fix() {
+        Ok(gps_fix) => {
+            unsafe { *fix = gps_fix.into() };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Record every position update to a binary fix log written from the GPS reader thread.
+/// The file starts with a MIC2_FIX_LOG_HEADER_LENGTH byte header followed by CGPSFix records
+/// in the order they were received, monotonic_time_ns never decreases. Replaces a log that is
+/// already running, stays active across mic2_gps_close()/mic2_gps_open(). See mic2::FixLogReader in mic2.hpp.
+/// The file is locked while it's written, fails with NeoVIMICErrTypeFailure if another writer has it open.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param path      File to create or truncate. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+unsafe extern "C" fn mic2_gps_fix_log_start(
+    device: *const NeoVIMIC,
+    path: *const c_char,
+) -> NeoVIMICErrType {
+    if device.is_null() || path.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let Ok(path) = CStr::from_ptr(path).to_str() else {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_fix_log_start(path) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Flush and close the fix log started by mic2_gps_fix_log_start().
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param stopped   Pointer to a bool. Set to false if no log was running. Okay to pass a nullptr.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not or if a failed write
+///                  already stopped the log, see CGPSStats::fix_log_errors
+#[no_mangle]
+extern "C" fn mic2_gps_fix_log_stop(
+    device: *const NeoVIMIC,
+    stopped: *mut bool,
+) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_fix_log_stop() {
+        Ok(b) => {
+            if !stopped.is_null() {
+                unsafe { *stopped = b };
+            }
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Pass every byte read from the GPS serial port to callback, exactly as the receiver sent it
+/// and before it is parsed. callback is invoked from the GPS reader thread with its read buffer,
+/// so it should return quickly. Replaces a tap that is already installed, stays installed across
+/// mic2_gps_close()/mic2_gps_open(). Do not call mic2_gps_raw_tap_*() from inside the callback.
+///
+/// @param device           Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param parse            false to only pass the bytes on. The receiver is still configured on open, but GPS info,
+///                         subscriptions, waits and the fix log stop updating.
+/// @param callback         Function to call with every read. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param user_data        Passed through to callback and user_data_free untouched. Okay to pass a nullptr.
+/// @param user_data_free   Called once with user_data when the tap is removed or replaced, or before returning if this fails. Okay to pass a nullptr.
+///
+/// @return                 NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_raw_tap_start(
+    device: *const NeoVIMIC,
+    parse: bool,
+    callback: CRawTapCallback,
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+) -> NeoVIMICErrType {
+    let callback = match callback {
+        Some(callback) if !device.is_null() => callback,
+        _ => {
+            free_user_data(user_data, user_data_free);
+            return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+        }
+    };
+    let subscriber = CRawTapSubscriber {
+        callback,
+        user_data,
+        user_data_free,
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_raw_tap_start(parse, move |bytes| subscriber.call(bytes)) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Write every byte read from the GPS serial port to a file, see mic2_gps_raw_tap_start().
+/// The file is flushed when the tap is removed or replaced. Failed writes are counted in CGPSStats::tap_write_errors.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param parse     false to only record the bytes, see mic2_gps_raw_tap_start().
+/// @param path      File to create or truncate. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+unsafe extern "C" fn mic2_gps_raw_tap_file(
+    device: *const NeoVIMIC,
+    parse: bool,
+    path: *const c_char,
+) -> NeoVIMICErrType {
+    if device.is_null() || path.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let Ok(path) = CStr::from_ptr(path).to_str() else {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_raw_tap_to_file(parse, path) {
+        Ok(()) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Remove the raw tap installed by mic2_gps_raw_tap_start() or mic2_gps_raw_tap_file(). No
+/// callbacks are made after this returns and parsing resumes.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidIndex if no tap was installed
+#[no_mangle]
+extern "C" fn mic2_gps_raw_tap_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_raw_tap_stop() {
+        Ok(true) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Ok(false) => NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Tuning of the GPS metrics, see mic2_gps_metrics_config_default() and mic2_gps_metrics_start().
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CMetricsConfig {
+    /// How fast the velocity is expected to change ((m/s)^2/s). Larger follows the receiver closer, smaller smooths more.
+    pub velocity_process_noise: f64,
+    /// Variance of the velocity reported by the receiver ((m/s)^2)
+    pub velocity_measurement_noise: f64,
+}
+
+impl From<MetricsConfig> for CMetricsConfig {
+    fn from(config: MetricsConfig) -> Self {
+        Self {
+            velocity_process_noise: config.velocity_process_noise,
+            velocity_measurement_noise: config.velocity_measurement_noise,
+        }
+    }
+}
+
+impl From<CMetricsConfig> for MetricsConfig {
+    fn from(config: CMetricsConfig) -> Self {
+        Self {
+            velocity_process_noise: config.velocity_process_noise,
+            velocity_measurement_noise: config.velocity_measurement_noise,
+        }
+    }
+}
+
+/// Vertex of a geofence in decimal degrees, see mic2_gps_geofence_add().
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CGeoPoint {
+    /// Negative is south
+    pub latitude: f64,
+    /// Negative is west
+    pub longitude: f64,
+}
+
+/// Capacity of CFixMetrics::geofences.
+pub const MIC2_METRICS_MAX_GEOFENCES: usize = 32;
+
+/// Values derived from the latest position update by the GPS reader thread, see mic2_gps_metrics().
+#[repr(C)]
+pub struct CFixMetrics {
+    /// Latest position update
+    pub fix: CGPSFix,
+    /// ecef_x/y/z are set, false without a position
+    pub ecef_valid: bool,
+    /// Earth-centered, earth-fixed coordinates (m)
+    pub ecef_x: f64,
+    pub ecef_y: f64,
+    pub ecef_z: f64,
+    /// Distance travelled since mic2_gps_metrics_start() or mic2_gps_metrics_reset_odometer() (m)
+    pub odometer_m: f64,
+    /// The velocity fields are set, false until the receiver reported a speed and course
+    pub velocity_valid: bool,
+    /// Kalman smoothed velocity north (m/s)
+    pub velocity_north: f64,
+    /// Kalman smoothed velocity east (m/s)
+    pub velocity_east: f64,
+    /// Smoothed speed over ground (m/s)
+    pub speed_mps: f64,
+    /// Smoothed course over ground (degrees, 0 to 360)
+    pub course_deg: f64,
+    /// Ids of the geofences containing the position, ascending. Only valid indexes are defined by geofences_count.
+    pub geofences: [u32; MIC2_METRICS_MAX_GEOFENCES],
+    /// Number of valid ids in geofences
+    pub geofences_count: u32,
+    /// Position updates evaluated
+    pub fixes: u64,
+}
+
+impl From<FixMetrics> for CFixMetrics {
+    fn from(metrics: FixMetrics) -> Self {
+        let [ecef_x, ecef_y, ecef_z] = metrics.ecef.unwrap_or_default();
+        let (velocity_north, velocity_east) = metrics.velocity_ne.unwrap_or_default();
+        let mut geofences = [0; MIC2_METRICS_MAX_GEOFENCES];
+        let count = metrics.geofences.len().min(MIC2_METRICS_MAX_GEOFENCES);
+        geofences[..count].copy_from_slice(&metrics.geofences[..count]);
+        Self {
+            fix: metrics.fix.into(),
+            ecef_valid: metrics.ecef.is_some(),
+            ecef_x,
+            ecef_y,
+            ecef_z,
+            odometer_m: metrics.odometer_m,
+            velocity_valid: metrics.velocity_ne.is_some(),
+            velocity_north,
+            velocity_east,
+            speed_mps: metrics.speed_mps().unwrap_or_default(),
+            course_deg: metrics.course_deg().unwrap_or_default(),
+            geofences,
+            geofences_count: count as u32,
+            fixes: metrics.fixes,
+        }
+    }
+}
+
+/// Get the default GPS metrics tuning, used as a starting point for mic2_gps_metrics_start().
+///
+/// @param config    Pointer to a CMetricsConfig that is filled in. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidParameter if not
+#[no_mangle]
+extern "C" fn mic2_gps_metrics_config_default(config: *mut CMetricsConfig) -> NeoVIMICErrType {
+    if config.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    unsafe { *config = MetricsConfig::default().into() };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Evaluate every position update once on the GPS reader thread: ECEF coordinates, an odometer, Kalman smoothed
+/// velocity and geofence membership, read with mic2_gps_metrics(). Only changes the tuning if already started.
+/// Stays active across mic2_gps_close()/mic2_gps_open().
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param config    Pointer to a CMetricsConfig, nullptr for mic2_gps_metrics_config_default(). Returns NeoVIMICErrTypeInvalidParameter if a noise isn't positive
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_metrics_start(
+    device: *const NeoVIMIC,
+    config: *const CMetricsConfig,
+) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let config = if config.is_null() {
+        MetricsConfig::default()
+    } else {
+        MetricsConfig::from(unsafe { *config })
+    };
+    if config.validate().is_err() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_metrics_start(config) {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Stop evaluating position updates, the odometer and geofences are dropped.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidIndex if metrics weren't started, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_metrics_stop(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_metrics_stop() {
+        Ok(true) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Ok(false) => NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Retrieve the metrics of the latest position update. Costs a copy, nothing is recomputed.
+///
+/// @param device        Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param metrics       Pointer to a CFixMetrics struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param metrics_size  Size of the CFixMetrics struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return              NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if metrics weren't started
+#[no_mangle]
+extern "C" fn mic2_gps_metrics(
+    device: *const NeoVIMIC,
+    metrics: *mut CFixMetrics,
+    metrics_size: usize,
+) -> NeoVIMICErrType {
+    if device.is_null() || metrics.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if metrics_size < std::mem::size_of::<CFixMetrics>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_metrics() {
+        Ok(fix_metrics) => {
+            unsafe { *metrics = fix_metrics.into() };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Zero the odometer of the GPS metrics.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if metrics weren't started
+#[no_mangle]
+extern "C" fn mic2_gps_metrics_reset_odometer(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_metrics_reset_odometer() {
+        Ok(_) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Register a geofence polygon evaluated on every position update, the last vertex connects back to the first.
+/// Geofences are indexed by area so each update is only tested against the ones nearby. Every edge takes the shorter
+/// way around so a geofence may cross the antimeridian, one spanning 180 degrees of longitude or more needs vertices
+/// in between.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param vertices  Array of count CGeoPoint. Returns NeoVIMICErrTypeInvalidParameter if nullptr, fewer than 3, out of
+///                  range or circling a pole
+/// @param count     Number of vertices
+/// @param id        Pointer to a uint32_t. Set to the geofence id reported in CFixMetrics::geofences. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if metrics weren't started
+#[no_mangle]
+extern "C" fn mic2_gps_geofence_add(
+    device: *const NeoVIMIC,
+    vertices: *const CGeoPoint,
+    count: usize,
+    id: *mut u32,
+) -> NeoVIMICErrType {
+    if device.is_null() || vertices.is_null() || id.is_null() || count < 3 {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let vertices: Vec<(f64, f64)> = unsafe { slice::from_raw_parts(vertices, count) }
+        .iter()
+        .map(|vertex| (vertex.latitude, vertex.longitude))
+        .collect();
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_geofence_add(&vertices) {
+        Ok(added) => {
+            unsafe { *id = added };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(mic2::types::Error::IOError(std::io::ErrorKind::InvalidInput)) => {
+            NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Remove a geofence registered with mic2_gps_geofence_add().
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param id        Geofence id from mic2_gps_geofence_add()
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidIndex if id isn't registered, NeoVIMICErrTypeFailure if metrics weren't started
+#[no_mangle]
+extern "C" fn mic2_gps_geofence_remove(device: *const NeoVIMIC, id: u32) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_geofence_remove(id) {
+        Ok(true) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Ok(false) => NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Offline u-blox parser, see mic2_gps_parser_new(). Not tied to a device, ie. to replay
+/// captures recorded with mic2_gps_raw_tap_file(). Not thread safe.
+pub struct CGPSParser {
+    parser: GPSParser,
+}
+
+/// Create an offline u-blox parser. It frames and parses bytes exactly like the GPS reader
+/// thread. Must be released with mic2_gps_parser_free().
+///
+/// @param parser    Set to the new parser. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_gps_parser_new(parser: *mut *mut CGPSParser) -> NeoVIMICErrType {
+    if parser.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let new_parser = Box::new(CGPSParser {
+        parser: GPSParser::new(),
+    });
+    unsafe { *parser = Box::into_raw(new_parser) };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Release a parser created by mic2_gps_parser_new(). Does nothing if parser is a nullptr.
+///
+/// @param parser    Parser to release, must not be used afterwards
+#[no_mangle]
+extern "C" fn mic2_gps_parser_free(parser: *mut CGPSParser) {
+    if parser.is_null() {
+        return;
+    }
+    unsafe { std::mem::drop(Box::from_raw(parser)) };
+}
+
+/// Parse raw bytes from a u-blox receiver. Partial frames are kept until the next call.
+///
+/// @param parser    Parser from mic2_gps_parser_new(). Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param data      Bytes to parse. Returns NeoVIMICErrTypeInvalidParameter if nullptr and length isn't 0
+/// @param length    Number of bytes in data
+/// @param updates   Set to the number of GPS info updates the bytes completed, may be nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_gps_parser_push(
+    parser: *mut CGPSParser,
+    data: *const u8,
+    length: usize,
+    updates: *mut u32,
+) -> NeoVIMICErrType {
+    if parser.is_null() || (data.is_null() && length != 0) {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let parser = unsafe { &mut (*parser).parser };
+    let bytes = if length == 0 {
+        &[]
+    } else {
+        unsafe { slice::from_raw_parts(data, length) }
+    };
+    let count = parser.push(bytes);
+    if !updates.is_null() {
+        unsafe { *updates = count as u32 };
+    }
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Retrieve the GPS info of everything parsed so far, same conversion as mic2_gps_info().
+///
+/// @param parser    Parser from mic2_gps_parser_new(). Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param info      Pointer to a CGPSInfo struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param info_size Size of the CGPSInfo struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_gps_parser_info(
+    parser: *const CGPSParser,
+    info: *mut CGPSInfo,
+    info_size: usize,
+) -> NeoVIMICErrType {
+    if parser.is_null() || info.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if info_size < std::mem::size_of::<CGPSInfo>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let parser = unsafe { &(*parser).parser };
+    unsafe { *info = parser.gps_info().into() };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Retrieve the frame and message counters of everything parsed so far. read_timeouts,
+/// lock_wait_ns and the histograms are always 0, they only apply to a device.
+///
+/// @param parser      Parser from mic2_gps_parser_new(). Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param stats       Pointer to a CGPSStats struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param stats_size  Size of the CGPSStats struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return            NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_gps_parser_stats(
+    parser: *const CGPSParser,
+    stats: *mut CGPSStats,
+    stats_size: usize,
+) -> NeoVIMICErrType {
+    if parser.is_null() || stats.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if stats_size < std::mem::size_of::<CGPSStats>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let parser = unsafe { &(*parser).parser };
+    unsafe { *stats = parser.stats().into() };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Answer to a message of a CUbxTransaction, see mic2_ubx_transaction_states().
+#[repr(u32)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum CUbxAckState {
+    /// Not answered yet
+    CUbxAckStatePending = 0,
+    /// UBX-ACK-ACK received
+    CUbxAckStateAccepted,
+    /// UBX-ACK-NAK received, the receiver rejected the message
+    CUbxAckStateRejected,
+}
+
+impl From<ubx::AckState> for CUbxAckState {
+    fn from(state: ubx::AckState) -> Self {
+        match state {
+            ubx::AckState::Pending => CUbxAckState::CUbxAckStatePending,
+            ubx::AckState::Accepted => CUbxAckState::CUbxAckStateAccepted,
+            ubx::AckState::Rejected => CUbxAckState::CUbxAckStateRejected,
+        }
+    }
+}
+
+/// UBX CFG messages sent to the receiver in a single write, see mic2_ubx_transaction_new(). Not thread safe.
+pub struct CUbxTransaction {
+    transaction: ubx::Transaction,
+}
+
+/// Create an empty UBX transaction for custom receiver configuration, see mic2_gps_open_transaction(). The
+/// receiver answers every CFG message with an ACK, matched to the oldest unanswered message with the same class
+/// and id. Must be released with mic2_ubx_transaction_free().
+///
+/// @param transaction  Set to the new transaction. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return             NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_ubx_transaction_new(transaction: *mut *mut CUbxTransaction) -> NeoVIMICErrType {
+    if transaction.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let new_transaction = Box::new(CUbxTransaction {
+        transaction: ubx::Transaction::new(),
+    });
+    unsafe { *transaction = Box::into_raw(new_transaction) };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Release a transaction created by mic2_ubx_transaction_new(). Does nothing if transaction is a nullptr.
+///
+/// @param transaction  Transaction to release, must not be used afterwards
+#[no_mangle]
+extern "C" fn mic2_ubx_transaction_free(transaction: *mut CUbxTransaction) {
+    if transaction.is_null() {
+        return;
+    }
+    unsafe { std::mem::drop(Box::from_raw(transaction)) };
+}
+
+/// Queue a UBX message, the checksum is added.
+///
+/// @param transaction  Transaction from mic2_ubx_transaction_new(). Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param class        UBX message class. Returns NeoVIMICErrTypeInvalidParameter if not CFG (0x06), the receiver
+///                     only answers CFG messages
+/// @param id           UBX message id
+/// @param payload      Payload bytes. Returns NeoVIMICErrTypeInvalidParameter if nullptr and length isn't 0
+/// @param length       Number of bytes in payload. Returns NeoVIMICErrTypeInvalidParameter if more than 65535
+/// @param index        Set to the index of the message in mic2_ubx_transaction_states(), may be nullptr
+///
+/// @return             NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_ubx_transaction_add(
+    transaction: *mut CUbxTransaction,
+    class: u8,
+    id: u8,
+    payload: *const u8,
+    length: usize,
+    index: *mut usize,
+) -> NeoVIMICErrType {
+    if transaction.is_null() || (payload.is_null() && length != 0) || length > u16::MAX as usize {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if ubx::ClassField::try_from(class) != Ok(ubx::ClassField::CFG) {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let payload = if length == 0 {
+        Vec::new()
+    } else {
+        unsafe { slice::from_raw_parts(payload, length) }.to_vec()
+    };
+    let transaction = unsafe { &mut (*transaction).transaction };
+    let added = transaction.push(&ubx::PacketHeader::new(
+        ubx::ClassField::CFG,
+        id,
+        payload,
+        true,
+    ));
+    if !index.is_null() {
+        unsafe { *index = added };
+    }
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Retrieve the answer to every message of a transaction, in the order they were added.
+///
+/// @param transaction  Transaction from mic2_ubx_transaction_new(). Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param states       Array of length CUbxAckState. Only the first length answers are copied. Okay to pass a nullptr.
+/// @param length       Number of elements in states
+/// @param count        Pointer to a size_t. Set to the number of messages, which can be more than length. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return             NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_ubx_transaction_states(
+    transaction: *const CUbxTransaction,
+    states: *mut CUbxAckState,
+    length: usize,
+    count: *mut usize,
+) -> NeoVIMICErrType {
+    if transaction.is_null() || count.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let transaction = unsafe { &(*transaction).transaction };
+    let c_states: Vec<CUbxAckState> = transaction
+        .states()
+        .iter()
+        .map(|&state| state.into())
+        .collect();
+    copy_to_c_array(states, length, &c_states);
+    unsafe { *count = c_states.len() };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Retrieve the performance counters and latency histograms of the GPS reader thread, IO
+/// transfers and audio capture. Counters are relaxed atomics, cheap enough to poll in production.
+///
+/// @param device      Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param stats       Pointer to a CDeviceStats struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param stats_size  Size of the CDeviceStats struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return            NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_stats(
+    device: *const NeoVIMIC,
+    stats: *mut CDeviceStats,
+    stats_size: usize,
+) -> NeoVIMICErrType {
+    if device.is_null() || stats.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if stats_size < std::mem::size_of::<CDeviceStats>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    let device_stats = neovi_mic.stats();
+    unsafe {
+        *stats = CDeviceStats {
+            gps: device_stats.gps.map(Into::into).unwrap_or_default(),
+            gps_valid: device_stats.gps.is_some(),
+            io: device_stats.io.map(Into::into).unwrap_or_default(),
+            io_valid: device_stats.io.is_some(),
+            audio: device_stats.audio.map(Into::into).unwrap_or_default(),
+            audio_valid: device_stats.audio.is_some(),
+        }
+    };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Zero every counter reported by mic2_stats().
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_stats_reset(device: *const NeoVIMIC) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    neovi_mic.stats_reset();
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Retrieve the GPS and IO state of many devices in one call, ie. once per monitoring tick. Answered from the
+/// latest GPS update and the last known IO levels, no USB transfer is made and nothing waits on the GPS
+/// beyond its info lock, so the cost is predictable.
+///
+/// @param devices       Array of count pointers to NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if it or any entry is nullptr
+/// @param count         Number of devices
+/// @param statuses      Array of count CDeviceStatus structs, filled in the order of devices. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param status_size   Size of the CDeviceStatus struct, elements are status_size apart. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return              NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_snapshot(
+    devices: *const *const NeoVIMIC,
+    count: usize,
+    statuses: *mut CDeviceStatus,
+    status_size: usize,
+) -> NeoVIMICErrType {
+    if count == 0 {
+        return NeoVIMICErrType::NeoVIMICErrTypeSuccess;
+    }
+    if devices.is_null() || statuses.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if status_size < std::mem::size_of::<CDeviceStatus>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let devices = unsafe { slice::from_raw_parts(devices, count) };
+    if devices.iter().any(|device| device.is_null()) {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mics = devices.iter().map(|&device| unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    });
+    for (i, device_status) in mic::snapshot_all(neovi_mics).into_iter().enumerate() {
+        // Elements are status_size apart in case the caller's CDeviceStatus is newer than ours,
+        // which also means they may not be aligned for ours
+        let status: CDeviceStatus = device_status.into();
+        unsafe { statuses.byte_add(i * status_size).write_unaligned(status) };
+    }
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Open the subsystems of many devices at once, ie. a whole rack. Every device is opened on a thread of its
+/// own with its IO and GPS set up concurrently, so this takes about as long as the slowest device instead of
+/// the sum of all of them. Blocks until every device is done, a device failing doesn't stop the others.
+///
+/// @param devices       Array of count pointers to NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if it or any entry is nullptr
+/// @param count         Number of devices
+/// @param subsystems    Bitwise OR of MIC2_SUBSYSTEM_* values. Returns NeoVIMICErrTypeInvalidParameter if it has unknown bits
+/// @param gps_config    GPS receiver setup, see mic2_gps_config_default(). nullptr for the default NMEA setup. Returns NeoVIMICErrTypeInvalidParameter if out of range
+/// @param results       Array of count COpenResult structs, filled in the order of devices. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param result_size   Size of the COpenResult struct, elements are result_size apart. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return              NeoVIMICErrTypeSuccess if every requested subsystem opened, NeoVIMICErrTypeFailure if any failed, see results
+#[no_mangle]
+extern "C" fn mic2_open_all(
+    devices: *const *const NeoVIMIC,
+    count: usize,
+    subsystems: u8,
+    gps_config: *const CGpsConfig,
+    results: *mut COpenResult,
+    result_size: usize,
+) -> NeoVIMICErrType {
+    let Ok(subsystems) = Subsystem::from_bits(subsystems) else {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    };
+    let gps_config = if gps_config.is_null() {
+        GpsConfig::default()
+    } else {
+        match GpsConfig::try_from(unsafe { *gps_config }) {
+            Ok(config) if config.validate().is_ok() => config,
+            _ => return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter,
+        }
+    };
+    if count == 0 {
+        return NeoVIMICErrType::NeoVIMICErrTypeSuccess;
+    }
+    if devices.is_null() || results.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if result_size < std::mem::size_of::<COpenResult>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let devices = unsafe { slice::from_raw_parts(devices, count) };
+    if devices.iter().any(|device| device.is_null()) {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mics = devices.iter().map(|&device| unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    });
+    let mut all_ok = true;
+    for (i, open_result) in mic::open_all(neovi_mics, subsystems, &gps_config)
+        .into_iter()
+        .enumerate()
+    {
+        all_ok &= open_result.is_ok();
+        // Elements are result_size apart in case the caller's COpenResult is newer than ours
+        let result: COpenResult = open_result.into();
+        unsafe { results.byte_add(i * result_size).write_unaligned(result) };
+    }
+    match all_ok {
+        true => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        false => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Copy `src` into the C array `dst` of `length` elements, skipped if dst is a nullptr.
+fn copy_to_c_array<T: Copy>(dst: *mut T, length: usize, src: &[T]) {
+    if dst.is_null() {
+        return;
+    }
+    let count = length.min(src.len());
+    unsafe { std::ptr::copy_nonoverlapping(src.as_ptr(), dst, count) };
+}
+
+/// Retrieve the satellites in view as one array per field. Index i of every array describes
+/// the same satellite. Pass nullptr for arrays that aren't needed, all nullptr with length 0
+/// only queries the count.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param prn       Array of length uint16_t. Set to the satellite PRN numbers. Okay to pass a nullptr.
+/// @param snr       Array of length uint8_t. Set to the signal strength (C/N0, 0-99), zero if invalid. Okay to pass a nullptr.
+/// @param elevation Array of length uint16_t. Set to the elevation (degrees), zero if invalid. Okay to pass a nullptr.
+/// @param azimuth   Array of length uint16_t. Set to the azimuth (degrees), zero if invalid. Okay to pass a nullptr.
+/// @param flags     Array of length uint8_t. Set to a bitwise OR of MIC2_GPS_SAT_* flags. Okay to pass a nullptr.
+/// @param length    Number of elements in each array that isn't a nullptr. Only the first length satellites are copied.
+/// @param count     Pointer to a size_t. Set to the number of satellites in view, which can be more than length. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+#[allow(clippy::too_many_arguments)]
+extern "C" fn mic2_gps_satellites(
+    device: *const NeoVIMIC,
+    prn: *mut u16,
+    snr: *mut u8,
+    elevation: *mut u16,
+    azimuth: *mut u16,
+    flags: *mut u8,
+    length: usize,
+    count: *mut usize,
+) -> NeoVIMICErrType {
+    if device.is_null() || count.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_satellites() {
+        Ok(satellites) => {
+            copy_to_c_array(prn, length, &satellites.prn);
+            copy_to_c_array(snr, length, &satellites.snr);
+            copy_to_c_array(elevation, length, &satellites.elevation);
+            copy_to_c_array(azimuth, length, &satellites.azimuth);
+            copy_to_c_array(flags, length, &satellites.flags);
+            unsafe { *count = satellites.len() };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Subscribe to GPS info updates. callback is invoked from the GPS reader thread every time a
+/// PUBX00/03/04 sentence or UBX-NAV message has been received, so it should return quickly. Subscriptions stay active
+/// across mic2_gps_close()/mic2_gps_open() until mic2_gps_unsubscribe() or mic2_free() is called.
+/// Do not call mic2_gps_subscribe() or mic2_gps_unsubscribe() from inside the callback.
+///
+/// @param device           Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param callback         Function to call on every update. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param user_data        Passed through to callback and user_data_free untouched. Okay to pass a nullptr.
+/// @param user_data_free   Called once with user_data when the subscription is removed, or before returning if this fails. Okay to pass a nullptr.
+/// @param id               Pointer to a uint32_t. Set to the subscription id. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return                 NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_subscribe(
+    device: *const NeoVIMIC,
+    callback: CGPSInfoCallback,
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+    id: *mut u32,
+) -> NeoVIMICErrType {
+    let callback = match callback {
+        Some(callback) if !device.is_null() && !id.is_null() => callback,
+        _ => {
+            free_user_data(user_data, user_data_free);
+            return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+        }
+    };
+    let subscriber = CGPSInfoSubscriber {
+        callback,
+        user_data,
+        user_data_free,
+    };
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_subscribe(move |gps_info| subscriber.call(gps_info)) {
+        Ok(subscription_id) => {
+            unsafe { *id = subscription_id };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Remove a GPS info subscription created by mic2_gps_subscribe().
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param id        Subscription id returned by mic2_gps_subscribe(). Returns NeoVIMICErrTypeInvalidIndex if not found.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_unsubscribe(device: *const NeoVIMIC, id: u32) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_unsubscribe(id) {
+        Ok(true) => NeoVIMICErrType::NeoVIMICErrTypeSuccess,
+        Ok(false) => NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Copy every GPS update received since the last call into infos, oldest first. Updates are
+/// buffered from the GPS reader thread without taking the device lock, so none are lost between
+/// calls as long as this is called before the buffer fills up. Buffering starts with the first
+/// call, which copies nothing, so devices that are never drained don't pay for it. Only one
+/// thread should drain a device at a time.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param infos     Pointer to an array of CGPSInfo structs allocated by the caller. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param length    Length of infos. Must not be null, returns NeoVIMICErrTypeInvalidParameter if it is. Set to how many updates were copied.
+/// @param info_size Size of the CGPSInfo struct. Returns NeoVIMICErrTypeSizeMismatch if size is smaller than expected.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not
+#[no_mangle]
+extern "C" fn mic2_gps_drain(
+    device: *const NeoVIMIC,
+    infos: *mut CGPSInfo,
+    length: *mut u32,
+    info_size: usize,
+) -> NeoVIMICErrType {
+    if device.is_null() || infos.is_null() || length.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    if info_size < std::mem::size_of::<CGPSInfo>() {
+        return NeoVIMICErrType::NeoVIMICErrTypeSizeMismatch;
+    }
+    let length = unsafe { &mut *length };
+    let capacity = *length as usize;
+    *length = 0;
+    let handle = unsafe {
+        let device = &*device;
+        &*(device.handle as *mut NeoVIMICHandle)
+    };
+    let mut gps_ring = handle.gps_ring.lock().unwrap();
+    let gps_ring = match gps_ring.as_mut() {
+        Some(gps_ring) => gps_ring,
+        None => {
+            let (mut producer, consumer) = ring::channel(GPS_RING_CAPACITY);
+            let subscribed = handle.inner.gps_subscribe(move |gps_info| {
+                producer.push(CGPSInfo::from(gps_info));
+            });
+            if subscribed.is_err() {
+                return NeoVIMICErrType::NeoVIMICErrTypeFailure;
+            }
+            gps_ring.insert(consumer)
+        }
+    };
+    for i in 0..capacity {
+        match gps_ring.pop() {
+            // infos may be uninitialized, write without dropping the old value. Elements are
+            // info_size apart in case the caller's CGPSInfo is newer than ours.
+            Some(info) => unsafe { infos.byte_add(i * info_size).write_unaligned(info) },
+            None => break,
+        }
+        *length += 1;
+    }
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Get the mapping between the host monotonic clock and GPS UTC time from the latest GPS time received.
+///
+/// @param device    Pointer to a NeoVIMIC struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param mapping   Pointer to a CGPSClockMapping struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if the GPS isn't open or hasn't received the time yet
+#[no_mangle]
+extern "C" fn mic2_gps_clock_mapping(
+    device: *const NeoVIMIC,
+    mapping: *mut CGPSClockMapping,
+) -> NeoVIMICErrType {
+    if device.is_null() || mapping.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    match neovi_mic.gps_clock_mapping() {
+        Ok(Some(clock_mapping)) => {
+            unsafe { *mapping = clock_mapping.into() };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        _ => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Convert a host monotonic timestamp (ie. CAudioChunk::monotonic_time_ns) to UTC.
+///
+/// @param mapping              Pointer to a CGPSClockMapping struct. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param monotonic_time_ns    Host monotonic time (ns), see mic2_monotonic_time_ns()
+/// @param utc_time_ns          Pointer to an int64_t. Set to the UTC time as unix timestamp in nanoseconds. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return                     NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeInvalidParameter if not
+#[no_mangle]
+extern "C" fn mic2_gps_utc_time_ns_at(
+    mapping: *const CGPSClockMapping,
+    monotonic_time_ns: u64,
+    utc_time_ns: *mut i64,
+) -> NeoVIMICErrType {
+    if mapping.is_null() || utc_time_ns.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let mapping = unsafe { &*mapping };
+    let offset_ns = monotonic_time_ns as i64 - mapping.monotonic_time_ns as i64;
+    unsafe { *utc_time_ns = mapping.utc_time_ns.saturating_add(offset_ns) };
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Current host monotonic time, same clock as CGPSInfo::monotonic_time_ns.
+///
+/// @return          Nanoseconds since the first call into the library.
+#[no_mangle]
+extern "C" fn mic2_monotonic_time_ns() -> u64 {
+    monotonic_time_ns()
+}
+
+/// Kind of change reported to a CHotplugCallback, see mic2_hotplug_subscribe().
+#[repr(u32)]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum CHotplugEventType {
+    /// A neoVI MIC2 was attached and is ready to use.
+    CHotplugEventTypeArrived = 0,
+    /// A neoVI MIC2 previously reported as arrived was removed.
+    CHotplugEventTypeLeft,
+}
+
+/// Hotplug callback, see mic2_hotplug_subscribe().
+///
+/// For CHotplugEventTypeArrived device is a new NeoVIMIC owned by the callee, it must be released with mic2_free().
+/// For CHotplugEventTypeLeft only device->serial_number is set and device->handle is a nullptr.
+/// device is only valid for the duration of the callback, copy the struct to keep it.
+pub type CHotplugCallback = Option<
+    unsafe extern "C" fn(
+        event_type: CHotplugEventType,
+        device: *const NeoVIMIC,
+        user_data: *mut c_void,
+    ),
+>;
+
+/// Owns the C callback and user_data of a hotplug subscription, see CGPSInfoSubscriber.
+struct CHotplugSubscriber {
+    callback: unsafe extern "C" fn(
+        event_type: CHotplugEventType,
+        device: *const NeoVIMIC,
+        user_data: *mut c_void,
+    ),
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+}
+
+// The caller is responsible for user_data being usable from the hotplug thread.
+unsafe impl Send for CHotplugSubscriber {}
+
+impl CHotplugSubscriber {
+    fn call(&self, event: HotplugEvent) {
+        let mut device = NeoVIMIC {
+            version: MIC2_API_VERSION,
+            size: std::mem::size_of::<NeoVIMIC>() as u32,
+            serial_number: [0; 16],
+            handle: std::ptr::null_mut(),
+        };
+        let event_type = match event {
+            HotplugEvent::Arrived(neovi_mic) => {
+                write_device(
+                    &mut device,
+                    NeoVIMICHandle::from(*neovi_mic),
+                    MIC2_API_VERSION,
+                    std::mem::size_of::<NeoVIMIC>() as u32,
+                );
+                CHotplugEventType::CHotplugEventTypeArrived
+            }
+            HotplugEvent::Left { serial_number, .. } => {
+                copy_serial_number(device.serial_number.as_mut_slice(), &serial_number);
+                CHotplugEventType::CHotplugEventTypeLeft
+            }
+        };
+        unsafe { (self.callback)(event_type, &device, self.user_data) };
+    }
+}
+
+impl Drop for CHotplugSubscriber {
+    fn drop(&mut self) {
+        free_user_data(self.user_data, self.user_data_free);
+    }
+}
+
+// Active hotplug subscriptions by id, see mic2_hotplug_subscribe().
+static HOTPLUG_MONITORS: Mutex<Vec<(u32, HotplugMonitor)>> = Mutex::new(Vec::new());
+static HOTPLUG_NEXT_ID: AtomicU32 = AtomicU32::new(1);
+
+/// Subscribe to neoVI MIC2 arrivals and removals. callback is invoked from a background thread,
+/// first with CHotplugEventTypeArrived for every neoVI MIC2 already attached and then on every change.
+/// The USB bus is only scanned after libusb reports a change, so there is no need to poll mic2_find().
+/// Do not call mic2_hotplug_subscribe() or mic2_hotplug_unsubscribe() from inside the callback.
+///
+/// @param callback         Function to call on every event, see CHotplugCallback. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+/// @param user_data        Passed through to callback and user_data_free untouched. Okay to pass a nullptr.
+/// @param user_data_free   Called once with user_data when the subscription is removed, or before returning if this fails. Okay to pass a nullptr.
+/// @param id               Pointer to a uint32_t. Set to the subscription id. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return                 NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if libusb hotplug isn't supported on this platform
+#[no_mangle]
+extern "C" fn mic2_hotplug_subscribe(
+    callback: CHotplugCallback,
+    user_data: *mut c_void,
+    user_data_free: CUserDataFree,
+    id: *mut u32,
+) -> NeoVIMICErrType {
+    let callback = match callback {
+        Some(callback) if !id.is_null() => callback,
+        _ => {
+            free_user_data(user_data, user_data_free);
+            return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+        }
+    };
+    let subscriber = CHotplugSubscriber {
+        callback,
+        user_data,
+        user_data_free,
+    };
+    match HotplugMonitor::start(move |event| subscriber.call(event)) {
+        Ok(monitor) => {
+            let subscription_id = HOTPLUG_NEXT_ID.fetch_add(1, Ordering::Relaxed);
+            HOTPLUG_MONITORS
+                .lock()
+                .unwrap()
+                .push((subscription_id, monitor));
+            unsafe { *id = subscription_id };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Remove a hotplug subscription created by mic2_hotplug_subscribe(). No callbacks are made once this returns.
+///
+/// @param id        Subscription id returned by mic2_hotplug_subscribe(). Returns NeoVIMICErrTypeInvalidIndex if not found.
+///
+/// @return          NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_hotplug_unsubscribe(id: u32) -> NeoVIMICErrType {
+    let monitor = {
+        let mut monitors = HOTPLUG_MONITORS.lock().unwrap();
+        match monitors
+            .iter()
+            .position(|(monitor_id, _)| *monitor_id == id)
+        {
+            Some(index) => monitors.remove(index).1,
+            None => return NeoVIMICErrType::NeoVIMICErrTypeInvalidIndex,
+        }
+    };
+    // Joins the hotplug thread, outside the lock so other subscriptions aren't blocked
+    drop(monitor);
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Shared event loop servicing the GPS ports and IO button monitors of every device attached
+/// to it from one thread, see mic2_context_new().
+pub struct CContext {
+    reactor: Reactor,
+}
+
+/// Start a shared event loop. Devices attached with mic2_context_attach() are serviced by
+/// it instead of a thread each. Must be released with mic2_context_free().
+///
+/// @param context   Set to the new context. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful, NeoVIMICErrTypeFailure if not supported on this platform
+#[no_mangle]
+extern "C" fn mic2_context_new(context: *mut *mut CContext) -> NeoVIMICErrType {
+    if context.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    match Reactor::new() {
+        Ok(reactor) => {
+            unsafe { *context = Box::into_raw(Box::new(CContext { reactor })) };
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        }
+        Err(_e) => NeoVIMICErrType::NeoVIMICErrTypeFailure,
+    }
+}
+
+/// Stop the event loop and release a context created by mic2_context_new(). GPS ports still
+/// attached are closed. Does nothing if context is a nullptr.
+///
+/// @param context   Context to release, must not be used afterwards
+#[no_mangle]
+extern "C" fn mic2_context_free(context: *mut CContext) {
+    if context.is_null() {
+        return;
+    }
+    unsafe { std::mem::drop(Box::from_raw(context)) };
+}
+
+/// Service the GPS port and IO button monitor of device from context, starting with the next
+/// mic2_gps_open() and mic2_io_button_monitor_start(). GPS and button callbacks then run on the
+/// context thread and hold up every other device attached to it.
+///
+/// @param context   Context from mic2_context_new(), nullptr to go back to a thread per subsystem
+/// @param device    Pointer to a NeoVIMIC structs. Returns NeoVIMICErrTypeInvalidParameter if nullptr
+///
+/// @return          NeoVIMICErrTypeSuccess if successful
+#[no_mangle]
+extern "C" fn mic2_context_attach(
+    context: *const CContext,
+    device: *const NeoVIMIC,
+) -> NeoVIMICErrType {
+    if device.is_null() {
+        return NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter;
+    }
+    let neovi_mic = unsafe {
+        let device = &*device;
+        let handle = &*(device.handle as *mut NeoVIMICHandle);
+        &*handle.inner
+    };
+    let reactor = unsafe { context.as_ref() }.map(|context| context.reactor.handle());
+    neovi_mic.set_reactor(reactor);
+    NeoVIMICErrType::NeoVIMICErrTypeSuccess
+}
+
+/// Free the NeoVIMIC object. This must be called when finished otherwise a memory leak will occur.
+///
+/// @param device    Pointer to a NeoVIMIC structs. Okay to pass a nullptr or a NeoVIMIC with a nullptr handle.
+///
+/// @return          None
+#[no_mangle]
+unsafe extern "C" fn mic2_free(device: *const NeoVIMIC) {
+    if device.is_null() {
+        return;
+    }
+    unsafe {
+        let device = &*device;
+        if device.handle.is_null() {
+            return;
+        }
+        std::mem::drop(Box::from_raw(device.handle as *mut NeoVIMICHandle))
+    };
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// NeoVIMIC struct around a device without IO, audio or GPS, release with mic2_free().
+    fn test_device() -> NeoVIMIC {
+        let handle = Box::new(NeoVIMICHandle::from(mic::NeoVIMIC::default()));
+        NeoVIMIC {
+            version: MIC2_API_VERSION,
+            size: std::mem::size_of::<NeoVIMIC>() as u32,
+            serial_number: [0; 16],
+            handle: Box::into_raw(handle) as *mut c_void,
+        }
+    }
+
+    unsafe extern "C" fn count_free(user_data: *mut c_void) {
+        (*(user_data as *const AtomicU32)).fetch_add(1, Ordering::Relaxed);
+    }
+
+    unsafe extern "C" fn ignore_info(_info: *const CGPSInfo, _user_data: *mut c_void) {}
+
+    #[test]
+    fn test_error_string_unknown() {
+        assert!(matches!(
+            NeoVIMICErrType::from(u32::MAX),
+            NeoVIMICErrType::NeoVIMICErrTypeFailure
+        ));
+        let mut buffer = [0 as c_char; 32];
+        let mut length = buffer.len() as u32;
+        let err = mic2_error_string(u32::MAX, buffer.as_mut_ptr(), &mut length);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        let message = unsafe { CStr::from_ptr(buffer.as_ptr()) };
+        assert_eq!(message.to_str().unwrap(), "Unknown Error");
+        let err = mic2_error_string(1, buffer.as_mut_ptr(), &mut length);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        let message = unsafe { CStr::from_ptr(buffer.as_ptr()) };
+        assert_eq!(message.to_str().unwrap(), "Failure");
+    }
+
+    #[test]
+    fn test_find_fill_empty() {
+        let size = std::mem::size_of::<NeoVIMIC>() as u32;
+        *FIND_CACHE.lock().unwrap() = Some(
+            [NeoVIMICHandle::from(mic::NeoVIMIC::default())]
+                .into_iter()
+                .collect(),
+        );
+        // No array is needed to fill nothing, the device is kept for the next call
+        let mut length = 0;
+        let err = mic2_find_fill(std::ptr::null(), &mut length, MIC2_API_VERSION, size);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        assert_eq!(length, 0);
+        length = 1;
+        let err = mic2_find_fill(std::ptr::null(), &mut length, MIC2_API_VERSION, size);
+        assert!(matches!(
+            err,
+            NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+        ));
+        let devices: [NeoVIMIC; 1] = unsafe { std::mem::zeroed() };
+        let err = mic2_find_fill(devices.as_ptr(), &mut length, MIC2_API_VERSION, size);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        assert_eq!(length, 1);
+        assert!(FIND_CACHE.lock().unwrap().is_none());
+        unsafe { mic2_free(&devices[0]) };
+    }
+
+    #[test]
+    fn test_gps_parser_replay() {
+        // Capture of a receiver still sending its default NMEA output, split mid-sentence
+        let capture = concat!(
+            "$GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47*17\r\n",
+            "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n",
+            "$GPGST,182141.000,15.5,15.3,7.2,21.8,0.9,0.5,0.8*54\r\n",
+            "$PUBX,00,025554.00,0000.00000,N,00000.00000,E,0.000,NF,5311696,3755936,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0*28\r\n",
+        )
+        .as_bytes();
+        let mut parser = std::ptr::null_mut();
+        assert!(matches!(
+            mic2_gps_parser_new(&mut parser),
+            NeoVIMICErrType::NeoVIMICErrTypeSuccess
+        ));
+        let mut total = 0;
+        for chunk in capture.chunks(37) {
+            let mut updates = 0;
+            let err = mic2_gps_parser_push(parser, chunk.as_ptr(), chunk.len(), &mut updates);
+            assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+            total += updates;
+        }
+        assert_eq!(total, 1);
+        let mut stats: CGPSStats = unsafe { std::mem::zeroed() };
+        let err = mic2_gps_parser_stats(parser, &mut stats, std::mem::size_of::<CGPSStats>());
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        assert_eq!(stats.nmea_sentences, 4);
+        // GSA, GSV and GST aren't used and are only counted
+        assert_eq!(stats.unsupported, 3);
+        assert_eq!(stats.fixes, 1);
+        mic2_gps_parser_free(parser);
+    }
+
+    #[test]
+    fn test_snapshot_stride() {
+        // A newer caller's CDeviceStatus with an extra field and a size that isn't aligned
+        let size = std::mem::size_of::<CDeviceStatus>();
+        let status_size = size + 3;
+        let first = test_device();
+        let second = test_device();
+        let devices = [&first as *const NeoVIMIC, &second];
+        let mut buffer = vec![0xAAu8; status_size * devices.len()];
+        let err = mic2_snapshot(
+            devices.as_ptr(),
+            devices.len(),
+            buffer.as_mut_ptr().cast(),
+            status_size,
+        );
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        for i in 0..devices.len() {
+            let element = &buffer[i * status_size..(i + 1) * status_size];
+            let status: CDeviceStatus =
+                unsafe { element.as_ptr().cast::<CDeviceStatus>().read_unaligned() };
+            assert!(!status.gps_open && !status.io_open);
+            // The caller's extra field is left alone
+            assert_eq!(element[size..], [0xAA; 3]);
+        }
+        unsafe {
+            mic2_free(&first);
+            mic2_free(&second);
+        }
+    }
+
+    #[test]
+    fn test_open_all_results() {
+        let size = std::mem::size_of::<COpenResult>();
+        let result_size = size + 1;
+        let first = test_device();
+        let second = test_device();
+        let devices = [&first as *const NeoVIMIC, &second];
+        let mut buffer = vec![0xAAu8; result_size * devices.len()];
+        let err = mic2_open_all(
+            devices.as_ptr(),
+            devices.len(),
+            MIC2_SUBSYSTEM_IO | MIC2_SUBSYSTEM_GPS,
+            std::ptr::null(),
+            buffer.as_mut_ptr().cast(),
+            result_size,
+        );
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeFailure));
+        for i in 0..devices.len() {
+            let element = &buffer[i * result_size..(i + 1) * result_size];
+            let result: COpenResult =
+                unsafe { element.as_ptr().cast::<COpenResult>().read_unaligned() };
+            // Neither subsystem exists on the test device
+            assert!(matches!(
+                result.io,
+                NeoVIMICErrType::NeoVIMICErrTypeNotSupported
+            ));
+            assert!(matches!(
+                result.gps,
+                NeoVIMICErrType::NeoVIMICErrTypeNotSupported
+            ));
+            assert_eq!(element[size..], [0xAA]);
+        }
+        unsafe {
+            mic2_free(&first);
+            mic2_free(&second);
+        }
+    }
+
+    #[test]
+    fn test_gps_subscribe_frees_once() {
+        // The caller must not free user_data itself when subscribing fails
+        let frees = AtomicU32::new(0);
+        let user_data = &frees as *const AtomicU32 as *mut c_void;
+        let device = test_device();
+        let mut id = 0;
+        let err = mic2_gps_subscribe(
+            &device,
+            Some(ignore_info),
+            user_data,
+            Some(count_free),
+            &mut id,
+        );
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeFailure));
+        assert_eq!(frees.load(Ordering::Relaxed), 1);
+        let err = mic2_gps_subscribe(
+            std::ptr::null(),
+            Some(ignore_info),
+            user_data,
+            Some(count_free),
+            &mut id,
+        );
+        assert!(matches!(
+            err,
+            NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+        ));
+        assert_eq!(frees.load(Ordering::Relaxed), 2);
+        unsafe { mic2_free(&device) };
+    }
+
+    #[test]
+    fn test_ubx_transaction_cfg_only() {
+        let mut transaction: *mut CUbxTransaction = std::ptr::null_mut();
+        let err = mic2_ubx_transaction_new(&mut transaction);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        // NAV-PVT poll, never ACKed by the receiver
+        let err = mic2_ubx_transaction_add(
+            transaction,
+            0x01,
+            0x07,
+            std::ptr::null(),
+            0,
+            std::ptr::null_mut(),
+        );
+        assert!(matches!(
+            err,
+            NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+        ));
+        let payload = [0xF0u8, 0x00, 0];
+        let mut index = usize::MAX;
+        let err = mic2_ubx_transaction_add(
+            transaction,
+            0x06,
+            0x01,
+            payload.as_ptr(),
+            payload.len(),
+            &mut index,
+        );
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        assert_eq!(index, 0);
+        let mut count = 0;
+        let err = mic2_ubx_transaction_states(transaction, std::ptr::null_mut(), 0, &mut count);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        assert_eq!(count, 1);
+        mic2_ubx_transaction_free(transaction);
+    }
+
+    #[test]
+    fn test_gps_protocol_out_of_range() {
+        let mut config: CGpsConfig = unsafe { std::mem::zeroed() };
+        let err = mic2_gps_config_default(CGpsProtocol::CGpsProtocolUbx as u32, &mut config);
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeSuccess));
+        let err = mic2_gps_config_default(2, &mut config);
+        assert!(matches!(
+            err,
+            NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+        ));
+        let device = test_device();
+        let err = mic2_gps_open_protocol(&device, u32::MAX);
+        assert!(matches!(
+            err,
+            NeoVIMICErrType::NeoVIMICErrTypeInvalidParameter
+        ));
+        unsafe { mic2_free(&device) };
+    }
+
+    #[test]
+    fn test_gps_drain_subscribes_on_demand() {
+        let device = test_device();
+        let handle = unsafe { &*(device.handle as *const NeoVIMICHandle) };
+        assert!(handle.gps_ring.lock().unwrap().is_none());
+        let mut infos: [CGPSInfo; 1] = unsafe { std::mem::zeroed() };
+        let mut length = infos.len() as u32;
+        let err = mic2_gps_drain(
+            &device,
+            infos.as_mut_ptr(),
+            &mut length,
+            std::mem::size_of::<CGPSInfo>(),
+        );
+        // Without a GPS there is nothing to subscribe to
+        assert!(matches!(err, NeoVIMICErrType::NeoVIMICErrTypeFailure));
+        assert_eq!(length, 0);
+        assert!(handle.gps_ring.lock().unwrap().is_none());
+        unsafe { mic2_free(&device) };
+    }
 }
@@ -1,54 +1,551 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <expected>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <limits>
+#include <list>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <mic2.h>
 
+// Define MIC2_HEADER_ONLY before including mic2.hpp to use the wrapper without
+// compiling mic2.cpp, every definition is then inline in this header. On
+// Windows that also includes <windows.h> with WIN32_LEAN_AND_MEAN and NOMINMAX,
+// build mic2.cpp instead to keep it out of your translation units.
+#ifdef MIC2_HEADER_ONLY
+#define MIC2_INLINE inline
+#else
+#define MIC2_INLINE
+#endif
+
 namespace mic2 {
 
+// Invoked from the GPS reader thread, see CNeoVIMIC::gps_subscribe().
+using GPSInfoCallback = std::function<void(const CGPSInfo &)>;
+// Invoked from the GPS reader thread with its read buffer, see
+// CNeoVIMIC::gps_raw_tap_start().
+using RawTapCallback = std::function<void(std::span<const uint8_t>)>;
+// Invoked from the audio capture thread, see CNeoVIMIC::audio_stream_start().
+using AudioChunkCallback = std::function<void(const CAudioChunk &)>;
+
+// Invoked from the button monitor thread, see
+// CNeoVIMIC::io_button_monitor_start().
+using ButtonEventCallback = std::function<void(const CButtonEvent &)>;
+
+// Satellites in view, index i of every vector describes the same satellite.
+// flags is a bitwise OR of MIC2_GPS_SAT_* values, see mic2_gps_satellites().
+struct GPSSatellites {
+  std::vector<uint16_t> prn;
+  std::vector<uint8_t> snr;
+  std::vector<uint16_t> elevation;
+  std::vector<uint16_t> azimuth;
+  std::vector<uint8_t> flags;
+};
+
+// GPS receiver setup, messages is a bitwise OR of MIC2_GPS_MESSAGE_* values.
+using GpsConfig = CGpsConfig;
+
+// Tuning of the GPS metrics, see CNeoVIMIC::gps_metrics_start().
+using MetricsConfig = CMetricsConfig;
+
+// Tuning of the audio analysis, see CNeoVIMIC::audio_analysis_start().
+using AnalysisConfig = CAnalysisConfig;
+
+class Context;
+class UbxTransaction;
+
+// Safe to use from multiple threads at once. IO, GPS and audio calls are
+// locked separately, so ie. gps_info() doesn't wait on io_buzzer_enable().
 class CNeoVIMIC {
 public:
+  // Takes ownership of device.handle, it is released with mic2_free() when
+  // this is destroyed.
   CNeoVIMIC(const NeoVIMIC &device);
   ~CNeoVIMIC();
+  // Move-only, a copy would free the handle twice.
+  CNeoVIMIC(const CNeoVIMIC &) = delete;
+  CNeoVIMIC &operator=(const CNeoVIMIC &) = delete;
+  CNeoVIMIC(CNeoVIMIC &&other) noexcept;
+  CNeoVIMIC &operator=(CNeoVIMIC &&other) noexcept;
 
-  auto has_gps() const -> std::expected<bool, NeoVIMICErrType>;
-  auto get_serial_number() const -> std::string;
+  [[nodiscard]] auto has_gps() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto get_serial_number() const -> std::string;
+  // Counters and latency histograms of the GPS reader thread, IO transfers and
+  // audio capture. Cheap enough to poll, see CDeviceStats.
+  [[nodiscard]] auto stats() const noexcept
+      -> std::expected<CDeviceStats, NeoVIMICErrType>;
+  auto stats_reset() const -> std::expected<void, NeoVIMICErrType>;
 
   auto audio_save(std::string path) const
       -> std::expected<void, NeoVIMICErrType>;
   auto audio_start(uint32_t sample_rate) const
       -> std::expected<void, NeoVIMICErrType>;
+  // Records straight to a WAV file at path while capturing, audio_stop()
+  // finishes the file. A non-zero segment_length starts a new numbered file
+  // every segment_length.
+  auto audio_start(uint32_t sample_rate, std::string path,
+                   std::chrono::seconds segment_length = {}) const
+      -> std::expected<void, NeoVIMICErrType>;
   auto audio_stop() const -> std::expected<void, NeoVIMICErrType>;
+  // Calls callback from the audio capture thread with every chunk_length
+  // samples instead of buffering the whole recording. chunk.samples is only
+  // valid during the call.
+  auto audio_stream_start(uint32_t sample_rate, uint32_t chunk_length,
+                          AudioChunkCallback callback) const
+      -> std::expected<void, NeoVIMICErrType>;
+  auto audio_stream_stop() const -> std::expected<void, NeoVIMICErrType>;
+  // Meters every streamed chunk on the capture thread: RMS and peak level, a
+  // low/mid/high band split and a voice activity trigger. Calling it again
+  // changes the tuning and empties the level buffers.
+  auto audio_analysis_start() const -> std::expected<void, NeoVIMICErrType>;
+  auto audio_analysis_start(const AnalysisConfig &config) const
+      -> std::expected<void, NeoVIMICErrType>;
+  auto audio_analysis_stop() const -> std::expected<void, NeoVIMICErrType>;
+  // Copies the levels analyzed since the last call into levels, oldest first.
+  // Returns how many entries of levels were filled.
+  [[nodiscard]] auto audio_levels_drain(
+      std::span<CAudioLevel> levels) const noexcept
+      -> std::expected<size_t, NeoVIMICErrType>;
+  // Same as audio_levels_drain() but only the levels where trigger is set.
+  [[nodiscard]] auto audio_triggers_drain(
+      std::span<CAudioLevel> levels) const noexcept
+      -> std::expected<size_t, NeoVIMICErrType>;
+  // Records only the audio around triggers of the analysis, each event to its
+  // own numbered WAV file starting with pre_trigger of audio from before it.
+  // Needs audio_analysis_start(), audio_stop() stops.
+  auto audio_trigger_record_start(uint32_t sample_rate, std::string path,
+                                  std::chrono::milliseconds pre_trigger) const
+      -> std::expected<void, NeoVIMICErrType>;
 
   auto gps_close() const -> std::expected<void, NeoVIMICErrType>;
-  auto gps_has_lock() const -> std::expected<bool, NeoVIMICErrType>;
-  auto gps_info() const -> std::expected<CGPSInfo, NeoVIMICErrType>;
-  auto gps_is_open() const -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto gps_has_lock() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
+  // Blocks until the GPS has a lock. Returns false if timeout expired first.
+  auto gps_wait_for_lock(std::chrono::milliseconds timeout) const
+      -> std::expected<bool, NeoVIMICErrType>;
+  // Blocks until the next position update. Returns false if timeout expired
+  // first.
+  auto gps_wait_for_fix(std::chrono::milliseconds timeout) const
+      -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto gps_info() const noexcept
+      -> std::expected<CGPSInfo, NeoVIMICErrType>;
+  // Empty if nothing changed since the info with sequence last_seq, which
+  // costs no copy. Pass 0 to get the first update.
+  [[nodiscard]] auto gps_info_if_newer(uint64_t last_seq) const noexcept
+      -> std::expected<std::optional<CGPSInfo>, NeoVIMICErrType>;
+  // CGPSInfo::sequence of the latest update, 0 until the first one.
+  [[nodiscard]] auto gps_sequence() const noexcept
+      -> std::expected<uint64_t, NeoVIMICErrType>;
+  // Position, velocity and DOP without copying the satellites.
+  [[nodiscard]] auto gps_fix() const noexcept
+      -> std::expected<CGPSFix, NeoVIMICErrType>;
+  [[nodiscard]] auto gps_satellites() const
+      -> std::expected<GPSSatellites, NeoVIMICErrType>;
+  // Mapping from host monotonic time to GPS UTC, fails until the GPS has
+  // reported the time.
+  [[nodiscard]] auto gps_clock_mapping() const noexcept
+      -> std::expected<CGPSClockMapping, NeoVIMICErrType>;
+  [[nodiscard]] auto gps_is_open() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
   auto gps_open() const -> std::expected<void, NeoVIMICErrType>;
+  auto gps_open(CGpsProtocol protocol) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Fails if the receiver doesn't acknowledge the configuration.
+  auto gps_open(const GpsConfig &config) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Also sends every message of transaction in one write once configured,
+  // see mic2_gps_open_transaction(). transaction.states() tells which ones
+  // the receiver rejected.
+  auto gps_open(const GpsConfig &config, UbxTransaction &transaction) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Calls callback from the GPS reader thread after every PUBX00/03/04 or
+  // UBX-NAV update. Returns the subscription id to pass to gps_unsubscribe().
+  auto gps_subscribe(GPSInfoCallback callback) const
+      -> std::expected<uint32_t, NeoVIMICErrType>;
+  auto gps_unsubscribe(uint32_t id) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Moves every GPS update received since the last call into infos, oldest
+  // first. Returns how many entries of infos were filled. Buffering starts
+  // with the first call, which fills nothing.
+  [[nodiscard]] auto gps_drain(std::span<CGPSInfo> infos) const noexcept
+      -> std::expected<size_t, NeoVIMICErrType>;
+  // Records every position update to path from the GPS reader thread, read
+  // it back with FixLogReader. Replaces a log that is already running.
+  auto gps_fix_log_start(std::string path) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Returns false if no log was running.
+  auto gps_fix_log_stop() const -> std::expected<bool, NeoVIMICErrType>;
+  // Calls callback with every byte read from the GPS port before it is parsed.
+  // With parse false the bytes are only passed on and gps_info() stops
+  // updating, for record-only setups.
+  auto gps_raw_tap_start(bool parse, RawTapCallback callback) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Same as gps_raw_tap_start() but writes the bytes to path.
+  auto gps_raw_tap_start(bool parse, std::string path) const
+      -> std::expected<void, NeoVIMICErrType>;
+  auto gps_raw_tap_stop() const -> std::expected<void, NeoVIMICErrType>;
+  // Evaluates every position update once on the GPS reader thread: ECEF
+  // coordinates, an odometer, smoothed velocity and geofence membership, read
+  // with gps_metrics(). Only changes the tuning if already started.
+  auto gps_metrics_start() const -> std::expected<void, NeoVIMICErrType>;
+  auto gps_metrics_start(const MetricsConfig &config) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Drops the odometer and geofences.
+  auto gps_metrics_stop() const -> std::expected<void, NeoVIMICErrType>;
+  [[nodiscard]] auto gps_metrics() const noexcept
+      -> std::expected<CFixMetrics, NeoVIMICErrType>;
+  auto gps_metrics_reset_odometer() const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Returns the geofence id reported in CFixMetrics::geofences.
+  auto gps_geofence_add(std::span<const CGeoPoint> vertices) const
+      -> std::expected<uint32_t, NeoVIMICErrType>;
+  auto gps_geofence_remove(uint32_t id) const
+      -> std::expected<void, NeoVIMICErrType>;
 
-  auto io_button_is_pressed() const -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto io_button_is_pressed() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
+  // Samples the button every sample_interval and calls callback with every
+  // press and release that holds for debounce. The IO must be open,
+  // io_close() stops the monitor.
+  auto io_button_monitor_start(std::chrono::milliseconds sample_interval,
+                               std::chrono::milliseconds debounce,
+                               ButtonEventCallback callback) const
+      -> std::expected<void, NeoVIMICErrType>;
+  auto io_button_monitor_stop() const -> std::expected<void, NeoVIMICErrType>;
   auto io_buzzer_enable(bool enable) const
       -> std::expected<void, NeoVIMICErrType>;
-  auto io_buzzer_is_enabled() const -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto io_buzzer_is_enabled() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
   auto io_close() const -> std::expected<void, NeoVIMICErrType>;
   auto io_gpsled_enable(bool enable) const
       -> std::expected<void, NeoVIMICErrType>;
-  auto io_gpsled_is_enabled() const -> std::expected<bool, NeoVIMICErrType>;
-  auto io_is_open() const -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto io_gpsled_is_enabled() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
+  [[nodiscard]] auto io_is_open() const noexcept
+      -> std::expected<bool, NeoVIMICErrType>;
+  // io_buzzer_is_enabled()/io_gpsled_is_enabled() answer from the last state
+  // written, the pins are read again once it is older than interval. Zero,
+  // the default, trusts it until the IO is reopened.
+  auto io_set_revalidate_interval(std::chrono::milliseconds interval) const
+      -> std::expected<void, NeoVIMICErrType>;
+  // Bitwise OR of the MIC2_IO_* lines that are high, read in one USB transfer.
+  [[nodiscard]] auto io_read_state() const noexcept
+      -> std::expected<uint8_t, NeoVIMICErrType>;
+  // Drives the MIC2_IO_BUZZER/MIC2_IO_GPSLED outputs in mask to values in one
+  // USB transfer, ie. io_write_state(MIC2_IO_BUZZER | MIC2_IO_GPSLED,
+  // MIC2_IO_GPSLED).
+  auto io_write_state(uint8_t mask, uint8_t values) const
+      -> std::expected<void, NeoVIMICErrType>;
   auto io_open() const -> std::expected<void, NeoVIMICErrType>;
+  // Opens the MIC2_SUBSYSTEM_* subsystems in subsystems in the background, IO
+  // and GPS concurrently. Fails with the error of the first subsystem that
+  // failed. The future holds on to the handle, so this may be moved meanwhile
+  // but not destroyed until the future is ready. Discarding the future waits
+  // for the open.
+  [[nodiscard]] auto open_async(uint8_t subsystems) const
+      -> std::future<std::expected<void, NeoVIMICErrType>>;
+  [[nodiscard]] auto open_async(uint8_t subsystems,
+                                const GpsConfig &config) const
+      -> std::future<std::expected<void, NeoVIMICErrType>>;
+
+  // Hot path variants of the accessors above without a std::expected, they
+  // return the mic2_* result as is and the out parameters are only valid on
+  // NeoVIMICErrTypeSuccess. Always inline, even without MIC2_HEADER_ONLY.
+  [[nodiscard]] auto try_stats(CDeviceStats &stats) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_stats(&device, &stats, sizeof(stats));
+  }
+  [[nodiscard]] auto try_gps_has_lock(bool &has_lock) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_gps_has_lock(&device, &has_lock);
+  }
+  [[nodiscard]] auto try_gps_info(CGPSInfo &info) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_gps_info(&device, &info, sizeof(info));
+  }
+  // updated is false and info untouched if nothing changed since last_seq.
+  [[nodiscard]] auto try_gps_info_if_newer(uint64_t last_seq, CGPSInfo &info,
+                                           bool &updated) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_gps_info_if_newer(&device, last_seq, &info, sizeof(info),
+                                  &updated);
+  }
+  [[nodiscard]] auto try_gps_sequence(uint64_t &sequence) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_gps_sequence(&device, &sequence);
+  }
+  [[nodiscard]] auto try_gps_fix(CGPSFix &fix) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_gps_fix(&device, &fix, sizeof(fix));
+  }
+  [[nodiscard]] auto try_gps_metrics(CFixMetrics &metrics) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_gps_metrics(&device, &metrics, sizeof(metrics));
+  }
+  // count is how many entries of infos were filled.
+  [[nodiscard]] auto try_gps_drain(std::span<CGPSInfo> infos,
+                                   size_t &count) const noexcept
+      -> NeoVIMICErrType {
+    auto length = static_cast<uint32_t>(
+        std::min(infos.size(), size_t{std::numeric_limits<uint32_t>::max()}));
+    NeoVIMICErrType err =
+        mic2_gps_drain(&device, infos.data(), &length, sizeof(CGPSInfo));
+    count = length;
+    return err;
+  }
+  // count is how many entries of levels were filled.
+  [[nodiscard]] auto try_audio_levels_drain(std::span<CAudioLevel> levels,
+                                            size_t &count) const noexcept
+      -> NeoVIMICErrType {
+    auto length = static_cast<uint32_t>(
+        std::min(levels.size(), size_t{std::numeric_limits<uint32_t>::max()}));
+    NeoVIMICErrType err = mic2_audio_levels_drain(&device, levels.data(),
+                                                  &length, sizeof(CAudioLevel));
+    count = length;
+    return err;
+  }
+  [[nodiscard]] auto try_io_read_state(uint8_t &state) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_io_read_state(&device, &state);
+  }
+  [[nodiscard]] auto try_io_write_state(uint8_t mask,
+                                        uint8_t values) const noexcept
+      -> NeoVIMICErrType {
+    return mic2_io_write_state(&device, mask, values);
+  }
 
   // std::variant<bool, NeoVIMICErrType> mic2_find() const;
   // std::variant<bool, NeoVIMICErrType> mic2_free() const;
   // std::variant<bool, NeoVIMICErrType> mic2_error_string() const;
 
 private:
-  const NeoVIMIC device;
+  friend class Context;
+  friend auto snapshot_all(std::span<const CNeoVIMIC> devices)
+      -> std::expected<std::vector<CDeviceStatus>, NeoVIMICErrType>;
+  friend auto open_all(std::span<const CNeoVIMIC> devices, uint8_t subsystems,
+                       const GpsConfig &config)
+      -> std::future<std::expected<std::vector<COpenResult>, NeoVIMICErrType>>;
+
+  // Closes IO/GPS and frees the handle, leaves device without a handle.
+  void release() noexcept;
+
+  // handle is nullptr once moved from.
+  NeoVIMIC device;
+};
+
+// Read-only view of a log written by CNeoVIMIC::gps_fix_log_start(). The file
+// is memory mapped and records are used in place, nothing is parsed. Records
+// are in the order they were received, monotonic_time_ns never decreases.
+// A record still being written by the GPS reader thread is ignored.
+// monotonic_time_ns is relative to the process that wrote the log, add
+// epoch_utc_ns() for the host UTC time.
+class FixLogReader {
+public:
+  // Fails with NeoVIMICErrTypeVersionMismatch if the file was written by an
+  // incompatible libmic2 or its records aren't in this host's byte order, or
+  // with NeoVIMICErrTypeSizeMismatch if the record layout differs.
+  static auto open(const std::string &path)
+      -> std::expected<FixLogReader, NeoVIMICErrType>;
+  ~FixLogReader();
+  FixLogReader(const FixLogReader &) = delete;
+  FixLogReader &operator=(const FixLogReader &) = delete;
+  FixLogReader(FixLogReader &&other) noexcept;
+  FixLogReader &operator=(FixLogReader &&other) noexcept;
+
+  auto records() const -> std::span<const CGPSFix> { return fixes; }
+  auto size() const -> size_t { return fixes.size(); }
+  // Host UTC time in ns since the Unix epoch at monotonic_time_ns 0 of the
+  // writer.
+  auto epoch_utc_ns() const -> int64_t { return epoch_ns; }
+  auto operator[](size_t index) const -> const CGPSFix & {
+    return fixes[index];
+  }
+  // Records with begin_ns <= monotonic_time_ns < end_ns, found with a binary
+  // search.
+  auto range(uint64_t begin_ns, uint64_t end_ns) const
+      -> std::span<const CGPSFix>;
+
+private:
+  FixLogReader() = default;
+  void unmap() noexcept;
+
+  void *mapping = nullptr;
+  size_t mapping_length = 0;
+  int64_t epoch_ns = 0;
+  std::span<const CGPSFix> fixes;
+};
+
+// Offline u-blox parser, see mic2_gps_parser_new(). Replays raw bytes, ie. from
+// CNeoVIMIC::gps_raw_tap_start(), through the same parsing as the GPS reader
+// thread. Not thread safe.
+class GPSParser {
+public:
+  static auto create() -> std::expected<GPSParser, NeoVIMICErrType>;
+  ~GPSParser();
+  GPSParser(const GPSParser &) = delete;
+  GPSParser &operator=(const GPSParser &) = delete;
+  GPSParser(GPSParser &&other) noexcept;
+  GPSParser &operator=(GPSParser &&other) noexcept;
+
+  // Returns the number of GPS info updates the bytes completed.
+  auto push(std::span<const uint8_t> data)
+      -> std::expected<uint32_t, NeoVIMICErrType>;
+  [[nodiscard]] auto info() const noexcept
+      -> std::expected<CGPSInfo, NeoVIMICErrType>;
+  [[nodiscard]] auto stats() const noexcept
+      -> std::expected<CGPSStats, NeoVIMICErrType>;
+
+private:
+  explicit GPSParser(CGPSParser *parser) : parser(parser) {}
+
+  // nullptr once moved from.
+  CGPSParser *parser = nullptr;
+};
+
+// UBX CFG messages for custom receiver configuration, see
+// mic2_ubx_transaction_new() and CNeoVIMIC::gps_open(). Not thread safe.
+class UbxTransaction {
+public:
+  static auto create() -> std::expected<UbxTransaction, NeoVIMICErrType>;
+  ~UbxTransaction();
+  UbxTransaction(const UbxTransaction &) = delete;
+  UbxTransaction &operator=(const UbxTransaction &) = delete;
+  UbxTransaction(UbxTransaction &&other) noexcept;
+  UbxTransaction &operator=(UbxTransaction &&other) noexcept;
+
+  // Returns the index of the message in states(). Only CFG (0x06) messages are
+  // accepted, the receiver never acknowledges any other class.
+  auto add(uint8_t msg_class, uint8_t id, std::span<const uint8_t> payload)
+      -> std::expected<size_t, NeoVIMICErrType>;
+  // Answer to every message, in the order they were added.
+  auto states() const
+      -> std::expected<std::vector<CUbxAckState>, NeoVIMICErrType>;
+
+private:
+  friend class CNeoVIMIC;
+  explicit UbxTransaction(CUbxTransaction *transaction)
+      : transaction(transaction) {}
+
+  // nullptr once moved from.
+  CUbxTransaction *transaction = nullptr;
 };
 
+// Shared event loop, see mic2_context_new(). The GPS ports and IO button
+// monitors of every device it owns are serviced by one thread instead of a
+// thread each, so GPS and button callbacks hold up every other device. Devices
+// are closed before the event loop stops.
+class Context {
+public:
+  // Fails with NeoVIMICErrTypeFailure if the platform has no shared event
+  // loop, devices then need threads of their own.
+  static auto create() -> std::expected<Context, NeoVIMICErrType>;
+  ~Context();
+  Context(const Context &) = delete;
+  Context &operator=(const Context &) = delete;
+  Context(Context &&other) noexcept;
+  Context &operator=(Context &&other) noexcept;
+
+  // Replaces devices() with every neoVI MIC2 attached now, returns how many
+  // were found.
+  auto find() -> std::expected<size_t, NeoVIMICErrType>;
+  // Takes ownership of device, ie. from hotplug_subscribe(). The pointer stays
+  // valid until the device is released or the context is destroyed.
+  auto adopt(CNeoVIMIC device) -> std::expected<CNeoVIMIC *, NeoVIMICErrType>;
+  // Closes and frees devices with serial_number, returns how many there were.
+  auto release(const std::string &serial_number) -> size_t;
+  // snapshot_all() of devices(), in the same order.
+  auto snapshot() const
+      -> std::expected<std::vector<CDeviceStatus>, NeoVIMICErrType>;
+  auto devices() -> std::list<CNeoVIMIC> & { return owned; }
+
+private:
+  explicit Context(CContext *context) : context(context) {}
+  void destroy() noexcept;
+
+  // nullptr once moved from.
+  CContext *context = nullptr;
+  // A list so release() doesn't invalidate adopt() pointers.
+  std::list<CNeoVIMIC> owned;
+};
+
+// Passed to the callback of hotplug_subscribe().
+struct HotplugEvent {
+  CHotplugEventType type;
+  std::string serial_number;
+  // The neoVI MIC2 that arrived, empty for CHotplugEventTypeLeft.
+  std::optional<CNeoVIMIC> device;
+};
+// Invoked from the hotplug thread, see hotplug_subscribe().
+using HotplugCallback = std::function<void(HotplugEvent)>;
+
 auto find() -> std::expected<std::vector<CNeoVIMIC>, NeoVIMICErrType>;
-auto error_string(NeoVIMICErrType err) -> std::string;
+// GPS and IO state of every device in one call without USB transfers, see
+// mic2_snapshot(). Entry i describes devices[i].
+auto snapshot_all(std::span<const CNeoVIMIC> devices)
+    -> std::expected<std::vector<CDeviceStatus>, NeoVIMICErrType>;
+// Calls callback for every neoVI MIC2 already attached and then every time one
+// arrives or leaves. Returns the subscription id to pass to
+// hotplug_unsubscribe().
+auto hotplug_subscribe(HotplugCallback callback)
+    -> std::expected<uint32_t, NeoVIMICErrType>;
+auto hotplug_unsubscribe(uint32_t id) -> std::expected<void, NeoVIMICErrType>;
+// Same text as mic2_error_string() without calling into libmic2.
+[[nodiscard]] constexpr auto error_string_view(NeoVIMICErrType err) noexcept
+    -> std::string_view {
+  switch (err) {
+  case NeoVIMICErrTypeSuccess:
+    return "Success";
+  case NeoVIMICErrTypeFailure:
+    return "Failure";
+  case NeoVIMICErrTypeInvalidParameter:
+    return "Invalid Parameter";
+  case NeoVIMICErrTypeInvalidIndex:
+    return "Invalid Index";
+  case NeoVIMICErrTypeVersionMismatch:
+    return "Version Mismatch";
+  case NeoVIMICErrTypeSizeMismatch:
+    return "Size Mismatch";
+  case NeoVIMICErrTypeNotSupported:
+    return "Not Supported";
+  case NeoVIMICErrTypeTimedOut:
+    return "Timed Out";
+  }
+  return "Unknown Error";
+}
+static_assert(error_string_view(NeoVIMICErrTypeSuccess) == "Success");
+static_assert(error_string_view(NeoVIMICErrTypeSizeMismatch) ==
+              "Size Mismatch");
+[[nodiscard]] auto error_string(NeoVIMICErrType err) -> std::string;
+// Default receiver setup for protocol, a starting point for
+// CNeoVIMIC::gps_open(const GpsConfig &).
+auto gps_config_default(CGpsProtocol protocol = CGpsProtocolNmea) -> GpsConfig;
+// Default tuning for CNeoVIMIC::gps_metrics_start().
+auto metrics_config_default() -> MetricsConfig;
+// Default tuning for CNeoVIMIC::audio_analysis_start().
+auto analysis_config_default() -> AnalysisConfig;
+// Opens the MIC2_SUBSYSTEM_* subsystems of every device at once in the
+// background, see mic2_open_all(). Entry i describes devices[i], the future
+// only holds an error if the arguments were rejected. The devices may be moved
+// while it runs but must outlive the future.
+[[nodiscard]] auto open_all(std::span<const CNeoVIMIC> devices, uint8_t subsystems,
+              const GpsConfig &config = gps_config_default())
+    -> std::future<std::expected<std::vector<COpenResult>, NeoVIMICErrType>>;
+// UTC unix time in nanoseconds of a host monotonic timestamp, ie.
+// CAudioChunk::monotonic_time_ns.
+auto utc_time_ns_at(const CGPSClockMapping &mapping,
+                    uint64_t monotonic_time_ns) -> int64_t;
 
 }; // namespace mic2
+
+#ifdef MIC2_HEADER_ONLY
+#include "mic2_impl.hpp"
+#endif
@@ -0,0 +1,1233 @@
+#pragma once
+
+// Definitions of mic2.hpp. Compiled once by mic2.cpp, or inline into every
+// translation unit that includes mic2.hpp with MIC2_HEADER_ONLY defined.
+
+#include "mic2.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <functional>
+#include <future>
+#include <limits>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+// Only the file mapping API is used. With MIC2_HEADER_ONLY this reaches every
+// includer, so keep it lean and leave their macro environment as it was.
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#define MIC2_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#define MIC2_UNDEF_NOMINMAX
+#endif
+#include <windows.h>
+#ifdef MIC2_UNDEF_WIN32_LEAN_AND_MEAN
+#undef WIN32_LEAN_AND_MEAN
+#undef MIC2_UNDEF_WIN32_LEAN_AND_MEAN
+#endif
+#ifdef MIC2_UNDEF_NOMINMAX
+#undef NOMINMAX
+#undef MIC2_UNDEF_NOMINMAX
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mic2 {
+
+namespace detail {
+MIC2_INLINE void gps_info_callback_trampoline(const CGPSInfo *info,
+                                              void *user_data) noexcept {
+  (*static_cast<GPSInfoCallback *>(user_data))(*info);
+}
+
+MIC2_INLINE void gps_info_callback_free(void *user_data) noexcept {
+  delete static_cast<GPSInfoCallback *>(user_data);
+}
+
+MIC2_INLINE void raw_tap_callback_trampoline(const uint8_t *data, size_t length,
+                                             void *user_data) noexcept {
+  (*static_cast<RawTapCallback *>(user_data))({data, length});
+}
+
+MIC2_INLINE void raw_tap_callback_free(void *user_data) noexcept {
+  delete static_cast<RawTapCallback *>(user_data);
+}
+
+MIC2_INLINE void audio_chunk_callback_trampoline(const CAudioChunk *chunk,
+                                                 void *user_data) noexcept {
+  (*static_cast<AudioChunkCallback *>(user_data))(*chunk);
+}
+
+MIC2_INLINE void audio_chunk_callback_free(void *user_data) noexcept {
+  delete static_cast<AudioChunkCallback *>(user_data);
+}
+
+MIC2_INLINE void button_event_callback_trampoline(const CButtonEvent *event,
+                                                  void *user_data) noexcept {
+  (*static_cast<ButtonEventCallback *>(user_data))(*event);
+}
+
+MIC2_INLINE void button_event_callback_free(void *user_data) noexcept {
+  delete static_cast<ButtonEventCallback *>(user_data);
+}
+
+MIC2_INLINE void hotplug_callback_trampoline(CHotplugEventType event_type,
+                                             const NeoVIMIC *device,
+                                             void *user_data) noexcept {
+  HotplugEvent event = {event_type, device->serial_number, std::nullopt};
+  if (event_type == CHotplugEventTypeArrived) {
+    event.device.emplace(*device);
+  }
+  (*static_cast<HotplugCallback *>(user_data))(std::move(event));
+}
+
+MIC2_INLINE void hotplug_callback_free(void *user_data) noexcept {
+  delete static_cast<HotplugCallback *>(user_data);
+}
+
+// Clamp to what the C API accepts, negative timeouts don't wait.
+MIC2_INLINE auto to_timeout_ms(std::chrono::milliseconds timeout) -> uint32_t {
+  return static_cast<uint32_t>(std::clamp<std::chrono::milliseconds::rep>(
+      timeout.count(), 0, std::numeric_limits<uint32_t>::max()));
+}
+
+MIC2_INLINE auto to_segment_seconds(std::chrono::seconds segment_length)
+    -> uint32_t {
+  return static_cast<uint32_t>(std::clamp<std::chrono::seconds::rep>(
+      segment_length.count(), 0, std::numeric_limits<uint32_t>::max()));
+}
+} // namespace detail
+
+MIC2_INLINE CNeoVIMIC::CNeoVIMIC(const NeoVIMIC &device) : device(device) {}
+MIC2_INLINE CNeoVIMIC::~CNeoVIMIC() { release(); }
+MIC2_INLINE CNeoVIMIC::CNeoVIMIC(CNeoVIMIC &&other) noexcept
+    : device(other.device) {
+  other.device.handle = nullptr;
+}
+MIC2_INLINE auto CNeoVIMIC::operator=(CNeoVIMIC &&other) noexcept
+    -> CNeoVIMIC & {
+  if (this != &other) {
+    release();
+    device = other.device;
+    other.device.handle = nullptr;
+  }
+  return *this;
+}
+
+MIC2_INLINE void CNeoVIMIC::release() noexcept {
+  if (device.handle == nullptr) {
+    return;
+  }
+  if (io_is_open().value_or(false)) {
+    io_close();
+  }
+  if (gps_is_open().value_or(false)) {
+    gps_close();
+  }
+  mic2_free(&device);
+  device.handle = nullptr;
+}
+
+MIC2_INLINE auto CNeoVIMIC::has_gps() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool has_gps = false;
+  NeoVIMICErrType err = mic2_has_gps(&device, &has_gps);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return has_gps;
+  }
+}
+
+MIC2_INLINE auto CNeoVIMIC::get_serial_number() const -> std::string {
+  return device.serial_number;
+}
+MIC2_INLINE auto CNeoVIMIC::stats() const noexcept
+    -> std::expected<CDeviceStats, NeoVIMICErrType> {
+  CDeviceStats stats = {};
+  NeoVIMICErrType err = mic2_stats(&device, &stats, sizeof(stats));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return stats;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::stats_reset() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_stats_reset(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+
+MIC2_INLINE auto CNeoVIMIC::audio_save(std::string path) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_save(&device, path.c_str());
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_start(uint32_t sample_rate) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_start(&device, sample_rate);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_start(
+    uint32_t sample_rate, std::string path,
+    std::chrono::seconds segment_length) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err =
+      mic2_audio_record_start(&device, sample_rate, path.c_str(),
+                              detail::to_segment_seconds(segment_length));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_stop() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_stop(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_stream_start(
+    uint32_t sample_rate, uint32_t chunk_length,
+    AudioChunkCallback callback) const
+    -> std::expected<void, NeoVIMICErrType> {
+  // Ownership is handed to libmic2, audio_chunk_callback_free() releases it
+  // even if starting fails
+  auto *user_data = new AudioChunkCallback(std::move(callback));
+  NeoVIMICErrType err = mic2_audio_stream_start(
+      &device, sample_rate, chunk_length,
+      detail::audio_chunk_callback_trampoline, user_data,
+      detail::audio_chunk_callback_free);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_stream_stop() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_stream_stop(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_analysis_start() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_analysis_start(&device, nullptr);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_analysis_start(
+    const AnalysisConfig &config) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_analysis_start(&device, &config);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_analysis_stop() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_analysis_stop(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_levels_drain(
+    std::span<CAudioLevel> levels) const noexcept
+    -> std::expected<size_t, NeoVIMICErrType> {
+  auto length = static_cast<uint32_t>(
+      std::min(levels.size(), size_t{std::numeric_limits<uint32_t>::max()}));
+  NeoVIMICErrType err = mic2_audio_levels_drain(&device, levels.data(),
+                                                &length, sizeof(CAudioLevel));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return length;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_triggers_drain(
+    std::span<CAudioLevel> levels) const noexcept
+    -> std::expected<size_t, NeoVIMICErrType> {
+  auto length = static_cast<uint32_t>(
+      std::min(levels.size(), size_t{std::numeric_limits<uint32_t>::max()}));
+  NeoVIMICErrType err = mic2_audio_triggers_drain(&device, levels.data(),
+                                                  &length, sizeof(CAudioLevel));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return length;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::audio_trigger_record_start(
+    uint32_t sample_rate, std::string path,
+    std::chrono::milliseconds pre_trigger) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_audio_trigger_record_start(
+      &device, sample_rate, path.c_str(), detail::to_timeout_ms(pre_trigger));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_close() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_close(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_has_lock() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool gps_has_lock = false;
+  NeoVIMICErrType err = mic2_gps_has_lock(&device, &gps_has_lock);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return gps_has_lock;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_wait_for_lock(
+    std::chrono::milliseconds timeout) const
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool gps_has_lock = false;
+  NeoVIMICErrType err = mic2_gps_wait_for_lock(
+      &device, detail::to_timeout_ms(timeout), &gps_has_lock);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return gps_has_lock;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_wait_for_fix(
+    std::chrono::milliseconds timeout) const
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool received = false;
+  NeoVIMICErrType err =
+      mic2_gps_wait_for_fix(&device, detail::to_timeout_ms(timeout), &received);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return received;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_info() const noexcept
+    -> std::expected<CGPSInfo, NeoVIMICErrType> {
+  CGPSInfo info = {};
+  NeoVIMICErrType err = mic2_gps_info(&device, &info, sizeof(info));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return info;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_info_if_newer(uint64_t last_seq) const noexcept
+    -> std::expected<std::optional<CGPSInfo>, NeoVIMICErrType> {
+  CGPSInfo info = {};
+  bool updated = false;
+  NeoVIMICErrType err =
+      mic2_gps_info_if_newer(&device, last_seq, &info, sizeof(info), &updated);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else if (!updated) {
+    return std::nullopt;
+  } else {
+    return info;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_sequence() const noexcept
+    -> std::expected<uint64_t, NeoVIMICErrType> {
+  uint64_t sequence = 0;
+  NeoVIMICErrType err = mic2_gps_sequence(&device, &sequence);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return sequence;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_fix() const noexcept
+    -> std::expected<CGPSFix, NeoVIMICErrType> {
+  CGPSFix fix = {};
+  NeoVIMICErrType err = mic2_gps_fix(&device, &fix, sizeof(fix));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return fix;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_satellites() const
+    -> std::expected<GPSSatellites, NeoVIMICErrType> {
+  GPSSatellites satellites;
+  size_t count = 0;
+  // Satellites can come and go between calls, retry until they fit
+  for (size_t length = 0;; length = count) {
+    satellites.prn.resize(length);
+    satellites.snr.resize(length);
+    satellites.elevation.resize(length);
+    satellites.azimuth.resize(length);
+    satellites.flags.resize(length);
+    NeoVIMICErrType err = mic2_gps_satellites(
+        &device, satellites.prn.data(), satellites.snr.data(),
+        satellites.elevation.data(), satellites.azimuth.data(),
+        satellites.flags.data(), length, &count);
+    if (err != NeoVIMICErrTypeSuccess) {
+      return std::unexpected(err);
+    }
+    if (count == length) {
+      return satellites;
+    }
+    // Fewer than last time, the copied ones are complete
+    if (count < length) {
+      satellites.prn.resize(count);
+      satellites.snr.resize(count);
+      satellites.elevation.resize(count);
+      satellites.azimuth.resize(count);
+      satellites.flags.resize(count);
+      return satellites;
+    }
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_clock_mapping() const noexcept
+    -> std::expected<CGPSClockMapping, NeoVIMICErrType> {
+  CGPSClockMapping mapping = {};
+  NeoVIMICErrType err = mic2_gps_clock_mapping(&device, &mapping);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return mapping;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_is_open() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool gps_is_open = false;
+  NeoVIMICErrType err = mic2_gps_is_open(&device, &gps_is_open);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return gps_is_open;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_open() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_open(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_open(CGpsProtocol protocol) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_open_protocol(&device, protocol);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_open(const GpsConfig &config) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_open_config(&device, &config);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_open(const GpsConfig &config,
+                                     UbxTransaction &transaction) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err =
+      mic2_gps_open_transaction(&device, &config, transaction.transaction);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_subscribe(GPSInfoCallback callback) const
+    -> std::expected<uint32_t, NeoVIMICErrType> {
+  uint32_t id = 0;
+  // Ownership is handed to libmic2, gps_info_callback_free() releases it even
+  // if subscribing fails
+  auto *user_data = new GPSInfoCallback(std::move(callback));
+  NeoVIMICErrType err = mic2_gps_subscribe(
+      &device, detail::gps_info_callback_trampoline, user_data,
+      detail::gps_info_callback_free, &id);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return id;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_unsubscribe(uint32_t id) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_unsubscribe(&device, id);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_drain(std::span<CGPSInfo> infos) const noexcept
+    -> std::expected<size_t, NeoVIMICErrType> {
+  auto length = static_cast<uint32_t>(
+      std::min(infos.size(), size_t{std::numeric_limits<uint32_t>::max()}));
+  NeoVIMICErrType err =
+      mic2_gps_drain(&device, infos.data(), &length, sizeof(CGPSInfo));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return length;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_button_is_pressed() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool io_button_is_pressed = false;
+  NeoVIMICErrType err =
+      mic2_io_button_is_pressed(&device, &io_button_is_pressed);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return io_button_is_pressed;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_button_monitor_start(
+    std::chrono::milliseconds sample_interval,
+    std::chrono::milliseconds debounce, ButtonEventCallback callback) const
+    -> std::expected<void, NeoVIMICErrType> {
+  // Ownership is handed to libmic2, button_event_callback_free() releases it
+  // even if starting fails
+  auto *user_data = new ButtonEventCallback(std::move(callback));
+  NeoVIMICErrType err = mic2_io_button_monitor_start(
+      &device, detail::to_timeout_ms(sample_interval),
+      detail::to_timeout_ms(debounce), detail::button_event_callback_trampoline,
+      user_data, detail::button_event_callback_free);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_button_monitor_stop() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_io_button_monitor_stop(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_buzzer_enable(bool enable) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_io_buzzer_enable(&device, enable);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_buzzer_is_enabled() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool buzzer_is_enabled = false;
+  NeoVIMICErrType err = mic2_io_buzzer_is_enabled(&device, &buzzer_is_enabled);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return buzzer_is_enabled;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_close() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_io_close(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_gpsled_enable(bool enable) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_io_gpsled_enable(&device, enable);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_gpsled_is_enabled() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool gpsled_is_enabled = false;
+  NeoVIMICErrType err = mic2_io_gpsled_is_enabled(&device, &gpsled_is_enabled);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return gpsled_is_enabled;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_is_open() const noexcept
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool io_is_open = false;
+  NeoVIMICErrType err = mic2_io_is_open(&device, &io_is_open);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return io_is_open;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_set_revalidate_interval(
+    std::chrono::milliseconds interval) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err =
+      mic2_io_set_revalidate_interval(&device, detail::to_timeout_ms(interval));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_read_state() const noexcept
+    -> std::expected<uint8_t, NeoVIMICErrType> {
+  uint8_t state = 0;
+  NeoVIMICErrType err = mic2_io_read_state(&device, &state);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return state;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_write_state(uint8_t mask, uint8_t values) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_io_write_state(&device, mask, values);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::io_open() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_io_open(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+
+MIC2_INLINE auto CNeoVIMIC::gps_fix_log_start(std::string path) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_fix_log_start(&device, path.c_str());
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_fix_log_stop() const
+    -> std::expected<bool, NeoVIMICErrType> {
+  bool stopped = false;
+  NeoVIMICErrType err = mic2_gps_fix_log_stop(&device, &stopped);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return stopped;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_raw_tap_start(bool parse,
+                                              RawTapCallback callback) const
+    -> std::expected<void, NeoVIMICErrType> {
+  // Ownership is handed to libmic2, raw_tap_callback_free() releases it even
+  // if this fails
+  auto *user_data = new RawTapCallback(std::move(callback));
+  NeoVIMICErrType err = mic2_gps_raw_tap_start(
+      &device, parse, detail::raw_tap_callback_trampoline, user_data,
+      detail::raw_tap_callback_free);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_raw_tap_start(bool parse,
+                                              std::string path) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_raw_tap_file(&device, parse, path.c_str());
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_raw_tap_stop() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_raw_tap_stop(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_metrics_start() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_metrics_start(&device, nullptr);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_metrics_start(const MetricsConfig &config) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_metrics_start(&device, &config);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_metrics_stop() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_metrics_stop(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_metrics() const noexcept
+    -> std::expected<CFixMetrics, NeoVIMICErrType> {
+  CFixMetrics metrics = {};
+  NeoVIMICErrType err = mic2_gps_metrics(&device, &metrics, sizeof(metrics));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return metrics;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_metrics_reset_odometer() const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_metrics_reset_odometer(&device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_geofence_add(
+    std::span<const CGeoPoint> vertices) const
+    -> std::expected<uint32_t, NeoVIMICErrType> {
+  uint32_t id = 0;
+  NeoVIMICErrType err =
+      mic2_gps_geofence_add(&device, vertices.data(), vertices.size(), &id);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return id;
+  }
+}
+MIC2_INLINE auto CNeoVIMIC::gps_geofence_remove(uint32_t id) const
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_gps_geofence_remove(&device, id);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+
+namespace detail {
+inline constexpr char fix_log_magic[8] = {'M', 'I', 'C', '2',
+                                          'F', 'I', 'X', 'L'};
+
+// Maps the whole file read-only, nullptr on failure. Empty files can't be
+// mapped and aren't valid logs anyway.
+MIC2_INLINE auto map_file(const std::string &path, size_t &length) -> void * {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  LARGE_INTEGER size = {};
+  void *data = nullptr;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+    HANDLE view =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (view != nullptr) {
+      data = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(view);
+    }
+  }
+  CloseHandle(file);
+  length = static_cast<size_t>(size.QuadPart);
+  return data;
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st = {};
+  void *data = nullptr;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      data = nullptr;
+    }
+  }
+  ::close(fd);
+  length = static_cast<size_t>(st.st_size);
+  return data;
+#endif
+}
+
+MIC2_INLINE auto snapshot_handles(std::span<const NeoVIMIC *const> handles)
+    -> std::expected<std::vector<CDeviceStatus>, NeoVIMICErrType> {
+  std::vector<CDeviceStatus> statuses(handles.size());
+  NeoVIMICErrType err =
+      mic2_snapshot(handles.data(), handles.size(), statuses.data(),
+                    sizeof(CDeviceStatus));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return statuses;
+}
+// mic2_open_all() only fails as a whole on bad arguments, a subsystem failing
+// is reported in its COpenResult.
+MIC2_INLINE auto open_handles(std::span<const NeoVIMIC *const> handles,
+                              uint8_t subsystems, const GpsConfig *config)
+    -> std::expected<std::vector<COpenResult>, NeoVIMICErrType> {
+  std::vector<COpenResult> results(handles.size());
+  NeoVIMICErrType err =
+      mic2_open_all(handles.data(), handles.size(), subsystems, config,
+                    results.data(), sizeof(COpenResult));
+  if (err != NeoVIMICErrTypeSuccess && err != NeoVIMICErrTypeFailure) {
+    return std::unexpected(err);
+  }
+  return results;
+}
+MIC2_INLINE auto open_device(const NeoVIMIC *handle, uint8_t subsystems,
+                             const GpsConfig *config)
+    -> std::expected<void, NeoVIMICErrType> {
+  auto results = open_handles({&handle, 1}, subsystems, config);
+  if (!results) {
+    return std::unexpected(results.error());
+  }
+  const COpenResult &result = results->front();
+  if (result.io != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(result.io);
+  } else if (result.gps != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(result.gps);
+  }
+  return {};
+}
+} // namespace detail
+
+MIC2_INLINE auto FixLogReader::open(const std::string &path)
+    -> std::expected<FixLogReader, NeoVIMICErrType> {
+  FixLogReader reader;
+  reader.mapping = detail::map_file(path, reader.mapping_length);
+  if (reader.mapping == nullptr) {
+    return std::unexpected(NeoVIMICErrTypeFailure);
+  }
+  // Header fields are little-endian, like the records
+  auto *bytes = static_cast<const unsigned char *>(reader.mapping);
+  if (reader.mapping_length < MIC2_FIX_LOG_HEADER_LENGTH ||
+      std::memcmp(bytes, detail::fix_log_magic,
+                  sizeof(detail::fix_log_magic)) != 0) {
+    return std::unexpected(NeoVIMICErrTypeFailure);
+  }
+  uint16_t version = bytes[8] | bytes[9] << 8;
+  size_t header_length = bytes[10] | bytes[11] << 8;
+  size_t record_length = bytes[12] | bytes[13] << 8 | bytes[14] << 16 |
+                         static_cast<size_t>(bytes[15]) << 24;
+  // Read in host order, records can only be used in place if it matches
+  uint32_t byte_order = 0;
+  std::memcpy(&byte_order, bytes + 16, sizeof(byte_order));
+  if (version != MIC2_FIX_LOG_VERSION ||
+      byte_order != MIC2_FIX_LOG_BYTE_ORDER) {
+    return std::unexpected(NeoVIMICErrTypeVersionMismatch);
+  }
+  std::memcpy(&reader.epoch_ns, bytes + 24, sizeof(reader.epoch_ns));
+  if (header_length < MIC2_FIX_LOG_HEADER_LENGTH ||
+      header_length % alignof(CGPSFix) != 0 ||
+      header_length > reader.mapping_length ||
+      record_length != sizeof(CGPSFix)) {
+    return std::unexpected(NeoVIMICErrTypeSizeMismatch);
+  }
+  size_t count = (reader.mapping_length - header_length) / record_length;
+  reader.fixes = {reinterpret_cast<const CGPSFix *>(bytes + header_length),
+                  count};
+  return reader;
+}
+MIC2_INLINE FixLogReader::~FixLogReader() { unmap(); }
+MIC2_INLINE FixLogReader::FixLogReader(FixLogReader &&other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr)),
+      mapping_length(std::exchange(other.mapping_length, 0)),
+      epoch_ns(std::exchange(other.epoch_ns, 0)),
+      fixes(std::exchange(other.fixes, {})) {}
+MIC2_INLINE auto FixLogReader::operator=(FixLogReader &&other) noexcept
+    -> FixLogReader & {
+  if (this != &other) {
+    unmap();
+    mapping = std::exchange(other.mapping, nullptr);
+    mapping_length = std::exchange(other.mapping_length, 0);
+    epoch_ns = std::exchange(other.epoch_ns, 0);
+    fixes = std::exchange(other.fixes, {});
+  }
+  return *this;
+}
+MIC2_INLINE void FixLogReader::unmap() noexcept {
+  if (mapping == nullptr) {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(mapping);
+#else
+  munmap(mapping, mapping_length);
+#endif
+  mapping = nullptr;
+  mapping_length = 0;
+  fixes = {};
+}
+MIC2_INLINE auto FixLogReader::range(uint64_t begin_ns, uint64_t end_ns) const
+    -> std::span<const CGPSFix> {
+  auto by_time = [](const CGPSFix &fix, uint64_t time_ns) {
+    return fix.monotonic_time_ns < time_ns;
+  };
+  auto begin =
+      std::lower_bound(fixes.begin(), fixes.end(), begin_ns, by_time);
+  auto end = std::lower_bound(begin, fixes.end(), std::max(begin_ns, end_ns),
+                              by_time);
+  return {begin, end};
+}
+
+MIC2_INLINE auto GPSParser::create()
+    -> std::expected<GPSParser, NeoVIMICErrType> {
+  CGPSParser *parser = nullptr;
+  NeoVIMICErrType err = mic2_gps_parser_new(&parser);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return GPSParser(parser);
+}
+MIC2_INLINE GPSParser::~GPSParser() { mic2_gps_parser_free(parser); }
+MIC2_INLINE GPSParser::GPSParser(GPSParser &&other) noexcept
+    : parser(std::exchange(other.parser, nullptr)) {}
+MIC2_INLINE auto GPSParser::operator=(GPSParser &&other) noexcept
+    -> GPSParser & {
+  if (this != &other) {
+    mic2_gps_parser_free(parser);
+    parser = std::exchange(other.parser, nullptr);
+  }
+  return *this;
+}
+MIC2_INLINE auto GPSParser::push(std::span<const uint8_t> data)
+    -> std::expected<uint32_t, NeoVIMICErrType> {
+  uint32_t updates = 0;
+  NeoVIMICErrType err =
+      mic2_gps_parser_push(parser, data.data(), data.size(), &updates);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return updates;
+}
+MIC2_INLINE auto GPSParser::info() const noexcept
+    -> std::expected<CGPSInfo, NeoVIMICErrType> {
+  CGPSInfo info{};
+  NeoVIMICErrType err = mic2_gps_parser_info(parser, &info, sizeof(info));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return info;
+}
+MIC2_INLINE auto GPSParser::stats() const noexcept
+    -> std::expected<CGPSStats, NeoVIMICErrType> {
+  CGPSStats stats{};
+  NeoVIMICErrType err = mic2_gps_parser_stats(parser, &stats, sizeof(stats));
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return stats;
+}
+
+MIC2_INLINE auto UbxTransaction::create()
+    -> std::expected<UbxTransaction, NeoVIMICErrType> {
+  CUbxTransaction *transaction = nullptr;
+  NeoVIMICErrType err = mic2_ubx_transaction_new(&transaction);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return UbxTransaction(transaction);
+}
+MIC2_INLINE UbxTransaction::~UbxTransaction() {
+  mic2_ubx_transaction_free(transaction);
+}
+MIC2_INLINE UbxTransaction::UbxTransaction(UbxTransaction &&other) noexcept
+    : transaction(std::exchange(other.transaction, nullptr)) {}
+MIC2_INLINE auto UbxTransaction::operator=(UbxTransaction &&other) noexcept
+    -> UbxTransaction & {
+  if (this != &other) {
+    mic2_ubx_transaction_free(transaction);
+    transaction = std::exchange(other.transaction, nullptr);
+  }
+  return *this;
+}
+MIC2_INLINE auto UbxTransaction::add(uint8_t msg_class, uint8_t id,
+                                     std::span<const uint8_t> payload)
+    -> std::expected<size_t, NeoVIMICErrType> {
+  size_t index = 0;
+  NeoVIMICErrType err = mic2_ubx_transaction_add(
+      transaction, msg_class, id, payload.data(), payload.size(), &index);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return index;
+}
+MIC2_INLINE auto UbxTransaction::states() const
+    -> std::expected<std::vector<CUbxAckState>, NeoVIMICErrType> {
+  size_t count = 0;
+  NeoVIMICErrType err =
+      mic2_ubx_transaction_states(transaction, nullptr, 0, &count);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  std::vector<CUbxAckState> states(count);
+  err = mic2_ubx_transaction_states(transaction, states.data(), states.size(),
+                                    &count);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return states;
+}
+
+MIC2_INLINE auto Context::create() -> std::expected<Context, NeoVIMICErrType> {
+  CContext *context = nullptr;
+  NeoVIMICErrType err = mic2_context_new(&context);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return Context(context);
+}
+MIC2_INLINE Context::~Context() { destroy(); }
+MIC2_INLINE Context::Context(Context &&other) noexcept
+    : context(std::exchange(other.context, nullptr)),
+      owned(std::move(other.owned)) {}
+MIC2_INLINE auto Context::operator=(Context &&other) noexcept -> Context & {
+  if (this != &other) {
+    destroy();
+    context = std::exchange(other.context, nullptr);
+    owned = std::move(other.owned);
+  }
+  return *this;
+}
+MIC2_INLINE void Context::destroy() noexcept {
+  // Close the devices while the event loop still services them
+  owned.clear();
+  mic2_context_free(context);
+  context = nullptr;
+}
+MIC2_INLINE auto Context::find() -> std::expected<size_t, NeoVIMICErrType> {
+  auto found = mic2::find();
+  if (!found) {
+    return std::unexpected(found.error());
+  }
+  owned.clear();
+  for (auto &device : *found) {
+    if (auto adopted = adopt(std::move(device)); !adopted) {
+      return std::unexpected(adopted.error());
+    }
+  }
+  return owned.size();
+}
+MIC2_INLINE auto Context::snapshot() const
+    -> std::expected<std::vector<CDeviceStatus>, NeoVIMICErrType> {
+  std::vector<const NeoVIMIC *> handles;
+  handles.reserve(owned.size());
+  for (const auto &device : owned) {
+    handles.push_back(&device.device);
+  }
+  return detail::snapshot_handles(handles);
+}
+MIC2_INLINE auto CNeoVIMIC::open_async(uint8_t subsystems) const
+    -> std::future<std::expected<void, NeoVIMICErrType>> {
+  // A copy of device keeps pointing at the same handle after this is moved
+  return std::async(std::launch::async, [device = device, subsystems] {
+    return detail::open_device(&device, subsystems, nullptr);
+  });
+}
+MIC2_INLINE auto CNeoVIMIC::open_async(uint8_t subsystems,
+                                       const GpsConfig &config) const
+    -> std::future<std::expected<void, NeoVIMICErrType>> {
+  return std::async(std::launch::async, [device = device, subsystems, config] {
+    return detail::open_device(&device, subsystems, &config);
+  });
+}
+
+MIC2_INLINE auto Context::adopt(CNeoVIMIC device)
+    -> std::expected<CNeoVIMIC *, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_context_attach(context, &device.device);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  return &owned.emplace_back(std::move(device));
+}
+MIC2_INLINE auto Context::release(const std::string &serial_number) -> size_t {
+  return owned.remove_if([&serial_number](const CNeoVIMIC &device) {
+    return device.get_serial_number() == serial_number;
+  });
+}
+
+MIC2_INLINE auto snapshot_all(std::span<const CNeoVIMIC> devices)
+    -> std::expected<std::vector<CDeviceStatus>, NeoVIMICErrType> {
+  std::vector<const NeoVIMIC *> handles;
+  handles.reserve(devices.size());
+  for (const auto &device : devices) {
+    handles.push_back(&device.device);
+  }
+  return detail::snapshot_handles(handles);
+}
+
+MIC2_INLINE auto open_all(std::span<const CNeoVIMIC> devices,
+                          uint8_t subsystems, const GpsConfig &config)
+    -> std::future<std::expected<std::vector<COpenResult>, NeoVIMICErrType>> {
+  // Copies keep pointing at the same handles when the devices move
+  std::vector<NeoVIMIC> copies;
+  copies.reserve(devices.size());
+  for (const auto &device : devices) {
+    copies.push_back(device.device);
+  }
+  return std::async(
+      std::launch::async, [copies = std::move(copies), subsystems, config] {
+        std::vector<const NeoVIMIC *> handles;
+        handles.reserve(copies.size());
+        for (const auto &device : copies) {
+          handles.push_back(&device);
+        }
+        return detail::open_handles(handles, subsystems, &config);
+      });
+}
+
+MIC2_INLINE auto find()
+    -> std::expected<std::vector<CNeoVIMIC>, NeoVIMICErrType> {
+  uint32_t count = 0;
+  NeoVIMICErrType err = NeoVIMICErrTypeFailure;
+  if ((err = mic2_find_count(&count)) != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  // An empty vector has no buffer to pass to mic2_find_fill()
+  if (count == 0) {
+    return {};
+  }
+  std::vector<NeoVIMIC> dev_buffer(count);
+  uint32_t length = count;
+  if ((err = mic2_find_fill(dev_buffer.data(), &length, MIC2_API_VERSION,
+                            sizeof(NeoVIMIC))) != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  }
+  std::vector<CNeoVIMIC> devices;
+  devices.reserve(length);
+  for (uint32_t i = 0; i < length; i++) {
+    devices.emplace_back(dev_buffer[i]);
+  }
+  return devices;
+}
+
+MIC2_INLINE auto hotplug_subscribe(HotplugCallback callback)
+    -> std::expected<uint32_t, NeoVIMICErrType> {
+  uint32_t id = 0;
+  // Ownership is handed to libmic2, hotplug_callback_free() releases it even
+  // if subscribing fails
+  auto *user_data = new HotplugCallback(std::move(callback));
+  NeoVIMICErrType err =
+      mic2_hotplug_subscribe(detail::hotplug_callback_trampoline, user_data,
+                             detail::hotplug_callback_free, &id);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return id;
+  }
+}
+
+MIC2_INLINE auto hotplug_unsubscribe(uint32_t id)
+    -> std::expected<void, NeoVIMICErrType> {
+  NeoVIMICErrType err = mic2_hotplug_unsubscribe(id);
+  if (err != NeoVIMICErrTypeSuccess) {
+    return std::unexpected(err);
+  } else {
+    return {};
+  }
+}
+
+MIC2_INLINE auto error_string(NeoVIMICErrType err) -> std::string {
+  return std::string(error_string_view(err));
+}
+
+MIC2_INLINE auto gps_config_default(CGpsProtocol protocol) -> GpsConfig {
+  GpsConfig config = {};
+  mic2_gps_config_default(protocol, &config);
+  return config;
+}
+
+MIC2_INLINE auto metrics_config_default() -> MetricsConfig {
+  MetricsConfig config = {};
+  mic2_gps_metrics_config_default(&config);
+  return config;
+}
+
+MIC2_INLINE auto analysis_config_default() -> AnalysisConfig {
+  AnalysisConfig config = {};
+  mic2_audio_analysis_config_default(&config);
+  return config;
+}
+
+MIC2_INLINE auto utc_time_ns_at(const CGPSClockMapping &mapping,
+                                uint64_t monotonic_time_ns)
+    -> int64_t {
+  int64_t utc_time_ns = 0;
+  mic2_gps_utc_time_ns_at(&mapping, monotonic_time_ns, &utc_time_ns);
+  return utc_time_ns;
+}
+
+} // namespace mic2
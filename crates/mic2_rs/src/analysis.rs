@@ -0,0 +1,355 @@
+//! Level metering and voice activity detection of every streamed audio chunk, see
+//! [crate::audio::Audio::analysis_start].
+//!
+//! Detecting sound events used to mean recording everything and analyzing the files offline.
+//! [Analyzer] reduces each chunk to an [AudioLevel] on the capture thread instead, which is
+//! enough to drive a trigger that only keeps the audio around events, see
+//! [crate::audio::Audio::trigger_record_start].
+use std::time::Duration;
+
+use crate::{audio::AudioChunk, types::Result};
+
+/// Number of bands in [AudioLevel::bands_dbfs]: low, mid and high.
+pub const AUDIO_BANDS: usize = 3;
+/// Level reported for silence, instead of negative infinity (dBFS).
+pub const MIN_DBFS: f32 = -120.0;
+/// How fast the noise floor follows a louder background (dB/s). It drops to a quieter one
+/// right away.
+const NOISE_FLOOR_RISE_DB_PER_S: f32 = 1.0;
+/// Accumulators of [energy_peak], 16 lanes fill an AVX2 register of i16.
+const LANES: usize = 16;
+
+/// Tuning of an [Analyzer].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct AnalysisConfig {
+    /// Split between the low and mid band (Hz)
+    pub low_cutoff_hz: f32,
+    /// Split between the mid and high band (Hz). The mid band defaults to the speech band.
+    pub high_cutoff_hz: f32,
+    /// Chunks at or above this level always trigger (dBFS)
+    pub threshold_dbfs: f32,
+    /// Chunks with the mid band this far above its noise floor trigger (dB)
+    pub snr_db: f32,
+    /// How long the trigger stays active after the last chunk that triggered
+    pub hang: Duration,
+}
+
+impl Default for AnalysisConfig {
+    fn default() -> Self {
+        Self {
+            low_cutoff_hz: 300.0,
+            high_cutoff_hz: 3400.0,
+            threshold_dbfs: -30.0,
+            snr_db: 12.0,
+            hang: Duration::from_millis(500),
+        }
+    }
+}
+
+impl AnalysisConfig {
+    /// Returns an error if the cutoffs aren't ascending positive frequencies, or the levels
+    /// aren't finite.
+    pub fn validate(&self) -> Result<()> {
+        let cutoffs_valid = self.low_cutoff_hz.is_finite()
+            && self.high_cutoff_hz.is_finite()
+            && self.low_cutoff_hz > 0.0
+            && self.low_cutoff_hz < self.high_cutoff_hz;
+        if !cutoffs_valid || !self.threshold_dbfs.is_finite() || !self.snr_db.is_finite() {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Audio band cutoffs have to be ascending and levels finite",
+            )
+            .into());
+        }
+        Ok(())
+    }
+}
+
+/// Edge of the trigger, see [AudioLevel::trigger].
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TriggerEdge {
+    /// The chunk is the first one of an event
+    Start,
+    /// The chunk is the first one after an event, the hang ran out
+    Stop,
+}
+
+/// Summary of one chunk, see [Analyzer::process].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct AudioLevel {
+    /// [AudioChunk::sequence] of the chunk
+    pub sequence: u64,
+    /// [AudioChunk::monotonic_time_ns] of the chunk
+    pub monotonic_time_ns: u64,
+    /// Number of samples in the chunk
+    pub samples: u32,
+    /// Root mean square level (dBFS)
+    pub rms_dbfs: f32,
+    /// Largest sample (dBFS)
+    pub peak_dbfs: f32,
+    /// Root mean square level of the low, mid and high band (dBFS)
+    pub bands_dbfs: [f32; AUDIO_BANDS],
+    /// Background level of the mid band the trigger compares against (dBFS)
+    pub noise_floor_dbfs: f32,
+    /// The chunk is part of an event, including the hang after it
+    pub active: bool,
+    /// Set on the chunks where [AudioLevel::active] changes
+    pub trigger: Option<TriggerEdge>,
+}
+
+/// Level of `value` relative to a full scale i16, [MIN_DBFS] for silence.
+fn dbfs(value: f64) -> f32 {
+    ((20.0 * (value / 32768.0).log10()) as f32).max(MIN_DBFS)
+}
+
+/// Sum of the squared samples and the largest magnitude. Accumulates in independent lanes
+/// so the compiler vectorizes the loop (SSE2, AVX2 or NEON) on stable Rust.
+pub fn energy_peak(samples: &[i16]) -> (u64, u16) {
+    let mut sums = [0u64; LANES];
+    let mut peaks = [0u16; LANES];
+    let mut blocks = samples.chunks_exact(LANES);
+    for block in &mut blocks {
+        for i in 0..LANES {
+            let sample = block[i] as i32;
+            sums[i] += (sample * sample) as u64;
+            peaks[i] = peaks[i].max(block[i].unsigned_abs());
+        }
+    }
+    let mut sum: u64 = sums.iter().sum();
+    let mut peak = peaks.iter().copied().max().unwrap_or_default();
+    for &sample in blocks.remainder() {
+        sum += (sample as i32 * sample as i32) as u64;
+        peak = peak.max(sample.unsigned_abs());
+    }
+    (sum, peak)
+}
+
+/// One-pole lowpass coefficient of `cutoff_hz`.
+fn lowpass_coefficient(cutoff_hz: f32, sample_rate: u32) -> f32 {
+    1.0 - (-2.0 * std::f32::consts::PI * cutoff_hz / sample_rate as f32).exp()
+}
+
+/// Meters chunks and runs the trigger on the mid band. The band split is a pair of one-pole
+/// crossovers, cheap enough for every sample but only 6 dB/octave steep.
+#[derive(Debug)]
+pub struct Analyzer {
+    config: AnalysisConfig,
+    /// Sample rate the coefficients are for
+    sample_rate: u32,
+    coefficients: [f32; 2],
+    /// Lowpass states at the low and high cutoff, carried across chunks
+    lowpass: [f32; 2],
+    noise_floor_dbfs: Option<f32>,
+    /// Time left before an active trigger stops (ns)
+    hang_left_ns: Option<u64>,
+}
+
+impl Analyzer {
+    pub fn new(config: AnalysisConfig) -> Self {
+        Self {
+            config,
+            sample_rate: 0,
+            coefficients: [0.0; 2],
+            lowpass: [0.0; 2],
+            noise_floor_dbfs: None,
+            hang_left_ns: None,
+        }
+    }
+
+    pub fn config(&self) -> AnalysisConfig {
+        self.config
+    }
+
+    /// Change the tuning without losing the noise floor or an active trigger.
+    pub fn set_config(&mut self, config: AnalysisConfig) {
+        self.config = config;
+        // Recomputed by the next chunk
+        self.sample_rate = 0;
+    }
+
+    /// Forget the stream, ie. when a new one starts.
+    pub fn reset(&mut self) {
+        *self = Self::new(self.config);
+    }
+
+    pub fn process(&mut self, chunk: &AudioChunk) -> AudioLevel {
+        // A new stream doesn't continue the filters or trigger of the last one
+        if chunk.sequence == 0 {
+            self.reset();
+        }
+        if self.sample_rate != chunk.sample_rate {
+            self.sample_rate = chunk.sample_rate;
+            self.coefficients = [
+                lowpass_coefficient(self.config.low_cutoff_hz, chunk.sample_rate),
+                lowpass_coefficient(self.config.high_cutoff_hz, chunk.sample_rate),
+            ];
+        }
+        let count = chunk.samples.len().max(1) as f64;
+        let (energy, peak) = energy_peak(chunk.samples);
+
+        let [a_low, a_high] = self.coefficients;
+        let [mut low, mut high] = self.lowpass;
+        let mut band_energy = [0f64; AUDIO_BANDS];
+        for &sample in chunk.samples {
+            let sample = sample as f32;
+            low += a_low * (sample - low);
+            high += a_high * (sample - high);
+            for (energy, band) in band_energy.iter_mut().zip([low, high - low, sample - high]) {
+                *energy += (band * band) as f64;
+            }
+        }
+        self.lowpass = [low, high];
+        let bands_dbfs = band_energy.map(|energy| dbfs((energy / count).sqrt()));
+        let rms_dbfs = dbfs((energy as f64 / count).sqrt());
+
+        let chunk_ns = chunk.samples.len() as u64 * 1_000_000_000 / chunk.sample_rate.max(1) as u64;
+        let mid_dbfs = bands_dbfs[1];
+        let noise_floor_dbfs = match self.noise_floor_dbfs {
+            Some(floor) => {
+                let rise = NOISE_FLOOR_RISE_DB_PER_S * chunk_ns as f32 / 1e9;
+                mid_dbfs.min(floor + rise)
+            }
+            None => mid_dbfs,
+        };
+        self.noise_floor_dbfs = Some(noise_floor_dbfs);
+
+        let triggered = rms_dbfs >= self.config.threshold_dbfs
+            || mid_dbfs >= noise_floor_dbfs + self.config.snr_db;
+        let was_active = self.hang_left_ns.is_some();
+        self.hang_left_ns = if triggered {
+            Some(self.config.hang.as_nanos() as u64)
+        } else {
+            self.hang_left_ns
+                .and_then(|left| left.checked_sub(chunk_ns).filter(|left| *left > 0))
+        };
+        let active = self.hang_left_ns.is_some();
+        let trigger = match (was_active, active) {
+            (false, true) => Some(TriggerEdge::Start),
+            (true, false) => Some(TriggerEdge::Stop),
+            _ => None,
+        };
+        AudioLevel {
+            sequence: chunk.sequence,
+            monotonic_time_ns: chunk.monotonic_time_ns,
+            samples: chunk.samples.len() as u32,
+            rms_dbfs,
+            peak_dbfs: dbfs(peak as f64),
+            bands_dbfs,
+            noise_floor_dbfs,
+            active,
+            trigger,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// `count` samples of a sine at `frequency_hz` and `amplitude`, starting at sample `offset`.
+    fn tone(frequency_hz: f32, amplitude: f32, offset: usize, count: usize) -> Vec<i16> {
+        (offset..offset + count)
+            .map(|i| {
+                let phase = 2.0 * std::f32::consts::PI * frequency_hz * i as f32 / 48_000.0;
+                (amplitude * phase.sin()) as i16
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_energy_peak() {
+        assert_eq!(energy_peak(&[]), (0, 0));
+        // Spans the lanes and the remainder, i16::MIN doesn't overflow
+        let mut samples = vec![2i16; 35];
+        samples[3] = -3;
+        samples[34] = i16::MIN;
+        let (energy, peak) = energy_peak(&samples);
+        assert_eq!(energy, 33 * 4 + 9 + (1 << 30));
+        assert_eq!(peak, 32768);
+        assert_eq!(dbfs(peak as f64), 0.0);
+        assert_eq!(dbfs(0.0), MIN_DBFS);
+    }
+
+    #[test]
+    fn test_analyzer() {
+        let mut analyzer = Analyzer::new(AnalysisConfig::default());
+        // 20ms chunks at 48kHz
+        let mut sequence = 0;
+        let process = |analyzer: &mut Analyzer, samples: &[i16], sequence: &mut u64| {
+            let level = analyzer.process(&AudioChunk {
+                samples,
+                sample_rate: 48_000,
+                sequence: *sequence,
+                monotonic_time_ns: *sequence * 20_000_000,
+            });
+            *sequence += 1;
+            level
+        };
+        let loudest_band = |level: &AudioLevel| {
+            (0..AUDIO_BANDS)
+                .max_by(|a, b| level.bands_dbfs[*a].total_cmp(&level.bands_dbfs[*b]))
+                .unwrap()
+        };
+
+        // Quiet hum, learns the noise floor without triggering
+        for i in 0..50 {
+            let level = process(
+                &mut analyzer,
+                &tone(60.0, 30.0, i * 960, 960),
+                &mut sequence,
+            );
+            assert!(!level.active);
+            assert_eq!(level.trigger, None);
+            assert_eq!(level.samples, 960);
+        }
+        let level = process(
+            &mut analyzer,
+            &tone(60.0, 30.0, 50 * 960, 960),
+            &mut sequence,
+        );
+        assert_eq!(loudest_band(&level), 0);
+
+        // A 1kHz tone well above the floor but below the threshold
+        let level = process(&mut analyzer, &tone(1000.0, 300.0, 0, 960), &mut sequence);
+        assert_eq!(level.trigger, Some(TriggerEdge::Start));
+        assert!(level.active);
+        assert!(level.rms_dbfs < AnalysisConfig::default().threshold_dbfs);
+        assert_eq!(loudest_band(&level), 1);
+        assert!((level.peak_dbfs - dbfs(300.0)).abs() < 0.1);
+
+        // Stays active for the 500ms hang, 25 chunks
+        for i in 0..24 {
+            let level = process(
+                &mut analyzer,
+                &tone(60.0, 30.0, i * 960, 960),
+                &mut sequence,
+            );
+            assert!(level.active);
+            assert_eq!(level.trigger, None);
+        }
+        let level = process(&mut analyzer, &tone(60.0, 30.0, 0, 960), &mut sequence);
+        assert_eq!(level.trigger, Some(TriggerEdge::Stop));
+        assert!(!level.active);
+
+        // Loud enough for the threshold alone, even outside of the mid band
+        let level = process(
+            &mut analyzer,
+            &tone(12_000.0, 20_000.0, 0, 960),
+            &mut sequence,
+        );
+        assert_eq!(level.trigger, Some(TriggerEdge::Start));
+        assert_eq!(loudest_band(&level), 2);
+        assert!((level.rms_dbfs - dbfs(20_000.0 / 2f64.sqrt())).abs() < 0.5);
+
+        // A new stream starts over
+        sequence = 0;
+        let level = process(&mut analyzer, &tone(60.0, 30.0, 0, 960), &mut sequence);
+        assert!(!level.active);
+        assert_eq!(level.trigger, None);
+
+        assert!(AnalysisConfig::default().validate().is_ok());
+        let mut config = AnalysisConfig::default();
+        config.high_cutoff_hz = config.low_cutoff_hz;
+        assert!(config.validate().is_err());
+    }
+}
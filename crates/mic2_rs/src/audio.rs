@@ -1,10 +1,396 @@
-use crate::types::{Error, Result};
+use crate::{
+    analysis::{AnalysisConfig, Analyzer, AudioLevel, TriggerEdge},
+    stats::{self, AudioStats, AudioStatsSnapshot},
+    types::{monotonic_time_ns, Error, Result},
+    wav::{EventWavWriter, SegmentedWavWriter},
+};
 use core::time;
-use std::cell::RefCell;
+use std::{
+    collections::VecDeque,
+    fmt,
+    path::Path,
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        mpsc, Arc, Mutex,
+    },
+    thread::JoinHandle,
+    time::Duration,
+};
 
 use regex::Regex;
-use sfml::{self, audio::SoundBufferRecorder};
+use sfml::{
+    self,
+    audio::{SoundBufferRecorder, SoundRecorder, SoundRecorderDriver},
+    system::Time,
+};
 
+/// Fixed size block of captured audio passed to an [AudioChunkCallback].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct AudioChunk<'a> {
+    /// Mono 16-bit PCM samples, always the chunk length passed to [Audio::stream_start].
+    /// Only valid for the duration of the callback.
+    pub samples: &'a [i16],
+    /// Sample rate in Hz
+    pub sample_rate: u32,
+    /// Number of chunks delivered before this one since the stream started.
+    pub sequence: u64,
+    /// Host monotonic time the first sample was captured (ns), see [monotonic_time_ns].
+    /// Same clock as [crate::nmea::types::GPSInfo::monotonic_time_ns].
+    pub monotonic_time_ns: u64,
+}
+
+/// Callback invoked from the audio capture thread, see [Audio::stream_start].
+pub type AudioChunkCallback = Box<dyn FnMut(&AudioChunk) + Send>;
+
+/// Callback invoked from the audio capture thread with the level of every chunk, see
+/// [Audio::analysis_start].
+pub type AudioLevelCallback = Box<dyn FnMut(&AudioLevel) + Send>;
+
+/// Passed to the file writer of [Audio::record_start] or [Audio::trigger_record_start] by
+/// [chunk_channel].
+#[derive(Debug, PartialEq)]
+enum EventMessage {
+    /// Buffer from the pool, hand it back with [ChunkReceiver::recycle] once it's written
+    Samples(Vec<i16>),
+    /// The trigger stopped, finish the event file
+    End,
+}
+
+/// Keeps the latest `pre_trigger_length` samples while it's quiet and hands events to the
+/// file writer, see [Audio::trigger_record_start].
+#[derive(Debug)]
+struct TriggerRecorder {
+    pre_trigger: VecDeque<i16>,
+    pre_trigger_length: usize,
+    /// Length of the pool buffers of tx, the pre-trigger samples are sent in pieces this long
+    chunk_length: usize,
+    tx: ChunkSender,
+}
+
+impl TriggerRecorder {
+    fn push(&mut self, samples: &[i16], level: &AudioLevel) {
+        match (level.active, level.trigger) {
+            (true, Some(TriggerEdge::Start)) => {
+                for piece in self.pre_trigger.make_contiguous().chunks(self.chunk_length) {
+                    self.tx.send(piece);
+                }
+                self.pre_trigger.clear();
+                self.tx.send(samples);
+            }
+            (true, _) => self.tx.send(samples),
+            (false, trigger) => {
+                if trigger == Some(TriggerEdge::Stop) {
+                    self.tx.end();
+                }
+                self.pre_trigger.extend(samples);
+                let excess = self
+                    .pre_trigger
+                    .len()
+                    .saturating_sub(self.pre_trigger_length);
+                self.pre_trigger.drain(..excess);
+            }
+        }
+    }
+}
+
+/// Analysis stage of the capture thread, see [Audio::analysis_start].
+struct AudioAnalysis {
+    analyzer: Analyzer,
+    /// Taken by the capture thread while it runs, see [StreamRecorder::on_process_samples]
+    callback: Option<AudioLevelCallback>,
+    recorder: Option<TriggerRecorder>,
+}
+
+impl fmt::Debug for AudioAnalysis {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("AudioAnalysis")
+            .field("analyzer", &self.analyzer)
+            .field("recorder", &self.recorder)
+            .finish_non_exhaustive()
+    }
+}
+
+impl AudioAnalysis {
+    /// Level of chunk, also passed to the trigger recorder. The callback isn't called.
+    fn process(&mut self, chunk: &AudioChunk) -> AudioLevel {
+        let level = self.analyzer.process(chunk);
+        if let Some(recorder) = &mut self.recorder {
+            recorder.push(chunk.samples, &level);
+        }
+        level
+    }
+}
+
+/// Capture side of [chunk_channel], copies chunks into buffers from the pool.
+#[derive(Debug)]
+struct ChunkSender {
+    tx: mpsc::SyncSender<EventMessage>,
+    free: mpsc::Receiver<Vec<i16>>,
+    /// Takes back buffers the queue had no room for
+    recycle: mpsc::SyncSender<Vec<i16>>,
+    stats: Arc<AudioStats>,
+}
+
+impl ChunkSender {
+    /// Queue a copy of `samples` without allocating or blocking. The chunk is dropped and
+    /// counted in [AudioStatsSnapshot::dropped_chunks] when every buffer is still queued.
+    fn send(&self, samples: &[i16]) {
+        let Ok(mut buffer) = self.free.try_recv() else {
+            stats::add(&self.stats.dropped_chunks, 1);
+            return;
+        };
+        buffer.clear();
+        buffer.extend_from_slice(samples);
+        self.queue(EventMessage::Samples(buffer));
+    }
+
+    /// Queue an [EventMessage::End].
+    fn end(&self) {
+        self.queue(EventMessage::End);
+    }
+
+    fn queue(&self, message: EventMessage) {
+        // Full once End messages take the room of buffers, or the writer is gone
+        if let Err(e) = self.tx.try_send(message) {
+            stats::add(&self.stats.dropped_chunks, 1);
+            if let mpsc::TrySendError::Full(EventMessage::Samples(buffer))
+            | mpsc::TrySendError::Disconnected(EventMessage::Samples(buffer)) = e
+            {
+                let _ = self.recycle.try_send(buffer);
+            }
+        }
+    }
+}
+
+/// Writer side of [chunk_channel].
+#[derive(Debug)]
+struct ChunkReceiver {
+    rx: mpsc::Receiver<EventMessage>,
+    free: mpsc::SyncSender<Vec<i16>>,
+}
+
+impl ChunkReceiver {
+    /// Next queued message, None once the [ChunkSender] is dropped and the queue is empty.
+    fn recv(&self) -> Option<EventMessage> {
+        self.rx.recv().ok()
+    }
+
+    /// Return a buffer from [ChunkReceiver::recv] to the pool.
+    fn recycle(&self, buffer: Vec<i16>) {
+        let _ = self.free.try_send(buffer);
+    }
+}
+
+/// Queue of `count` preallocated `chunk_length` buffers so the capture thread never allocates,
+/// the writer hands each one back with [ChunkReceiver::recycle] once it's written.
+fn chunk_channel(
+    count: usize,
+    chunk_length: usize,
+    stats: Arc<AudioStats>,
+) -> (ChunkSender, ChunkReceiver) {
+    let (tx, rx) = mpsc::sync_channel(count);
+    let (free_tx, free) = mpsc::sync_channel(count);
+    for _ in 0..count {
+        let _ = free_tx.try_send(Vec::with_capacity(chunk_length));
+    }
+    (
+        ChunkSender {
+            tx,
+            free,
+            recycle: free_tx.clone(),
+            stats,
+        },
+        ChunkReceiver { rx, free: free_tx },
+    )
+}
+
+/// Splits the variable size sample blocks from the capture device into fixed size chunks.
+#[derive(Debug)]
+struct Chunker {
+    /// Samples of the chunk being filled, never grows past the chunk length.
+    buffer: Vec<i16>,
+    chunk_length: usize,
+    sequence: u64,
+}
+
+impl Chunker {
+    fn new(chunk_length: usize) -> Self {
+        Self {
+            buffer: Vec::with_capacity(chunk_length),
+            chunk_length,
+            sequence: 0,
+        }
+    }
+
+    /// Append samples, `on_chunk` is called with (samples, sequence) for every completed chunk.
+    fn push(&mut self, mut samples: &[i16], mut on_chunk: impl FnMut(&[i16], u64)) {
+        while !samples.is_empty() {
+            let count = (self.chunk_length - self.buffer.len()).min(samples.len());
+            let (head, tail) = samples.split_at(count);
+            samples = tail;
+            // Full chunks are passed straight through without copying
+            if self.buffer.is_empty() && count == self.chunk_length {
+                on_chunk(head, self.sequence);
+            } else {
+                self.buffer.extend_from_slice(head);
+                if self.buffer.len() < self.chunk_length {
+                    break;
+                }
+                on_chunk(&self.buffer, self.sequence);
+                self.buffer.clear();
+            }
+            self.sequence += 1;
+        }
+    }
+}
+
+/// Estimates the host monotonic time samples were captured at, without the jitter of when
+/// the capture thread happens to run.
+///
+/// Delivery latency only ever makes samples look late, so the earliest start time implied
+/// by (arrival time - captured duration) is kept. It may move later by up to 0.1% of the
+/// elapsed time to follow drift between the audio and host clocks.
+#[derive(Debug)]
+struct CaptureClock {
+    sample_rate: u32,
+    /// Estimated host time of the first sample
+    start_ns: Option<u64>,
+    /// Samples received so far
+    samples: u64,
+    /// Host time of the last update
+    updated_ns: u64,
+}
+
+impl CaptureClock {
+    fn new(sample_rate: u32) -> Self {
+        Self {
+            sample_rate,
+            start_ns: None,
+            samples: 0,
+            updated_ns: 0,
+        }
+    }
+
+    /// Host time in ns of `samples` worth of audio.
+    fn duration_ns(&self, samples: u64) -> u64 {
+        (samples as u128 * 1_000_000_000 / self.sample_rate as u128) as u64
+    }
+
+    /// Account for `count` samples that arrived at `now_ns`.
+    fn update(&mut self, count: usize, now_ns: u64) {
+        self.samples += count as u64;
+        let estimate = now_ns.saturating_sub(self.duration_ns(self.samples));
+        self.start_ns = Some(match self.start_ns {
+            Some(start_ns) => {
+                let drift_ns = now_ns.saturating_sub(self.updated_ns) / 1000;
+                estimate.min(start_ns + drift_ns)
+            }
+            None => estimate,
+        });
+        self.updated_ns = now_ns;
+    }
+
+    /// Host time in ns sample number `index` was captured at.
+    fn sample_time_ns(&self, index: u64) -> u64 {
+        self.start_ns.unwrap_or_default() + self.duration_ns(index)
+    }
+}
+
+/// [SoundRecorder] that forwards [Chunker] output to an [AudioChunkCallback].
+struct StreamRecorder {
+    chunker: Chunker,
+    clock: CaptureClock,
+    sample_rate: u32,
+    callback: AudioChunkCallback,
+    analysis: Arc<Mutex<Option<AudioAnalysis>>>,
+    stats: Arc<AudioStats>,
+}
+
+impl SoundRecorder for StreamRecorder {
+    fn on_process_samples(&mut self, samples: &[i16]) -> bool {
+        let Self {
+            chunker,
+            clock,
+            sample_rate,
+            callback,
+            analysis,
+            stats,
+        } = self;
+        stats::add(&stats.samples, samples.len() as u64);
+        clock.update(samples.len(), monotonic_time_ns());
+        let chunk_length = chunker.chunk_length as u64;
+        chunker.push(samples, |samples, sequence| {
+            stats::add(&stats.chunks, 1);
+            let chunk = AudioChunk {
+                samples,
+                sample_rate: *sample_rate,
+                sequence,
+                monotonic_time_ns: clock.sample_time_ns(sequence * chunk_length),
+            };
+            // The level callback runs without the lock so it can't stall analysis_stop() and
+            // friends, or deadlock calling them. It's put back unless the analysis was
+            // stopped or given a new callback meanwhile.
+            let level = analysis
+                .lock()
+                .unwrap()
+                .as_mut()
+                .map(|analysis| (analysis.process(&chunk), analysis.callback.take()));
+            if let Some((level, Some(mut level_callback))) = level {
+                level_callback(&level);
+                if let Some(analysis) = analysis.lock().unwrap().as_mut() {
+                    analysis.callback.get_or_insert(level_callback);
+                }
+            }
+            callback(&chunk)
+        });
+        true
+    }
+}
+
+/// Chunks queued for the file writer before new ones are dropped, about 6 seconds of audio.
+const RECORD_QUEUE_LENGTH: usize = 64;
+
+/// Chunk length of [Audio::trigger_record_start], the trigger reacts within 20ms.
+const TRIGGER_CHUNKS_PER_SECOND: usize = 50;
+
+/// File writer thread started by [Audio::record_start] or [Audio::trigger_record_start].
+#[derive(Debug)]
+struct AudioRecording {
+    thread: JoinHandle<std::io::Result<()>>,
+}
+
+/// Capture thread started by [Audio::stream_start].
+#[derive(Debug)]
+struct AudioStream {
+    shutdown: Arc<AtomicBool>,
+    thread: JoinHandle<()>,
+}
+
+/// SoundBufferRecorder for [Audio::start]. SFML objects can be used from any thread as long as
+/// it's one at a time, it's only ever reached through the Mutex in [Audio].
+#[derive(Debug)]
+struct Recorder {
+    inner: SoundBufferRecorder,
+    /// Only a started recorder is stopped
+    started: bool,
+}
+
+unsafe impl Send for Recorder {}
+
+impl Recorder {
+    fn new(capture_name: &str) -> Self {
+        let mut recorder = SoundBufferRecorder::new();
+        recorder
+            .set_device(capture_name)
+            .expect("Failed to set recorder device name");
+        Self {
+            inner: recorder,
+            started: false,
+        }
+    }
+}
+
+/// Each field is locked on its own, streaming doesn't wait on a buffered recording.
 #[derive(Debug)]
 pub struct Audio {
     /// Typically is "Monitor of PCM2912A Audio Codec Analog Stereo"
@@ -12,20 +398,23 @@ pub struct Audio {
     /// Index of the capture device if multiple, starts at 1
     /// "Monitor of PCM2912A Audio Codec Analog Stereo #2" would be an index of 2
     pub index: u32,
-    recorder: RefCell<SoundBufferRecorder>,
+    recorder: Mutex<Recorder>,
+    stream: Mutex<Option<AudioStream>>,
+    recording: Mutex<Option<AudioRecording>>,
+    analysis: Arc<Mutex<Option<AudioAnalysis>>>,
+    stats: Arc<AudioStats>,
 }
 
 impl Clone for Audio {
     fn clone(&self) -> Self {
-        let recorder = RefCell::new(SoundBufferRecorder::new());
-        recorder
-            .borrow_mut()
-            .set_device(self.capture_name.as_str())
-            .expect("Failed to set recorder device name");
         Self {
             capture_name: self.capture_name.clone(),
             index: self.index,
-            recorder,
+            recorder: Mutex::new(Recorder::new(&self.capture_name)),
+            stream: Mutex::new(None),
+            recording: Mutex::new(None),
+            analysis: Arc::new(Mutex::new(None)),
+            stats: Arc::new(AudioStats::default()),
         }
     }
 }
@@ -53,37 +442,323 @@ impl Audio {
                 Some(m) => m.as_str().parse::<u32>().unwrap(),
                 None => 1,
             };
-            // Create the recorder
-            let recorder = RefCell::new(SoundBufferRecorder::new());
-            let name = device.to_str().unwrap();
-            recorder.borrow_mut().set_device(name).unwrap();
             // Create the Audio device
+            let name = device.to_str().unwrap();
             capture_devices.push(Self {
                 capture_name: device.to_string(),
                 index,
-                recorder,
+                recorder: Mutex::new(Recorder::new(name)),
+                stream: Mutex::new(None),
+                recording: Mutex::new(None),
+                analysis: Arc::new(Mutex::new(None)),
+                stats: Arc::new(AudioStats::default()),
             });
         }
         Ok(capture_devices)
     }
 
     pub fn start(&self, sample_rate: u32) -> Result<()> {
-        if !self.recorder.borrow_mut().start(sample_rate) {
+        let mut recorder = self.recorder.lock().unwrap();
+        if !recorder.inner.start(sample_rate) {
             return Err(Error::CriticalError("Failed to start recording!".into()));
         }
+        recorder.started = true;
         Ok(())
     }
 
+    /// Stop recording started with [Audio::start] or [Audio::record_start].
     pub fn stop(&self) -> Result<()> {
-        self.recorder.borrow_mut().stop();
+        {
+            let mut recorder = self.recorder.lock().unwrap();
+            if recorder.started {
+                recorder.inner.stop();
+                recorder.started = false;
+            }
+        }
+        self.record_stop()
+    }
+
+    /// Start recording straight to a WAV file at `path`. Samples are appended from a
+    /// background thread while capturing so memory use stays constant, call [Audio::stop] to
+    /// finish the file. With `segment_length` a new file is started every `segment_length`,
+    /// named "<path stem>_0000.wav", "<path stem>_0001.wav", etc.
+    pub fn record_start(
+        &self,
+        sample_rate: u32,
+        path: impl AsRef<Path>,
+        segment_length: Option<Duration>,
+    ) -> Result<()> {
+        let mut recording = self.recording.lock().unwrap();
+        if recording.is_some() {
+            return Err(Error::CriticalError(
+                "Audio recording already started!".into(),
+            ));
+        }
+        if sample_rate == 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Audio sample rate must be greater than zero",
+            )
+            .into());
+        }
+        let segment_length =
+            segment_length.map(|length| (length.as_secs_f64() * sample_rate as f64) as u64);
+        // Create the first file here so path errors are reported right away
+        let mut writer = SegmentedWavWriter::new(path, sample_rate, segment_length)?;
+        // 100ms chunks
+        let chunk_length = (sample_rate as usize / 10).max(1);
+        let (tx, rx) = chunk_channel(RECORD_QUEUE_LENGTH, chunk_length, self.stats.clone());
+        let thread = std::thread::spawn(move || {
+            // End is only sent by the trigger recorder
+            while let Some(EventMessage::Samples(samples)) = rx.recv() {
+                writer.write_samples(&samples)?;
+                rx.recycle(samples);
+            }
+            writer.finish()
+        });
+        // Never block the capture thread on the disk
+        let callback = move |chunk: &AudioChunk| tx.send(chunk.samples);
+        if let Err(e) = self.stream_start(sample_rate, chunk_length, callback) {
+            let _ = thread.join();
+            return Err(e);
+        }
+        *recording = Some(AudioRecording { thread });
         Ok(())
     }
 
+    /// Record only the audio around events found by the analysis started with
+    /// [Audio::analysis_start], each to its own WAV file named "<path stem>_0000.wav",
+    /// "<path stem>_0001.wav", etc. Every file starts with up to `pre_trigger` of audio from
+    /// before the trigger and ends when its hang runs out. Nothing is written while it's quiet.
+    /// Call [Audio::stop] to stop, which also returns write errors.
+    pub fn trigger_record_start(
+        &self,
+        sample_rate: u32,
+        path: impl AsRef<Path>,
+        pre_trigger: Duration,
+    ) -> Result<()> {
+        let mut recording = self.recording.lock().unwrap();
+        if recording.is_some() {
+            return Err(Error::CriticalError(
+                "Audio recording already started!".into(),
+            ));
+        }
+        if sample_rate == 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Audio sample rate must be greater than zero",
+            )
+            .into());
+        }
+        let mut writer = EventWavWriter::new(path, sample_rate);
+        let chunk_length = (sample_rate as usize / TRIGGER_CHUNKS_PER_SECOND).max(1);
+        let pre_trigger_length = (pre_trigger.as_secs_f64() * sample_rate as f64) as usize;
+        // Room for the whole pre-trigger on top of the queue
+        let (tx, rx) = chunk_channel(
+            RECORD_QUEUE_LENGTH + pre_trigger_length.div_ceil(chunk_length),
+            chunk_length,
+            self.stats.clone(),
+        );
+        {
+            let mut analysis = self.analysis.lock().unwrap();
+            let Some(analysis) = analysis.as_mut() else {
+                return Err(Error::NotSupported(
+                    "Audio analysis isn't started".to_string(),
+                ));
+            };
+            analysis.recorder = Some(TriggerRecorder {
+                pre_trigger: VecDeque::with_capacity(pre_trigger_length),
+                pre_trigger_length,
+                chunk_length,
+                tx,
+            });
+        }
+        let thread = std::thread::spawn(move || {
+            while let Some(message) = rx.recv() {
+                match message {
+                    EventMessage::Samples(samples) => {
+                        writer.write_samples(&samples)?;
+                        rx.recycle(samples);
+                    }
+                    EventMessage::End => writer.end_event()?,
+                }
+            }
+            writer.finish()
+        });
+        if let Err(e) = self.stream_start(sample_rate, chunk_length, |_| {}) {
+            self.recorder_stop();
+            let _ = thread.join();
+            return Err(e);
+        }
+        *recording = Some(AudioRecording { thread });
+        Ok(())
+    }
+
+    /// Drop the sender of [Audio::trigger_record_start] so its writer finishes.
+    fn recorder_stop(&self) {
+        if let Some(analysis) = self.analysis.lock().unwrap().as_mut() {
+            analysis.recorder = None;
+        }
+    }
+
+    /// Stop a recording started with [Audio::record_start] or [Audio::trigger_record_start]
+    /// and finish the file. Chunks the writer fell behind on are counted in
+    /// [AudioStatsSnapshot::dropped_chunks].
+    fn record_stop(&self) -> Result<()> {
+        let Some(recording) = self.recording.lock().unwrap().take() else {
+            return Ok(());
+        };
+        // Stopping the stream drops the sender, the writer then finishes the file
+        self.stream_stop()?;
+        self.recorder_stop();
+        recording
+            .thread
+            .join()
+            .map_err(|_| Error::CriticalError("Audio writer thread panicked".into()))??;
+        Ok(())
+    }
+
+    /// Start capturing and call `callback` from the capture thread with every `chunk_length`
+    /// samples. Unlike [Audio::start] nothing is kept in memory, call [Audio::stream_stop] to
+    /// stop. The callback should return quickly or samples will be dropped by the capture device.
+    pub fn stream_start(
+        &self,
+        sample_rate: u32,
+        chunk_length: usize,
+        callback: impl FnMut(&AudioChunk) + Send + 'static,
+    ) -> Result<()> {
+        if chunk_length == 0 || sample_rate == 0 {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Audio sample rate and chunk length must be greater than zero",
+            )
+            .into());
+        }
+        let mut stream = self.stream.lock().unwrap();
+        if stream.is_some() {
+            return Err(Error::CriticalError("Audio stream already started!".into()));
+        }
+        let capture_name = self.capture_name.clone();
+        let shutdown = Arc::new(AtomicBool::new(false));
+        let (tx, rx) = mpsc::channel();
+        let mut recorder = StreamRecorder {
+            chunker: Chunker::new(chunk_length),
+            clock: CaptureClock::new(sample_rate),
+            sample_rate,
+            callback: Box::new(callback),
+            analysis: self.analysis.clone(),
+            stats: self.stats.clone(),
+        };
+        let thread = {
+            let shutdown = shutdown.clone();
+            // The driver borrows the recorder so both live on this thread, SFML calls
+            // on_process_samples() from its own capture thread.
+            std::thread::spawn(move || {
+                let mut driver = SoundRecorderDriver::new(&mut recorder);
+                if driver.set_device(&capture_name).is_err() {
+                    let _ = tx.send(Err(Error::CriticalError(format!(
+                        "Failed to set recorder device {capture_name}"
+                    ))));
+                    return;
+                }
+                // Ask for blocks about the size of a chunk, the default is 100ms
+                let interval_ms = chunk_length as u64 * 1000 / sample_rate as u64;
+                driver
+                    .set_processing_interval(Time::milliseconds(interval_ms.clamp(1, 100) as i32));
+                if !driver.start(sample_rate) {
+                    let _ = tx.send(Err(Error::CriticalError(
+                        "Failed to start recording!".into(),
+                    )));
+                    return;
+                }
+                let _ = tx.send(Ok(()));
+                while !shutdown.load(Ordering::Relaxed) {
+                    std::thread::park();
+                }
+                driver.stop();
+            })
+        };
+        match rx.recv() {
+            Ok(Ok(())) => {
+                *stream = Some(AudioStream { shutdown, thread });
+                Ok(())
+            }
+            Ok(Err(e)) => {
+                let _ = thread.join();
+                Err(e)
+            }
+            Err(_) => Err(Error::CriticalError("Audio capture thread panicked".into())),
+        }
+    }
+
+    /// Stop a capture started with [Audio::stream_start]. The callback isn't called anymore
+    /// once this returns.
+    pub fn stream_stop(&self) -> Result<()> {
+        let Some(stream) = self.stream.lock().unwrap().take() else {
+            return Ok(());
+        };
+        stream.shutdown.store(true, Ordering::Relaxed);
+        stream.thread.thread().unpark();
+        stream
+            .thread
+            .join()
+            .map_err(|_| Error::CriticalError("Audio capture thread panicked".into()))
+    }
+
+    /// Meter every streamed chunk on the capture thread and call `callback` with its
+    /// [AudioLevel], including the edges of the voice activity trigger. Runs whenever a stream
+    /// from [Audio::stream_start], [Audio::record_start] or [Audio::trigger_record_start] does.
+    /// Only changes the tuning and callback if already started.
+    pub fn analysis_start(
+        &self,
+        config: AnalysisConfig,
+        callback: impl FnMut(&AudioLevel) + Send + 'static,
+    ) -> Result<()> {
+        config.validate()?;
+        let mut analysis = self.analysis.lock().unwrap();
+        match analysis.as_mut() {
+            Some(analysis) => {
+                analysis.analyzer.set_config(config);
+                analysis.callback = Some(Box::new(callback));
+            }
+            None => {
+                *analysis = Some(AudioAnalysis {
+                    analyzer: Analyzer::new(config),
+                    callback: Some(Box::new(callback)),
+                    recorder: None,
+                })
+            }
+        }
+        Ok(())
+    }
+
+    /// Stop the analysis started with [Audio::analysis_start], a running
+    /// [Audio::trigger_record_start] finishes its event and stops writing. Returns false if the
+    /// analysis wasn't started.
+    pub fn analysis_stop(&self) -> bool {
+        self.analysis.lock().unwrap().take().is_some()
+    }
+
+    /// Capture counters, see [AudioStatsSnapshot].
+    pub fn stats(&self) -> AudioStatsSnapshot {
+        self.stats.snapshot()
+    }
+
+    pub fn stats_reset(&self) {
+        self.stats.reset();
+    }
+
+    pub fn stream_is_running(&self) -> bool {
+        self.stream.lock().unwrap().is_some()
+    }
+
     pub fn save_to_file(&self, fname: impl Into<String>) -> Result<()> {
         let fname: String = fname.into();
         if !self
             .recorder
-            .borrow_mut()
+            .lock()
+            .unwrap()
+            .inner
             .buffer()
             .save_to_file(fname.as_str())
         {
@@ -116,6 +791,174 @@ pub fn record_default_capture() {
     }
 }
 
+impl Drop for Audio {
+    fn drop(&mut self) {
+        let _ = self.record_stop();
+        let _ = self.stream_stop();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_chunker() {
+        let mut chunker = Chunker::new(4);
+        let mut chunks = Vec::new();
+        let mut collect = |samples: &[i16], sequence| chunks.push((samples.to_vec(), sequence));
+        chunker.push(&[1, 2, 3], &mut collect);
+        chunker.push(&[4, 5], &mut collect);
+        // Spans a buffered chunk, a full chunk and a partial chunk
+        chunker.push(&[6, 7, 8, 9, 10, 11, 12, 13], &mut collect);
+        chunker.push(&[], &mut collect);
+        assert_eq!(
+            chunks,
+            [
+                (vec![1, 2, 3, 4], 0),
+                (vec![5, 6, 7, 8], 1),
+                (vec![9, 10, 11, 12], 2)
+            ]
+        );
+        assert_eq!(chunker.buffer, [13]);
+    }
+
+    #[test]
+    fn test_trigger_recorder() {
+        use crate::analysis::{AUDIO_BANDS, MIN_DBFS};
+
+        let (tx, rx) = chunk_channel(8, 2, Arc::default());
+        let mut recorder = TriggerRecorder {
+            pre_trigger: VecDeque::new(),
+            pre_trigger_length: 3,
+            chunk_length: 2,
+            tx,
+        };
+        let level = |active, trigger| AudioLevel {
+            sequence: 0,
+            monotonic_time_ns: 0,
+            samples: 2,
+            rms_dbfs: MIN_DBFS,
+            peak_dbfs: MIN_DBFS,
+            bands_dbfs: [MIN_DBFS; AUDIO_BANDS],
+            noise_floor_dbfs: MIN_DBFS,
+            active,
+            trigger,
+        };
+        recorder.push(&[1, 2], &level(false, None));
+        recorder.push(&[3, 4], &level(false, None));
+        // Starts with the last 3 samples from before the trigger
+        recorder.push(&[5, 6], &level(true, Some(TriggerEdge::Start)));
+        recorder.push(&[7, 8], &level(true, None));
+        recorder.push(&[9, 10], &level(false, Some(TriggerEdge::Stop)));
+        recorder.push(&[11, 12], &level(true, Some(TriggerEdge::Start)));
+        drop(recorder);
+        assert_eq!(
+            std::iter::from_fn(|| rx.recv()).collect::<Vec<_>>(),
+            [
+                EventMessage::Samples(vec![2, 3]),
+                EventMessage::Samples(vec![4]),
+                EventMessage::Samples(vec![5, 6]),
+                EventMessage::Samples(vec![7, 8]),
+                EventMessage::End,
+                EventMessage::Samples(vec![9, 10]),
+                EventMessage::Samples(vec![11, 12]),
+            ]
+        );
+    }
+
+    #[test]
+    fn test_level_callback_unlocked() {
+        let analysis: Arc<Mutex<Option<AudioAnalysis>>> = Arc::default();
+        let levels = Arc::new(std::sync::atomic::AtomicU32::new(0));
+        let callback = {
+            let (analysis, levels) = (analysis.clone(), levels.clone());
+            move |_: &AudioLevel| {
+                // Stops the analysis from its own callback, like analysis_stop() would
+                if levels.fetch_add(1, Ordering::Relaxed) == 1 {
+                    analysis.lock().unwrap().take();
+                }
+            }
+        };
+        *analysis.lock().unwrap() = Some(AudioAnalysis {
+            analyzer: Analyzer::new(AnalysisConfig::default()),
+            callback: Some(Box::new(callback)),
+            recorder: None,
+        });
+        let mut recorder = StreamRecorder {
+            chunker: Chunker::new(2),
+            clock: CaptureClock::new(8000),
+            sample_rate: 8000,
+            callback: Box::new(|_| {}),
+            analysis: analysis.clone(),
+            stats: Arc::default(),
+        };
+        recorder.on_process_samples(&[1, 2, 3, 4, 5, 6]);
+        assert_eq!(levels.load(Ordering::Relaxed), 2);
+        assert!(analysis.lock().unwrap().is_none());
+    }
+
+    #[test]
+    fn test_chunk_channel() {
+        let samples = |message| match message {
+            Some(EventMessage::Samples(samples)) => samples,
+            message => panic!("Expected samples, got {message:?}"),
+        };
+        let stats = Arc::new(AudioStats::default());
+        let (tx, rx) = chunk_channel(2, 3, stats.clone());
+        tx.send(&[1, 2, 3]);
+        tx.send(&[4, 5, 6]);
+        // Both buffers are queued
+        tx.send(&[7, 8, 9]);
+        assert_eq!(stats.snapshot().dropped_chunks, 1);
+        let first = samples(rx.recv());
+        assert_eq!(first, [1, 2, 3]);
+        let pointer = first.as_ptr();
+        rx.recycle(first);
+        tx.send(&[10, 11, 12]);
+        let second = samples(rx.recv());
+        assert_eq!(second, [4, 5, 6]);
+        rx.recycle(second);
+        // The recycled buffer is reused
+        let reused = samples(rx.recv());
+        assert_eq!(reused, [10, 11, 12]);
+        assert_eq!(reused.as_ptr(), pointer);
+        rx.recycle(reused);
+
+        // An End takes the room of a buffer, the buffer that didn't fit goes back to the pool
+        tx.end();
+        tx.send(&[13, 14, 15]);
+        tx.send(&[16, 17, 18]);
+        assert_eq!(stats.snapshot().dropped_chunks, 2);
+        assert_eq!(rx.recv(), Some(EventMessage::End));
+        rx.recycle(samples(rx.recv()));
+        tx.send(&[19, 20, 21]);
+        tx.send(&[22, 23, 24]);
+        assert_eq!(stats.snapshot().dropped_chunks, 2);
+        drop(tx);
+        assert_eq!(rx.recv(), Some(EventMessage::Samples(vec![19, 20, 21])));
+        assert_eq!(rx.recv(), Some(EventMessage::Samples(vec![22, 23, 24])));
+        assert_eq!(rx.recv(), None);
+    }
+
+    #[test]
+    fn test_capture_clock() {
+        // 1000 Hz, blocks of 100 samples arrive 100ms apart with up to 30ms of latency
+        let mut clock = CaptureClock::new(1000);
+        clock.update(100, 1_130_000_000);
+        assert_eq!(clock.sample_time_ns(0), 1_030_000_000);
+        clock.update(100, 1_200_000_000);
+        assert_eq!(clock.sample_time_ns(0), 1_000_000_000);
+        // Late delivery only moves the estimate by 0.1% of the elapsed time
+        clock.update(100, 1_320_000_000);
+        assert_eq!(clock.sample_time_ns(0), 1_000_120_000);
+        assert_eq!(clock.sample_time_ns(250), 1_250_120_000);
+        // Earlier delivery is taken as is
+        clock.update(100, 1_400_100_000);
+        assert_eq!(clock.sample_time_ns(0), 1_000_100_000);
+    }
+}
+
 #[cfg(test)]
 #[cfg(not(feature = "_skip-hil-testing"))]
 mod test_hil {
@@ -139,6 +982,26 @@ mod test_hil {
         Ok(())
     }
 
+    #[test]
+    fn test_stream() -> Result<()> {
+        let devices = Audio::find_neovi_mic2_audio()?;
+        let device = devices
+            .first()
+            .expect("Expected at least 1 neoVI MIC2 audio device!");
+        let chunks = Arc::new(std::sync::atomic::AtomicU64::new(0));
+        {
+            let chunks = chunks.clone();
+            device.stream_start(44_100, 4410, move |chunk| {
+                assert_eq!(chunk.samples.len(), 4410);
+                assert_eq!(chunk.sequence, chunks.fetch_add(1, Ordering::Relaxed));
+            })?;
+        }
+        std::thread::sleep(std::time::Duration::from_secs(1));
+        device.stream_stop()?;
+        assert!(chunks.load(Ordering::Relaxed) >= 5);
+        Ok(())
+    }
+
     #[test]
     fn test_record_default_capture() {
         record_default_capture();
@@ -0,0 +1,388 @@
+//! Append-only binary log of [GPSFix] records written by the GPS reader thread, see
+//! [crate::gps::GPSDevice::fix_log_start].
+//!
+//! The file is a 32 byte header followed by fixed size little-endian records in the order
+//! they were received. monotonic_time_ns never decreases from one record to the next, so the
+//! records themselves are the time index: record i starts at header_length + i * record_length
+//! and a time range is found with a binary search, nothing has to be parsed.
+//!
+//! monotonic_time_ns only means something within the process that wrote the log, see
+//! [monotonic_time_ns]. The header stores the UTC time that clock started at, so
+//! epoch_utc_ns + monotonic_time_ns is the host wall clock time of a record in any later
+//! session. A log is written by one process at a time, [FixLogWriter::create] locks the file.
+//!
+//! Header, all fields little-endian:
+//! | Offset | Type    | Field                                           |
+//! |--------|---------|-------------------------------------------------|
+//! | 0      | [u8; 8] | magic "MIC2FIXL"                                |
+//! | 8      | u16     | version, [FIX_LOG_VERSION]                      |
+//! | 10     | u16     | header_length                                   |
+//! | 12     | u32     | record_length                                   |
+//! | 16     | u32     | byte_order, [FIX_LOG_BYTE_ORDER]                |
+//! | 20     | [u8; 4] | reserved, zero                                  |
+//! | 24     | i64     | epoch_utc_ns, UTC time of monotonic_time_ns 0   |
+//!
+//! A record has the layout of the libmic2 CGPSFix struct so it can be used in place:
+//! | Offset | Type | Field                                        |
+//! |--------|------|----------------------------------------------|
+//! | 0      | i64  | current_time_ns, zero means invalid          |
+//! | 8      | u64  | monotonic_time_ns                            |
+//! | 16     | f64  | latitude, negative is south                  |
+//! | 24     | f64  | longitude, negative is west                  |
+//! | 32     | f64  | altitude, -1 means invalid                   |
+//! | 40     | f64  | h_acc, -1 means invalid                      |
+//! | 48     | f64  | v_acc, -1 means invalid                      |
+//! | 56     | f64  | sog_kmh, -1 means invalid                    |
+//! | 64     | f64  | cog, -1 means invalid                        |
+//! | 72     | f64  | vvel, -1 means invalid                       |
+//! | 80     | f64  | hdop, -1 means invalid                       |
+//! | 88     | f64  | vdop, -1 means invalid                       |
+//! | 96     | f64  | tdop, -1 means invalid                       |
+//! | 104    | u32  | nav_stat, [GpsNavigationStatus] in order     |
+//! | 108    | u16  | satellites_count                             |
+//! | 110    | u16  | satellites_used                              |
+//! | 112    | u8   | position_valid, latitude/longitude are valid |
+//! | 113    | [u8] | padding, zero                                |
+use crate::{
+    nmea::types::{GPSFix, GpsNavigationStatus},
+    types::monotonic_time_ns,
+};
+use chrono::DateTime;
+use std::{
+    fs::{File, OpenOptions},
+    io::{self, BufWriter, Write},
+    path::Path,
+    time::SystemTime,
+};
+
+pub const FIX_LOG_MAGIC: [u8; 8] = *b"MIC2FIXL";
+/// Bumped whenever the header or record layout changes.
+pub const FIX_LOG_VERSION: u16 = 2;
+pub const FIX_LOG_HEADER_LENGTH: usize = 32;
+pub const FIX_LOG_RECORD_LENGTH: usize = 120;
+/// Stored little-endian, a reader that sees it in its native byte order can use the records
+/// in place.
+pub const FIX_LOG_BYTE_ORDER: u32 = 0x0102_0304;
+/// Records are buffered up to this size before they are written to the file.
+const WRITE_BUFFER_SIZE: usize = 64 * 1024;
+
+/// Decoded fix log header, see the module documentation.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct FixLogHeader {
+    /// Offset of the first record
+    pub header_length: usize,
+    /// Host UTC time in ns since the Unix epoch at monotonic_time_ns 0 of the writer
+    pub epoch_utc_ns: i64,
+}
+
+/// UTC time in ns since the Unix epoch at [monotonic_time_ns] 0 of this process.
+pub fn session_epoch_utc_ns() -> i64 {
+    let monotonic_ns = monotonic_time_ns() as i64;
+    let utc_ns = match SystemTime::now().duration_since(SystemTime::UNIX_EPOCH) {
+        Ok(elapsed) => elapsed.as_nanos() as i64,
+        Err(e) => -(e.duration().as_nanos() as i64),
+    };
+    utc_ns - monotonic_ns
+}
+
+/// Header of a fix log written by a session whose monotonic clock started at `epoch_utc_ns`.
+pub fn encode_header(epoch_utc_ns: i64) -> [u8; FIX_LOG_HEADER_LENGTH] {
+    let mut header = [0u8; FIX_LOG_HEADER_LENGTH];
+    header[0..8].copy_from_slice(&FIX_LOG_MAGIC);
+    header[8..10].copy_from_slice(&FIX_LOG_VERSION.to_le_bytes());
+    header[10..12].copy_from_slice(&(FIX_LOG_HEADER_LENGTH as u16).to_le_bytes());
+    header[12..16].copy_from_slice(&(FIX_LOG_RECORD_LENGTH as u32).to_le_bytes());
+    header[16..20].copy_from_slice(&FIX_LOG_BYTE_ORDER.to_le_bytes());
+    header[24..32].copy_from_slice(&epoch_utc_ns.to_le_bytes());
+    header
+}
+
+/// Validates the header at the start of `bytes`.
+pub fn decode_header(bytes: &[u8]) -> io::Result<FixLogHeader> {
+    let invalid = |message: &str| io::Error::new(io::ErrorKind::InvalidData, message.to_string());
+    if bytes.len() < FIX_LOG_HEADER_LENGTH || bytes[0..8] != FIX_LOG_MAGIC {
+        return Err(invalid("Not a fix log"));
+    }
+    let version = u16::from_le_bytes([bytes[8], bytes[9]]);
+    let header_length = u16::from_le_bytes([bytes[10], bytes[11]]) as usize;
+    let record_length = u32::from_le_bytes(bytes[12..16].try_into().unwrap()) as usize;
+    let byte_order = u32::from_le_bytes(bytes[16..20].try_into().unwrap());
+    if version != FIX_LOG_VERSION {
+        return Err(invalid(&format!("Unsupported fix log version {version}")));
+    }
+    if byte_order != FIX_LOG_BYTE_ORDER {
+        return Err(invalid("Fix log records aren't little-endian"));
+    }
+    if header_length < FIX_LOG_HEADER_LENGTH || record_length != FIX_LOG_RECORD_LENGTH {
+        return Err(invalid("Unexpected fix log header or record length"));
+    }
+    Ok(FixLogHeader {
+        header_length,
+        epoch_utc_ns: i64::from_le_bytes(bytes[24..32].try_into().unwrap()),
+    })
+}
+
+/// Take an exclusive lock on `file` without waiting, released when it's closed.
+#[cfg(unix)]
+fn lock_exclusive(file: &File) -> io::Result<()> {
+    use std::os::fd::AsRawFd;
+
+    if unsafe { libc::flock(file.as_raw_fd(), libc::LOCK_EX | libc::LOCK_NB) } != 0 {
+        let e = io::Error::last_os_error();
+        return Err(match e.kind() {
+            io::ErrorKind::WouldBlock => io::Error::new(
+                io::ErrorKind::WouldBlock,
+                "Fix log is already being written",
+            ),
+            _ => e,
+        });
+    }
+    Ok(())
+}
+
+fn nav_stat_to_u32(nav_stat: GpsNavigationStatus) -> u32 {
+    match nav_stat {
+        GpsNavigationStatus::NoFix => 0,
+        GpsNavigationStatus::DeadReckoningOnly => 1,
+        GpsNavigationStatus::StandAlone2D => 2,
+        GpsNavigationStatus::StandAlone3D => 3,
+        GpsNavigationStatus::Differential2D => 4,
+        GpsNavigationStatus::Differential3D => 5,
+        GpsNavigationStatus::CombinedRKGPSDeadReckoning => 6,
+        GpsNavigationStatus::TimeOnly => 7,
+    }
+}
+
+fn nav_stat_from_u32(value: u32) -> GpsNavigationStatus {
+    match value {
+        1 => GpsNavigationStatus::DeadReckoningOnly,
+        2 => GpsNavigationStatus::StandAlone2D,
+        3 => GpsNavigationStatus::StandAlone3D,
+        4 => GpsNavigationStatus::Differential2D,
+        5 => GpsNavigationStatus::Differential3D,
+        6 => GpsNavigationStatus::CombinedRKGPSDeadReckoning,
+        7 => GpsNavigationStatus::TimeOnly,
+        _ => GpsNavigationStatus::NoFix,
+    }
+}
+
+/// Serialize `fix` into a record, see the module documentation.
+pub fn encode_record(fix: &GPSFix) -> [u8; FIX_LOG_RECORD_LENGTH] {
+    let mut record = [0u8; FIX_LOG_RECORD_LENGTH];
+    let position = fix.latitude.zip(fix.longitude);
+    let (latitude, longitude) = position.unwrap_or((0.0, 0.0));
+    let current_time_ns = fix
+        .current_time
+        .and_then(|current_time| current_time.and_utc().timestamp_nanos_opt())
+        .unwrap_or(0);
+    record[0..8].copy_from_slice(&current_time_ns.to_le_bytes());
+    record[8..16].copy_from_slice(&fix.monotonic_time_ns.to_le_bytes());
+    let values = [
+        Some(latitude),
+        Some(longitude),
+        fix.altitude,
+        fix.h_acc,
+        fix.v_acc,
+        fix.sog_kmh,
+        fix.cog,
+        fix.vvel,
+        fix.hdop,
+        fix.vdop,
+        fix.tdop,
+    ];
+    for (dst, value) in record[16..104].chunks_exact_mut(8).zip(values) {
+        dst.copy_from_slice(&value.unwrap_or(-1.0).to_le_bytes());
+    }
+    let nav_stat = nav_stat_to_u32(fix.nav_stat.unwrap_or(GpsNavigationStatus::NoFix));
+    record[104..108].copy_from_slice(&nav_stat.to_le_bytes());
+    record[108..110].copy_from_slice(&fix.satellites_count.to_le_bytes());
+    record[110..112].copy_from_slice(&fix.satellites_used.to_le_bytes());
+    record[112] = position.is_some() as u8;
+    record
+}
+
+/// Deserialize a record written by [encode_record].
+pub fn decode_record(record: &[u8; FIX_LOG_RECORD_LENGTH]) -> GPSFix {
+    let f64_at = |offset: usize| {
+        let value = f64::from_le_bytes(record[offset..offset + 8].try_into().unwrap());
+        (value != -1.0).then_some(value)
+    };
+    let position_valid = record[112] != 0;
+    let coordinate = |offset: usize| {
+        position_valid.then(|| f64::from_le_bytes(record[offset..offset + 8].try_into().unwrap()))
+    };
+    let current_time_ns = i64::from_le_bytes(record[0..8].try_into().unwrap());
+    GPSFix {
+        current_time: (current_time_ns != 0)
+            .then(|| DateTime::from_timestamp_nanos(current_time_ns).naive_utc()),
+        latitude: coordinate(16),
+        longitude: coordinate(24),
+        altitude: f64_at(32),
+        nav_stat: Some(nav_stat_from_u32(u32::from_le_bytes(
+            record[104..108].try_into().unwrap(),
+        ))),
+        h_acc: f64_at(40),
+        v_acc: f64_at(48),
+        sog_kmh: f64_at(56),
+        cog: f64_at(64),
+        vvel: f64_at(72),
+        hdop: f64_at(80),
+        vdop: f64_at(88),
+        tdop: f64_at(96),
+        satellites_count: u16::from_le_bytes([record[108], record[109]]),
+        satellites_used: u16::from_le_bytes([record[110], record[111]]),
+        monotonic_time_ns: u64::from_le_bytes(record[8..16].try_into().unwrap()),
+    }
+}
+
+/// Appends [GPSFix] records to `W`. Records are flushed when the buffer fills and by
+/// [FixLogWriter::finish], a crash loses at most the buffered records.
+#[derive(Debug)]
+pub struct FixLogWriter<W: Write> {
+    inner: W,
+    /// monotonic_time_ns of the last record, records can't go back in time
+    last_monotonic_time_ns: u64,
+    records_written: u64,
+}
+
+impl FixLogWriter<BufWriter<File>> {
+    /// Create or truncate the log at `path`. The file stays locked until the writer is
+    /// dropped, fails with [io::ErrorKind::WouldBlock] if another writer has it open.
+    pub fn create(path: impl AsRef<Path>) -> io::Result<Self> {
+        let mut options = OpenOptions::new();
+        options.write(true).create(true).truncate(false);
+        // Readers may map the log while it's written, other writers can't open it
+        #[cfg(windows)]
+        std::os::windows::fs::OpenOptionsExt::share_mode(&mut options, 1);
+        let file = options.open(path)?;
+        // Only truncate once no one else is writing
+        #[cfg(unix)]
+        lock_exclusive(&file)?;
+        file.set_len(0)?;
+        Self::new(BufWriter::with_capacity(WRITE_BUFFER_SIZE, file))
+    }
+}
+
+impl<W: Write> FixLogWriter<W> {
+    /// Write the header for this session's monotonic clock and return a writer ready for
+    /// records.
+    pub fn new(mut inner: W) -> io::Result<Self> {
+        inner.write_all(&encode_header(session_epoch_utc_ns()))?;
+        Ok(Self {
+            inner,
+            last_monotonic_time_ns: 0,
+            records_written: 0,
+        })
+    }
+
+    /// Append a record. Fails with [io::ErrorKind::InvalidInput] if fix is older than the
+    /// last record, that would break the time ordering readers search on.
+    pub fn append(&mut self, fix: &GPSFix) -> io::Result<()> {
+        if fix.monotonic_time_ns < self.last_monotonic_time_ns {
+            return Err(io::Error::new(
+                io::ErrorKind::InvalidInput,
+                "Fix is older than the last record",
+            ));
+        }
+        self.inner.write_all(&encode_record(fix))?;
+        self.last_monotonic_time_ns = fix.monotonic_time_ns;
+        self.records_written += 1;
+        Ok(())
+    }
+
+    /// Number of records appended so far.
+    pub fn records_written(&self) -> u64 {
+        self.records_written
+    }
+
+    /// Flush the buffered records and return the inner writer.
+    pub fn finish(mut self) -> io::Result<W> {
+        self.inner.flush()?;
+        Ok(self.inner)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use chrono::NaiveDate;
+
+    #[test]
+    fn test_fix_log() {
+        let fix = GPSFix {
+            current_time: Some(
+                NaiveDate::from_ymd_opt(2024, 6, 15)
+                    .unwrap()
+                    .and_hms_milli_opt(12, 30, 45, 100)
+                    .unwrap(),
+            ),
+            latitude: Some(42.5),
+            longitude: Some(-83.25),
+            altitude: Some(190.5),
+            nav_stat: Some(GpsNavigationStatus::StandAlone3D),
+            hdop: Some(0.9),
+            satellites_count: 12,
+            satellites_used: 9,
+            monotonic_time_ns: 1_000,
+            ..Default::default()
+        };
+        let no_fix = GPSFix {
+            nav_stat: Some(GpsNavigationStatus::NoFix),
+            monotonic_time_ns: 2_000,
+            ..Default::default()
+        };
+        let mut writer = FixLogWriter::new(Vec::new()).unwrap();
+        writer.append(&fix).unwrap();
+        writer.append(&no_fix).unwrap();
+        assert_eq!(
+            writer.append(&fix).unwrap_err().kind(),
+            io::ErrorKind::InvalidInput
+        );
+        assert_eq!(writer.records_written(), 2);
+        let bytes = writer.finish().unwrap();
+        assert_eq!(
+            bytes.len(),
+            FIX_LOG_HEADER_LENGTH + 2 * FIX_LOG_RECORD_LENGTH
+        );
+
+        let header = decode_header(&bytes).unwrap();
+        let offset = header.header_length;
+        assert_eq!(offset, FIX_LOG_HEADER_LENGTH);
+        // The host clock at monotonic_time_ns 0 was some time after 2024
+        assert!(header.epoch_utc_ns > 1_700_000_000_000_000_000);
+        let records: Vec<GPSFix> = bytes[offset..]
+            .chunks_exact(FIX_LOG_RECORD_LENGTH)
+            .map(|record| decode_record(record.try_into().unwrap()))
+            .collect();
+        assert_eq!(records, [fix, no_fix]);
+        assert_eq!(&bytes[offset + 104..offset + 108], 3u32.to_le_bytes());
+
+        let mut bad_version = bytes.clone();
+        bad_version[8] = 1;
+        assert!(decode_header(&bad_version).is_err());
+        let mut big_endian = bytes.clone();
+        big_endian[16..20].copy_from_slice(&FIX_LOG_BYTE_ORDER.to_be_bytes());
+        assert!(decode_header(&big_endian).is_err());
+        assert!(decode_header(b"MIC2FIXL").is_err());
+    }
+
+    #[test]
+    fn test_fix_log_lock() {
+        let path = std::env::temp_dir().join(format!("mic2_fixlog_test_{}", std::process::id()));
+        let writer = FixLogWriter::create(&path).unwrap();
+        #[cfg(unix)]
+        assert_eq!(
+            FixLogWriter::create(&path).unwrap_err().kind(),
+            io::ErrorKind::WouldBlock
+        );
+        writer.finish().unwrap();
+        // Closing the first writer releases the lock
+        let writer = FixLogWriter::create(&path).unwrap();
+        drop(writer);
+        assert_eq!(
+            std::fs::metadata(&path).unwrap().len(),
+            FIX_LOG_HEADER_LENGTH as u64
+        );
+        std::fs::remove_file(&path).unwrap();
+    }
+}
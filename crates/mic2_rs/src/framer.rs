@@ -0,0 +1,366 @@
+//! Incremental byte level framer for the mixed NMEA / UBX stream coming from the GPS.
+//!
+//! Serial reads split sentences and packets at arbitrary points, [Framer] keeps its state
+//! between calls to [Framer::push] and only hands out complete frames with a valid checksum.
+//! Frames are assembled in fixed buffers so framing never allocates.
+use std::fmt;
+
+use crate::{nmea::sentence::NMEASentence, ubx};
+
+/// Longest NMEA sentence accepted, including the leading $ and the checksum.
+/// PUBX,03 with a full satellite table is far longer than the 82 characters of NMEA 0183.
+pub const NMEA_MAX_LENGTH: usize = 1024;
+/// Largest UBX payload accepted. NAV-SAT with 64 satellites is 776 bytes.
+pub const UBX_MAX_PAYLOAD_LENGTH: usize = 2048;
+
+/// UBX class, id and 2 byte length.
+const UBX_HEADER_LENGTH: usize = 4;
+const UBX_CHECKSUM_LENGTH: usize = 2;
+const UBX_SYNC_1: u8 = 0xB5;
+const UBX_SYNC_2: u8 = 0x62;
+
+/// A complete frame borrowed from the [Framer] buffers, only valid during the callback.
+#[derive(Debug, PartialEq)]
+pub enum Frame<'a> {
+    /// NMEA sentence from the $ up to and including the checksum, without CR/LF.
+    Nmea(&'a str),
+    /// UBX packet. Payload excludes the header and the checksum.
+    Ubx {
+        class: u8,
+        id: u8,
+        payload: &'a [u8],
+    },
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum FrameError {
+    /// NMEA sentence was terminated but the checksum was missing or wrong.
+    NmeaChecksum,
+    /// UBX packet checksum didn't match.
+    UbxChecksum,
+    /// Frame didn't fit in the fixed buffers and was discarded.
+    Overflow,
+}
+
+impl std::error::Error for FrameError {}
+
+impl fmt::Display for FrameError {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match &self {
+            Self::NmeaChecksum => write!(f, "Invalid NMEA checksum"),
+            Self::UbxChecksum => write!(f, "Invalid UBX checksum"),
+            Self::Overflow => write!(f, "Frame too large"),
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+enum State {
+    /// Looking for $ or the first UBX sync char.
+    Idle,
+    /// Inside a NMEA sentence, waiting for LF.
+    Nmea,
+    /// Got the first UBX sync char.
+    UbxSync,
+    /// Collecting the UBX class, id and length.
+    UbxHeader,
+    /// Collecting the UBX payload and checksum.
+    UbxBody,
+}
+
+pub struct Framer {
+    state: State,
+    nmea: [u8; NMEA_MAX_LENGTH],
+    nmea_length: usize,
+    ubx: [u8; UBX_HEADER_LENGTH + UBX_MAX_PAYLOAD_LENGTH + UBX_CHECKSUM_LENGTH],
+    ubx_length: usize,
+    /// Total length of the current UBX packet in ubx, known once the header is complete.
+    ubx_expected: usize,
+}
+
+impl Default for Framer {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl fmt::Debug for Framer {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("Framer")
+            .field("state", &self.state)
+            .field("nmea_length", &self.nmea_length)
+            .field("ubx_length", &self.ubx_length)
+            .finish()
+    }
+}
+
+impl Framer {
+    pub fn new() -> Self {
+        Self {
+            state: State::Idle,
+            nmea: [0; NMEA_MAX_LENGTH],
+            nmea_length: 0,
+            ubx: [0; UBX_HEADER_LENGTH + UBX_MAX_PAYLOAD_LENGTH + UBX_CHECKSUM_LENGTH],
+            ubx_length: 0,
+            ubx_expected: 0,
+        }
+    }
+
+    /// Drop any partially received frame.
+    pub fn reset(&mut self) {
+        self.state = State::Idle;
+        self.nmea_length = 0;
+        self.ubx_length = 0;
+        self.ubx_expected = 0;
+    }
+
+    /// Whether the bytes pushed so far ended inside a frame.
+    pub fn in_frame(&self) -> bool {
+        self.state != State::Idle
+    }
+
+    /// Feed bytes read from the GPS. `on_frame` is called for every frame completed by these
+    /// bytes, in order. Bytes outside of a frame are skipped.
+    pub fn push(&mut self, bytes: &[u8], mut on_frame: impl FnMut(Result<Frame<'_>, FrameError>)) {
+        let mut i = 0;
+        while i < bytes.len() {
+            match self.state {
+                State::Idle => {
+                    // Skip ahead to the next possible frame start
+                    match bytes[i..]
+                        .iter()
+                        .position(|b| *b == b'$' || *b == UBX_SYNC_1)
+                    {
+                        Some(offset) => {
+                            i += offset;
+                            self.start(bytes[i]);
+                            i += 1;
+                        }
+                        None => i = bytes.len(),
+                    }
+                }
+                State::Nmea => {
+                    // Copy everything up to the end of the sentence in one go
+                    let remaining = &bytes[i..];
+                    let end = remaining
+                        .iter()
+                        .position(|b| matches!(*b, b'\n' | b'$') || !b.is_ascii())
+                        .unwrap_or(remaining.len());
+                    if self.nmea_length + end > self.nmea.len() {
+                        self.reset();
+                        on_frame(Err(FrameError::Overflow));
+                        i += end;
+                        continue;
+                    }
+                    self.nmea[self.nmea_length..self.nmea_length + end]
+                        .copy_from_slice(&remaining[..end]);
+                    self.nmea_length += end;
+                    i += end;
+                    match remaining.get(end) {
+                        Some(b'\n') => {
+                            i += 1;
+                            self.state = State::Idle;
+                            let sentence = &self.nmea[..self.nmea_length];
+                            let sentence = sentence.strip_suffix(b"\r").unwrap_or(sentence);
+                            if NMEASentence::verify_checksum(sentence) {
+                                // verify_checksum only passes ASCII
+                                on_frame(Ok(Frame::Nmea(
+                                    std::str::from_utf8(sentence).unwrap_or_default(),
+                                )));
+                            } else {
+                                on_frame(Err(FrameError::NmeaChecksum));
+                            }
+                        }
+                        // Unterminated sentence followed by a new frame, drop it and restart
+                        Some(b) => {
+                            let b = *b;
+                            i += 1;
+                            on_frame(Err(FrameError::NmeaChecksum));
+                            self.reset();
+                            self.start(b);
+                        }
+                        None => {}
+                    }
+                }
+                State::UbxSync => {
+                    let b = bytes[i];
+                    i += 1;
+                    match b {
+                        UBX_SYNC_2 => {
+                            self.state = State::UbxHeader;
+                            self.ubx_length = 0;
+                        }
+                        _ => {
+                            self.state = State::Idle;
+                            self.start(b);
+                        }
+                    }
+                }
+                State::UbxHeader => {
+                    self.ubx[self.ubx_length] = bytes[i];
+                    self.ubx_length += 1;
+                    i += 1;
+                    if self.ubx_length == UBX_HEADER_LENGTH {
+                        let payload_length =
+                            u16::from_le_bytes([self.ubx[2], self.ubx[3]]) as usize;
+                        if payload_length > UBX_MAX_PAYLOAD_LENGTH {
+                            self.reset();
+                            on_frame(Err(FrameError::Overflow));
+                            continue;
+                        }
+                        self.ubx_expected =
+                            UBX_HEADER_LENGTH + payload_length + UBX_CHECKSUM_LENGTH;
+                        self.state = State::UbxBody;
+                    }
+                }
+                State::UbxBody => {
+                    let count = std::cmp::min(self.ubx_expected - self.ubx_length, bytes.len() - i);
+                    self.ubx[self.ubx_length..self.ubx_length + count]
+                        .copy_from_slice(&bytes[i..i + count]);
+                    self.ubx_length += count;
+                    i += count;
+                    if self.ubx_length == self.ubx_expected {
+                        self.state = State::Idle;
+                        let (packet, checksum) = self.ubx[..self.ubx_length]
+                            .split_at(self.ubx_length - UBX_CHECKSUM_LENGTH);
+                        if ubx::fletcher_checksum(packet) == (checksum[0], checksum[1]) {
+                            on_frame(Ok(Frame::Ubx {
+                                class: packet[0],
+                                id: packet[1],
+                                payload: &packet[UBX_HEADER_LENGTH..],
+                            }));
+                        } else {
+                            on_frame(Err(FrameError::UbxChecksum));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// Begin a new frame with its first byte. Anything other than a frame start is ignored.
+    fn start(&mut self, b: u8) {
+        match b {
+            b'$' => {
+                self.state = State::Nmea;
+                self.nmea[0] = b;
+                self.nmea_length = 1;
+            }
+            UBX_SYNC_1 => self.state = State::UbxSync,
+            _ => self.state = State::Idle,
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const PUBX03: &[u8] = b"$PUBX,03,00*1C\r\n";
+    // CFG-MSG from the ubx tests
+    const UBX_CFG_MSG: [u8; 16] = [
+        0xB5, 0x62, 0x06, 0x01, 0x08, 0x00, 0xF1, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x02,
+        0x31,
+    ];
+
+    fn collect(framer: &mut Framer, bytes: &[u8]) -> Vec<std::result::Result<String, FrameError>> {
+        let mut frames = Vec::new();
+        framer.push(bytes, |frame| {
+            frames.push(frame.map(|f| match f {
+                Frame::Nmea(s) => s.to_string(),
+                Frame::Ubx { class, id, payload } => {
+                    format!("UBX {class:02X} {id:02X} {}", payload.len())
+                }
+            }))
+        });
+        frames
+    }
+
+    #[test]
+    fn test_mixed_stream() {
+        let mut stream = Vec::new();
+        stream.extend_from_slice(b"garbage");
+        stream.extend_from_slice(PUBX03);
+        stream.extend_from_slice(&UBX_CFG_MSG);
+        stream.extend_from_slice(PUBX03);
+        let mut framer = Framer::new();
+        let frames = collect(&mut framer, &stream);
+        assert_eq!(
+            frames,
+            vec![
+                Ok("$PUBX,03,00*1C".to_string()),
+                Ok("UBX 06 01 8".to_string()),
+                Ok("$PUBX,03,00*1C".to_string()),
+            ]
+        );
+    }
+
+    #[test]
+    fn test_split_reads() {
+        let mut stream = Vec::new();
+        stream.extend_from_slice(PUBX03);
+        stream.extend_from_slice(&UBX_CFG_MSG);
+        // Every possible split point, including one byte at a time
+        for chunk_size in 1..stream.len() {
+            let mut framer = Framer::new();
+            let mut frames = Vec::new();
+            for chunk in stream.chunks(chunk_size) {
+                frames.extend(collect(&mut framer, chunk));
+            }
+            assert_eq!(
+                frames,
+                vec![
+                    Ok("$PUBX,03,00*1C".to_string()),
+                    Ok("UBX 06 01 8".to_string())
+                ],
+                "chunk size {chunk_size}"
+            );
+        }
+    }
+
+    #[test]
+    fn test_bad_checksums() {
+        let mut framer = Framer::new();
+        let frames = collect(&mut framer, b"$PUBX,03,01*1C\r\n");
+        assert_eq!(frames, vec![Err(FrameError::NmeaChecksum)]);
+
+        let mut packet = UBX_CFG_MSG;
+        packet[15] ^= 0xFF;
+        let frames = collect(&mut framer, &packet);
+        assert_eq!(frames, vec![Err(FrameError::UbxChecksum)]);
+
+        // Framer recovers after errors
+        let frames = collect(&mut framer, PUBX03);
+        assert_eq!(frames, vec![Ok("$PUBX,03,00*1C".to_string())]);
+    }
+
+    #[test]
+    fn test_truncated_sentence() {
+        let mut framer = Framer::new();
+        let frames = collect(&mut framer, b"$PUBX,03,0$PUBX,03,00*1C\r\n");
+        assert_eq!(
+            frames,
+            vec![
+                Err(FrameError::NmeaChecksum),
+                Ok("$PUBX,03,00*1C".to_string())
+            ]
+        );
+    }
+
+    #[test]
+    fn test_overflow() {
+        let mut framer = Framer::new();
+        let mut stream = vec![b'$'];
+        stream.resize(NMEA_MAX_LENGTH + 10, b'A');
+        stream.extend_from_slice(PUBX03);
+        let frames = collect(&mut framer, &stream);
+        assert_eq!(
+            frames,
+            vec![Err(FrameError::Overflow), Ok("$PUBX,03,00*1C".to_string())]
+        );
+
+        // UBX length larger than the buffer
+        let frames = collect(&mut framer, &[0xB5, 0x62, 0x01, 0x07, 0xFF, 0xFF]);
+        assert_eq!(frames, vec![Err(FrameError::Overflow)]);
+    }
+}
@@ -1,20 +1,31 @@
 use std::{
     borrow::BorrowMut,
+    fmt,
+    fs::File,
+    io::{BufWriter, Read, Write},
+    path::Path,
     sync::{
-        atomic::{AtomicBool, Ordering},
-        mpsc, Arc, RwLock,
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        mpsc, Arc, Condvar, Mutex, RwLock,
     },
-    time::Duration,
+    thread::JoinHandle,
+    time::{Duration, Instant},
 };
 
 use crate::{
+    fixlog::FixLogWriter,
+    framer::{Frame, FrameError, Framer},
+    metrics::{FixMetrics, MetricsConfig, MetricsEngine},
     nmea::{
         sentence::NMEASentence,
-        types::{GPSInfo, GpsNavigationStatus, NMEAError, NMEASentenceType},
+        types::{GPSFix, GPSInfo, GPSSatellites, GpsNavigationStatus, NMEASentenceType},
     },
-    types::{Error, Result},
+    reactor::{ReactorHandle, Registration},
+    stats::{self, GPSStats, GPSStatsSnapshot},
+    types::{monotonic_time_ns, Error, Result},
     ubx,
 };
+use enumflags2::{bitflags, BitFlags};
 use serialport::{self, ErrorKind, SerialPortType};
 
 impl From<serialport::Error> for Error {
@@ -26,41 +37,783 @@ impl From<serialport::Error> for Error {
     }
 }
 
-#[allow(clippy::upper_case_acronyms)]
+/// Callback invoked from the GPS reader thread, see [GPSDevice::subscribe].
+pub type GPSInfoCallback = Box<dyn FnMut(&GPSInfo) + Send>;
+
+/// Receives the raw bytes read from the serial port, see [GPSDevice::raw_tap_start].
+pub type RawTapCallback = Box<dyn FnMut(&[u8]) + Send>;
+
+/// Raw byte sink installed on the reader thread.
+struct RawTap {
+    callback: RawTapCallback,
+    /// Whether the bytes are still parsed into [GPSInfo] updates.
+    parse: bool,
+}
+
+impl fmt::Debug for RawTap {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("RawTap")
+            .field("parse", &self.parse)
+            .finish_non_exhaustive()
+    }
+}
+
+/// Fix log written by the reader thread, see [GPSDevice::fix_log_start].
+type FixLog = FixLogWriter<BufWriter<File>>;
+
+/// Fix log slot shared with the reader thread.
+#[derive(Debug, Default)]
+enum FixLogState {
+    #[default]
+    Stopped,
+    Running(FixLog),
+    /// A write failed and the reader thread stopped the log, reported by
+    /// [GPSDevice::fix_log_stop]
+    Failed(std::io::ErrorKind),
+}
+
+/// Registered [GPSInfoCallback]s, shared between the [GPSDevice] and its reader thread.
+#[derive(Default)]
+struct GPSSubscribers {
+    /// Id handed out to the next subscriber.
+    next_id: u32,
+    callbacks: Vec<(u32, GPSInfoCallback)>,
+}
+
+impl fmt::Debug for GPSSubscribers {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("GPSSubscribers")
+            .field("next_id", &self.next_id)
+            .field("count", &self.callbacks.len())
+            .finish()
+    }
+}
+
+impl GPSSubscribers {
+    fn notify(&mut self, gps_info: &GPSInfo) {
+        for (_id, callback) in &mut self.callbacks {
+            callback(gps_info);
+        }
+    }
+}
+
+#[derive(Debug, Default)]
+struct GPSSignalState {
+    /// Incremented every time a PUBX00 or UBX-NAV-PVT position update is received.
+    fixes: u64,
+    /// Whether the last update had a navigation solution.
+    has_lock: bool,
+    /// Whether the reader thread has the port open.
+    running: bool,
+    /// Why the port stopped reading, None while it runs or after [GPSDevice::close].
+    error: Option<std::io::ErrorKind>,
+}
+
+/// Lets threads block until the reader thread has new data instead of polling.
+#[derive(Debug, Default)]
+struct GPSSignal {
+    state: Mutex<GPSSignalState>,
+    condvar: Condvar,
+}
+
+impl GPSSignal {
+    fn update(&self, f: impl FnOnce(&mut GPSSignalState)) {
+        f(&mut self.state.lock().unwrap());
+        self.condvar.notify_all();
+    }
+
+    /// Mark the port closed and wake every waiter, `error` is why it closed if it failed.
+    fn stop(&self, error: Option<std::io::ErrorKind>) {
+        self.update(|s| {
+            s.running = false;
+            s.has_lock = false;
+            if error.is_some() {
+                s.error = error;
+            }
+        });
+    }
+}
+
+/// Error a waiter returns once the port is closed.
+fn closed_error(state: &GPSSignalState) -> Error {
+    match state.error {
+        Some(kind) => Error::IOError(kind),
+        None => not_open_error(),
+    }
+}
+
+/// Blocks on GPS events from the reader thread. Obtained from [GPSDevice::waiter], it stays
+/// usable without holding a reference to the [GPSDevice].
+#[derive(Debug, Clone)]
+pub struct GPSWaiter {
+    signal: Arc<GPSSignal>,
+}
+
+impl GPSWaiter {
+    /// Block until the GPS has a fix or `timeout` elapses. Returns Ok(true) if the GPS has a
+    /// fix, Ok(false) on timeout. Returns an error if the port isn't open or closes while
+    /// waiting, the read error if reading failed, see [GPSDevice::last_error].
+    pub fn wait_for_lock(&self, timeout: Duration) -> Result<bool> {
+        let state = self.signal.state.lock().unwrap();
+        if !state.running {
+            return Err(closed_error(&state));
+        }
+        let (state, _) = self
+            .signal
+            .condvar
+            .wait_timeout_while(state, timeout, |s| s.running && !s.has_lock)
+            .unwrap();
+        if !state.running {
+            return Err(closed_error(&state));
+        }
+        Ok(state.has_lock)
+    }
+
+    /// Block until the next position update (PUBX00 or UBX-NAV-PVT) is received or `timeout` elapses.
+    /// Returns Ok(true) if an update was received, Ok(false) on timeout. Returns an error if
+    /// the port isn't open or closes while waiting, like [GPSWaiter::wait_for_lock].
+    pub fn wait_for_fix(&self, timeout: Duration) -> Result<bool> {
+        let state = self.signal.state.lock().unwrap();
+        if !state.running {
+            return Err(closed_error(&state));
+        }
+        let fixes = state.fixes;
+        let (state, _) = self
+            .signal
+            .condvar
+            .wait_timeout_while(state, timeout, |s| s.running && s.fixes == fixes)
+            .unwrap();
+        if !state.running {
+            return Err(closed_error(&state));
+        }
+        Ok(state.fixes != fixes)
+    }
+}
+
+fn not_open_error() -> Error {
+    std::io::Error::new(std::io::ErrorKind::NotConnected, "Serial Port not open").into()
+}
+
+fn has_lock(gps_info: &GPSInfo) -> bool {
+    !matches!(gps_info.nav_stat, Some(GpsNavigationStatus::NoFix) | None)
+}
+
+/// Apply an update and stamp it with the host monotonic time it was received at.
+fn apply_update(gps_info: &mut GPSInfo, update: &dyn Fn(&mut GPSInfo), received_ns: u64) {
+    let current_time = gps_info.current_time;
+    update(gps_info);
+    gps_info.sequence += 1;
+    gps_info.monotonic_time_ns = received_ns;
+    // Keep the first arrival of each epoch, later messages of the same epoch are further from it.
+    if gps_info.current_time != current_time {
+        gps_info.time_monotonic_ns = received_ns;
+    }
+}
+
+/// Parse a frame and hand the GPS update it carries to publish along with whether it is a
+/// position update. UBX-ACKs are appended to acks. Shared by [GPSReader] and [GPSParser].
+/// Anything else the receiver sends, ie. its default NMEA output while it is being configured,
+/// is only counted in [GPSStats::unsupported] or [GPSStats::invalid_frames] and dropped.
+fn dispatch_frame<F>(
+    frame: std::result::Result<Frame<'_>, FrameError>,
+    stats: &GPSStats,
+    acks: &mut Vec<ubx::Ack>,
+    publish: &mut F,
+) where
+    F: FnMut(bool, &dyn Fn(&mut GPSInfo)),
+{
+    match frame {
+        Ok(Frame::Nmea(sentence)) => {
+            stats::add(&stats.nmea_sentences, 1);
+            // Only PUBX feeds GPSInfo, anything else is rejected from its prefix unparsed
+            match NMEASentence::parse_pubx(sentence) {
+                Ok(
+                    nmea @ (NMEASentenceType::PUBX00(_)
+                    | NMEASentenceType::PUBX03(_)
+                    | NMEASentenceType::PUBX04(_)),
+                ) => publish(matches!(nmea, NMEASentenceType::PUBX00(_)), &|gps_info| {
+                    gps_info.update_from_nmea_sentence(&nmea)
+                }),
+                Ok(_) | Err(_) => stats::add(&stats.unsupported, 1),
+            }
+        }
+        Ok(Frame::Ubx { class, id, payload }) if class == ubx::ClassField::ACK as u8 => {
+            stats::add(&stats.ubx_messages, 1);
+            match ubx::Ack::from_packet(class, id, payload) {
+                Ok(Some(received)) => acks.push(received),
+                Ok(None) | Err(_) => stats::add(&stats.unsupported, 1),
+            }
+        }
+        Ok(Frame::Ubx { class, id, payload }) => {
+            stats::add(&stats.ubx_messages, 1);
+            match ubx::NavMessage::from_packet(class, id, payload) {
+                Ok(Some(message)) => {
+                    publish(matches!(message, ubx::NavMessage::Pvt(_)), &|gps_info| {
+                        gps_info.update_from_ubx_message(&message)
+                    })
+                }
+                Ok(None) | Err(_) => stats::add(&stats.unsupported, 1),
+            }
+        }
+        Err(_) => stats::add(&stats.invalid_frames, 1),
+    }
+}
+
+/// State owned by the GPS reader thread. Turns raw serial bytes into [GPSInfo] updates.
 #[derive(Debug)]
-enum GPSPacket {
-    Ubx(ubx::PacketHeader),
-    NMEA(NMEASentenceType),
-    NMEAUnsupported(String, NMEAError),
-    Unsupported(Vec<u8>, String),
-    NMEAPartialStart(String),
-    NMEAPartial(String),
-    NMEAPartialEnd(String),
-}
-
-impl GPSPacket {
-    pub fn new(bytes: &[u8]) -> Vec<Self> {
-        let mut packets = Vec::new();
-        for packet in NMEASentence::from_bytes(bytes) {
-            packets.push(match packet {
-                Ok(ns) => match ns.data() {
-                    Ok(nst) => GPSPacket::NMEA(nst),
-                    Err(e) => GPSPacket::NMEAUnsupported(ns.inner, e),
-                },
-                Err(NMEAError::PartialStart(s)) => Self::NMEAPartialStart(s),
-                Err(NMEAError::Partial(s)) => Self::NMEAPartial(s),
-                Err(NMEAError::PartialEnd(s)) => Self::NMEAPartialEnd(s),
-                Err(NMEAError::InvalidMode(s)) => Self::Unsupported(bytes.to_vec(), s),
-                Err(NMEAError::InvalidData(_)) => match ubx::PacketHeader::from_bytes(bytes) {
-                    Ok(p) => Self::Ubx(p),
-                    Err(e) => Self::Unsupported(bytes.to_vec(), e.to_string()),
-                },
-            });
+struct GPSReader {
+    framer: Framer,
+    gps_info: Arc<RwLock<GPSInfo>>,
+    subscribers: Arc<Mutex<GPSSubscribers>>,
+    fix_log: Arc<Mutex<FixLogState>>,
+    metrics: Arc<Mutex<Option<MetricsEngine>>>,
+    raw_tap: Arc<Mutex<Option<RawTap>>>,
+    signal: Arc<GPSSignal>,
+    stats: Arc<GPSStats>,
+    /// Mirrors [GPSInfo::sequence] so pollers can check it without the lock.
+    sequence: Arc<AtomicU64>,
+    /// Host monotonic time of the last position update, for [GPSStats] fix intervals.
+    last_fix_ns: Option<u64>,
+    /// UBX-ACKs received, drained by [run_transaction].
+    acks: Vec<ubx::Ack>,
+}
+
+impl GPSReader {
+    /// Hand bytes read from the port to the raw tap, then parse them unless the tap turned
+    /// parsing off. `force_parse` keeps parsing on while the receiver is being configured.
+    fn receive(&mut self, bytes: &[u8], force_parse: bool) {
+        stats::add(&self.stats.reads, 1);
+        stats::add(&self.stats.bytes_read, bytes.len() as u64);
+        let parse = match self.raw_tap.lock().unwrap().as_mut() {
+            Some(tap) => {
+                (tap.callback)(bytes);
+                tap.parse
+            }
+            None => true,
+        };
+        if parse || force_parse {
+            self.process(bytes);
+        }
+    }
+
+    /// Read once from port and process what arrived. Returns Ok(false) once the port is gone,
+    /// ie. the device was disconnected.
+    fn read_from(&mut self, port: &mut dyn Read, buffer: &mut [u8]) -> std::io::Result<bool> {
+        match port.read(buffer) {
+            // This reader has reached its "end of file" and will likely no longer be able to produce bytes.
+            Ok(0) => Ok(false),
+            // Successfully read some bytes
+            Ok(size) => {
+                self.receive(&buffer[..size], false);
+                // Nothing is waiting for ACKs once configured
+                self.acks.clear();
+                Ok(true)
+            }
+            // Nothing to read, try again later
+            Err(e) if e.kind() == std::io::ErrorKind::TimedOut => {
+                stats::add(&self.stats.read_timeouts, 1);
+                Ok(true)
+            }
+            // An error of the ErrorKind::Interrupted kind is non-fatal and the read operation should be retried if there is nothing else to do.
+            Err(e) if e.kind() == std::io::ErrorKind::Interrupted => Ok(true),
+            Err(e) if e.kind() == std::io::ErrorKind::BrokenPipe => Ok(false),
+            Err(e) => Err(e),
+        }
+    }
+
+    /// Process bytes read from the port. Partial frames are kept until the next call.
+    fn process(&mut self, bytes: &[u8]) {
+        let Self {
+            framer,
+            gps_info,
+            subscribers,
+            fix_log,
+            metrics,
+            signal,
+            stats,
+            sequence,
+            last_fix_ns,
+            acks,
+            ..
+        } = self;
+        // Apply an update, wake up waiters and notify subscribers
+        // Timestamp on arrival so parsing doesn't add to it
+        let received_ns = monotonic_time_ns();
+        let mut frames = 0;
+        let mut publish = |is_fix: bool, update: &dyn Fn(&mut GPSInfo)| {
+            if is_fix {
+                stats::add(&stats.fixes, 1);
+                if let Some(last_fix_ns) = last_fix_ns.replace(received_ns) {
+                    stats
+                        .fix_interval
+                        .record_ns(received_ns.saturating_sub(last_fix_ns));
+                }
+            }
+            let fix = {
+                let lock_start_ns = monotonic_time_ns();
+                let mut gps_info = gps_info.write().unwrap();
+                stats::add(
+                    &stats.lock_wait_ns,
+                    monotonic_time_ns().saturating_sub(lock_start_ns),
+                );
+                apply_update(&mut gps_info, update, received_ns);
+                sequence.store(gps_info.sequence, Ordering::Release);
+                signal.update(|s| {
+                    if is_fix {
+                        s.fixes = s.fixes.wrapping_add(1);
+                    }
+                    s.has_lock = has_lock(&gps_info);
+                });
+                is_fix.then(|| gps_info.fix())
+            };
+            if let Some(fix) = fix {
+                let mut fix_log = fix_log.lock().unwrap();
+                if let FixLogState::Running(log) = &mut *fix_log {
+                    if let Err(e) = log.append(&fix) {
+                        stats::add(&stats.fix_log_errors, 1);
+                        *fix_log = FixLogState::Failed(e.kind());
+                    }
+                }
+                if let Some(engine) = metrics.lock().unwrap().as_mut() {
+                    engine.update(&fix);
+                }
+            }
+            let mut subscribers = subscribers.lock().unwrap();
+            if !subscribers.callbacks.is_empty() {
+                subscribers.notify(&gps_info.read().unwrap());
+            }
+        };
+        framer.push(bytes, |frame| {
+            frames += 1;
+            dispatch_frame(frame, stats, acks, &mut publish);
+        });
+        if framer.in_frame() {
+            stats::add(&stats.partial_reads, 1);
+        }
+        if frames > 0 {
+            stats
+                .parse_latency
+                .record_ns(monotonic_time_ns().saturating_sub(received_ns));
         }
-        packets
     }
 }
 
+/// Turns raw u-blox bytes into [GPSInfo] updates without a serial port, ie. to replay
+/// captures made with [GPSDevice::raw_tap_to_file]. Frames and parses exactly like the
+/// reader thread, updates are stamped with the host monotonic time they were pushed at.
+#[derive(Debug, Default)]
+pub struct GPSParser {
+    framer: Framer,
+    gps_info: GPSInfo,
+    stats: GPSStats,
+    /// UBX-ACKs of the last push, only kept so the frames are dispatched like the reader's.
+    acks: Vec<ubx::Ack>,
+}
+
+impl GPSParser {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Parse bytes, partial frames are kept until the next call. Returns the number of
+    /// updates applied to [GPSParser::gps_info].
+    pub fn push(&mut self, bytes: &[u8]) -> usize {
+        let Self {
+            framer,
+            gps_info,
+            stats,
+            acks,
+        } = self;
+        acks.clear();
+        stats::add(&stats.reads, 1);
+        stats::add(&stats.bytes_read, bytes.len() as u64);
+        let received_ns = monotonic_time_ns();
+        let mut updates = 0;
+        let mut publish = |is_fix: bool, update: &dyn Fn(&mut GPSInfo)| {
+            if is_fix {
+                stats::add(&stats.fixes, 1);
+            }
+            apply_update(gps_info, update, received_ns);
+            updates += 1;
+        };
+        framer.push(bytes, |frame| {
+            dispatch_frame(frame, stats, acks, &mut publish);
+        });
+        if framer.in_frame() {
+            stats::add(&stats.partial_reads, 1);
+        }
+        updates
+    }
+
+    /// Latest state of everything pushed so far.
+    pub fn gps_info(&self) -> &GPSInfo {
+        &self.gps_info
+    }
+
+    /// Counters of everything pushed so far. Read latency and fix intervals are left empty,
+    /// they depend on the receiver rather than the parser.
+    pub fn stats(&self) -> GPSStatsSnapshot {
+        self.stats.snapshot()
+    }
+}
+
+/// Output protocol configured on the receiver when opening, see [GPSDevice::open_with_protocol].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub enum GpsProtocol {
+    /// Text PUBX,00/03/04 sentences at 1 Hz.
+    #[default]
+    Nmea,
+    /// Binary UBX-NAV-PVT/DOP/CLOCK at 10 Hz and UBX-NAV-SAT at 1 Hz.
+    Ubx,
+}
+
+/// Receiver output messages, combined into a [BitFlags] set in [GpsConfig::messages].
+#[bitflags]
+#[derive(Clone, Copy, PartialEq, Debug)]
+#[repr(u8)]
+pub enum GpsMessage {
+    /// PUBX,00 Lat/Long position data
+    PubxPosition = 0x01,
+    /// PUBX,03 Satellite status
+    PubxSvStatus = 0x02,
+    /// PUBX,04 Time of day and clock information
+    PubxTime = 0x04,
+    /// UBX-NAV-PVT Navigation position velocity time solution
+    NavPvt = 0x08,
+    /// UBX-NAV-DOP Dilution of precision
+    NavDop = 0x10,
+    /// UBX-NAV-CLOCK Clock solution
+    NavClock = 0x20,
+    /// UBX-NAV-SAT Satellite information, output once a second
+    NavSat = 0x40,
+}
+
+impl GpsMessage {
+    /// Returns an error if `value` contains unknown messages.
+    pub fn from_bits(value: u32) -> Result<BitFlags<Self>> {
+        u8::try_from(value)
+            .ok()
+            .and_then(|bits| BitFlags::<Self>::from_bits(bits).ok())
+            .ok_or_else(|| {
+                std::io::Error::new(
+                    std::io::ErrorKind::InvalidInput,
+                    format!("Unknown GPS messages: {value:#x}"),
+                )
+                .into()
+            })
+    }
+
+    /// All PUBX messages used by [GpsProtocol::Nmea]
+    pub fn pubx() -> BitFlags<Self> {
+        Self::PubxPosition | Self::PubxSvStatus | Self::PubxTime
+    }
+
+    /// All UBX-NAV messages used by [GpsProtocol::Ubx]
+    pub fn nav() -> BitFlags<Self> {
+        Self::NavPvt | Self::NavDop | Self::NavClock | Self::NavSat
+    }
+}
+
+/// UBX-CFG-MSG (class, id) of every [GpsMessage].
+const GPS_MESSAGE_IDS: [(GpsMessage, u8, u8); 7] = [
+    // 19 NMEA Messages Overview, PUBX class
+    (GpsMessage::PubxPosition, 0xF1, 0x00),
+    (GpsMessage::PubxSvStatus, 0xF1, 0x03),
+    (GpsMessage::PubxTime, 0xF1, 0x04),
+    (GpsMessage::NavPvt, ubx::ClassField::NAV as u8, ubx::NAV_PVT),
+    (GpsMessage::NavDop, ubx::ClassField::NAV as u8, ubx::NAV_DOP),
+    (
+        GpsMessage::NavClock,
+        ubx::ClassField::NAV as u8,
+        ubx::NAV_CLOCK,
+    ),
+    (GpsMessage::NavSat, ubx::ClassField::NAV as u8, ubx::NAV_SAT),
+];
+
+/// Receiver setup applied by [GPSDevice::open_with_config].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct GpsConfig {
+    /// Time between GNSS measurements in milliseconds (UBX-CFG-RATE measRate), minimum 25.
+    pub measurement_rate_ms: u16,
+    /// Number of measurements per navigation solution (UBX-CFG-RATE navRate), 1 to 127.
+    pub navigation_rate: u16,
+    /// Baud rate of the host serial port.
+    pub baud_rate: u32,
+    /// Messages output by the receiver, every other message is disabled.
+    pub messages: BitFlags<GpsMessage>,
+}
+
+impl Default for GpsConfig {
+    fn default() -> Self {
+        GpsProtocol::default().into()
+    }
+}
+
+impl From<GpsProtocol> for GpsConfig {
+    fn from(protocol: GpsProtocol) -> Self {
+        match protocol {
+            GpsProtocol::Nmea => Self {
+                measurement_rate_ms: 1000,
+                navigation_rate: 1,
+                baud_rate: UBLOX_DEFAULT_BAUD,
+                messages: GpsMessage::pubx(),
+            },
+            GpsProtocol::Ubx => Self {
+                measurement_rate_ms: 100,
+                navigation_rate: 1,
+                baud_rate: UBLOX_DEFAULT_BAUD,
+                messages: GpsMessage::nav(),
+            },
+        }
+    }
+}
+
+impl GpsConfig {
+    /// Returns an error if the receiver or serial port can't be configured with these values.
+    pub fn validate(&self) -> Result<()> {
+        let invalid = |msg: &str| -> Result<()> {
+            Err(std::io::Error::new(std::io::ErrorKind::InvalidInput, msg.to_string()).into())
+        };
+        if self.measurement_rate_ms < 25 {
+            return invalid("GPS measurement rate must be at least 25 ms");
+        }
+        if !(1..=127).contains(&self.navigation_rate) {
+            return invalid("GPS navigation rate must be between 1 and 127");
+        }
+        if self.baud_rate == 0 {
+            return invalid("GPS baud rate can't be zero");
+        }
+        if self.messages.is_empty() {
+            return invalid("No GPS messages enabled");
+        }
+        Ok(())
+    }
+
+    /// UBX-CFG-MSG rate for `message`, in navigation solutions.
+    fn message_rate(&self, message: GpsMessage) -> u8 {
+        if !self.messages.contains(message) {
+            0
+        } else if message == GpsMessage::NavSat {
+            // Satellite info doesn't change quickly, limit it to about once a second
+            let solution_ms = self.measurement_rate_ms as u32 * self.navigation_rate as u32;
+            (1000 / solution_ms).clamp(1, u8::MAX as u32) as u8
+        } else {
+            1
+        }
+    }
+}
+
+/// How long to wait for the receiver to acknowledge a CFG message.
+const UBX_ACK_TIMEOUT: Duration = Duration::from_millis(500);
+/// Times a CFG message is sent before giving up, the receiver ignores
+/// messages while it restarts after CFG-RST.
+const UBX_ACK_ATTEMPTS: u32 = 3;
+/// 32.10.25.5 UBX-CFG-PRT portID of the USB port
+const UBX_USB_PORT_ID: u8 = 3;
+
+/// Send every pending message of `transaction` in one write and resolve the ACKs as they
+/// arrive, everything else received in the meantime goes through `reader` as usual. Messages
+/// still unanswered after `timeout` are sent again. Fails if some are never answered, NAKs
+/// are left in [ubx::Transaction::states] for the caller.
+fn run_transaction<P: Read + Write + ?Sized>(
+    port: &mut P,
+    reader: &mut GPSReader,
+    transaction: &mut ubx::Transaction,
+    timeout: Duration,
+) -> Result<()> {
+    let mut buffer = [0u8; 256];
+    for _ in 0..UBX_ACK_ATTEMPTS {
+        let data = transaction.begin();
+        if data.is_empty() {
+            return Ok(());
+        }
+        reader.acks.clear();
+        port.write_all(&data)?;
+        let deadline = Instant::now() + timeout;
+        while !transaction.is_complete() && Instant::now() < deadline {
+            match port.read(&mut buffer) {
+                Ok(0) => return Err(std::io::Error::from(std::io::ErrorKind::BrokenPipe).into()),
+                Ok(size) => reader.receive(&buffer[..size], true),
+                Err(e)
+                    if matches!(
+                        e.kind(),
+                        std::io::ErrorKind::TimedOut | std::io::ErrorKind::Interrupted
+                    ) => {}
+                Err(e) => return Err(e.into()),
+            }
+            for ack in reader.acks.drain(..) {
+                transaction.resolve(&ack);
+            }
+        }
+    }
+    match transaction.is_complete() {
+        true => Ok(()),
+        false => Err(std::io::Error::from(std::io::ErrorKind::TimedOut).into()),
+    }
+}
+
+/// Send a single CFG message and wait for the receiver to acknowledge it. Returns Ok(false)
+/// if the receiver replied with ACK-NAK.
+fn send_cfg<P: Read + Write + ?Sized>(
+    port: &mut P,
+    reader: &mut GPSReader,
+    id: u8,
+    payload: Vec<u8>,
+    timeout: Duration,
+) -> Result<bool> {
+    let mut transaction = ubx::Transaction::new();
+    transaction.push(&ubx::PacketHeader::new(
+        ubx::ClassField::CFG,
+        id,
+        payload,
+        true,
+    ));
+    run_transaction(port, reader, &mut transaction, timeout)?;
+    Ok(transaction.states()[0] == ubx::AckState::Accepted)
+}
+
+/// Apply `config` to the receiver, every CFG message has to be acknowledged within `timeout`.
+fn configure_receiver<P: Read + Write + ?Sized>(
+    port: &mut P,
+    reader: &mut GPSReader,
+    config: &GpsConfig,
+    timeout: Duration,
+) -> Result<()> {
+    let rejected = |name: &str| Error::NotSupported(format!("GPS receiver rejected {name}"));
+    // 32.10.29.1 Reset receiver / Clear backup data structures
+    // Payload: Hot Start (0x00), Controlled software reset (0x01), reserved1 (0x00)
+    // The receiver doesn't acknowledge CFG-RST
+    port.write_all(
+        &ubx::PacketHeader::new(ubx::ClassField::CFG, ubx::CFG_RST, vec![0x0, 0x01, 0], true)
+            .data(true),
+    )?;
+    // 32.10.25.5 Port configuration for USB port
+    // Payload: portID, reserved1, txReady, reserved2, reserved3, inProtoMask, outProtoMask,
+    // reserved4, reserved5. UBX output stays on for the ACK messages.
+    let mut out_proto_mask: u16 = 0x01;
+    if config.messages.intersects(GpsMessage::pubx()) {
+        out_proto_mask |= 0x02;
+    }
+    let mut payload = vec![UBX_USB_PORT_ID, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0];
+    // UBX and NMEA input
+    payload.extend_from_slice(&0x03u16.to_le_bytes());
+    payload.extend_from_slice(&out_proto_mask.to_le_bytes());
+    payload.extend_from_slice(&[0, 0, 0, 0]);
+    // Sent on its own, it is retried until the receiver is back from the reset
+    if !send_cfg(port, reader, ubx::CFG_PRT, payload, timeout)? {
+        return Err(rejected("CFG-PRT"));
+    }
+
+    // Everything else goes out in a single write
+    let cfg =
+        |id: u8, payload: Vec<u8>| ubx::PacketHeader::new(ubx::ClassField::CFG, id, payload, true);
+    let mut transaction = ubx::Transaction::new();
+    // Disable all NEMA messages, not every receiver supports all of them so NAKs are ignored
+    // 31.1.9 Messages overview
+    for i in [
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0D, 0x0E, 0x0F, 0x40,
+        0x41, 0x42, 0x43, 0x44,
+    ] {
+        transaction.push(&cfg(ubx::CFG_MSG, vec![0xF0, i, 0]));
+    }
+    let required_start = transaction.len();
+    // 32.10.27 Navigation/measurement rate settings
+    // Payload: measRate (ms), navRate (cycles), timeRef (1 = GPS time)
+    let mut payload = config.measurement_rate_ms.to_le_bytes().to_vec();
+    payload.extend_from_slice(&config.navigation_rate.to_le_bytes());
+    payload.extend_from_slice(&1u16.to_le_bytes());
+    transaction.push(&cfg(ubx::CFG_RATE, payload));
+    // 32.10.13 Set message rate, rates are per navigation solution
+    for (message, class, id) in GPS_MESSAGE_IDS {
+        transaction.push(&cfg(
+            ubx::CFG_MSG,
+            vec![class, id, config.message_rate(message)],
+        ));
+    }
+    run_transaction(port, reader, &mut transaction, timeout)?;
+    let states = &transaction.states()[required_start..];
+    if states[0] != ubx::AckState::Accepted {
+        return Err(rejected("CFG-RATE"));
+    }
+    for ((_, class, id), state) in GPS_MESSAGE_IDS.iter().zip(&states[1..]) {
+        if *state != ubx::AckState::Accepted {
+            return Err(rejected(&format!("CFG-MSG {class:02X} {id:02X}")));
+        }
+    }
+    Ok(())
+}
+
+/// Marks the port of a reader thread closed when the thread ends, see
+/// [GPSDevice::open_with_transaction].
+struct ReaderTeardown {
+    is_open: Arc<AtomicBool>,
+    signal: Arc<GPSSignal>,
+    thread_running: Arc<AtomicBool>,
+    /// Read error that ended the thread
+    error: Option<std::io::ErrorKind>,
+}
+
+impl Drop for ReaderTeardown {
+    fn drop(&mut self) {
+        self.is_open.store(false, Ordering::Relaxed);
+        self.signal.stop(self.error);
+        self.thread_running.store(false, Ordering::SeqCst);
+    }
+}
+
+/// GPS port serviced by a [crate::reactor::Reactor] instead of a reader thread. Dropped by the
+/// reactor once the port is gone or [GPSDevice::close] removes it.
+#[cfg(unix)]
+struct ReactorPort {
+    port: serialport::TTYPort,
+    reader: GPSReader,
+    buffer: Vec<u8>,
+    is_open: Arc<AtomicBool>,
+    /// Read error that stopped the port, see [GPSDevice::last_error]
+    error: Option<std::io::ErrorKind>,
+}
+
+#[cfg(unix)]
+impl ReactorPort {
+    /// Called from the reactor thread when the port is readable, returns false once it is gone.
+    fn ready(&mut self) -> bool {
+        match self.reader.read_from(&mut self.port, &mut self.buffer) {
+            Ok(open) => open,
+            // Other devices share the reactor thread, only this port stops
+            Err(e) => {
+                self.error = Some(e.kind());
+                false
+            }
+        }
+    }
+}
+
+#[cfg(unix)]
+impl Drop for ReactorPort {
+    fn drop(&mut self) {
+        self.is_open.store(false, Ordering::Relaxed);
+        self.reader.signal.stop(self.error);
+    }
+}
+
+/// USB port path of the device behind a tty, from the sysfs interface directory
+/// "/sys/class/tty/ttyACM0/device" links to, ie. ".../usb1/1-2/1-2.3/1-2.3:1.0".
+#[cfg(target_os = "linux")]
+fn usb_port_path(port_name: &str) -> Option<String> {
+    let tty = Path::new(port_name).file_name()?;
+    let interface =
+        std::fs::canonicalize(Path::new("/sys/class/tty").join(tty).join("device")).ok()?;
+    let name = interface.file_name()?.to_str()?;
+    // <port path>:<configuration>.<interface>
+    let (path, _) = name.split_once(':')?;
+    Some(path.to_string())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn usb_port_path(_port_name: &str) -> Option<String> {
+    None
+}
+
 #[derive(Debug, Default, Clone)]
 pub struct GPSDevice {
     /// Port name string similar to "/dev/ttyACM0"
@@ -69,7 +822,10 @@ pub struct GPSDevice {
     pub vid: u16,
     /// USB product ID of the GPS
     pub pid: u16,
-    /// baudrate of the port, typically UBLOX_DEFAULT_BAUD
+    /// USB port path of the receiver, "<bus>-<port>.<port>..." like "1-2.3". None if the
+    /// platform doesn't tell, only Linux does.
+    pub usb_port_path: Option<String>,
+    /// baudrate of the port used by [GPSDevice::open_with_protocol], typically UBLOX_DEFAULT_BAUD
     baud_rate: u32,
     /// If set to true, it tells the thread to shutdown.
     shutdown_thread: Arc<AtomicBool>,
@@ -78,6 +834,26 @@ pub struct GPSDevice {
     /// Whether the port is open or not
     is_open: Arc<AtomicBool>,
     gps_info: Arc<RwLock<GPSInfo>>,
+    /// Callbacks fired by the reader thread after every PUBX00/03/04 or UBX-NAV update.
+    subscribers: Arc<Mutex<GPSSubscribers>>,
+    /// Appended to by the reader thread on every position update.
+    fix_log: Arc<Mutex<FixLogState>>,
+    /// Updated by the reader thread on every position update, see [GPSDevice::metrics_start].
+    metrics: Arc<Mutex<Option<MetricsEngine>>>,
+    /// Gets every byte read from the port before it is parsed.
+    raw_tap: Arc<Mutex<Option<RawTap>>>,
+    /// Filled by the reader thread, see [GPSDevice::stats].
+    stats: Arc<GPSStats>,
+    /// [GPSInfo::sequence] of the latest update, see [GPSDevice::sequence].
+    sequence: Arc<AtomicU64>,
+    /// Signaled by the reader thread on every update and when it exits.
+    signal: Arc<GPSSignal>,
+    /// Reader thread, joined by [GPSDevice::close].
+    thread: Arc<Mutex<Option<JoinHandle<()>>>>,
+    /// Services the port instead of a reader thread if set, see [GPSDevice::set_reactor].
+    reactor: Arc<Mutex<Option<ReactorHandle>>>,
+    /// Port attached to the reactor, removed by [GPSDevice::close].
+    registration: Arc<Mutex<Option<Registration>>>,
 }
 
 impl Drop for GPSDevice {
@@ -111,6 +887,7 @@ impl GPSDevice {
                 SerialPortType::UsbPort(upi) => {
                     if upi.vid == UBLOX_VID && UBLOX_PIDS.contains(&upi.pid) {
                         Some(Self {
+                            usb_port_path: usb_port_path(&p.port_name),
                             port_name: p.port_name,
                             vid: upi.vid,
                             pid: upi.pid,
@@ -126,6 +903,16 @@ impl GPSDevice {
                             gps_info: std::sync::Arc::new(std::sync::RwLock::new(
                                 GPSInfo::default(),
                             )),
+                            subscribers: Arc::new(Mutex::new(GPSSubscribers::default())),
+                            fix_log: Arc::new(Mutex::new(FixLogState::Stopped)),
+                            metrics: Arc::new(Mutex::new(None)),
+                            raw_tap: Arc::new(Mutex::new(None)),
+                            stats: Arc::new(GPSStats::default()),
+                            sequence: Arc::new(AtomicU64::new(0)),
+                            signal: Arc::new(GPSSignal::default()),
+                            thread: Arc::new(Mutex::new(None)),
+                            reactor: Arc::new(Mutex::new(None)),
+                            registration: Arc::new(Mutex::new(None)),
                         })
                     } else {
                         None
@@ -149,162 +936,159 @@ impl GPSDevice {
         }
     }
 
+    /// Open the port with the [GpsProtocol::Nmea] output protocol.
     pub fn open(&self) -> Result<bool> {
+        self.open_with_protocol(GpsProtocol::Nmea)
+    }
+
+    /// Open the port and configure the receiver to output `protocol`.
+    pub fn open_with_protocol(&self, protocol: GpsProtocol) -> Result<bool> {
+        self.open_with_config(&GpsConfig {
+            baud_rate: self.baud_rate,
+            ..protocol.into()
+        })
+    }
+
+    /// Open the port and apply `config` to the receiver. Fails if the receiver doesn't
+    /// acknowledge the configuration.
+    pub fn open_with_config(&self, config: &GpsConfig) -> Result<bool> {
+        self.open_with_transaction(config, &mut ubx::Transaction::new())
+    }
+
+    /// Like [GPSDevice::open_with_config], then send `transaction` to the receiver in one
+    /// write, ie. for settings [GpsConfig] doesn't cover. Fails if any of its messages isn't
+    /// answered, [ubx::Transaction::states] tells which ones the receiver rejected. Nothing is
+    /// sent if the port is already open.
+    pub fn open_with_transaction(
+        &self,
+        config: &GpsConfig,
+        transaction: &mut ubx::Transaction,
+    ) -> Result<bool> {
+        config.validate()?;
         // Nothing to do if already open
         if self.thread_running.load(Ordering::Relaxed) {
             return Ok(true);
         }
+        let reactor = self.reactor.lock().unwrap().clone();
+        if let Some(reactor) = reactor {
+            return self.open_on_reactor(config, transaction, &reactor);
+        }
         // Prepare the thread variables
         let port_name = self.port_name.clone();
-        let baud_rate = self.baud_rate;
+        let config = *config;
         let shutdown_thread = self.shutdown_thread.clone();
         shutdown_thread.store(false, Ordering::SeqCst);
         let thread_running = self.thread_running.clone();
         thread_running.store(false, Ordering::SeqCst);
         let is_open = self.is_open.clone();
         is_open.store(false, Ordering::SeqCst);
-        let gps_info = self.gps_info.clone();
+        let reader = self.reader();
+        let signal = self.signal.clone();
+        let mut thread_transaction = std::mem::take(transaction);
+        // Reap the previous thread if it exited on its own (ie. device disconnected)
+        if let Some(thread) = self.thread.lock().unwrap().take() {
+            let _ = thread.join();
+        }
         // create the thread
         let (tx, rx) = mpsc::channel();
-        let _thread = std::thread::spawn(move || {
+        let thread = std::thread::spawn(move || {
             thread_running.store(true, Ordering::SeqCst);
             is_open.store(false, Ordering::SeqCst);
+            // Runs however the thread ends, a panicking subscriber included, so waiters
+            // don't sit out their timeout
+            let mut teardown = ReaderTeardown {
+                is_open: is_open.clone(),
+                signal: signal.clone(),
+                thread_running: thread_running.clone(),
+                error: None,
+            };
             // We notify the condvar that the value has changed.
             // Open the port
             println!("Opening port {}", port_name);
-            let mut port = serialport::new(&port_name, baud_rate)
+            let mut reader = reader;
+            // setup the port
+            let setup = serialport::new(&port_name, config.baud_rate)
                 .timeout(Duration::from_millis(10))
                 .open()
                 .map_err(Error::SerialError)
-                .unwrap_or_else(|_| panic!("Failed to open port {}.", &port_name));
+                .and_then(|mut port| {
+                    configure_receiver(&mut *port, &mut reader, &config, UBX_ACK_TIMEOUT)?;
+                    run_transaction(
+                        &mut *port,
+                        &mut reader,
+                        &mut thread_transaction,
+                        UBX_ACK_TIMEOUT,
+                    )?;
+                    Ok(port)
+                });
+            let mut port = match setup {
+                Ok(port) => port,
+                Err(e) => {
+                    let _ = tx.send((Err(e), thread_transaction));
+                    return;
+                }
+            };
             let mut buffer: Vec<u8> = vec![0; 1000];
 
-            // setup the port
-
-            // 32.10.29.1 Reset receiver / Clear backup data structures
-            // Payload: Hot Start (0x00), Controlled software reset (0x01), reserved1 (0x00)
-            port.write_all(
-                ubx::PacketHeader::new(ubx::ClassField::CFG, 0x04, vec![0x0, 0x01, 0], true)
-                    .data(true)
-                    .as_slice(),
-            )
-            .unwrap();
-
-            // Disable all NEMA messages
-            // 31.1.9 Messages overview
-            for i in [
-                0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0D, 0x0E, 0x0F,
-                0x40, 0x41, 0x42, 0x43, 0x44,
-            ] {
-                port.write_all(
-                    ubx::PacketHeader::new(ubx::ClassField::CFG, 0x01, vec![0xF0, i, 0], true)
-                        .data(true)
-                        .as_slice(),
-                )
-                .unwrap();
-            }
-            // Enable UBX messages UBX,00 UBX,03 UBX,04
-            // 19 NMEA Messages Overview
-            for i in [0u8, 3, 4] {
-                let cfg_msg_pkt = ubx::PacketHeader::new(
-                    ubx::ClassField::CFG,
-                    0x01,
-                    vec![0xF1, i, 1], //0, 0, 0, 1, 0, 0],
-                    true,
-                );
-                let data = cfg_msg_pkt.data(true);
-                port.write_all(data.as_slice()).unwrap();
-                //println!("Sent CFG message: {:02X?}", data);
-                // TODO: Verify we got ACK messages from the GPS
-            }
-
-            let mut partial_sentence = String::new();
-            let mut partial_complete = false;
             is_open.store(true, Ordering::Relaxed);
-            tx.send(()).unwrap();
+            signal.update(|s| {
+                s.running = true;
+                s.error = None;
+            });
+            tx.send((Ok(()), thread_transaction)).unwrap();
             loop {
                 // Detect if we should shutdown
                 if shutdown_thread.load(std::sync::atomic::Ordering::Relaxed) {
                     break;
                 }
                 // read the port
-                match port.read(buffer.as_mut_slice()) {
-                    // This reader has reached its "end of file" and will likely no longer be able to produce bytes.
-                    Ok(0) => break,
-                    // Successfully read some bytes
-                    Ok(size) => {
-                        let data = if partial_complete {
-                            partial_complete = false;
-                            partial_sentence.as_bytes()
-                        } else {
-                            &buffer[..size]
-                        };
-                        let packets = GPSPacket::new(data);
-                        // Parse the packet
-                        for packet in packets {
-                            match &packet {
-                                GPSPacket::NMEA(nmea) => match nmea {
-                                    NMEASentenceType::PUBX00(_) => {
-                                        gps_info.write().unwrap().update_from_nmea_sentence(nmea);
-                                    }
-                                    NMEASentenceType::PUBX03(_) => {
-                                        gps_info.write().unwrap().update_from_nmea_sentence(nmea);
-                                    }
-                                    NMEASentenceType::PUBX04(_) => {
-                                        gps_info.write().unwrap().update_from_nmea_sentence(nmea);
-                                    }
-                                    _ => panic!("Unsupported sentence: {nmea:?}"),
-                                },
-                                GPSPacket::Ubx(_packet) => {} //println!("Received: {:#?}", packet),
-                                GPSPacket::Unsupported(data, e) => {
-                                    println!("Unsupported: {data:?} {e}")
-                                }
-                                GPSPacket::NMEAUnsupported(data, e) => {
-                                    println!("Unsupported NMEA: {data:?} {e:?}")
-                                }
-                                GPSPacket::NMEAPartialStart(s) => {
-                                    s.clone_into(&mut partial_sentence);
-                                    partial_complete = false;
-                                }
-                                GPSPacket::NMEAPartial(s) => partial_sentence.push_str(s),
-                                GPSPacket::NMEAPartialEnd(s) => {
-                                    partial_sentence.push_str(s);
-                                    partial_complete = true;
-                                }
-                            }
-                        }
-                        //println!("GPSInfo: {:?}", gps_info.read().unwrap());
-                    }
-                    // Nothing to read, try again later
-                    Err(e) if e.kind() == std::io::ErrorKind::TimedOut => {}
-                    // An error of the ErrorKind::Interrupted kind is non-fatal and the read operation should be retried if there is nothing else to do.
-                    Err(e) if e.kind() == std::io::ErrorKind::Interrupted => {}
+                match reader.read_from(&mut *port, &mut buffer) {
+                    Ok(true) => {}
                     // Fatal, this will happen when device is disconnected.
-                    Err(e) if e.kind() == std::io::ErrorKind::BrokenPipe => {
-                        break;
-                    }
-                    // Uncaught errors, panic!
+                    Ok(false) => break,
+                    // Reported by GPSDevice::last_error and the waiters
                     Err(e) => {
-                        panic!("Error: {e}");
+                        teardown.error = Some(e.kind());
+                        break;
                     }
                 }
             }
-            is_open.store(false, Ordering::Relaxed);
-            thread_running.store(false, Ordering::SeqCst);
-            //tx.send(()).unwrap();
         });
-        rx.recv().unwrap();
+        *self.thread.lock().unwrap() = Some(thread);
+        let started = match rx.recv() {
+            Ok((started, thread_transaction)) => {
+                *transaction = thread_transaction;
+                started
+            }
+            Err(_) => Err(Error::CriticalError("GPS reader thread panicked".into())),
+        };
+        if let Err(e) = started {
+            if let Some(thread) = self.thread.lock().unwrap().take() {
+                let _ = thread.join();
+            }
+            return Err(e);
+        }
         Ok(self.is_open.load(std::sync::atomic::Ordering::Relaxed))
     }
 
     /// Close the GPS connection.
     pub fn close(&self) -> Result<()> {
+        // Waits for the reactor to drop the port, unless called from a reactor callback
+        let registration = self.registration.lock().unwrap().take();
+        drop(registration);
         self.shutdown_thread
             .clone()
             .borrow_mut()
             .store(true, Ordering::Relaxed);
-        while self.thread_running.load(Ordering::Relaxed) {
-            std::thread::sleep(std::time::Duration::from_millis(3));
+        let thread = self.thread.lock().unwrap().take();
+        if let Some(thread) = thread {
+            // A subscriber closing the device from the reader thread can't join itself,
+            // the thread exits on its own after the callback returns.
+            if thread.thread().id() != std::thread::current().id() {
+                thread
+                    .join()
+                    .map_err(|_| Error::CriticalError("GPS reader thread panicked".into()))?;
+            }
         }
         Ok(())
     }
@@ -313,8 +1097,91 @@ impl GPSDevice {
         self.is_open.load(std::sync::atomic::Ordering::Relaxed)
     }
 
-    /// Returns the current GPS Info. See [GPSInfo] for more info. Port should be open first.
-    pub fn get_info(&self) -> Result<GPSInfo> {
+    /// Read error that closed the port, None while it's open, after [GPSDevice::close] or if
+    /// it was disconnected. Cleared by the next open.
+    pub fn last_error(&self) -> Option<Error> {
+        self.signal.state.lock().unwrap().error.map(Error::IOError)
+    }
+
+    /// Service the port from `reactor` instead of a reader thread of its own, starting with
+    /// the next open. None goes back to a reader thread. Subscribers, raw taps and the fix log
+    /// are then called from the reactor thread and hold up every other device on it.
+    pub fn set_reactor(&self, reactor: Option<ReactorHandle>) {
+        *self.reactor.lock().unwrap() = reactor;
+    }
+
+    /// Reader state for a new reader thread or reactor port.
+    fn reader(&self) -> GPSReader {
+        GPSReader {
+            framer: Framer::new(),
+            gps_info: self.gps_info.clone(),
+            subscribers: self.subscribers.clone(),
+            fix_log: self.fix_log.clone(),
+            metrics: self.metrics.clone(),
+            raw_tap: self.raw_tap.clone(),
+            signal: self.signal.clone(),
+            stats: self.stats.clone(),
+            sequence: self.sequence.clone(),
+            last_fix_ns: None,
+            acks: Vec::new(),
+        }
+    }
+
+    /// Configure the receiver from the calling thread, then hand the port to the reactor.
+    #[cfg(unix)]
+    fn open_on_reactor(
+        &self,
+        config: &GpsConfig,
+        transaction: &mut ubx::Transaction,
+        reactor: &ReactorHandle,
+    ) -> Result<bool> {
+        use std::os::unix::io::AsRawFd;
+
+        let mut registration = self.registration.lock().unwrap();
+        if registration.is_some() && self.is_open() {
+            return Ok(true);
+        }
+        // Left over from a port that was disconnected
+        *registration = None;
+        let mut reader = self.reader();
+        let mut port = serialport::new(&self.port_name, config.baud_rate)
+            .timeout(Duration::from_millis(10))
+            .open_native()
+            .map_err(Error::SerialError)?;
+        configure_receiver(&mut port, &mut reader, config, UBX_ACK_TIMEOUT)?;
+        run_transaction(&mut port, &mut reader, transaction, UBX_ACK_TIMEOUT)?;
+        let fd = port.as_raw_fd();
+        self.is_open.store(true, Ordering::Relaxed);
+        self.signal.update(|s| {
+            s.running = true;
+            s.error = None;
+        });
+        let mut source = ReactorPort {
+            port,
+            reader,
+            buffer: vec![0; 1000],
+            is_open: self.is_open.clone(),
+            error: None,
+        };
+        *registration = Some(reactor.add_fd(fd, Box::new(move || source.ready()))?);
+        Ok(true)
+    }
+
+    #[cfg(not(unix))]
+    fn open_on_reactor(
+        &self,
+        _config: &GpsConfig,
+        _transaction: &mut ubx::Transaction,
+        _reactor: &ReactorHandle,
+    ) -> Result<bool> {
+        Err(Error::NotSupported(
+            "The shared reactor is not supported on this platform".into(),
+        ))
+    }
+
+    /// Run f on the current GPS Info under the read lock, ie. to convert it without cloning.
+    /// f holds up the reader thread so it should return quickly. Port should be open first.
+    pub fn with_info<R>(&self, f: impl FnOnce(&GPSInfo) -> R) -> Result<R> {
         if !self.is_open() {
             return Err(std::io::Error::new(
                 std::io::ErrorKind::NotConnected,
@@ -322,7 +1189,197 @@ impl GPSDevice {
             )
             .into());
         }
-        Ok(self.gps_info.read().unwrap().clone())
+        Ok(f(&self.gps_info.read().unwrap()))
+    }
+
+    /// [GPSInfo::sequence] of the latest update without taking the lock, zero until the first
+    /// one. Works whether or not the port is open.
+    pub fn sequence(&self) -> u64 {
+        self.sequence.load(Ordering::Acquire)
+    }
+
+    /// Like [GPSDevice::with_info] but returns Ok(None) without taking the lock if nothing
+    /// was applied since the update numbered `last_sequence`.
+    pub fn with_info_if_newer<R>(
+        &self,
+        last_sequence: u64,
+        f: impl FnOnce(&GPSInfo) -> R,
+    ) -> Result<Option<R>> {
+        if self.is_open() && self.sequence() <= last_sequence {
+            return Ok(None);
+        }
+        self.with_info(|gps_info| (gps_info.sequence > last_sequence).then(|| f(gps_info)))
+    }
+
+    /// Returns the current GPS Info. See [GPSInfo] for more info. Port should be open first.
+    pub fn get_info(&self) -> Result<GPSInfo> {
+        self.with_info(GPSInfo::clone)
+    }
+
+    /// Returns the current fix without the satellites, see [GPSInfo::fix]. Port should be open first.
+    pub fn get_fix(&self) -> Result<GPSFix> {
+        self.with_info(GPSInfo::fix)
+    }
+
+    /// Returns the current fix and whether it has a lock, read under one lock. Port should be
+    /// open first.
+    pub fn get_fix_with_lock(&self) -> Result<(GPSFix, bool)> {
+        self.with_info(|gps_info| (gps_info.fix(), has_lock(gps_info)))
+    }
+
+    /// Returns the satellites in view, see [GPSInfo::satellites_soa]. Port should be open first.
+    pub fn get_satellites(&self) -> Result<GPSSatellites> {
+        self.with_info(GPSInfo::satellites_soa)
+    }
+
+    /// Register a callback that is invoked from the GPS reader thread every time a
+    /// PUBX00/03/04 sentence or UBX-NAV message has been applied to the [GPSInfo]. Returns an id that
+    /// can be passed to [GPSDevice::unsubscribe].
+    ///
+    /// The callback runs on the reader thread so it should return quickly, and it must
+    /// not call [GPSDevice::subscribe] or [GPSDevice::unsubscribe] itself.
+    /// Subscriptions persist across [GPSDevice::close] and [GPSDevice::open].
+    pub fn subscribe(&self, callback: impl FnMut(&GPSInfo) + Send + 'static) -> u32 {
+        let mut subscribers = self.subscribers.lock().unwrap();
+        let id = subscribers.next_id;
+        subscribers.next_id = subscribers.next_id.wrapping_add(1);
+        subscribers.callbacks.push((id, Box::new(callback)));
+        id
+    }
+
+    /// Remove a callback previously registered with [GPSDevice::subscribe].
+    /// Returns false if the id wasn't found.
+    pub fn unsubscribe(&self, id: u32) -> bool {
+        let mut subscribers = self.subscribers.lock().unwrap();
+        let count = subscribers.callbacks.len();
+        subscribers.callbacks.retain(|(i, _)| *i != id);
+        count != subscribers.callbacks.len()
+    }
+
+    /// Record every position update (PUBX00 or UBX-NAV-PVT) to `path` as a binary
+    /// [crate::fixlog] written from the reader thread. Replaces a log that is already running.
+    /// Like subscriptions the log stays active across [GPSDevice::close]/open. Fails if
+    /// another writer has `path` open. A failed write stops the log, it's counted in
+    /// [GPSStatsSnapshot::fix_log_errors] and returned by [GPSDevice::fix_log_stop].
+    pub fn fix_log_start(&self, path: impl AsRef<Path>) -> Result<()> {
+        let mut fix_log = self.fix_log.lock().unwrap();
+        // Close the previous log first, it holds the lock if path is the same file
+        if let FixLogState::Running(previous) = std::mem::take(&mut *fix_log) {
+            previous.finish()?;
+        }
+        *fix_log = FixLogState::Running(FixLogWriter::create(path)?);
+        Ok(())
+    }
+
+    /// Pass every byte read from the serial port to callback, exactly as the receiver sent
+    /// it and before it is parsed. callback gets the reader thread's read buffer, so it runs on
+    /// the reader thread and should return quickly. It must not call [GPSDevice::raw_tap_start]
+    /// or [GPSDevice::raw_tap_stop] itself.
+    ///
+    /// With `parse` false the bytes are only handed to callback. The receiver is still
+    /// configured on open, but [GPSInfo] stops updating: subscribers, waiters and the fix log
+    /// see nothing. Replaces a tap that is already installed. Stays installed across
+    /// [GPSDevice::close]/open.
+    pub fn raw_tap_start(&self, parse: bool, callback: impl FnMut(&[u8]) + Send + 'static) {
+        let tap = RawTap {
+            callback: Box::new(callback),
+            parse,
+        };
+        // Drop the previous tap outside of the lock
+        let previous = self.raw_tap.lock().unwrap().replace(tap);
+        drop(previous);
+    }
+
+    /// Write every byte read from the serial port to `path`, see [GPSDevice::raw_tap_start].
+    /// The file is flushed when the tap is stopped or replaced. Failed writes are counted in
+    /// [GPSStatsSnapshot::tap_write_errors].
+    pub fn raw_tap_to_file(&self, parse: bool, path: impl AsRef<Path>) -> Result<()> {
+        let mut file = BufWriter::new(File::create(path)?);
+        let stats = self.stats.clone();
+        self.raw_tap_start(parse, move |bytes| {
+            if file.write_all(bytes).is_err() {
+                stats::add(&stats.tap_write_errors, 1);
+            }
+        });
+        Ok(())
+    }
+
+    /// Remove the raw tap, no callbacks are made after this returns. Returns false if no tap
+    /// was installed.
+    pub fn raw_tap_stop(&self) -> bool {
+        let previous = self.raw_tap.lock().unwrap().take();
+        previous.is_some()
+    }
+
+    /// Reader thread counters, see [GPSStatsSnapshot]. Kept across [GPSDevice::close]/open.
+    pub fn stats(&self) -> GPSStatsSnapshot {
+        self.stats.snapshot()
+    }
+
+    pub fn stats_reset(&self) {
+        self.stats.reset();
+    }
+
+    /// Evaluate every position update once on the reader thread: ECEF coordinates, an
+    /// odometer, Kalman smoothed velocity and geofence membership, read with
+    /// [GPSDevice::metrics]. Only changes the tuning if already started. Like the fix log it
+    /// stays active across [GPSDevice::close]/open.
+    pub fn metrics_start(&self, config: MetricsConfig) -> Result<()> {
+        let mut metrics = self.metrics.lock().unwrap();
+        match metrics.as_mut() {
+            Some(engine) => engine.set_config(config),
+            None => {
+                *metrics = Some(MetricsEngine::new(config)?);
+                Ok(())
+            }
+        }
+    }
+
+    /// Stop evaluating updates, the odometer and geofences are dropped. Returns false if
+    /// metrics weren't started.
+    pub fn metrics_stop(&self) -> bool {
+        self.metrics.lock().unwrap().take().is_some()
+    }
+
+    /// Run f on the metrics engine, fails if [GPSDevice::metrics_start] wasn't called.
+    fn with_metrics<R>(&self, f: impl FnOnce(&mut MetricsEngine) -> R) -> Result<R> {
+        match self.metrics.lock().unwrap().as_mut() {
+            Some(engine) => Ok(f(engine)),
+            None => Err(Error::NotSupported("GPS metrics aren't started".into())),
+        }
+    }
+
+    /// Metrics of the latest position update, see [GPSDevice::metrics_start].
+    pub fn metrics(&self) -> Result<FixMetrics> {
+        self.with_metrics(|engine| engine.metrics().clone())
+    }
+
+    pub fn metrics_reset_odometer(&self) -> Result<()> {
+        self.with_metrics(MetricsEngine::reset_odometer)
+    }
+
+    /// See [MetricsEngine::geofence_add]
+    pub fn geofence_add(&self, vertices: &[(f64, f64)]) -> Result<u32> {
+        self.with_metrics(|engine| engine.geofence_add(vertices))?
+    }
+
+    /// See [MetricsEngine::geofence_remove]
+    pub fn geofence_remove(&self, id: u32) -> Result<bool> {
+        self.with_metrics(|engine| engine.geofence_remove(id))
+    }
+
+    /// Flush and close the fix log. Returns false if no log was running, or the error of
+    /// the write that stopped it.
+    pub fn fix_log_stop(&self) -> Result<bool> {
+        let log = std::mem::take(&mut *self.fix_log.lock().unwrap());
+        match log {
+            FixLogState::Running(log) => {
+                log.finish()?;
+                Ok(true)
+            }
+            FixLogState::Failed(kind) => Err(Error::IOError(kind)),
+            FixLogState::Stopped => Ok(false),
+        }
     }
 
     /// Returns true if the GPS has a fix. False if it does not.
@@ -334,11 +1391,507 @@ impl GPSDevice {
             )
             .into());
         }
-        match &self.gps_info.read().unwrap().nav_stat {
-            Some(GpsNavigationStatus::NoFix) => Ok(false),
-            Some(_) => Ok(true),
-            _ => Ok(false),
+        Ok(has_lock(&self.gps_info.read().unwrap()))
+    }
+
+    /// Returns a [GPSWaiter] to block on GPS events without polling.
+    pub fn waiter(&self) -> GPSWaiter {
+        GPSWaiter {
+            signal: self.signal.clone(),
+        }
+    }
+
+    /// See [GPSWaiter::wait_for_lock]
+    pub fn wait_for_lock(&self, timeout: Duration) -> Result<bool> {
+        self.waiter().wait_for_lock(timeout)
+    }
+
+    /// See [GPSWaiter::wait_for_fix]
+    pub fn wait_for_fix(&self, timeout: Duration) -> Result<bool> {
+        self.waiter().wait_for_fix(timeout)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::atomic::AtomicU32;
+
+    use crate::nmea::types::GPSDMS;
+
+    use super::*;
+
+    #[test]
+    fn test_subscribe() {
+        let gps_device = GPSDevice::default();
+        let count = Arc::new(AtomicU32::new(0));
+        let id = {
+            let count = count.clone();
+            gps_device.subscribe(move |_info| {
+                count.fetch_add(1, Ordering::Relaxed);
+            })
+        };
+        gps_device
+            .subscribers
+            .lock()
+            .unwrap()
+            .notify(&GPSInfo::default());
+        assert_eq!(count.load(Ordering::Relaxed), 1);
+
+        assert!(gps_device.unsubscribe(id));
+        assert!(!gps_device.unsubscribe(id));
+        gps_device
+            .subscribers
+            .lock()
+            .unwrap()
+            .notify(&GPSInfo::default());
+        assert_eq!(count.load(Ordering::Relaxed), 1);
+    }
+
+    #[test]
+    fn test_raw_tap() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        let tapped = Arc::new(Mutex::new(Vec::<u8>::new()));
+        let sentence = b"$PUBX,00,025554.00,0000.00000,N,00000.00000,E,0.000,NF,5311696,3755936,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0*28\r\n";
+        {
+            let tapped = tapped.clone();
+            gps_device.raw_tap_start(false, move |bytes| tapped.lock().unwrap().extend(bytes));
+        }
+        reader.receive(&sentence[..20], false);
+        reader.receive(&sentence[20..], false);
+        assert_eq!(*tapped.lock().unwrap(), sentence);
+        assert_eq!(gps_device.signal.state.lock().unwrap().fixes, 0);
+        // Configuration still needs the acknowledgements
+        reader.receive(sentence, true);
+        assert_eq!(gps_device.signal.state.lock().unwrap().fixes, 1);
+        assert!(gps_device.raw_tap_stop());
+        assert!(!gps_device.raw_tap_stop());
+        reader.receive(sentence, false);
+        assert_eq!(tapped.lock().unwrap().len(), sentence.len() * 2);
+    }
+
+    #[test]
+    fn test_fix_log_errors() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        let path = std::env::temp_dir().join(format!("mic2_gps_fixlog_{}", std::process::id()));
+        gps_device.fix_log_start(&path).unwrap();
+        // Every fix that follows is older and fails to append
+        if let FixLogState::Running(log) = &mut *gps_device.fix_log.lock().unwrap() {
+            log.append(&crate::nmea::types::GPSFix {
+                monotonic_time_ns: u64::MAX,
+                ..Default::default()
+            })
+            .unwrap();
+        }
+        let sentence = b"$PUBX,00,025554.00,0000.00000,N,00000.00000,E,0.000,NF,5311696,3755936,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0*28\r\n";
+        reader.process(sentence);
+        reader.process(sentence);
+        // Counted once, the log stopped
+        assert_eq!(gps_device.stats().fix_log_errors, 1);
+        assert!(matches!(
+            gps_device.fix_log_stop(),
+            Err(Error::IOError(std::io::ErrorKind::InvalidInput))
+        ));
+        assert!(!gps_device.fix_log_stop().unwrap());
+        std::fs::remove_file(&path).unwrap();
+    }
+
+    #[test]
+    #[cfg(target_os = "linux")]
+    fn test_raw_tap_to_file_errors() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        // Every write to /dev/full fails, reads larger than the buffer are written right away
+        gps_device.raw_tap_to_file(true, "/dev/full").unwrap();
+        reader.receive(&[0; 16 * 1024], false);
+        reader.receive(&[0; 16 * 1024], false);
+        assert_eq!(gps_device.stats().tap_write_errors, 2);
+        gps_device.stats_reset();
+        assert_eq!(gps_device.stats().tap_write_errors, 0);
+        assert!(gps_device.raw_tap_stop());
+    }
+
+    #[test]
+    fn test_reader_process() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        let sentence = b"$PUBX,00,025554.00,0000.00000,N,00000.00000,E,0.000,NF,5311696,3755936,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0*28\r\n";
+        // Split across reads
+        reader.process(&sentence[..20]);
+        assert_eq!(gps_device.signal.state.lock().unwrap().fixes, 0);
+        reader.process(&sentence[20..]);
+        assert_eq!(gps_device.signal.state.lock().unwrap().fixes, 1);
+        let gps_info = gps_device.gps_info.read().unwrap();
+        assert_eq!(gps_info.nav_stat, Some(GpsNavigationStatus::NoFix));
+        let stats = gps_device.stats();
+        assert_eq!(stats.nmea_sentences, 1);
+        assert_eq!(stats.partial_reads, 1);
+        assert_eq!(stats.fixes, 1);
+        assert_eq!(stats.parse_latency.count, 1);
+        assert_eq!(stats.fix_interval.count, 0);
+        drop(gps_info);
+
+        assert_eq!(gps_device.sequence(), 1);
+        gps_device.is_open.store(true, Ordering::Relaxed);
+        let nav_stat = |gps_info: &GPSInfo| gps_info.nav_stat;
+        assert_eq!(
+            gps_device.with_info_if_newer(0, nav_stat).unwrap(),
+            Some(Some(GpsNavigationStatus::NoFix))
+        );
+        assert_eq!(gps_device.with_info_if_newer(1, nav_stat).unwrap(), None);
+        reader.process(sentence);
+        assert_eq!(gps_device.sequence(), 2);
+        assert!(gps_device
+            .with_info_if_newer(1, nav_stat)
+            .unwrap()
+            .is_some());
+
+        assert!(gps_device.metrics().is_err());
+        gps_device.metrics_start(MetricsConfig::default()).unwrap();
+        reader.process(sentence);
+        let metrics = gps_device.metrics().unwrap();
+        assert_eq!(metrics.fixes, 1);
+        assert_eq!(metrics.fix.nav_stat, Some(GpsNavigationStatus::NoFix));
+        assert!(metrics.ecef.is_none());
+        assert!(gps_device.metrics_stop());
+        assert!(!gps_device.metrics_stop());
+    }
+
+    #[test]
+    fn test_parser() {
+        let mut parser = GPSParser::new();
+        let sentence = b"$PUBX,00,025554.00,0000.00000,N,00000.00000,E,0.000,NF,5311696,3755936,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0*28\r\n";
+        assert_eq!(parser.push(&sentence[..20]), 0);
+        assert_eq!(parser.push(&sentence[20..]), 1);
+        assert_eq!(parser.gps_info().nav_stat, Some(GpsNavigationStatus::NoFix));
+        assert_ne!(parser.gps_info().monotonic_time_ns, 0);
+        let stats = parser.stats();
+        assert_eq!(stats.reads, 2);
+        assert_eq!(stats.bytes_read, sentence.len() as u64);
+        assert_eq!(stats.partial_reads, 1);
+        assert_eq!(stats.fixes, 1);
+    }
+
+    #[test]
+    fn test_reader_process_ubx() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        let mut payload = vec![0u8; 92];
+        payload[4..6].copy_from_slice(&2024u16.to_le_bytes());
+        payload[6..11].copy_from_slice(&[6, 15, 12, 30, 45]);
+        // validDate | validTime
+        payload[11] = 0x03;
+        // 3D fix, gnssFixOK
+        payload[20] = 3;
+        payload[21] = 0x01;
+        payload[24..28].copy_from_slice(&(-833_913_000i32).to_le_bytes());
+        payload[28..32].copy_from_slice(&(423_456_000i32).to_le_bytes());
+        payload[32..36].copy_from_slice(&(250_500i32).to_le_bytes());
+        payload[40..44].copy_from_slice(&(1_500u32).to_le_bytes());
+        payload[60..64].copy_from_slice(&(10_000i32).to_le_bytes());
+        let packet = ubx::PacketHeader::new(ubx::ClassField::NAV, ubx::NAV_PVT, payload, true);
+        reader.process(&packet.data(true));
+
+        assert_eq!(gps_device.signal.state.lock().unwrap().fixes, 1);
+        let gps_info = gps_device.gps_info.read().unwrap();
+        assert_eq!(gps_info.nav_stat, Some(GpsNavigationStatus::StandAlone3D));
+        assert_eq!(
+            gps_info.current_time.unwrap().to_string(),
+            "2024-06-15 12:30:45"
+        );
+        let (latitude, n) = gps_info.latitude.unwrap();
+        assert_eq!((latitude, n), (GPSDMS::new(42, 20, 44), 'N'));
+        let (longitude, e) = gps_info.longitude.unwrap();
+        assert_eq!((longitude, e), (GPSDMS::new(83, 23, 29), 'W'));
+        assert_eq!(gps_info.altitude, Some(250.5));
+        assert_eq!(gps_info.h_acc, Some(1.5));
+        assert_eq!(gps_info.sog_kmh, Some(36.0));
+    }
+
+    #[test]
+    fn test_reader_metrics_precision() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        gps_device.metrics_start(MetricsConfig::default()).unwrap();
+        let nav_pvt = |lat: i32| {
+            let mut payload = vec![0u8; 92];
+            // 3D fix, gnssFixOK
+            payload[20] = 3;
+            payload[21] = 0x01;
+            payload[24..28].copy_from_slice(&(-833_913_000i32).to_le_bytes());
+            payload[28..32].copy_from_slice(&lat.to_le_bytes());
+            payload[40..44].copy_from_slice(&(1_500u32).to_le_bytes());
+            ubx::PacketHeader::new(ubx::ClassField::NAV, ubx::NAV_PVT, payload, true).data(true)
+        };
+        // 5 m north, well under the 31 m of a whole arc-second
+        reader.process(&nav_pvt(423_456_000));
+        reader.process(&nav_pvt(423_456_450));
+        let metrics = gps_device.metrics().unwrap();
+        assert_eq!(metrics.fix.latitude, Some(42.345645));
+        assert!((metrics.odometer_m - 5.0).abs() < 0.05);
+    }
+
+    /// Fake receiver that acknowledges CFG messages written to it.
+    #[derive(Default)]
+    struct MockReceiver {
+        /// Bytes waiting to be read
+        pending: Vec<u8>,
+        /// (class, id) of a CFG-MSG message that gets an ACK-NAK
+        reject: Option<(u8, u8)>,
+        /// Don't reply at all
+        silent: bool,
+        /// (id, payload) of every CFG message received
+        received: Vec<(u8, Vec<u8>)>,
+        /// Number of writes
+        writes: usize,
+        /// Sent along with every reply, like the default NMEA output before it is disabled
+        chatter: Vec<u8>,
+    }
+
+    impl Read for MockReceiver {
+        fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+            if self.pending.is_empty() {
+                return Err(std::io::ErrorKind::TimedOut.into());
+            }
+            let size = buf.len().min(self.pending.len());
+            buf[..size].copy_from_slice(&self.pending[..size]);
+            self.pending.drain(..size);
+            Ok(size)
+        }
+    }
+
+    impl Write for MockReceiver {
+        fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+            self.writes += 1;
+            let chatter = self.chatter.clone();
+            self.pending.extend_from_slice(&chatter);
+            let mut packets = buf;
+            while !packets.is_empty() {
+                let (id, length) = (
+                    packets[3],
+                    u16::from_le_bytes([packets[4], packets[5]]) as usize,
+                );
+                let payload = packets[6..6 + length].to_vec();
+                assert_eq!(packets[2], ubx::ClassField::CFG as u8);
+                if id != ubx::CFG_RST && !self.silent {
+                    let accepted =
+                        !(id == ubx::CFG_MSG && self.reject == Some((payload[0], payload[1])));
+                    let ack_id = if accepted { ubx::ACK_ACK } else { ubx::ACK_NAK };
+                    let ack = ubx::PacketHeader::new(
+                        ubx::ClassField::ACK,
+                        ack_id,
+                        vec![ubx::ClassField::CFG as u8, id],
+                        true,
+                    );
+                    self.pending.extend_from_slice(&ack.data(true));
+                }
+                self.received.push((id, payload));
+                packets = &packets[8 + length..];
+            }
+            Ok(buf.len())
+        }
+
+        fn flush(&mut self) -> std::io::Result<()> {
+            Ok(())
+        }
+    }
+
+    fn test_reader(gps_device: &GPSDevice) -> GPSReader {
+        gps_device.reader()
+    }
+
+    #[test]
+    fn test_configure_receiver() {
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        let timeout = Duration::from_millis(5);
+        let config = GpsConfig::from(GpsProtocol::Ubx);
+        // Unsupported NMEA messages are allowed to be rejected
+        let mut port = MockReceiver {
+            reject: Some((0xF0, 0x40)),
+            ..Default::default()
+        };
+        configure_receiver(&mut port, &mut reader, &config, timeout).unwrap();
+        let find = |port: &MockReceiver, id: u8, prefix: &[u8]| {
+            port.received
+                .iter()
+                .find(|(i, payload)| *i == id && payload.starts_with(prefix))
+                .map(|(_, payload)| payload.clone())
+                .unwrap()
+        };
+        assert_eq!(port.received[0].0, ubx::CFG_RST);
+        assert_eq!(find(&port, ubx::CFG_RATE, &[]), [100, 0, 1, 0, 1, 0]);
+        // Only UBX output on the USB port
+        assert_eq!(
+            find(&port, ubx::CFG_PRT, &[UBX_USB_PORT_ID])[14..16],
+            [0x01, 0]
+        );
+        assert_eq!(find(&port, ubx::CFG_MSG, &[0x01, ubx::NAV_PVT])[2], 1);
+        assert_eq!(find(&port, ubx::CFG_MSG, &[0x01, ubx::NAV_SAT])[2], 10);
+        assert_eq!(find(&port, ubx::CFG_MSG, &[0xF1, 0x00])[2], 0);
+        // CFG-RST, CFG-PRT and then everything else at once
+        assert_eq!(port.writes, 3);
+        assert_eq!(port.received.len(), 2 + 19 + 1 + GPS_MESSAGE_IDS.len());
+
+        // Custom messages sent after the configuration get their own answers
+        let mut transaction = ubx::Transaction::new();
+        for payload in [vec![0xF0, 0x40, 1], vec![0xF0, 0x41, 1]] {
+            transaction.push(&ubx::PacketHeader::new(
+                ubx::ClassField::CFG,
+                ubx::CFG_MSG,
+                payload,
+                true,
+            ));
         }
+        run_transaction(&mut port, &mut reader, &mut transaction, timeout).unwrap();
+        assert_eq!(
+            transaction.states(),
+            [ubx::AckState::Rejected, ubx::AckState::Accepted]
+        );
+
+        // Required messages have to be accepted
+        port = MockReceiver {
+            reject: Some((0x01, ubx::NAV_PVT)),
+            ..Default::default()
+        };
+        assert!(matches!(
+            configure_receiver(&mut port, &mut reader, &config, timeout),
+            Err(Error::NotSupported(_))
+        ));
+
+        port = MockReceiver {
+            silent: true,
+            ..Default::default()
+        };
+        assert!(matches!(
+            configure_receiver(&mut port, &mut reader, &config, timeout),
+            Err(Error::IOError(std::io::ErrorKind::TimedOut))
+        ));
+        // CFG-RST and CFG-PRT with retries
+        assert_eq!(port.received.len(), 1 + UBX_ACK_ATTEMPTS as usize);
+    }
+
+    #[test]
+    fn test_configure_receiver_with_nmea() {
+        // Default NMEA output is still on until the configuration turns it off
+        let chatter = concat!(
+            "$GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47*17\r\n",
+            "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74\r\n",
+            "$GPGST,182141.000,15.5,15.3,7.2,21.8,0.9,0.5,0.8*54\r\n",
+            "$GNTXT,01,01,02,u-blox AG - www.u-blox.com*4E\r\n",
+        );
+        let gps_device = GPSDevice::default();
+        let mut reader = test_reader(&gps_device);
+        let mut port = MockReceiver {
+            chatter: chatter.as_bytes().to_vec(),
+            ..Default::default()
+        };
+        let config = GpsConfig::default();
+        configure_receiver(&mut port, &mut reader, &config, Duration::from_millis(5)).unwrap();
+        let stats = gps_device.stats();
+        assert_eq!(stats.nmea_sentences, 4 * port.writes as u64);
+        assert_eq!(stats.unsupported, 4 * port.writes as u64);
+        assert_eq!(gps_device.sequence(), 0);
+    }
+
+    #[test]
+    fn test_config_validate() {
+        assert!(GpsConfig::default().validate().is_ok());
+        assert_eq!(GpsConfig::default().messages, GpsMessage::pubx());
+        let config = GpsConfig {
+            measurement_rate_ms: 20,
+            ..Default::default()
+        };
+        assert!(config.validate().is_err());
+        let config = GpsConfig {
+            navigation_rate: 0,
+            ..Default::default()
+        };
+        assert!(config.validate().is_err());
+        let config = GpsConfig {
+            messages: BitFlags::empty(),
+            ..Default::default()
+        };
+        assert!(config.validate().is_err());
+        assert!(GpsMessage::from_bits(0x80).is_err());
+        assert!(GpsMessage::from_bits(0x100).is_err());
+        assert_eq!(GpsMessage::from_bits(0x07).unwrap(), GpsMessage::pubx());
+        let messages = GpsMessage::NavPvt | GpsMessage::PubxTime;
+        assert!(messages.contains(GpsMessage::NavPvt));
+        assert!(!messages.contains(GpsMessage::nav()));
+        assert!(messages.intersects(GpsMessage::pubx()));
+    }
+
+    #[test]
+    fn test_waiter() {
+        let gps_device = GPSDevice::default();
+        let waiter = gps_device.waiter();
+        // Nothing is running yet
+        assert!(waiter.wait_for_lock(Duration::from_millis(1)).is_err());
+
+        gps_device.signal.update(|s| s.running = true);
+        assert!(!waiter.wait_for_fix(Duration::from_millis(1)).unwrap());
+        assert!(!waiter.wait_for_lock(Duration::from_millis(1)).unwrap());
+
+        let signal = gps_device.signal.clone();
+        let done = Arc::new(AtomicBool::new(false));
+        let reader = {
+            let done = done.clone();
+            std::thread::spawn(move || {
+                while !done.load(Ordering::Relaxed) {
+                    std::thread::sleep(Duration::from_millis(1));
+                    signal.update(|s| {
+                        s.fixes += 1;
+                        s.has_lock = true;
+                    });
+                }
+            })
+        };
+        assert!(waiter.wait_for_fix(Duration::from_secs(5)).unwrap());
+        assert!(waiter.wait_for_lock(Duration::from_secs(5)).unwrap());
+        done.store(true, Ordering::Relaxed);
+        reader.join().unwrap();
+
+        // Waiters are woken up when the reader thread exits
+        gps_device.signal.update(|s| s.running = false);
+        assert!(waiter.wait_for_fix(Duration::from_secs(5)).is_err());
+    }
+
+    #[test]
+    fn test_reader_teardown() {
+        let gps_device = GPSDevice::default();
+        gps_device.is_open.store(true, Ordering::Relaxed);
+        gps_device.thread_running.store(true, Ordering::Relaxed);
+        gps_device.signal.update(|s| s.running = true);
+        let waiter = gps_device.waiter();
+        let thread = {
+            let gps_device = gps_device.clone();
+            std::thread::spawn(move || {
+                let mut teardown = ReaderTeardown {
+                    is_open: gps_device.is_open.clone(),
+                    signal: gps_device.signal.clone(),
+                    thread_running: gps_device.thread_running.clone(),
+                    error: None,
+                };
+                std::thread::sleep(Duration::from_millis(10));
+                teardown.error = Some(std::io::ErrorKind::PermissionDenied);
+            })
+        };
+        let started = std::time::Instant::now();
+        let err = waiter.wait_for_fix(Duration::from_secs(5)).unwrap_err();
+        assert!(started.elapsed() < Duration::from_secs(5));
+        assert!(matches!(
+            err,
+            Error::IOError(std::io::ErrorKind::PermissionDenied)
+        ));
+        thread.join().unwrap();
+        assert!(!gps_device.is_open());
+        assert!(!gps_device.thread_running.load(Ordering::Relaxed));
+        assert!(matches!(
+            gps_device.last_error(),
+            Some(Error::IOError(std::io::ErrorKind::PermissionDenied))
+        ));
     }
 }
 
@@ -0,0 +1,244 @@
+//! neoVI MIC2 arrival and removal notifications built on libusb hotplug callbacks.
+//!
+//! libusb only reports individual USB devices, and a neoVI MIC2 is a hub with its FT245R,
+//! audio codec and GPS arriving one after another. The libusb callback only marks the bus as
+//! changed; once it has been quiet for [HOTPLUG_SETTLE_TIME] the monitor thread runs
+//! [find_neovi_mics] and reports the difference to the devices it already knows about.
+//! Nothing is scanned while the bus is idle.
+use crate::{
+    mic::{find_neovi_mics, NeoVIMIC, UsbDeviceInfo, UsbDeviceType},
+    types::{Error, Result},
+};
+use rusb::{GlobalContext, Hotplug, HotplugBuilder, UsbContext};
+use std::{
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        mpsc, Arc,
+    },
+    thread::JoinHandle,
+    time::{Duration, Instant},
+};
+
+/// How long the bus has to be quiet after a change before it is scanned.
+pub const HOTPLUG_SETTLE_TIME: Duration = Duration::from_millis(500);
+/// Upper bound on how long the monitor thread waits for libusb events before checking for shutdown.
+const HOTPLUG_POLL_INTERVAL: Duration = Duration::from_millis(100);
+
+#[derive(Debug)]
+pub enum HotplugEvent {
+    /// A neoVI MIC2 is ready to use, its FT245R has enumerated.
+    Arrived(Box<NeoVIMIC>),
+    /// A neoVI MIC2 reported by [HotplugEvent::Arrived] was removed.
+    Left {
+        usb_hub: UsbDeviceInfo,
+        serial_number: String,
+    },
+}
+
+// Arrived devices are handed out from the monitor thread and used from any other thread.
+const _: fn() = || {
+    fn assert_send_sync<T: Send + Sync>() {}
+    assert_send_sync::<HotplugEvent>();
+};
+
+/// Identifies a neoVI MIC2 between scans. The hub address changes if it is replugged and the
+/// serial number tells units apart if the address is reused.
+#[derive(Debug, Clone, PartialEq)]
+struct HotplugKey {
+    usb_hub: UsbDeviceInfo,
+    serial_number: String,
+}
+
+impl HotplugKey {
+    fn from(device: &NeoVIMIC) -> Self {
+        Self {
+            usb_hub: device.get_usb_hub_info().clone(),
+            serial_number: device.get_serial_number(),
+        }
+    }
+}
+
+/// libusb callback, flags the bus as changed when a neoVI MIC2 part comes or goes.
+struct HotplugFlag {
+    changed: Arc<AtomicBool>,
+}
+
+impl HotplugFlag {
+    fn flag(&self, device: &rusb::Device<GlobalContext>) {
+        let Ok(descriptor) = device.device_descriptor() else {
+            return;
+        };
+        // Devices plugged into the neoVI MIC2 hub don't change anything we report
+        if UsbDeviceInfo::usb_device_type_from_vid_pid(
+            &descriptor.vendor_id(),
+            &descriptor.product_id(),
+        ) != UsbDeviceType::Unknown
+        {
+            self.changed.store(true, Ordering::SeqCst);
+        }
+    }
+}
+
+impl Hotplug<GlobalContext> for HotplugFlag {
+    fn device_arrived(&mut self, device: rusb::Device<GlobalContext>) {
+        self.flag(&device);
+    }
+
+    fn device_left(&mut self, device: rusb::Device<GlobalContext>) {
+        self.flag(&device);
+    }
+}
+
+/// Sorts devices from a new scan against the known ones. Returns the indexes of the arrived
+/// devices in found and removes the keys that left from known.
+fn diff(known: &mut Vec<HotplugKey>, found: &[HotplugKey]) -> (Vec<usize>, Vec<HotplugKey>) {
+    let arrived = found
+        .iter()
+        .enumerate()
+        .filter(|(_, key)| !known.contains(key))
+        .map(|(i, _)| i)
+        .collect();
+    let (kept, left) = known.drain(..).partition(|key| found.contains(key));
+    *known = kept;
+    (arrived, left)
+}
+
+/// Background thread reporting neoVI MIC2 arrivals and removals, see [HotplugMonitor::start].
+/// Stops when dropped.
+#[derive(Debug)]
+pub struct HotplugMonitor {
+    shutdown: Arc<AtomicBool>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl HotplugMonitor {
+    /// Start watching the USB bus. callback is invoked from the monitor thread, first with an
+    /// [HotplugEvent::Arrived] for every neoVI MIC2 already attached and then for every change.
+    /// Fails with [Error::NotSupported] if libusb has no hotplug support on this platform.
+    pub fn start(mut callback: impl FnMut(HotplugEvent) + Send + 'static) -> Result<Self> {
+        if !rusb::has_hotplug() {
+            return Err(Error::NotSupported(
+                "libusb hotplug is not supported on this platform".into(),
+            ));
+        }
+        let shutdown = Arc::new(AtomicBool::new(false));
+        let (tx, rx) = mpsc::channel();
+        let thread = {
+            let shutdown = shutdown.clone();
+            std::thread::spawn(move || {
+                let context = GlobalContext::default();
+                // Scan once up front so anything already attached is reported
+                let changed = Arc::new(AtomicBool::new(true));
+                let registration = HotplugBuilder::new().enumerate(false).register(
+                    context,
+                    Box::new(HotplugFlag {
+                        changed: changed.clone(),
+                    }),
+                );
+                let _registration = match registration {
+                    Ok(registration) => {
+                        let _ = tx.send(Ok(()));
+                        registration
+                    }
+                    Err(e) => {
+                        let _ = tx.send(Err(Error::CriticalError(format!(
+                            "Failed to register hotplug callback: {e}"
+                        ))));
+                        return;
+                    }
+                };
+                let mut known: Vec<HotplugKey> = Vec::new();
+                let mut last_change: Option<Instant> = None;
+                while !shutdown.load(Ordering::Relaxed) {
+                    let _ = context.handle_events(Some(HOTPLUG_POLL_INTERVAL));
+                    if changed.swap(false, Ordering::SeqCst) {
+                        last_change = Some(Instant::now());
+                    }
+                    match last_change {
+                        Some(time) if time.elapsed() >= HOTPLUG_SETTLE_TIME => last_change = None,
+                        _ => continue,
+                    }
+                    let Ok(devices) = find_neovi_mics() else {
+                        continue;
+                    };
+                    // Wait for the FT245R before reporting, it carries the serial number
+                    let devices: Vec<NeoVIMIC> = devices
+                        .into_iter()
+                        .filter(|d| d.get_usb_io_info().is_some())
+                        .collect();
+                    let found: Vec<HotplugKey> = devices.iter().map(HotplugKey::from).collect();
+                    let (arrived, left) = diff(&mut known, &found);
+                    for key in left {
+                        callback(HotplugEvent::Left {
+                            usb_hub: key.usb_hub,
+                            serial_number: key.serial_number,
+                        });
+                    }
+                    for (i, device) in devices.into_iter().enumerate() {
+                        if arrived.contains(&i) {
+                            known.push(found[i].clone());
+                            callback(HotplugEvent::Arrived(Box::new(device)));
+                        }
+                    }
+                }
+            })
+        };
+        match rx.recv() {
+            Ok(Ok(())) => Ok(Self {
+                shutdown,
+                thread: Some(thread),
+            }),
+            Ok(Err(e)) => {
+                let _ = thread.join();
+                Err(e)
+            }
+            Err(_) => {
+                let _ = thread.join();
+                Err(Error::CriticalError("Hotplug thread exited".into()))
+            }
+        }
+    }
+
+    /// Stop the monitor thread, no callbacks are made after this returns.
+    pub fn stop(&mut self) {
+        self.shutdown.store(true, Ordering::Relaxed);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+impl Drop for HotplugMonitor {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn key(address: u8, serial_number: &str) -> HotplugKey {
+        HotplugKey {
+            usb_hub: UsbDeviceInfo {
+                address,
+                ..Default::default()
+            },
+            serial_number: serial_number.into(),
+        }
+    }
+
+    #[test]
+    fn test_diff() {
+        let mut known = Vec::new();
+        let found = [key(1, "MC0001"), key(2, "MC0002")];
+        assert_eq!(diff(&mut known, &found), (vec![0, 1], vec![]));
+        known.extend(found);
+        // MC0001 replugged to a new address, MC0002 unplugged
+        let found = [key(3, "MC0001")];
+        let (arrived, left) = diff(&mut known, &found);
+        assert_eq!(arrived, [0]);
+        assert_eq!(left, [key(1, "MC0001"), key(2, "MC0002")]);
+        assert!(known.is_empty());
+    }
+}
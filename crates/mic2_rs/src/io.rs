@@ -1,6 +1,18 @@
-use std::cell::RefCell;
+use std::{
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc, Mutex,
+    },
+    thread::JoinHandle,
+    time::{Duration, Instant},
+};
 
-use crate::{mic::UsbDeviceInfo, types::Result};
+use crate::{
+    mic::UsbDeviceInfo,
+    reactor::{ReactorHandle, Registration},
+    stats::{self, IOStats, IOStatsSnapshot},
+    types::{monotonic_time_ns, Error, Result},
+};
 use enumflags2::{bitflags, BitFlags};
 use libftdi1_sys::{
     ftdi_context, ftdi_new, ftdi_read_pins, ftdi_set_bitmode, ftdi_usb_close,
@@ -32,25 +44,244 @@ impl IOBitMode {
         // TODO: This should handle unwrap better
         Ok(BitFlags::<Self>::from_bits(value).unwrap())
     }
+
+    /// CBUS lines that drive an output, the Button is always an input.
+    pub fn outputs() -> BitFlags<Self> {
+        Self::Buzzer | Self::GPSLed | Self::CBUS3
+    }
+
+    /// Bitmode for [IO::set_bitmode] driving the lines in outputs to values, every other line is
+    /// configured as an input.
+    pub fn output_bitmode(
+        outputs: BitFlags<Self>,
+        values: BitFlags<Self>,
+    ) -> Result<BitFlags<Self>> {
+        if !Self::outputs().contains(outputs) {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Only Buzzer, GPSLed and CBUS3 can be outputs",
+            )
+            .into());
+        }
+        // The mask bits sit 4 bits above their line
+        let masks = BitFlags::<Self>::from_bits_truncate(outputs.bits() << 4);
+        Ok(masks | (values & outputs))
+    }
+}
+
+/// Last known level of the output lines, see [IO::output_state].
+#[derive(Debug, Clone, Copy, PartialEq)]
+struct OutputShadow {
+    levels: BitFlags<IOBitMode>,
+    updated: Instant,
+}
+
+/// ftdi_context shared with the button monitor thread. libftdi isn't thread safe so every call
+/// goes through [FtdiContext::with].
+#[derive(Debug)]
+struct FtdiContext {
+    context: *mut ftdi_context,
+    lock: Mutex<()>,
+    stats: IOStats,
+}
+
+// All access to context is serialized by lock.
+unsafe impl Send for FtdiContext {}
+unsafe impl Sync for FtdiContext {}
+
+impl FtdiContext {
+    fn new(context: *mut ftdi_context) -> Arc<Self> {
+        Arc::new(Self {
+            context,
+            lock: Mutex::new(()),
+            stats: IOStats::default(),
+        })
+    }
+
+    fn with<T>(&self, f: impl FnOnce(*mut ftdi_context) -> T) -> T {
+        let lock_start_ns = monotonic_time_ns();
+        let _lock = self.lock.lock().unwrap();
+        stats::add(
+            &self.stats.lock_wait_ns,
+            monotonic_time_ns().saturating_sub(lock_start_ns),
+        );
+        stats::add(&self.stats.transfers, 1);
+        f(self.context)
+    }
+
+    fn read_pins(&self) -> Result<u8> {
+        let mut pins: u8 = 0;
+        let result = self.with(|context| unsafe { ftdi_read_pins(context, &mut pins) });
+        let error_code: String = match result {
+            0 => "all fine".into(),
+            -1 => "read pins failed".into(),
+            -2 => "USB device unavailable".into(),
+            _ => format!("Unknown error code: {result}"),
+        };
+        if result != 0 {
+            return Err(crate::types::Error::CriticalError(error_code));
+        };
+        // the bitbang_cbus.c example has all the mask values masked, I'm guessing it doesn't
+        // read back correctly.
+        Ok(pins & 0xf)
+    }
 }
 
-#[derive(Debug, Clone, PartialEq)]
+/// Edge of the button input, see [IO::button_monitor_start].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum ButtonEdge {
+    Pressed,
+    Released,
+}
+
+/// Debounced button change, see [IO::button_monitor_start].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct ButtonEvent {
+    pub edge: ButtonEdge,
+    /// Host monotonic time of the first sample in the new state (ns), see [monotonic_time_ns].
+    pub monotonic_time_ns: u64,
+}
+
+/// Called from the button monitor thread for every debounced edge.
+pub type ButtonEventCallback = Box<dyn FnMut(ButtonEvent) + Send>;
+
+/// Reports a change once the input has held its new level for the debounce time.
+#[derive(Debug)]
+struct Debouncer {
+    debounce_ns: u64,
+    /// Last reported level, None until the first sample
+    stable: Option<bool>,
+    /// Level of the latest samples and when it was first seen
+    candidate: bool,
+    candidate_since_ns: u64,
+}
+
+impl Debouncer {
+    fn new(debounce: Duration) -> Self {
+        Self {
+            debounce_ns: debounce.as_nanos() as u64,
+            stable: None,
+            candidate: false,
+            candidate_since_ns: 0,
+        }
+    }
+
+    fn update(&mut self, pressed: bool, now_ns: u64) -> Option<ButtonEvent> {
+        let Some(stable) = self.stable else {
+            // The button may already be held down when monitoring starts, that isn't an edge
+            self.stable = Some(pressed);
+            self.candidate = pressed;
+            return None;
+        };
+        if pressed != self.candidate {
+            self.candidate = pressed;
+            self.candidate_since_ns = now_ns;
+        }
+        if self.candidate == stable
+            || now_ns.saturating_sub(self.candidate_since_ns) < self.debounce_ns
+        {
+            return None;
+        }
+        self.stable = Some(self.candidate);
+        Some(ButtonEvent {
+            edge: if self.candidate {
+                ButtonEdge::Pressed
+            } else {
+                ButtonEdge::Released
+            },
+            monotonic_time_ns: self.candidate_since_ns,
+        })
+    }
+}
+
+/// Read the button once and report a debounced edge.
+fn sample_button(
+    context: &FtdiContext,
+    debouncer: &mut Debouncer,
+    pressed: &Mutex<Option<bool>>,
+    callback: &mut ButtonEventCallback,
+) {
+    // A failed read is skipped, close() stops the monitor before the device goes away
+    if let Ok(pins) = context.read_pins() {
+        let event = debouncer.update(pins & IOBitMode::Button as u8 != 0, monotonic_time_ns());
+        *pressed.lock().unwrap() = debouncer.stable;
+        if let Some(event) = event {
+            callback(event);
+        }
+    }
+}
+
+/// Background thread or reactor timer sampling the button, see [IO::button_monitor_start].
+#[derive(Debug)]
+struct ButtonMonitor {
+    shutdown: Arc<AtomicBool>,
+    thread: Option<JoinHandle<()>>,
+    /// Removed from the reactor when dropped
+    _registration: Option<Registration>,
+    /// Debounced button level, None until the first sample
+    pressed: Arc<Mutex<Option<bool>>>,
+}
+
+impl Drop for ButtonMonitor {
+    fn drop(&mut self) {
+        self.shutdown.store(true, Ordering::Relaxed);
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+#[derive(Debug)]
 pub struct IO {
     usb_device_info: UsbDeviceInfo,
-    context: RefCell<*mut ftdi_context>,
-    is_open: RefCell<bool>,
+    context: Arc<FtdiContext>,
+    is_open: AtomicBool,
+    /// Output levels from the last bitmode written or pins read, None until either happened since open
+    outputs: Mutex<Option<OutputShadow>>,
+    /// How old outputs can get before output_state() reads the pins again, None to always trust it
+    revalidate_interval: Mutex<Option<Duration>>,
+    button_monitor: Mutex<Option<ButtonMonitor>>,
+    /// Samples the button instead of a monitor thread if set, see [IO::set_reactor].
+    reactor: Mutex<Option<ReactorHandle>>,
 }
 
 impl Default for IO {
     fn default() -> Self {
         Self {
             usb_device_info: UsbDeviceInfo::default(),
-            context: RefCell::new(std::ptr::null_mut()),
-            is_open: RefCell::new(false),
+            context: FtdiContext::new(std::ptr::null_mut()),
+            is_open: AtomicBool::new(false),
+            outputs: Mutex::new(None),
+            revalidate_interval: Mutex::new(None),
+            button_monitor: Mutex::new(None),
+            reactor: Mutex::new(None),
+        }
+    }
+}
+
+impl Clone for IO {
+    /// Clones share the ftdi context, the button monitor stays with the original.
+    fn clone(&self) -> Self {
+        Self {
+            usb_device_info: self.usb_device_info.clone(),
+            context: self.context.clone(),
+            is_open: AtomicBool::new(self.is_open()),
+            outputs: Mutex::new(*self.outputs.lock().unwrap()),
+            revalidate_interval: Mutex::new(*self.revalidate_interval.lock().unwrap()),
+            button_monitor: Mutex::new(None),
+            reactor: Mutex::new(self.reactor.lock().unwrap().clone()),
         }
     }
 }
 
+impl PartialEq for IO {
+    fn eq(&self, other: &Self) -> bool {
+        self.usb_device_info == other.usb_device_info
+            && self.context.context == other.context.context
+            && self.is_open() == other.is_open()
+    }
+}
+
 impl Drop for IO {
     fn drop(&mut self) {
         let _ = self.close();
@@ -67,23 +298,36 @@ impl IO {
         }
         Ok(Self {
             usb_device_info,
-            context: RefCell::new(context),
-            is_open: RefCell::new(false),
+            context: FtdiContext::new(context),
+            is_open: AtomicBool::new(false),
+            outputs: Mutex::new(None),
+            revalidate_interval: Mutex::new(None),
+            button_monitor: Mutex::new(None),
+            reactor: Mutex::new(None),
         })
     }
 
     pub fn is_open(&self) -> bool {
-        *self.is_open.borrow()
+        self.is_open.load(Ordering::SeqCst)
+    }
+
+    /// FT245R transfer counters, see [IOStatsSnapshot]. Shared by clones of this IO.
+    pub fn stats(&self) -> IOStatsSnapshot {
+        self.context.stats.snapshot()
+    }
+
+    pub fn stats_reset(&self) {
+        self.context.stats.reset();
     }
 
     pub fn open(&self) -> Result<()> {
-        let result = unsafe {
+        let result = self.context.with(|context| unsafe {
             ftdi_usb_open_bus_addr(
-                *self.context.borrow_mut(),
+                context,
                 self.usb_device_info.bus_number,
                 self.usb_device_info.address,
             )
-        };
+        });
         let error_code: String = match result {
             0 => "all fine".into(),
             -1 => "usb_find_busses() failed".into(),
@@ -103,12 +347,16 @@ impl IO {
         if result != 0 {
             return Err(crate::types::Error::CriticalError(error_code));
         };
-        *self.is_open.borrow_mut() = true;
+        self.is_open.store(true, Ordering::SeqCst);
+        *self.outputs.lock().unwrap() = None;
         Ok(())
     }
 
     pub fn close(&self) -> Result<()> {
-        let result = unsafe { ftdi_usb_close(*self.context.borrow_mut()) };
+        self.button_monitor_stop();
+        let result = self
+            .context
+            .with(|context| unsafe { ftdi_usb_close(context) });
         let error_code: String = match result {
             0 => "all fine".into(),
             -1 => "usb_release failed".into(),
@@ -118,7 +366,8 @@ impl IO {
         if result != 0 {
             return Err(crate::types::Error::CriticalError(error_code));
         };
-        *self.is_open.borrow_mut() = false;
+        self.is_open.store(false, Ordering::SeqCst);
+        *self.outputs.lock().unwrap() = None;
         Ok(())
     }
 
@@ -132,16 +381,16 @@ impl IO {
     /// CBUS3 = N/C
     ///
     pub fn set_bitmode_raw(&self, bitmask: u8) -> Result<()> {
-        let result = unsafe {
+        let result = self.context.with(|context| unsafe {
             ftdi_set_bitmode(
-                *self.context.borrow_mut(),
+                context,
                 bitmask,
                 libftdi1_sys::ftdi_mpsse_mode::BITMODE_CBUS
                     .0
                     .try_into()
                     .unwrap(),
             )
-        };
+        });
         let error_code: String = match result {
             0 => "all fine".into(),
             -1 => "can't enable bitbang mode".into(),
@@ -151,6 +400,9 @@ impl IO {
         if result != 0 {
             return Err(crate::types::Error::CriticalError(error_code));
         };
+        // Lines with their mask bit clear are inputs and aren't driven
+        let outputs = BitFlags::<IOBitMode>::from_bits_truncate(bitmask >> 4);
+        self.update_outputs(BitFlags::<IOBitMode>::from_bits_truncate(bitmask) & outputs);
         Ok(())
     }
 
@@ -175,20 +427,8 @@ impl IO {
     /// CBUS3 = N/C
     ///
     pub fn read_pins_raw(&self) -> Result<u8> {
-        let mut pins: u8 = 0;
-        let result = unsafe { ftdi_read_pins(*self.context.borrow_mut(), &mut pins) };
-        let error_code: String = match result {
-            0 => "all fine".into(),
-            -1 => "read pins failed".into(),
-            -2 => "USB device unavailable".into(),
-            _ => format!("Unknown error code: {result}"),
-        };
-        if result != 0 {
-            return Err(crate::types::Error::CriticalError(error_code));
-        };
-        // the bitbang_cbus.c example has all the mask values masked, I'm guessing it doesn't
-        // read back correctly.
-        pins &= 0xf;
+        let pins = self.context.read_pins()?;
+        self.update_outputs(BitFlags::<IOBitMode>::from_bits_truncate(pins));
         Ok(pins)
     }
 
@@ -196,11 +436,234 @@ impl IO {
         Ok(BitFlags::<IOBitMode>::from_bits(self.read_pins_raw()?).unwrap())
     }
 
+    /// Drive every line in outputs to its state in values with a single [IO::set_bitmode_raw],
+    /// lines not in outputs are configured as inputs. See [IOBitMode::output_bitmode].
+    pub fn write_outputs(
+        &self,
+        outputs: BitFlags<IOBitMode>,
+        values: BitFlags<IOBitMode>,
+    ) -> Result<()> {
+        self.set_bitmode(IOBitMode::output_bitmode(outputs, values)?)
+    }
+
+    fn update_outputs(&self, levels: BitFlags<IOBitMode>) {
+        *self.outputs.lock().unwrap() = Some(OutputShadow {
+            levels: levels & IOBitMode::outputs(),
+            updated: Instant::now(),
+        });
+    }
+
+    /// Level of the Buzzer, GPS LED and CBUS3 outputs. Answered from the last bitmode written or
+    /// pins read without a USB transfer, the pins are only read when nothing is known since
+    /// [IO::open] or the last update is older than [IO::set_revalidate_interval].
+    pub fn output_state(&self) -> Result<BitFlags<IOBitMode>> {
+        let shadow = *self.outputs.lock().unwrap();
+        let interval = *self.revalidate_interval.lock().unwrap();
+        match shadow {
+            Some(shadow) if interval.is_none_or(|i| shadow.updated.elapsed() < i) => {
+                Ok(shadow.levels)
+            }
+            _ => Ok(self.read_pins()? & IOBitMode::outputs()),
+        }
+    }
+
+    /// Last known levels of the IO lines without a USB transfer, and which lines they are known
+    /// for. Outputs are known once written or read since [IO::open], the Button while a
+    /// [IO::button_monitor_start] monitor runs and has sampled it.
+    pub fn cached_state(&self) -> (BitFlags<IOBitMode>, BitFlags<IOBitMode>) {
+        let (mut levels, mut known) = match *self.outputs.lock().unwrap() {
+            Some(shadow) => (shadow.levels, IOBitMode::outputs()),
+            None => (BitFlags::empty(), BitFlags::empty()),
+        };
+        let pressed = self
+            .button_monitor
+            .lock()
+            .unwrap()
+            .as_ref()
+            .and_then(|monitor| *monitor.pressed.lock().unwrap());
+        if let Some(pressed) = pressed {
+            known |= IOBitMode::Button;
+            if pressed {
+                levels |= IOBitMode::Button;
+            }
+        }
+        (levels, known)
+    }
+
+    /// Read the pins again in [IO::output_state] once the known levels are older than interval,
+    /// in case something else drives the lines. None, the default, trusts them until closed.
+    pub fn set_revalidate_interval(&self, interval: Option<Duration>) {
+        *self.revalidate_interval.lock().unwrap() = interval;
+    }
+
+    /// Sample the button every sample_interval on a background thread and call callback with
+    /// every press and release that holds for debounce. Replaces a running monitor,
+    /// [IO::close] stops it.
+    pub fn button_monitor_start(
+        &self,
+        sample_interval: Duration,
+        debounce: Duration,
+        mut callback: ButtonEventCallback,
+    ) -> Result<()> {
+        if !self.is_open() {
+            return Err(Error::InvalidDevice("IO device is not open".into()));
+        }
+        if sample_interval.is_zero() {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "sample_interval must be greater than zero",
+            )
+            .into());
+        }
+        self.button_monitor_stop();
+        let pressed = Arc::new(Mutex::new(None));
+        let reactor = self.reactor.lock().unwrap().clone();
+        if let Some(reactor) = reactor {
+            let context = self.context.clone();
+            let mut debouncer = Debouncer::new(debounce);
+            let registration = {
+                let pressed = pressed.clone();
+                reactor.add_timer(
+                    sample_interval,
+                    Box::new(move || {
+                        sample_button(&context, &mut debouncer, &pressed, &mut callback);
+                        true
+                    }),
+                )?
+            };
+            *self.button_monitor.lock().unwrap() = Some(ButtonMonitor {
+                shutdown: Arc::new(AtomicBool::new(false)),
+                thread: None,
+                _registration: Some(registration),
+                pressed,
+            });
+            return Ok(());
+        }
+        let shutdown = Arc::new(AtomicBool::new(false));
+        let thread = {
+            let shutdown = shutdown.clone();
+            let context = self.context.clone();
+            let pressed = pressed.clone();
+            std::thread::spawn(move || {
+                let mut debouncer = Debouncer::new(debounce);
+                let mut next_sample = Instant::now();
+                while !shutdown.load(Ordering::Relaxed) {
+                    sample_button(&context, &mut debouncer, &pressed, &mut callback);
+                    // Keep a steady sample rate regardless of how long the read took
+                    next_sample += sample_interval;
+                    let now = Instant::now();
+                    if next_sample > now {
+                        std::thread::sleep(next_sample - now);
+                    } else {
+                        next_sample = now;
+                    }
+                }
+            })
+        };
+        *self.button_monitor.lock().unwrap() = Some(ButtonMonitor {
+            shutdown,
+            thread: Some(thread),
+            _registration: None,
+            pressed,
+        });
+        Ok(())
+    }
+
+    /// Sample the button from `reactor` instead of a monitor thread of its own, starting with
+    /// the next [IO::button_monitor_start]. None goes back to a monitor thread. The callback
+    /// then runs on the reactor thread and holds up every other device on it.
+    pub fn set_reactor(&self, reactor: Option<ReactorHandle>) {
+        *self.reactor.lock().unwrap() = reactor;
+    }
+
+    /// Stop the button monitor, no callbacks are made after this returns.
+    pub fn button_monitor_stop(&self) {
+        // Dropping joins the thread
+        let _ = self.button_monitor.lock().unwrap().take();
+    }
+
+    pub fn button_monitor_is_running(&self) -> bool {
+        self.button_monitor.lock().unwrap().is_some()
+    }
+
     pub fn get_usb_device_info(&self) -> &UsbDeviceInfo {
         &self.usb_device_info
     }
 }
 
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_output_bitmode() {
+        assert_eq!(
+            IOBitMode::output_bitmode(
+                IOBitMode::Buzzer | IOBitMode::GPSLed,
+                IOBitMode::GPSLed.into()
+            )
+            .unwrap(),
+            IOBitMode::BuzzerMask | IOBitMode::GPSLedMask | IOBitMode::GPSLed
+        );
+        // Values outside of outputs are ignored
+        assert_eq!(
+            IOBitMode::output_bitmode(IOBitMode::Buzzer.into(), IOBitMode::GPSLed.into()).unwrap(),
+            IOBitMode::BuzzerMask
+        );
+        assert!(IOBitMode::output_bitmode(IOBitMode::Button.into(), BitFlags::empty()).is_err());
+    }
+
+    #[test]
+    fn test_debouncer() {
+        let ms = |ms: u64| ms * 1_000_000;
+        let mut debouncer = Debouncer::new(Duration::from_millis(20));
+        // Held at start isn't an edge
+        assert_eq!(debouncer.update(true, ms(0)), None);
+        // Bounce shorter than the debounce time is ignored
+        assert_eq!(debouncer.update(false, ms(10)), None);
+        assert_eq!(debouncer.update(true, ms(15)), None);
+        assert_eq!(debouncer.update(false, ms(40)), None);
+        assert_eq!(debouncer.update(false, ms(50)), None);
+        assert_eq!(
+            debouncer.update(false, ms(60)),
+            Some(ButtonEvent {
+                edge: ButtonEdge::Released,
+                monotonic_time_ns: ms(40)
+            })
+        );
+        assert_eq!(debouncer.update(false, ms(70)), None);
+        assert_eq!(debouncer.update(true, ms(80)), None);
+        assert_eq!(
+            debouncer.update(true, ms(100)),
+            Some(ButtonEvent {
+                edge: ButtonEdge::Pressed,
+                monotonic_time_ns: ms(80)
+            })
+        );
+    }
+
+    #[test]
+    fn test_output_state() {
+        let io = IO::default();
+        io.update_outputs(IOBitMode::Buzzer | IOBitMode::Button);
+        // Button is an input and never part of the outputs
+        assert_eq!(io.output_state().unwrap(), IOBitMode::Buzzer);
+        io.set_revalidate_interval(Some(Duration::from_secs(60)));
+        assert_eq!(io.output_state().unwrap(), IOBitMode::Buzzer);
+    }
+
+    #[test]
+    fn test_cached_state() {
+        let io = IO::default();
+        assert_eq!(io.cached_state(), (BitFlags::empty(), BitFlags::empty()));
+        io.update_outputs(IOBitMode::GPSLed.into());
+        assert_eq!(
+            io.cached_state(),
+            (IOBitMode::GPSLed.into(), IOBitMode::outputs())
+        );
+    }
+}
+
 #[cfg(test)]
 #[cfg(not(feature = "_skip-hil-testing"))]
 mod tests_hil {
@@ -253,6 +716,16 @@ mod tests_hil {
                 "Expected GPS LED to be disabled!"
             );
 
+            // Test both outputs in one transfer
+            device.io_write_state(
+                IOBitMode::Buzzer | IOBitMode::GPSLed,
+                IOBitMode::GPSLed.into(),
+            )?;
+            std::thread::sleep(std::time::Duration::from_secs_f64(0.1f64));
+            let state = device.io_read_state()?;
+            assert!(state.contains(IOBitMode::GPSLed) && !state.contains(IOBitMode::Buzzer));
+            device.io_write_state(IOBitMode::Buzzer | IOBitMode::GPSLed, BitFlags::empty())?;
+
             // Test button
             assert!(!device.io_button_is_pressed()?);
 
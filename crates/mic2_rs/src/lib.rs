@@ -1,17 +1,31 @@
+pub mod reactor;
+pub mod ring;
+pub mod stats;
 pub mod types;
 
+#[cfg(feature = "gps")]
+pub mod fixlog;
+#[cfg(feature = "gps")]
+pub mod framer;
 #[cfg(feature = "gps")]
 pub mod gps;
 #[cfg(feature = "gps")]
+pub mod metrics;
+#[cfg(feature = "gps")]
 pub mod nmea;
 #[cfg(feature = "gps")]
 pub mod ubx;
 
+#[cfg(feature = "audio")]
+pub mod analysis;
 #[cfg(feature = "audio")]
 pub mod audio;
+#[cfg(feature = "audio")]
+pub mod wav;
 
 #[cfg(feature = "io")]
 pub mod io;
 
+pub mod hotplug;
 pub mod mic;
 pub use mic::*;
@@ -0,0 +1,518 @@
+//! Values derived from every position update by the GPS reader thread, see
+//! [crate::gps::GPSDevice::metrics_start].
+//!
+//! Every consumer used to convert the DMS coordinates and recompute distances, speed and
+//! geofence membership on its own. [MetricsEngine] evaluates each fix once when it arrives
+//! and consumers read the result with [crate::gps::GPSDevice::metrics].
+use std::collections::HashMap;
+
+use crate::{
+    nmea::types::{GPSFix, GpsNavigationStatus},
+    types::Result,
+};
+
+/// WGS84 semi-major axis (m)
+const WGS84_A: f64 = 6_378_137.0;
+/// WGS84 first eccentricity squared
+const WGS84_E2: f64 = 6.694_379_990_14e-3;
+/// Mean earth radius used for great-circle distances (m)
+const EARTH_RADIUS_M: f64 = 6_371_008.8;
+/// Size of a geofence index cell in degrees, about 11 km of latitude.
+const GEOFENCE_CELL_DEG: f64 = 0.1;
+/// Index cells around a parallel, longitudes 360 degrees apart share a cell.
+const GEOFENCE_LON_CELLS: i64 = (360.0 / GEOFENCE_CELL_DEG) as i64;
+/// Geofences covering more cells than this are checked on every fix instead of indexed.
+const GEOFENCE_MAX_CELLS: i64 = 4096;
+
+/// Earth-centered, earth-fixed coordinates (m) of a WGS84 position in decimal degrees.
+pub fn geodetic_to_ecef(latitude: f64, longitude: f64, altitude: f64) -> [f64; 3] {
+    let (lat, lon) = (latitude.to_radians(), longitude.to_radians());
+    let n = WGS84_A / (1.0 - WGS84_E2 * lat.sin().powi(2)).sqrt();
+    [
+        (n + altitude) * lat.cos() * lon.cos(),
+        (n + altitude) * lat.cos() * lon.sin(),
+        (n * (1.0 - WGS84_E2) + altitude) * lat.sin(),
+    ]
+}
+
+/// Great-circle distance (m) between two positions in decimal degrees, haversine formula.
+pub fn distance_m(from: (f64, f64), to: (f64, f64)) -> f64 {
+    let (lat1, lat2) = (from.0.to_radians(), to.0.to_radians());
+    let d_lat = lat2 - lat1;
+    let d_lon = (to.1 - from.1).to_radians();
+    let h = (d_lat / 2.0).sin().powi(2) + lat1.cos() * lat2.cos() * (d_lon / 2.0).sin().powi(2);
+    2.0 * EARTH_RADIUS_M * h.sqrt().min(1.0).asin()
+}
+
+/// Tuning of a [MetricsEngine].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct MetricsConfig {
+    /// How fast the velocity is expected to change, variance growth per second ((m/s)^2/s).
+    /// Larger follows the receiver closer, smaller smooths more.
+    pub velocity_process_noise: f64,
+    /// Variance of the velocity reported by the receiver ((m/s)^2)
+    pub velocity_measurement_noise: f64,
+}
+
+impl Default for MetricsConfig {
+    fn default() -> Self {
+        Self {
+            velocity_process_noise: 1.0,
+            velocity_measurement_noise: 0.25,
+        }
+    }
+}
+
+impl MetricsConfig {
+    /// Returns an error if a noise isn't a positive number.
+    pub fn validate(&self) -> Result<()> {
+        let valid = |noise: f64| noise.is_finite() && noise > 0.0;
+        if !valid(self.velocity_process_noise) || !valid(self.velocity_measurement_noise) {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "Velocity noise has to be a positive number",
+            )
+            .into());
+        }
+        Ok(())
+    }
+}
+
+/// Result of the latest fix, see [MetricsEngine::metrics].
+#[derive(Debug, Default, Clone, PartialEq)]
+pub struct FixMetrics {
+    /// Latest position update, with decimal degree coordinates
+    pub fix: GPSFix,
+    /// ECEF coordinates of fix (m), None without a position
+    pub ecef: Option<[f64; 3]>,
+    /// Distance travelled between fixes with a position (m), see [MetricsEngine::reset_odometer]
+    pub odometer_m: f64,
+    /// Smoothed velocity north and east (m/s), None until the receiver reported a speed and course
+    pub velocity_ne: Option<(f64, f64)>,
+    /// Ids of the geofences containing fix, ascending
+    pub geofences: Vec<u32>,
+    /// Position updates evaluated
+    pub fixes: u64,
+}
+
+impl FixMetrics {
+    /// Smoothed speed over ground (m/s)
+    pub fn speed_mps(&self) -> Option<f64> {
+        self.velocity_ne.map(|(north, east)| north.hypot(east))
+    }
+
+    /// Smoothed course over ground (degrees, 0 to 360)
+    pub fn course_deg(&self) -> Option<f64> {
+        self.velocity_ne
+            .map(|(north, east)| east.atan2(north).to_degrees().rem_euclid(360.0))
+    }
+}
+
+/// Polygon of (latitude, longitude) vertices in decimal degrees. Longitudes are unwrapped so
+/// every edge takes the shorter way around, an edge crossing the antimeridian continues past
+/// 180 instead of jumping back to -180.
+#[derive(Debug, Clone)]
+struct Geofence {
+    vertices: Vec<(f64, f64)>,
+    /// (min latitude, min longitude, max latitude, max longitude), min longitude is within
+    /// -180 to 180 while max longitude can reach 540
+    bounds: (f64, f64, f64, f64),
+}
+
+impl Geofence {
+    /// None if the polygon circles a pole, the edges then don't close without wrapping around.
+    fn new(vertices: &[(f64, f64)]) -> Option<Self> {
+        let mut unwrapped = Vec::with_capacity(vertices.len());
+        let mut previous = vertices[0].1;
+        for &(latitude, longitude) in vertices {
+            let longitude = previous + (longitude - previous + 180.0).rem_euclid(360.0) - 180.0;
+            unwrapped.push((latitude, longitude));
+            previous = longitude;
+        }
+        if (unwrapped[0].1 - previous).abs() > 180.0 {
+            return None;
+        }
+        let (min_lat, mut min_lon, max_lat, mut max_lon) = unwrapped.iter().fold(
+            (f64::MAX, f64::MAX, f64::MIN, f64::MIN),
+            |(min_lat, min_lon, max_lat, max_lon), &(lat, lon)| {
+                (
+                    min_lat.min(lat),
+                    min_lon.min(lon),
+                    max_lat.max(lat),
+                    max_lon.max(lon),
+                )
+            },
+        );
+        if min_lon < -180.0 {
+            for vertex in &mut unwrapped {
+                vertex.1 += 360.0;
+            }
+            (min_lon, max_lon) = (min_lon + 360.0, max_lon + 360.0);
+        }
+        Some(Self {
+            vertices: unwrapped,
+            bounds: (min_lat, min_lon, max_lat, max_lon),
+        })
+    }
+
+    fn contains(&self, (latitude, longitude): (f64, f64)) -> bool {
+        let max_lon = self.bounds.3;
+        self.contains_unwrapped((latitude, longitude))
+            || (max_lon > 180.0 && self.contains_unwrapped((latitude, longitude + 360.0)))
+    }
+
+    /// Even-odd rule, points on an edge may fall either way.
+    fn contains_unwrapped(&self, (latitude, longitude): (f64, f64)) -> bool {
+        let (min_lat, min_lon, max_lat, max_lon) = self.bounds;
+        if latitude < min_lat || latitude > max_lat || longitude < min_lon || longitude > max_lon {
+            return false;
+        }
+        let mut inside = false;
+        let mut previous = self.vertices[self.vertices.len() - 1];
+        for &vertex in &self.vertices {
+            if (vertex.0 > latitude) != (previous.0 > latitude) {
+                let crossing = vertex.1
+                    + (latitude - vertex.0) * (previous.1 - vertex.1) / (previous.0 - vertex.0);
+                if longitude < crossing {
+                    inside = !inside;
+                }
+            }
+            previous = vertex;
+        }
+        inside
+    }
+}
+
+/// Geofences bucketed by the grid cells their bounds cover, so a fix is only tested against
+/// the few geofences near it.
+#[derive(Debug, Default, Clone)]
+struct GeofenceIndex {
+    geofences: HashMap<u32, Geofence>,
+    cells: HashMap<(i64, i64), Vec<u32>>,
+    /// Geofences too large to index
+    unindexed: Vec<u32>,
+    next_id: u32,
+}
+
+/// Unwrapped cell of a position, see [wrap_cell].
+fn cell(latitude: f64, longitude: f64) -> (i64, i64) {
+    (
+        (latitude / GEOFENCE_CELL_DEG).floor() as i64,
+        (longitude / GEOFENCE_CELL_DEG).floor() as i64,
+    )
+}
+
+/// Index key of a cell, the same for longitudes 360 degrees apart.
+fn wrap_cell((lat, lon): (i64, i64)) -> (i64, i64) {
+    (lat, lon.rem_euclid(GEOFENCE_LON_CELLS))
+}
+
+impl GeofenceIndex {
+    /// Cells covered by bounds, None if there are too many of them.
+    fn cover(bounds: (f64, f64, f64, f64)) -> Option<Vec<(i64, i64)>> {
+        let (low, high) = (cell(bounds.0, bounds.1), cell(bounds.2, bounds.3));
+        if (high.0 - low.0 + 1) * (high.1 - low.1 + 1) > GEOFENCE_MAX_CELLS {
+            return None;
+        }
+        Some(
+            (low.0..=high.0)
+                .flat_map(|lat| (low.1..=high.1).map(move |lon| wrap_cell((lat, lon))))
+                .collect(),
+        )
+    }
+
+    fn add(&mut self, vertices: &[(f64, f64)]) -> Result<u32> {
+        let valid = |&(latitude, longitude): &(f64, f64)| {
+            (-90.0..=90.0).contains(&latitude) && (-180.0..=180.0).contains(&longitude)
+        };
+        if vertices.len() < 3 || !vertices.iter().all(valid) {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "A geofence needs at least 3 vertices in decimal degrees",
+            )
+            .into());
+        }
+        let Some(geofence) = Geofence::new(vertices) else {
+            return Err(std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                "A geofence can't circle a pole",
+            )
+            .into());
+        };
+        let id = self.next_id;
+        self.next_id += 1;
+        match Self::cover(geofence.bounds) {
+            Some(cells) => {
+                for cell in cells {
+                    self.cells.entry(cell).or_default().push(id);
+                }
+            }
+            None => self.unindexed.push(id),
+        }
+        self.geofences.insert(id, geofence);
+        Ok(id)
+    }
+
+    fn remove(&mut self, id: u32) -> bool {
+        let Some(geofence) = self.geofences.remove(&id) else {
+            return false;
+        };
+        match Self::cover(geofence.bounds) {
+            Some(cells) => {
+                for cell in cells {
+                    if let Some(ids) = self.cells.get_mut(&cell) {
+                        ids.retain(|&i| i != id);
+                        if ids.is_empty() {
+                            self.cells.remove(&cell);
+                        }
+                    }
+                }
+            }
+            None => self.unindexed.retain(|&i| i != id),
+        }
+        true
+    }
+
+    /// Ids of the geofences containing position, ascending.
+    fn containing(&self, position: (f64, f64)) -> Vec<u32> {
+        let nearby = self.cells.get(&wrap_cell(cell(position.0, position.1)));
+        let mut ids: Vec<u32> = nearby
+            .into_iter()
+            .flatten()
+            .chain(&self.unindexed)
+            .copied()
+            .filter(|id| self.geofences[id].contains(position))
+            .collect();
+        ids.sort_unstable();
+        ids
+    }
+}
+
+/// Kalman filter of the north and east velocity, both axes share the same variance since they
+/// use the same noise.
+#[derive(Debug, Clone, Copy)]
+struct VelocityFilter {
+    velocity_ne: (f64, f64),
+    variance: f64,
+    monotonic_time_ns: u64,
+}
+
+/// Turns position updates into [FixMetrics], see [crate::gps::GPSDevice::metrics_start].
+#[derive(Debug, Default, Clone)]
+pub struct MetricsEngine {
+    config: MetricsConfig,
+    metrics: FixMetrics,
+    /// Last position counted by the odometer
+    odometer_position: Option<(f64, f64)>,
+    velocity: Option<VelocityFilter>,
+    geofences: GeofenceIndex,
+}
+
+impl MetricsEngine {
+    pub fn new(config: MetricsConfig) -> Result<Self> {
+        config.validate()?;
+        Ok(Self {
+            config,
+            ..Default::default()
+        })
+    }
+
+    /// Change the tuning, the odometer, velocity and geofences are kept.
+    pub fn set_config(&mut self, config: MetricsConfig) -> Result<()> {
+        config.validate()?;
+        self.config = config;
+        Ok(())
+    }
+
+    /// Evaluate a position update.
+    pub fn update(&mut self, fix: &GPSFix) {
+        self.metrics.fix = *fix;
+        self.metrics.fixes += 1;
+        let has_fix = !matches!(
+            fix.nav_stat,
+            None | Some(GpsNavigationStatus::NoFix) | Some(GpsNavigationStatus::TimeOnly)
+        );
+        let position = match (fix.latitude, fix.longitude) {
+            (Some(latitude), Some(longitude)) if has_fix => Some((latitude, longitude)),
+            _ => None,
+        };
+        self.metrics.ecef = position.map(|(latitude, longitude)| {
+            geodetic_to_ecef(latitude, longitude, fix.altitude.unwrap_or(0.0))
+        });
+        if let Some(position) = position {
+            match self.odometer_position {
+                // Steps within the accuracy estimate are noise while standing still
+                Some(previous) => {
+                    let step = distance_m(previous, position);
+                    if step > fix.h_acc.unwrap_or(0.0) {
+                        self.metrics.odometer_m += step;
+                        self.odometer_position = Some(position);
+                    }
+                }
+                None => self.odometer_position = Some(position),
+            }
+            self.metrics.geofences = self.geofences.containing(position);
+        } else {
+            self.metrics.geofences.clear();
+        }
+        if let (Some(sog_kmh), Some(cog), true) = (fix.sog_kmh, fix.cog, has_fix) {
+            self.update_velocity(sog_kmh / 3.6, cog, fix.monotonic_time_ns);
+        }
+        self.metrics.velocity_ne = self.velocity.map(|filter| filter.velocity_ne);
+    }
+
+    fn update_velocity(&mut self, speed_mps: f64, cog: f64, monotonic_time_ns: u64) {
+        let course = cog.to_radians();
+        let measured = (speed_mps * course.cos(), speed_mps * course.sin());
+        let r = self.config.velocity_measurement_noise;
+        let Some(filter) = self.velocity.as_mut() else {
+            self.velocity = Some(VelocityFilter {
+                velocity_ne: measured,
+                variance: r,
+                monotonic_time_ns,
+            });
+            return;
+        };
+        let dt = monotonic_time_ns.saturating_sub(filter.monotonic_time_ns) as f64 / 1e9;
+        let predicted = filter.variance + self.config.velocity_process_noise * dt;
+        let gain = predicted / (predicted + r);
+        filter.velocity_ne = (
+            filter.velocity_ne.0 + gain * (measured.0 - filter.velocity_ne.0),
+            filter.velocity_ne.1 + gain * (measured.1 - filter.velocity_ne.1),
+        );
+        filter.variance = (1.0 - gain) * predicted;
+        filter.monotonic_time_ns = monotonic_time_ns;
+    }
+
+    /// Result of the latest update.
+    pub fn metrics(&self) -> &FixMetrics {
+        &self.metrics
+    }
+
+    pub fn reset_odometer(&mut self) {
+        self.metrics.odometer_m = 0.0;
+        self.odometer_position = None;
+    }
+
+    /// Register a polygon of (latitude, longitude) vertices in decimal degrees, the last
+    /// vertex connects back to the first. Returns its id for [FixMetrics::geofences]. Takes
+    /// effect with the next update. Every edge takes the shorter way around so polygons may
+    /// cross the antimeridian, one spanning 180 degrees of longitude or more needs vertices in
+    /// between. Polygons circling a pole are rejected.
+    pub fn geofence_add(&mut self, vertices: &[(f64, f64)]) -> Result<u32> {
+        self.geofences.add(vertices)
+    }
+
+    /// Returns false if `id` isn't registered.
+    pub fn geofence_remove(&mut self, id: u32) -> bool {
+        self.geofences.remove(id)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn fix(latitude: f64, longitude: f64, sog_kmh: f64, cog: f64, time_s: u64) -> GPSFix {
+        GPSFix {
+            latitude: Some(latitude),
+            longitude: Some(longitude),
+            altitude: Some(0.0),
+            nav_stat: Some(GpsNavigationStatus::StandAlone3D),
+            h_acc: Some(2.0),
+            sog_kmh: Some(sog_kmh),
+            cog: Some(cog),
+            monotonic_time_ns: time_s * 1_000_000_000,
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn test_geodesy() {
+        let [x, y, z] = geodetic_to_ecef(0.0, 0.0, 0.0);
+        assert_eq!((x, y, z), (WGS84_A, 0.0, 0.0));
+        let [x, y, z] = geodetic_to_ecef(90.0, 0.0, 0.0);
+        assert!(x.abs() < 1e-6 && y.abs() < 1e-6);
+        assert!((z - 6_356_752.314).abs() < 0.01);
+        // One degree of latitude is about 111.2 km
+        assert!((distance_m((42.0, -83.0), (43.0, -83.0)) - 111_195.0).abs() < 1.0);
+        assert_eq!(distance_m((42.0, -83.0), (42.0, -83.0)), 0.0);
+    }
+
+    #[test]
+    fn test_metrics_engine() {
+        assert!(MetricsEngine::new(MetricsConfig {
+            velocity_process_noise: 0.0,
+            ..Default::default()
+        })
+        .is_err());
+        let mut engine = MetricsEngine::new(MetricsConfig::default()).unwrap();
+        let square = [(42.0, -84.0), (42.0, -83.0), (43.0, -83.0), (43.0, -84.0)];
+        let square_id = engine.geofence_add(&square).unwrap();
+        // Spans too many cells to index
+        let world = [
+            (-89.0, -179.0),
+            (-89.0, 0.0),
+            (-89.0, 179.0),
+            (89.0, 179.0),
+            (89.0, 0.0),
+            (89.0, -179.0),
+        ];
+        let world_id = engine.geofence_add(&world).unwrap();
+        assert!(engine.geofence_add(&square[..2]).is_err());
+
+        engine.update(&fix(42.5, -83.5, 36.0, 90.0, 0));
+        let metrics = engine.metrics();
+        assert_eq!(metrics.geofences, [square_id, world_id]);
+        assert_eq!(metrics.odometer_m, 0.0);
+        assert!(metrics.ecef.is_some());
+        assert!((metrics.speed_mps().unwrap() - 10.0).abs() < 1e-9);
+        assert!((metrics.course_deg().unwrap() - 90.0).abs() < 1e-9);
+
+        // Jitter within h_acc isn't distance travelled
+        engine.update(&fix(42.500001, -83.5, 36.0, 90.0, 1));
+        assert_eq!(engine.metrics().odometer_m, 0.0);
+        // 10 m/s east for 1 s, then a noisy speed measurement is smoothed
+        engine.update(&fix(42.5, -83.499878, 72.0, 90.0, 2));
+        let metrics = engine.metrics();
+        assert!((metrics.odometer_m - 10.0).abs() < 0.1);
+        let speed = metrics.speed_mps().unwrap();
+        assert!(speed > 10.0 && speed < 20.0);
+
+        engine.update(&fix(41.0, -83.5, 36.0, 90.0, 3));
+        assert_eq!(engine.metrics().geofences, [world_id]);
+        assert!(engine.geofence_remove(world_id));
+        assert!(!engine.geofence_remove(world_id));
+        engine.update(&fix(41.0, -83.5, 36.0, 90.0, 4));
+        assert!(engine.metrics().geofences.is_empty());
+
+        // No position without a fix
+        let mut no_fix = fix(42.5, -83.5, 0.0, 0.0, 5);
+        no_fix.nav_stat = Some(GpsNavigationStatus::NoFix);
+        engine.update(&no_fix);
+        assert!(engine.metrics().ecef.is_none());
+        assert_eq!(engine.metrics().fixes, 6);
+        engine.reset_odometer();
+        assert_eq!(engine.metrics().odometer_m, 0.0);
+    }
+
+    #[test]
+    fn test_geofence_antimeridian() {
+        let mut engine = MetricsEngine::new(MetricsConfig::default()).unwrap();
+        // Fiji, from 177 E to 178 W
+        let fiji = [
+            (-19.0, 177.0),
+            (-19.0, -178.0),
+            (-16.0, -178.0),
+            (-16.0, 177.0),
+        ];
+        let fiji_id = engine.geofence_add(&fiji).unwrap();
+        for (longitude, inside) in [(178.0, true), (180.0, true), (-179.0, true), (0.0, false)] {
+            engine.update(&fix(-17.5, longitude, 0.0, 0.0, 0));
+            assert_eq!(engine.metrics().geofences.contains(&fiji_id), inside);
+        }
+        // Around the north pole
+        let arctic = [(80.0, -90.0), (80.0, 30.0), (80.0, 150.0)];
+        assert!(engine.geofence_add(&arctic).is_err());
+    }
+}
@@ -1,12 +1,19 @@
 #[cfg(feature = "io")]
-use crate::io::{IOBitMode, IO};
+use crate::io::{ButtonEvent, IOBitMode, IO};
 use crate::{
-    audio::Audio,
-    gps::GPSDevice,
-    nmea::types::GPSInfo,
+    analysis::{AnalysisConfig, AudioLevel},
+    audio::{Audio, AudioChunk},
+    gps::{GPSDevice, GPSWaiter, GpsConfig, GpsProtocol},
+    metrics::{FixMetrics, MetricsConfig},
+    nmea::types::{GPSClockMapping, GPSFix, GPSInfo, GPSSatellites},
+    reactor::ReactorHandle,
+    stats::DeviceStats,
     types::{Error, Result},
+    ubx,
 };
+use enumflags2::{bitflags, BitFlags};
 use rusb::{self, GlobalContext};
+use std::{collections::HashMap, thread, time::Duration};
 
 /// Intrepid Control Systems, Inc. USB Vendor ID.
 const NEOVI_MIC_VID: u16 = 0x93c;
@@ -68,7 +75,7 @@ impl UsbDeviceInfo {
         }
     }
 
-    fn usb_device_type_from_vid_pid(vid: &u16, pid: &u16) -> UsbDeviceType {
+    pub(crate) fn usb_device_type_from_vid_pid(vid: &u16, pid: &u16) -> UsbDeviceType {
         match (*vid, *pid) {
             (NEOVI_MIC_HUB_VID, NEOVI_MIC_HUB_PID) => UsbDeviceType::MicrochipHub,
             (NEOVI_MIC_VID, NEOVI_MIC_PID) => UsbDeviceType::FT245R,
@@ -79,6 +86,66 @@ impl UsbDeviceInfo {
     }
 }
 
+/// Compact state of a neoVI MIC2 answered from what is already known, see [NeoVIMIC::status].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct DeviceStatus {
+    pub gps_open: bool,
+    pub gps_has_lock: bool,
+    /// Latest position, None while the GPS isn't open
+    pub gps_fix: Option<GPSFix>,
+    pub io_open: bool,
+    /// Last known levels of the IO lines, see [crate::io::IO::cached_state]
+    pub io_state: u8,
+    /// IO lines whose level in io_state is known
+    pub io_known: u8,
+}
+
+/// Subsystems of a neoVI MIC2, combined into a [BitFlags] set for [NeoVIMIC::open] and
+/// [open_all]. Audio has no open step, capture starts with [NeoVIMIC::audio_start].
+#[bitflags]
+#[derive(Clone, Copy, PartialEq, Debug)]
+#[repr(u8)]
+pub enum Subsystem {
+    /// FTDI IO, see [NeoVIMIC::io_open]
+    Io = 0x01,
+    /// GPS receiver, see [NeoVIMIC::gps_open_with_config]
+    Gps = 0x02,
+}
+
+impl Subsystem {
+    /// Returns an error if `value` contains unknown subsystems.
+    pub fn from_bits(value: u8) -> Result<BitFlags<Self>> {
+        BitFlags::<Self>::from_bits(value).map_err(|_| {
+            std::io::Error::new(
+                std::io::ErrorKind::InvalidInput,
+                format!("Unknown subsystems: {value:#x}"),
+            )
+            .into()
+        })
+    }
+}
+
+/// Outcome of [NeoVIMIC::open] for each subsystem, None if it wasn't requested.
+#[derive(Debug, Default, Clone)]
+pub struct OpenResult {
+    pub io: Option<Result<()>>,
+    pub gps: Option<Result<bool>>,
+}
+
+impl OpenResult {
+    /// True if every requested subsystem opened.
+    pub fn is_ok(&self) -> bool {
+        self.io.as_ref().is_none_or(Result::is_ok) && self.gps.as_ref().is_none_or(Result::is_ok)
+    }
+}
+
+/// Join a thread opening a subsystem, turning a panic into an error.
+fn join_open<T>(handle: thread::ScopedJoinHandle<'_, Result<T>>) -> Result<T> {
+    handle
+        .join()
+        .unwrap_or_else(|_| Err(Error::CriticalError("Open thread panicked".into())))
+}
+
 #[derive(Debug, Default, Clone)]
 pub struct NeoVIMIC {
     /// Index of the neoVI MIC, starts at 0. 2nd device would be 1.
@@ -102,101 +169,203 @@ pub struct NeoVIMIC {
     gps: Option<GPSDevice>,
 }
 
-pub fn find_neovi_mics() -> Result<Vec<NeoVIMIC>> {
-    let mut usb_hubs = Vec::new();
-
-    // Find all potential neoVI MIC2 USB hubs
-    // 0424:2514 Microchip Technology, Inc. (formerly SMSC) USB 2.0 Hub
-    for rusb_device in rusb::devices().unwrap().iter() {
-        let device = UsbDeviceInfo::from_rusb_device(&rusb_device, None);
-        // Are we the hub? 0424:2514 Microchip Technology, Inc. (formerly SMSC) USB 2.0 Hub
-        // neoVI PI has a microchip hub also with the same VID but PID 0x2507
-        if device.vendor_id == NEOVI_MIC_HUB_VID && device.product_id == NEOVI_MIC_HUB_PID {
-            usb_hubs.push(device);
-        }
-    }
-
-    let mut devices = Vec::new();
-    // Find all children attached to all the hubs
-    for (i, usb_hub) in usb_hubs.iter().enumerate() {
-        // define all the UsbDeviceInfo on the hub
-        let mut io_usb_info = None;
-        let mut audio_usb_info = None;
-        let mut gps_usb_info = None;
-        let mut extra_usb_info: Vec<UsbDeviceInfo> = Vec::new();
-        // define all the actual objects that reflect the UsbDeviceInfo
-        #[cfg(feature = "io")]
-        let mut io = None;
-        let mut audio = None;
-        let mut gps = None;
-        // Audio devices are kind of a pain to link to the actual hub so we are just
-        // going to match indexes on how they are found on the system. Index 0 neoVI MIC2 should match up
-        // to Index 1 of the audio codecs found.
-        let audio_devices = match Audio::find_neovi_mic2_audio() {
-            Ok(devs) => devs,
-            Err(e) => {
-                println!("{}", e);
-                Vec::new()
+/// Snapshot of the USB bus taken with a single enumeration: the neoVI MIC2 hubs and the
+/// devices attached to each of them.
+struct UsbTopology {
+    /// neoVI MIC2 hubs in enumeration order
+    hubs: Vec<rusb::Device<GlobalContext>>,
+    /// Devices keyed by the (bus number, address) of their parent
+    children: HashMap<(u8, u8), Vec<rusb::Device<GlobalContext>>>,
+}
+
+impl UsbTopology {
+    fn enumerate() -> Result<Self> {
+        let devices =
+            rusb::devices().map_err(|e| Error::CriticalError(format!("USB enumeration: {e}")))?;
+        let mut hubs = Vec::new();
+        let mut children: HashMap<(u8, u8), Vec<rusb::Device<GlobalContext>>> = HashMap::new();
+        for device in devices.iter() {
+            let (vendor_id, product_id) = match device.device_descriptor() {
+                Ok(d) => (d.vendor_id(), d.product_id()),
+                Err(_) => continue,
+            };
+            // Are we the hub? 0424:2514 Microchip Technology, Inc. (formerly SMSC) USB 2.0 Hub
+            // neoVI PI has a microchip hub also with the same VID but PID 0x2507
+            if vendor_id == NEOVI_MIC_HUB_VID && product_id == NEOVI_MIC_HUB_PID {
+                hubs.push(device.clone());
             }
-        };
-        // Find all devices attached to the hub
-        for device in rusb::devices().unwrap().iter().filter(|d| {
-            // Get the parent of the device, can't proceed if we don't have a parent.
-            match d.get_parent() {
-                Some(parent) => UsbDeviceInfo::from_rusb_device(&parent, None) == *usb_hub,
-                None => false,
+            if let Some(parent) = device.get_parent() {
+                children
+                    .entry((parent.bus_number(), parent.address()))
+                    .or_default()
+                    .push(device);
             }
-        }) {
+        }
+        Ok(Self { hubs, children })
+    }
+
+    fn children_of(&self, hub: &rusb::Device<GlobalContext>) -> &[rusb::Device<GlobalContext>] {
+        self.children
+            .get(&(hub.bus_number(), hub.address()))
+            .map(Vec::as_slice)
+            .unwrap_or_default()
+    }
+}
+
+/// USB devices found on a single neoVI MIC2 hub.
+#[derive(Debug, Default)]
+struct HubDevices {
+    io: Option<UsbDeviceInfo>,
+    audio: Option<UsbDeviceInfo>,
+    gps: Option<UsbDeviceInfo>,
+    /// USB port path of the GPS, see [usb_port_path]
+    gps_port_path: Option<String>,
+    extra: Vec<UsbDeviceInfo>,
+}
+
+/// USB port path of device, "<bus>-<port>.<port>..." the way Linux names it in sysfs. Matches
+/// [GPSDevice::usb_port_path].
+fn usb_port_path(device: &rusb::Device<GlobalContext>) -> Option<String> {
+    let ports = device.port_numbers().ok()?;
+    let ports: Vec<String> = ports.iter().map(u8::to_string).collect();
+    Some(format!("{}-{}", device.bus_number(), ports.join(".")))
+}
+
+/// Take the serial port of the GPS at `port_path` out of `gps_devices` so no two hubs share
+/// a port. Falls back to the first port with the same VID/PID when the port paths aren't
+/// known, ie. off Linux.
+fn take_gps(
+    gps_devices: &mut Vec<GPSDevice>,
+    usb_info: &UsbDeviceInfo,
+    port_path: Option<&str>,
+) -> Option<GPSDevice> {
+    let index = match port_path {
+        Some(path) if gps_devices.iter().any(|d| d.usb_port_path.is_some()) => gps_devices
+            .iter()
+            .position(|d| d.usb_port_path.as_deref() == Some(path)),
+        _ => gps_devices
+            .iter()
+            .position(|d| d.vid == usb_info.vendor_id && d.pid == usb_info.product_id),
+    }?;
+    Some(gps_devices.remove(index))
+}
+
+impl HubDevices {
+    /// Classify the children of a hub, reading the FT245R serial number.
+    fn from_children(children: &[rusb::Device<GlobalContext>]) -> Self {
+        let mut hub_devices = Self::default();
+        for device in children {
             // Grab the USB vendor/product ID of the device, continue if we can't get it.
-            let (vendor_id, product_id) = match device.device_descriptor() {
-                Ok(d) => (d.vendor_id(), d.product_id()),
+            let descriptor = match device.device_descriptor() {
+                Ok(d) => d,
                 Err(_) => continue,
             };
             // match up the VID/PID to a UsbDeviceType
-            match UsbDeviceInfo::usb_device_type_from_vid_pid(&vendor_id, &product_id) {
+            match UsbDeviceInfo::usb_device_type_from_vid_pid(
+                &descriptor.vendor_id(),
+                &descriptor.product_id(),
+            ) {
                 UsbDeviceType::MicrochipHub => {}
                 UsbDeviceType::FT245R => {
                     // Grab the serial number before we create the UsbDeviceInfo
                     let serial_number = match &device.open() {
                         Ok(handle) => handle
-                            .read_serial_number_string_ascii(&device.device_descriptor().unwrap())
-                            .unwrap(),
+                            .read_serial_number_string_ascii(&descriptor)
+                            .unwrap_or_else(|e| format!("{e}")),
                         Err(e) => {
                             // Probably an access denied error, udev rules correct?
                             format!("{e}")
                         }
                     };
-                    let usb_info = UsbDeviceInfo::from_rusb_device(&device, Some(serial_number));
-                    cfg_if::cfg_if! {
-                        if #[cfg(feature = "io")] {
-                            io = IO::from(usb_info.clone()).ok();
-                        }
-                    }
-                    io_usb_info = Some(usb_info);
+                    hub_devices.io =
+                        Some(UsbDeviceInfo::from_rusb_device(device, Some(serial_number)));
                 }
                 UsbDeviceType::GPS => {
-                    gps_usb_info = Some(UsbDeviceInfo::from_rusb_device(&device, None));
-                    gps = GPSDevice::find(&vendor_id, &product_id);
+                    hub_devices.gps = Some(UsbDeviceInfo::from_rusb_device(device, None));
+                    hub_devices.gps_port_path = usb_port_path(device);
                 }
                 UsbDeviceType::Audio => {
-                    audio_usb_info = Some(UsbDeviceInfo::from_rusb_device(&device, None));
-                    // See audio_device declaration above for information on how we are
-                    // matching indexes here.
-                    audio = audio_devices.get(i).cloned();
+                    hub_devices.audio = Some(UsbDeviceInfo::from_rusb_device(device, None));
                 }
                 UsbDeviceType::Unknown => {
-                    extra_usb_info.push(UsbDeviceInfo::from_rusb_device(&device, None));
+                    hub_devices
+                        .extra
+                        .push(UsbDeviceInfo::from_rusb_device(device, None));
                 }
             };
         }
-        // Create the IO device
+        hub_devices
+    }
+}
+
+pub fn find_neovi_mics() -> Result<Vec<NeoVIMIC>> {
+    // Enumerate the USB bus once and index every device by its parent
+    let topology = UsbTopology::enumerate()?;
+    if topology.hubs.is_empty() {
+        return Ok(Vec::new());
+    }
+
+    // Opening each FT245R to read the serial number is the slowest part of discovery,
+    // so every hub gets its own thread.
+    let hub_devices: Vec<HubDevices> = std::thread::scope(|scope| {
+        let handles: Vec<_> = topology
+            .hubs
+            .iter()
+            .map(|hub| {
+                let children = topology.children_of(hub);
+                scope.spawn(move || HubDevices::from_children(children))
+            })
+            .collect();
+        handles
+            .into_iter()
+            .map(|handle| handle.join().unwrap_or_default())
+            .collect()
+    });
+
+    // Audio devices are kind of a pain to link to the actual hub so we are just
+    // going to match indexes on how they are found on the system. Index 0 neoVI MIC2 should match up
+    // to Index 1 of the audio codecs found.
+    let audio_devices = match Audio::find_neovi_mic2_audio() {
+        Ok(devs) => devs,
+        Err(e) => {
+            println!("{}", e);
+            Vec::new()
+        }
+    };
+    let mut gps_devices = if hub_devices.iter().any(|d| d.gps.is_some()) {
+        GPSDevice::find_all().unwrap_or_default()
+    } else {
+        Vec::new()
+    };
+
+    let mut devices = Vec::with_capacity(topology.hubs.len());
+    for (i, (hub, hub_devices)) in topology.hubs.iter().zip(hub_devices).enumerate() {
+        cfg_if::cfg_if! {
+            if #[cfg(feature = "io")] {
+                let io = hub_devices
+                    .io
+                    .as_ref()
+                    .and_then(|usb_info| IO::from(usb_info.clone()).ok());
+            }
+        }
+        let audio = hub_devices
+            .audio
+            .as_ref()
+            .and_then(|_| audio_devices.get(i).cloned());
+        let gps = hub_devices.gps.as_ref().and_then(|usb_info| {
+            take_gps(
+                &mut gps_devices,
+                usb_info,
+                hub_devices.gps_port_path.as_deref(),
+            )
+        });
         devices.push(NeoVIMIC {
             index: i as u32,
-            usb_hub: usb_hub.clone(),
-            io_usb_info,
-            audio_usb_info,
-            gps_usb_info,
-            extra_usb_info,
+            usb_hub: UsbDeviceInfo::from_rusb_device(hub, None),
+            io_usb_info: hub_devices.io,
+            audio_usb_info: hub_devices.audio,
+            gps_usb_info: hub_devices.gps,
+            extra_usb_info: hub_devices.extra,
             #[cfg(feature = "io")]
             io,
             audio,
@@ -206,6 +375,41 @@ pub fn find_neovi_mics() -> Result<Vec<NeoVIMIC>> {
     Ok(devices)
 }
 
+/// [NeoVIMIC::status] of every device, in order.
+pub fn snapshot_all<'a>(devices: impl IntoIterator<Item = &'a NeoVIMIC>) -> Vec<DeviceStatus> {
+    devices.into_iter().map(NeoVIMIC::status).collect()
+}
+
+/// [NeoVIMIC::open] every device at once so bringing up a rack takes about as long as the
+/// slowest device instead of the sum of all of them. Returns once every device is done,
+/// entry i is the result of device i.
+pub fn open_all<'a>(
+    devices: impl IntoIterator<Item = &'a NeoVIMIC>,
+    subsystems: BitFlags<Subsystem>,
+    gps_config: &GpsConfig,
+) -> Vec<OpenResult> {
+    thread::scope(|scope| {
+        let handles: Vec<_> = devices
+            .into_iter()
+            .map(|device| scope.spawn(move || device.open(subsystems, gps_config)))
+            .collect();
+        handles
+            .into_iter()
+            .map(|handle| {
+                handle.join().unwrap_or_else(|_| {
+                    let error = Error::CriticalError("Open thread panicked".into());
+                    OpenResult {
+                        io: subsystems
+                            .contains(Subsystem::Io)
+                            .then(|| Err(error.clone())),
+                        gps: subsystems.contains(Subsystem::Gps).then_some(Err(error)),
+                    }
+                })
+            })
+            .collect()
+    })
+}
+
 impl NeoVIMIC {
     /// Returns true if this neoVI MIC2 has GPS capabilities, false otherwise
     pub fn has_gps(&self) -> bool {
@@ -297,14 +501,15 @@ impl NeoVIMIC {
         }
     }
 
+    /// Answered from the last state written without a USB transfer, see [IO::output_state].
     pub fn io_buzzer_is_enabled(&self) -> Result<bool> {
         cfg_if::cfg_if! {
             if #[cfg(feature = "io")] {
-                let pins = match self.io.as_ref() {
-                    Some(io) => io.read_pins()?,
+                let outputs = match self.io.as_ref() {
+                    Some(io) => io.output_state()?,
                     None => return Err(Error::NotSupported("IO device not available.".to_string())),
                 };
-                Ok(pins & IOBitMode::Buzzer == IOBitMode::Buzzer)
+                Ok(outputs.contains(IOBitMode::Buzzer))
             } else {
                 Err(Error::NotSupported("io feature not enabled".to_string()))
             }
@@ -330,14 +535,15 @@ impl NeoVIMIC {
         }
     }
 
+    /// Answered from the last state written without a USB transfer, see [IO::output_state].
     pub fn io_gpsled_is_enabled(&self) -> Result<bool> {
         cfg_if::cfg_if! {
             if #[cfg(feature = "io")] {
-                let pins = match self.io.as_ref() {
-                    Some(io) => io.read_pins()?,
+                let outputs = match self.io.as_ref() {
+                    Some(io) => io.output_state()?,
                     None => return Err(Error::NotSupported("IO device not available.".to_string())),
                 };
-                Ok(pins & IOBitMode::GPSLed == IOBitMode::GPSLed)
+                Ok(outputs.contains(IOBitMode::GPSLed))
             } else {
                 Err(Error::NotSupported("io feature not enabled".to_string()))
             }
@@ -347,17 +553,159 @@ impl NeoVIMIC {
     pub fn io_button_is_pressed(&self) -> Result<bool> {
         cfg_if::cfg_if! {
             if #[cfg(feature = "io")] {
-                let pins = match self.io.as_ref() {
-                    Some(io) => io.read_pins()?,
-                    None => return Err(Error::NotSupported("IO device not available.".to_string())),
-                };
-                Ok(pins & IOBitMode::Button == IOBitMode::Button)
+                Ok(self.io_read_state()?.contains(IOBitMode::Button))
+            } else {
+                Err(Error::NotSupported("io feature not enabled".to_string()))
+            }
+        }
+    }
+
+    /// See [IO::set_revalidate_interval]
+    pub fn io_set_revalidate_interval(&self, interval: Option<Duration>) -> Result<()> {
+        cfg_if::cfg_if! {
+            if #[cfg(feature = "io")] {
+                match self.io.as_ref() {
+                    Some(io) => {
+                        io.set_revalidate_interval(interval);
+                        Ok(())
+                    }
+                    None => Err(Error::NotSupported("IO device not available.".to_string())),
+                }
             } else {
+                let _ = interval;
                 Err(Error::NotSupported("io feature not enabled".to_string()))
             }
         }
     }
 
+    /// See [IO::button_monitor_start]
+    #[cfg(feature = "io")]
+    pub fn io_button_monitor_start(
+        &self,
+        sample_interval: Duration,
+        debounce: Duration,
+        callback: impl FnMut(ButtonEvent) + Send + 'static,
+    ) -> Result<()> {
+        match self.io.as_ref() {
+            Some(io) => io.button_monitor_start(sample_interval, debounce, Box::new(callback)),
+            None => Err(Error::NotSupported("IO device not available.".to_string())),
+        }
+    }
+
+    /// See [IO::button_monitor_stop]
+    #[cfg(feature = "io")]
+    pub fn io_button_monitor_stop(&self) -> Result<()> {
+        match self.io.as_ref() {
+            Some(io) => {
+                io.button_monitor_stop();
+                Ok(())
+            }
+            None => Err(Error::NotSupported("IO device not available.".to_string())),
+        }
+    }
+
+    /// Read the Buzzer, Button and GPS LED lines with a single USB transfer.
+    #[cfg(feature = "io")]
+    pub fn io_read_state(&self) -> Result<enumflags2::BitFlags<IOBitMode>> {
+        match self.io.as_ref() {
+            Some(io) => io.read_pins(),
+            None => Err(Error::NotSupported("IO device not available.".to_string())),
+        }
+    }
+
+    /// Set several outputs with a single USB transfer, ie. `io_write_state(Buzzer | GPSLed, GPSLed)`
+    /// turns the GPS LED on and the buzzer off. Outputs not in mask are turned off like
+    /// [NeoVIMIC::io_buzzer_enable] does.
+    #[cfg(feature = "io")]
+    pub fn io_write_state(
+        &self,
+        mask: enumflags2::BitFlags<IOBitMode>,
+        values: enumflags2::BitFlags<IOBitMode>,
+    ) -> Result<()> {
+        match self.io.as_ref() {
+            Some(io) => io.write_outputs(mask, values),
+            None => Err(Error::NotSupported("IO device not available.".to_string())),
+        }
+    }
+
+    /// Counters and latency histograms of the GPS reader thread, IO transfers and audio
+    /// capture. Cheap enough to poll, everything is a relaxed atomic.
+    pub fn stats(&self) -> DeviceStats {
+        #[cfg(feature = "io")]
+        let io = self.io.as_ref().map(IO::stats);
+        #[cfg(not(feature = "io"))]
+        let io = None;
+        DeviceStats {
+            gps: self.gps.as_ref().map(GPSDevice::stats),
+            io,
+            audio: self.audio.as_ref().map(Audio::stats),
+        }
+    }
+
+    /// GPS and IO state without any USB transfer or waiting on the reader thread beyond its
+    /// GPS info lock, for polling many devices every tick. See [snapshot_all].
+    pub fn status(&self) -> DeviceStatus {
+        let mut status = DeviceStatus::default();
+        if let Some(Ok((fix, has_lock))) = self.gps.as_ref().map(GPSDevice::get_fix_with_lock) {
+            status.gps_open = true;
+            status.gps_has_lock = has_lock;
+            status.gps_fix = Some(fix);
+        }
+        #[cfg(feature = "io")]
+        if let Some(io) = &self.io {
+            let (levels, known) = io.cached_state();
+            status.io_open = io.is_open();
+            status.io_state = levels.bits();
+            status.io_known = known.bits();
+        }
+        status
+    }
+
+    /// Zero every counter reported by [NeoVIMIC::stats].
+    pub fn stats_reset(&self) {
+        #[cfg(feature = "io")]
+        if let Some(io) = &self.io {
+            io.stats_reset();
+        }
+        if let Some(gps) = &self.gps {
+            gps.stats_reset();
+        }
+        if let Some(audio) = &self.audio {
+            audio.stats_reset();
+        }
+    }
+
+    /// Open `subsystems` concurrently, the IO on a thread of its own while the GPS is
+    /// configured with `gps_config` on the calling thread. Returns once both are done, failing
+    /// one doesn't stop the other. See [open_all] for many devices.
+    pub fn open(&self, subsystems: BitFlags<Subsystem>, gps_config: &GpsConfig) -> OpenResult {
+        thread::scope(|scope| {
+            let io = subsystems
+                .contains(Subsystem::Io)
+                .then(|| scope.spawn(|| self.io_open()));
+            let gps = subsystems
+                .contains(Subsystem::Gps)
+                .then(|| self.gps_open_with_config(gps_config));
+            OpenResult {
+                io: io.map(join_open),
+                gps,
+            }
+        })
+    }
+
+    /// Service the GPS port and IO button monitor from a shared [crate::reactor::Reactor]
+    /// instead of a thread each, starting with the next gps_open/io_button_monitor_start. None
+    /// goes back to threads of their own.
+    pub fn set_reactor(&self, reactor: Option<ReactorHandle>) {
+        #[cfg(feature = "io")]
+        if let Some(io) = &self.io {
+            io.set_reactor(reactor.clone());
+        }
+        if let Some(gps) = &self.gps {
+            gps.set_reactor(reactor);
+        }
+    }
+
     pub fn audio_start(&self, sample_rate: u32) -> Result<()> {
         match &self.audio {
             Some(audio) => audio.start(sample_rate),
@@ -385,6 +733,85 @@ impl NeoVIMIC {
         }
     }
 
+    /// See [Audio::record_start]
+    pub fn audio_record_start(
+        &self,
+        sample_rate: u32,
+        path: impl AsRef<std::path::Path>,
+        segment_length: Option<Duration>,
+    ) -> Result<()> {
+        match &self.audio {
+            Some(audio) => audio.record_start(sample_rate, path, segment_length),
+            None => Err(crate::types::Error::InvalidDevice(
+                "Audio device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [Audio::stream_start]
+    pub fn audio_stream_start(
+        &self,
+        sample_rate: u32,
+        chunk_length: usize,
+        callback: impl FnMut(&AudioChunk) + Send + 'static,
+    ) -> Result<()> {
+        match &self.audio {
+            Some(audio) => audio.stream_start(sample_rate, chunk_length, callback),
+            None => Err(crate::types::Error::InvalidDevice(
+                "Audio device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [Audio::stream_stop]
+    pub fn audio_stream_stop(&self) -> Result<()> {
+        match &self.audio {
+            Some(audio) => audio.stream_stop(),
+            None => Err(crate::types::Error::InvalidDevice(
+                "Audio device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [Audio::analysis_start]
+    pub fn audio_analysis_start(
+        &self,
+        config: AnalysisConfig,
+        callback: impl FnMut(&AudioLevel) + Send + 'static,
+    ) -> Result<()> {
+        match &self.audio {
+            Some(audio) => audio.analysis_start(config, callback),
+            None => Err(crate::types::Error::InvalidDevice(
+                "Audio device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [Audio::analysis_stop]
+    pub fn audio_analysis_stop(&self) -> Result<bool> {
+        match &self.audio {
+            Some(audio) => Ok(audio.analysis_stop()),
+            None => Err(crate::types::Error::InvalidDevice(
+                "Audio device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [Audio::trigger_record_start]
+    pub fn audio_trigger_record_start(
+        &self,
+        sample_rate: u32,
+        path: impl AsRef<std::path::Path>,
+        pre_trigger: Duration,
+    ) -> Result<()> {
+        match &self.audio {
+            Some(audio) => audio.trigger_record_start(sample_rate, path, pre_trigger),
+            None => Err(crate::types::Error::InvalidDevice(
+                "Audio device isn't available".to_string(),
+            )),
+        }
+    }
+
     pub fn gps_open(&self) -> Result<bool> {
         match &self.gps {
             Some(gps) => gps.open(),
@@ -394,6 +821,40 @@ impl NeoVIMIC {
         }
     }
 
+    /// See [GPSDevice::open_with_protocol]
+    pub fn gps_open_with_protocol(&self, protocol: GpsProtocol) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.open_with_protocol(protocol),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::open_with_config]
+    pub fn gps_open_with_config(&self, config: &GpsConfig) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.open_with_config(config),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::open_with_transaction]
+    pub fn gps_open_with_transaction(
+        &self,
+        config: &GpsConfig,
+        transaction: &mut ubx::Transaction,
+    ) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.open_with_transaction(config, transaction),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
     pub fn gps_is_open(&self) -> Result<bool> {
         match &self.gps {
             Some(gps) => Ok(gps.is_open()),
@@ -412,6 +873,11 @@ impl NeoVIMIC {
         }
     }
 
+    /// See [GPSInfo::clock_mapping]
+    pub fn gps_clock_mapping(&self) -> Result<Option<GPSClockMapping>> {
+        Ok(self.gps_info()?.clock_mapping())
+    }
+
     pub fn gps_info(&self) -> Result<GPSInfo> {
         match &self.gps {
             Some(gps) => gps.get_info(),
@@ -421,6 +887,58 @@ impl NeoVIMIC {
         }
     }
 
+    /// See [GPSDevice::with_info]
+    pub fn gps_with_info<R>(&self, f: impl FnOnce(&GPSInfo) -> R) -> Result<R> {
+        match &self.gps {
+            Some(gps) => gps.with_info(f),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::with_info_if_newer]
+    pub fn gps_with_info_if_newer<R>(
+        &self,
+        last_sequence: u64,
+        f: impl FnOnce(&GPSInfo) -> R,
+    ) -> Result<Option<R>> {
+        match &self.gps {
+            Some(gps) => gps.with_info_if_newer(last_sequence, f),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::sequence]
+    pub fn gps_sequence(&self) -> Result<u64> {
+        match &self.gps {
+            Some(gps) => Ok(gps.sequence()),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    pub fn gps_fix(&self) -> Result<GPSFix> {
+        match &self.gps {
+            Some(gps) => gps.get_fix(),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    pub fn gps_satellites(&self) -> Result<GPSSatellites> {
+        match &self.gps {
+            Some(gps) => gps.get_satellites(),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
     pub fn gps_has_lock(&self) -> Result<bool> {
         match &self.gps {
             Some(gps) => gps.has_lock(),
@@ -429,6 +947,177 @@ impl NeoVIMIC {
             )),
         }
     }
+
+    /// See [GPSDevice::wait_for_lock]. Use [NeoVIMIC::gps_waiter] to wait without borrowing self.
+    pub fn gps_wait_for_lock(&self, timeout: Duration) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.wait_for_lock(timeout),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::wait_for_fix]. Use [NeoVIMIC::gps_waiter] to wait without borrowing self.
+    pub fn gps_wait_for_fix(&self, timeout: Duration) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.wait_for_fix(timeout),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::waiter]
+    pub fn gps_waiter(&self) -> Result<GPSWaiter> {
+        match &self.gps {
+            Some(gps) => Ok(gps.waiter()),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::subscribe]
+    pub fn gps_subscribe(&self, callback: impl FnMut(&GPSInfo) + Send + 'static) -> Result<u32> {
+        match &self.gps {
+            Some(gps) => Ok(gps.subscribe(callback)),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::unsubscribe]
+    pub fn gps_unsubscribe(&self, id: u32) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => Ok(gps.unsubscribe(id)),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::fix_log_start]
+    pub fn gps_fix_log_start(&self, path: impl AsRef<std::path::Path>) -> Result<()> {
+        match &self.gps {
+            Some(gps) => gps.fix_log_start(path),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::raw_tap_start]
+    pub fn gps_raw_tap_start(
+        &self,
+        parse: bool,
+        callback: impl FnMut(&[u8]) + Send + 'static,
+    ) -> Result<()> {
+        match &self.gps {
+            Some(gps) => {
+                gps.raw_tap_start(parse, callback);
+                Ok(())
+            }
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::raw_tap_to_file]
+    pub fn gps_raw_tap_to_file(
+        &self,
+        parse: bool,
+        path: impl AsRef<std::path::Path>,
+    ) -> Result<()> {
+        match &self.gps {
+            Some(gps) => gps.raw_tap_to_file(parse, path),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::raw_tap_stop]
+    pub fn gps_raw_tap_stop(&self) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => Ok(gps.raw_tap_stop()),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::metrics_start]
+    pub fn gps_metrics_start(&self, config: MetricsConfig) -> Result<()> {
+        match &self.gps {
+            Some(gps) => gps.metrics_start(config),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::metrics_stop]
+    pub fn gps_metrics_stop(&self) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => Ok(gps.metrics_stop()),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::metrics]
+    pub fn gps_metrics(&self) -> Result<FixMetrics> {
+        match &self.gps {
+            Some(gps) => gps.metrics(),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::metrics_reset_odometer]
+    pub fn gps_metrics_reset_odometer(&self) -> Result<()> {
+        match &self.gps {
+            Some(gps) => gps.metrics_reset_odometer(),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::geofence_add]
+    pub fn gps_geofence_add(&self, vertices: &[(f64, f64)]) -> Result<u32> {
+        match &self.gps {
+            Some(gps) => gps.geofence_add(vertices),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::geofence_remove]
+    pub fn gps_geofence_remove(&self, id: u32) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.geofence_remove(id),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
+
+    /// See [GPSDevice::fix_log_stop]
+    pub fn gps_fix_log_stop(&self) -> Result<bool> {
+        match &self.gps {
+            Some(gps) => gps.fix_log_stop(),
+            None => Err(crate::types::Error::InvalidDevice(
+                "GPS device isn't available".to_string(),
+            )),
+        }
+    }
 }
 
 #[cfg(test)]
@@ -442,6 +1131,65 @@ mod tests {
         devices
     }
 
+    #[test]
+    fn test_take_gps() {
+        let gps = |port_name: &str, usb_port_path: Option<&str>| {
+            let mut gps = GPSDevice::default();
+            gps.port_name = port_name.to_string();
+            gps.vid = NEOVI_MIC_GPS_VID;
+            gps.pid = NEOVI_MIC_GPS_PID;
+            gps.usb_port_path = usb_port_path.map(str::to_string);
+            gps
+        };
+        let usb_info = UsbDeviceInfo {
+            vendor_id: NEOVI_MIC_GPS_VID,
+            product_id: NEOVI_MIC_GPS_PID,
+            bus_number: 1,
+            address: 0,
+            device_type: UsbDeviceType::GPS,
+            serial_number: None,
+        };
+        let mut gps_devices = vec![
+            gps("/dev/ttyACM0", Some("1-2.3")),
+            gps("/dev/ttyACM1", Some("1-4.3")),
+        ];
+        let second = take_gps(&mut gps_devices, &usb_info, Some("1-4.3")).unwrap();
+        assert_eq!(second.port_name, "/dev/ttyACM1");
+        assert!(take_gps(&mut gps_devices, &usb_info, Some("1-4.3")).is_none());
+        assert!(take_gps(&mut gps_devices, &usb_info, Some("2-1.3")).is_none());
+        assert_eq!(gps_devices.len(), 1);
+
+        // Without port paths every hub still gets a port of its own
+        let mut gps_devices = vec![gps("COM3", None), gps("COM4", None)];
+        let first = take_gps(&mut gps_devices, &usb_info, Some("1-2.3")).unwrap();
+        let second = take_gps(&mut gps_devices, &usb_info, None).unwrap();
+        assert_eq!(
+            (first.port_name.as_str(), second.port_name.as_str()),
+            ("COM3", "COM4")
+        );
+        assert!(take_gps(&mut gps_devices, &usb_info, None).is_none());
+    }
+
+    #[test]
+    fn test_open_all() {
+        // Defaults have no subsystems, every requested one fails on its own
+        let devices = vec![NeoVIMIC::default(), NeoVIMIC::default()];
+        let results = open_all(
+            &devices,
+            Subsystem::Io | Subsystem::Gps,
+            &GpsConfig::default(),
+        );
+        assert_eq!(results.len(), 2);
+        for result in &results {
+            assert!(matches!(result.io, Some(Err(_))));
+            assert!(matches!(result.gps, Some(Err(Error::InvalidDevice(_)))));
+            assert!(!result.is_ok());
+        }
+        let result = devices[0].open(Subsystem::Gps.into(), &GpsConfig::default());
+        assert!(result.io.is_none());
+        assert!(OpenResult::default().is_ok());
+    }
+
     #[test]
     fn test_find_neovi_mics() {
         let devices = _get_devices();
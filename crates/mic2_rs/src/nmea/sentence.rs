@@ -1,6 +1,6 @@
 use super::types::{
-    nmea_str_to_vec, GpsDataFromNmeaString, GsaData, GstData, GsvDataCollection, NMEAError,
-    NMEASentenceType, Pubx00Data, Pubx03Data, Pubx04Data,
+    GpsDataFromNmeaString, GsaData, GstData, GsvDataCollection, NMEAError, NMEASentenceType,
+    Pubx00Data, Pubx03Data, Pubx04Data,
 };
 
 /// Represents a GPS NMEA Sentence
@@ -66,51 +66,94 @@ impl NMEASentence {
     /// Checks the NMEA sentence to see if it contains a $ at the beginning of the sentence.
     /// Returns true if it contains a $ at the start, false otherwise.
     pub fn is_start<'a>(sentence: impl Into<&'a str>) -> bool {
-        // match checksum pattern at the end of a nmea sentence. * followed by two hexidecimal digits
-        regex::Regex::new(r"^\$").unwrap().is_match(sentence.into())
+        sentence.into().starts_with('$')
     }
 
     /// Checks the NMEA sentence to see if it contains a checksum at the end.
     /// Returns true if it contains a checksum, false otherwise.
     pub fn contains_checksum<'a>(sentence: impl Into<&'a str>) -> bool {
         // match checksum pattern at the end of a nmea sentence. * followed by two hexidecimal digits
-        regex::Regex::new(r"\*[0-9a-fA-F]{2}")
-            .unwrap()
-            .is_match(sentence.into())
+        sentence
+            .into()
+            .as_bytes()
+            .windows(3)
+            .any(|w| w[0] == b'*' && w[1].is_ascii_hexdigit() && w[2].is_ascii_hexdigit())
+    }
+
+    /// Verifies the checksum of a complete sentence in "$...*HH" form, trailing CR/LF is ignored.
+    /// The checksum is the XOR of every character between the $ and the *.
+    pub fn verify_checksum(sentence: &[u8]) -> bool {
+        let end = sentence
+            .iter()
+            .rposition(|b| !matches!(b, b'\r' | b'\n'))
+            .map_or(0, |i| i + 1);
+        let sentence = &sentence[..end];
+        if sentence.len() < 4 || sentence[0] != b'$' || sentence[sentence.len() - 3] != b'*' {
+            return false;
+        }
+        let (body, checksum) = sentence[1..].split_at(sentence.len() - 4);
+        let expected = match (hex_value(checksum[1]), hex_value(checksum[2])) {
+            (Some(high), Some(low)) => high << 4 | low,
+            _ => return false,
+        };
+        body.iter().fold(0u8, |acc, b| acc ^ b) == expected
     }
 
     /// Returns the NMEASentenceType for parsing, NMEAError on error.
     pub fn data(&self) -> Result<NMEASentenceType, NMEAError> {
-        // Split the raw data into a vec
-        let items = nmea_str_to_vec(&self.inner);
-        match &items[0][0..] {
-            "$GNGST" | "$GPGST" => Ok(NMEASentenceType::GST(GstData::from_nmea_str(&self.inner)?)),
-            "$GNGSA" | "$GPGSA" => Ok(NMEASentenceType::GSA(GsaData::from_nmea_str(&self.inner)?)),
+        Self::parse(&self.inner)
+    }
+
+    /// Parses a single sentence without creating a [NMEASentence]. Returns the
+    /// NMEASentenceType, NMEAError on error.
+    pub fn parse(sentence: &str) -> Result<NMEASentenceType, NMEAError> {
+        // Pick the parser from the address field before the sentence is tokenized
+        match sentence.split(',').next().unwrap_or_default() {
+            "$GNGST" | "$GPGST" => Ok(NMEASentenceType::GST(GstData::from_nmea_str(sentence)?)),
+            "$GNGSA" | "$GPGSA" => Ok(NMEASentenceType::GSA(GsaData::from_nmea_str(sentence)?)),
             "$GNGSV" | "$GPGSV" => Ok(NMEASentenceType::GSV(GsvDataCollection::from_nmea_str(
-                &self.inner,
+                sentence,
+            )?)),
+            // "GLL" => Ok(NMEASentenceType::GLL(GllData::from_nmea_str(sentence)?)),
+            // "GGA" => Ok(NMEASentenceType::GGA(GgaData::from_nmea_str(sentence)?)),
+            // "VTG" => Ok(NMEASentenceType::VTG(VtgData::from_nmea_str(sentence)?)),
+            // "RMC" => Ok(NMEASentenceType::RMC(RmcData::from_nmea_str(sentence)?)),
+            // "GNTXT" => Ok(NMEASentenceType::GNTXT(GNTXTData::from_nmea_str(sentence)?)),
+            _ => Self::parse_pubx(sentence),
+        }
+    }
+
+    /// Parses a single PUBX,00, PUBX,03 or PUBX,04 sentence, the only ones GPSInfo is built
+    /// from. Anything else is rejected with [NMEAError::Unsupported] from its prefix alone,
+    /// without tokenizing or allocating.
+    pub fn parse_pubx(sentence: &str) -> Result<NMEASentenceType, NMEAError> {
+        let Some(fields) = sentence.strip_prefix("$PUBX,") else {
+            return Err(NMEAError::Unsupported);
+        };
+        match fields.split([',', '*']).next() {
+            Some("00") => Ok(NMEASentenceType::PUBX00(Pubx00Data::from_nmea_str(
+                sentence,
+            )?)),
+            Some("03") => Ok(NMEASentenceType::PUBX03(Pubx03Data::from_nmea_str(
+                sentence,
             )?)),
-            // "GLL" => Ok(NMEASentenceType::GLL(GllData::from_nmea_str(&self.inner)?)),
-            // "GGA" => Ok(NMEASentenceType::GGA(GgaData::from_nmea_str(&self.inner)?)),
-            // "VTG" => Ok(NMEASentenceType::VTG(VtgData::from_nmea_str(&self.inner)?)),
-            // "RMC" => Ok(NMEASentenceType::RMC(RmcData::from_nmea_str(&self.inner)?)),
-            // "GNTXT" => Ok(NMEASentenceType::GNTXT(GNTXTData::from_nmea_str(&self.inner)?)),
-            "$PUBX" => match items[1] {
-                "00" => Ok(NMEASentenceType::PUBX00(Pubx00Data::from_nmea_str(
-                    &self.inner,
-                )?)),
-                "03" => Ok(NMEASentenceType::PUBX03(Pubx03Data::from_nmea_str(
-                    &self.inner,
-                )?)),
-                "04" => Ok(NMEASentenceType::PUBX04(Pubx04Data::from_nmea_str(
-                    &self.inner,
-                )?)),
-                _ => Err(NMEAError::InvalidData(self.inner.to_owned())),
-            },
-            _ => Err(NMEAError::InvalidData(self.inner.to_owned())),
+            Some("04") => Ok(NMEASentenceType::PUBX04(Pubx04Data::from_nmea_str(
+                sentence,
+            )?)),
+            _ => Err(NMEAError::Unsupported),
         }
     }
 }
 
+fn hex_value(c: u8) -> Option<u8> {
+    match c {
+        b'0'..=b'9' => Some(c - b'0'),
+        b'a'..=b'f' => Some(c - b'a' + 10),
+        b'A'..=b'F' => Some(c - b'A' + 10),
+        _ => None,
+    }
+}
+
 #[cfg(test)]
 mod test {
     use super::*;
@@ -140,6 +183,37 @@ mod test {
         println!("{data:#?}");
     }
 
+    #[test]
+    fn test_nmea_sentence_gsv_unsupported() {
+        let sentence = "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74";
+        assert!(matches!(
+            NMEASentence::parse(sentence),
+            Err(NMEAError::InvalidData(_))
+        ));
+    }
+
+    #[test]
+    fn test_nmea_sentence_unsupported() {
+        assert_eq!(
+            NMEASentence::parse("$GNTXT,01,01,02,u-blox AG - www.u-blox.com*4E").unwrap_err(),
+            NMEAError::Unsupported
+        );
+        assert_eq!(
+            NMEASentence::parse("$PUBX,41,1,0007,0003,115200,0*18").unwrap_err(),
+            NMEAError::Unsupported
+        );
+        // Parsed by parse() but never used for GPSInfo, so parse_pubx() skips it untouched
+        assert_eq!(
+            NMEASentence::parse_pubx("$GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47*17")
+                .unwrap_err(),
+            NMEAError::Unsupported
+        );
+        assert!(matches!(
+            NMEASentence::parse_pubx("$PUBX,03,00*1C"),
+            Ok(NMEASentenceType::PUBX03(_))
+        ));
+    }
+
     #[test]
     fn test_pubx00_sentence() {
         let sentence =
@@ -155,6 +229,21 @@ mod test {
         println!("{data:#?}");
     }
 
+    #[test]
+    fn test_verify_checksum() {
+        assert!(NMEASentence::verify_checksum(b"$PUBX,03,00*1C\r\n"));
+        assert!(NMEASentence::verify_checksum(
+            b"$GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47*17"
+        ));
+        assert!(!NMEASentence::verify_checksum(b"$PUBX,03,01*1C\r\n"));
+        assert!(!NMEASentence::verify_checksum(b"$PUBX,03,00*1"));
+        assert!(!NMEASentence::verify_checksum(b"PUBX,03,00*1C"));
+        assert!(NMEASentence::contains_checksum("$PUBX,03,00*1C"));
+        assert!(!NMEASentence::contains_checksum("$PUBX,03,00*"));
+        assert!(NMEASentence::is_start("$PUBX"));
+        assert!(!NMEASentence::is_start("PUBX,$"));
+    }
+
     #[test]
     fn test_pubx03_sentence() {
         let sentence =
@@ -1,4 +1,5 @@
 // https://gpsd.gitlab.io/gpsd/NMEA.html
+use crate::ubx::NavMessage;
 use chrono::{NaiveDate, NaiveDateTime, NaiveTime};
 use std::{
     fmt,
@@ -68,6 +69,8 @@ pub enum NMEAError {
     PartialStart(String),
     Partial(String),
     PartialEnd(String),
+    /// Sentence type that isn't parsed, carries nothing so it can be returned without allocating
+    Unsupported,
 }
 
 impl std::convert::From<ParseIntError> for NMEAError {
@@ -294,8 +297,7 @@ impl GPSDMS {
     // FIXME(drebbe): tolerance seems off
     /// assert!((dec - expected).abs() < 1.0, "{dec} is not approximately equal to {expected}");
     /// ```
-    pub fn from_nmea_str(value: impl Into<String>) -> Result<Self, NMEAError> {
-        let dd_mm: &str = &value.into();
+    pub fn from_nmea_str(dd_mm: &str) -> Result<Self, NMEAError> {
         // Check the length is at least 6 DDMM.MM
         if dd_mm.len() < 7 || !dd_mm.contains('.') {
             return Err(NMEAError::InvalidData(format!(
@@ -404,7 +406,7 @@ impl GPSDMS {
 pub trait GpsDataFromNmeaString {
     type Output;
     /// Creates a GPS Data struct from a standard nmea string
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError>;
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError>;
 }
 
 /// GPS Pseudorange Noise Statistics
@@ -429,19 +431,18 @@ pub struct GstData {
 }
 
 /// Converts a NMEA String into a collection of strings. No copies are made.
-pub fn nmea_str_to_vec<'a, 'b: 'a>(data: impl Into<&'b String>) -> Vec<&'a str> {
-    let items: Vec<&str> = data.into().split(',').flat_map(|v| v.split('*')).collect();
+pub fn nmea_str_to_vec(data: &str) -> Vec<&str> {
+    let items: Vec<&str> = data.split(',').flat_map(|v| v.split('*')).collect();
     items
 }
 
 impl GpsDataFromNmeaString for GstData {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields including the checksum
         const FIELD_COUNT: usize = 10;
-        let data: String = data.into();
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         let result = match &items[0][3..] {
             "GST" => {
                 if items.len() != FIELD_COUNT {
@@ -527,11 +528,10 @@ pub struct GsaData {
 impl GpsDataFromNmeaString for GsaData {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields including the checksum
         const FIELD_COUNT: usize = 19;
-        let data: String = data.into();
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         // Note: NMEA 4.1+ systems (u-blox 9, Quectel LCD79) may emit an extra field, System ID, just before the checksum.
         // Example: $GNGSA,A,3,80,71,73,79,69,,,,,,,,1.83,1.09,1.47*17
         let result = match &items[0][3..] {
@@ -619,12 +619,11 @@ pub struct GsvData {
 impl GpsDataFromNmeaString for GsvData {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields including the checksum
         const FIELD_COUNT: usize = 8;
-        let data: String = data.into();
         // Example: $GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         // Note: NMEA 4.1+ systems (u-blox 9, Quectel LCD79) may emit an extra field, System ID, just before the checksum.
         let result = match &items[0][3..] {
             "GSV" => {
@@ -648,7 +647,7 @@ impl GpsDataFromNmeaString for GsvData {
                                     Some(2u32) => Some(SystemID::GLONASS),
                                     Some(3u32) => Some(SystemID::Galileo),
                                     Some(4u32) => Some(SystemID::BeiDou),
-                                    _ => Some(SystemID::Unknown(items[18].to_string())),
+                                    _ => Some(SystemID::Unknown(items[8].to_string())),
                                 }
                             } else {
                                 None
@@ -675,8 +674,11 @@ pub struct GsvDataCollection {
 impl GpsDataFromNmeaString for GsvDataCollection {
     type Output = Self;
 
-    fn from_nmea_str(_data: impl Into<String>) -> Result<Self::Output, NMEAError> {
-        unimplemented!();
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
+        // Not parsed yet, real receivers send GSV so this can't panic
+        Err(NMEAError::InvalidData(format!(
+            "GSV sentences aren't supported: {data}"
+        )))
         // // All fields including the checksum
         // const FIELD_COUNT: usize = 9;
         // let data: String = data.into();
@@ -712,12 +714,11 @@ pub struct GllData {
 impl GpsDataFromNmeaString for GllData {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields including the checksum. NMEA 2.3 and later have 8 fields for FAA mode
         const FIELD_COUNT: usize = 7;
-        let data: String = data.into();
         // Example: $GNGLL,4404.14012,N,12118.85993,W,001037.00,A,A*67
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         // Note: NMEA 2.3+ systems may emit an extra field, FAA mode, just before the checksum.
         let result = match &items[0][3..] {
             "GLL" => {
@@ -839,6 +840,24 @@ impl GpsNavigationStatus {
         }
     }
 }
+/// Signed decimal degrees of a (d)ddmm.mmmmm NMEA coordinate, negative when direction is
+/// `negative`. Unlike [GPSDMS] the fraction of the minutes isn't truncated.
+fn nmea_degrees(ddmm: &str, direction: char, negative: char) -> Result<f64, NMEAError> {
+    let invalid = || NMEAError::InvalidData(format!("Couldn't convert value {ddmm} into degrees"));
+    let dot = ddmm.find('.').ok_or_else(invalid)?;
+    if dot < 3 {
+        return Err(invalid());
+    }
+    let degrees = ddmm[..dot - 2].parse::<u16>()? as f64;
+    let minutes = ddmm[dot - 2..].parse::<f64>()?;
+    let decimal = degrees + minutes / 60.0;
+    Ok(if direction == negative {
+        -decimal
+    } else {
+        decimal
+    })
+}
+
 // 21.2 UBX,00
 #[derive(Clone, Debug, Copy, PartialEq)]
 pub struct Pubx00Data {
@@ -852,6 +871,10 @@ pub struct Pubx00Data {
     pub longitude: GPSDMS,
     /// E/W Indicator, E=east or W=west
     pub e: char,
+    /// Latitude in signed decimal degrees at the full precision of the sentence
+    pub latitude_deg: f64,
+    /// Longitude in signed decimal degrees at the full precision of the sentence
+    pub longitude_deg: f64,
     /// Altitude above user datum ellipsoid (m)
     pub altitude: f64,
     /// Navigation Status. See [GpsNavigationStatus] for more details
@@ -885,12 +908,11 @@ pub struct Pubx00Data {
 impl GpsDataFromNmeaString for Pubx00Data {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields including the checksum
         const FIELD_COUNT: usize = 21;
-        let data: String = data.into();
         // Example: $PUBX,00,025554.00,0000.00000,N,00000.00000,E,0.000,NF,5311696,3755936,0.000,0.00,0.000,,99.99,99.99,99.99,0,0,0*28
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         let result = match &items[0][1..] {
             "PUBX" => {
                 if items.len() < FIELD_COUNT {
@@ -908,6 +930,16 @@ impl GpsDataFromNmeaString for Pubx00Data {
                         n: items[4].chars().next().unwrap_or_default(),
                         longitude: GPSDMS::from_nmea_str(items[5])?,
                         e: items[6].chars().next().unwrap_or_default(),
+                        latitude_deg: nmea_degrees(
+                            items[3],
+                            items[4].chars().next().unwrap_or_default(),
+                            'S',
+                        )?,
+                        longitude_deg: nmea_degrees(
+                            items[5],
+                            items[6].chars().next().unwrap_or_default(),
+                            'W',
+                        )?,
                         altitude: items[7].parse::<f64>()?,
                         nav_stat: GpsNavigationStatus::from_str(items[8])?,
                         h_acc: items[9].parse::<f64>()?,
@@ -974,12 +1006,11 @@ pub struct Pubx03Data {
 impl GpsDataFromNmeaString for Pubx03Data {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields
         const FIELD_COUNT: usize = 4;
-        let data: String = data.into();
         // Example: "$PUBX,03,00*1C\r\n"
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         let result = match &items[0][1..] {
             "PUBX" => {
                 if items.len() < FIELD_COUNT {
@@ -1050,12 +1081,11 @@ pub struct Pubx04Data {
 impl GpsDataFromNmeaString for Pubx04Data {
     type Output = Self;
 
-    fn from_nmea_str(data: impl Into<String>) -> Result<Self::Output, NMEAError> {
+    fn from_nmea_str(data: &str) -> Result<Self::Output, NMEAError> {
         // All fields including the checksum
         const FIELD_COUNT: usize = 10;
-        let data: String = data.into();
         // Example: $PUBX,04,073731.00,091202,113851.00,1196,15D,1930035,-2660.664,43,*3C
-        let items = nmea_str_to_vec(&data);
+        let items = nmea_str_to_vec(data);
         let result = match &items[0][1..] {
             "PUBX" => {
                 if items.len() < FIELD_COUNT {
@@ -1150,6 +1180,11 @@ pub struct GPSInfo {
     pub latitude: Option<(GPSDMS, char)>,
     /// Longitude. See [GPSDMS] for more details. E/W Indicator, E=east or W=west
     pub longitude: Option<(GPSDMS, char)>,
+    /// Latitude in signed decimal degrees at the receiver's precision. [GPSInfo::latitude] is
+    /// rounded to whole arc-seconds, about 31 m.
+    pub latitude_deg: Option<f64>,
+    /// Longitude in signed decimal degrees at the receiver's precision
+    pub longitude_deg: Option<f64>,
     /// Altitude above user datum ellipsoid (m)
     pub altitude: Option<f64>,
     /// Navigation Status. See [GpsNavigationStatus] for more details
@@ -1180,9 +1215,217 @@ pub struct GPSInfo {
     pub clock_drift: Option<f64>,
     /// Timepulse Granularity, The quantization error of the Timepulse pin (ns)
     pub timepulse_granularity: Option<f64>,
+    /// Host monotonic time the last update was received (ns), see [crate::types::monotonic_time_ns].
+    /// Zero means nothing has been received yet.
+    pub monotonic_time_ns: u64,
+    /// Host monotonic time the message carrying current_time was received (ns).
+    /// Zero means current_time hasn't been received yet.
+    pub time_monotonic_ns: u64,
+    /// Incremented on every update applied, zero means nothing has been received yet. Compare
+    /// with [crate::gps::GPSDevice::sequence] to skip copies of unchanged info.
+    pub sequence: u64,
+}
+
+/// Relates the host monotonic clock ([crate::types::monotonic_time_ns]) to GPS UTC time so
+/// host timestamped data, ie. [crate::audio::AudioChunk::monotonic_time_ns], can be placed
+/// on the GPS timeline. See [GPSInfo::clock_mapping].
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct GPSClockMapping {
+    /// UTC time of the navigation epoch
+    pub utc_time: NaiveDateTime,
+    /// Host monotonic time the epoch was received (ns)
+    pub monotonic_time_ns: u64,
+    /// Receiver clock bias (ns) at the epoch. The reported UTC time is already corrected
+    /// for it, it's kept to judge how well the receiver clock is steered.
+    pub clock_bias_ns: Option<f64>,
+    /// Quantization error of the receiver time (ns), the timepulse granularity if known.
+    /// Host receive latency (USB and serial buffering) comes on top of this.
+    pub uncertainty_ns: Option<f64>,
+}
+
+impl GPSClockMapping {
+    /// UTC time of host monotonic time `monotonic_time_ns`.
+    pub fn utc_time_at(&self, monotonic_time_ns: u64) -> NaiveDateTime {
+        let offset_ns = monotonic_time_ns as i64 - self.monotonic_time_ns as i64;
+        self.utc_time + chrono::Duration::nanoseconds(offset_ns)
+    }
+
+    /// Host monotonic time of UTC time `utc_time`, saturates at zero.
+    pub fn monotonic_time_at(&self, utc_time: NaiveDateTime) -> u64 {
+        let offset_ns =
+            (utc_time - self.utc_time)
+                .num_nanoseconds()
+                .unwrap_or(if utc_time > self.utc_time {
+                    i64::MAX
+                } else {
+                    i64::MIN
+                });
+        self.monotonic_time_ns.saturating_add_signed(offset_ns)
+    }
+}
+
+/// Position, velocity and DOP of a [GPSInfo] without the satellites, see [GPSInfo::fix].
+/// It is Copy so it can be stored and shipped at high rates.
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct GPSFix {
+    /// UTC Time, Current time
+    pub current_time: Option<NaiveDateTime>,
+    /// Latitude in decimal degrees, negative is south
+    pub latitude: Option<f64>,
+    /// Longitude in decimal degrees, negative is west
+    pub longitude: Option<f64>,
+    /// Altitude above user datum ellipsoid (m)
+    pub altitude: Option<f64>,
+    /// Navigation Status. See [GpsNavigationStatus] for more details
+    pub nav_stat: Option<GpsNavigationStatus>,
+    /// Horizontal accuracy estimate
+    pub h_acc: Option<f64>,
+    /// Vertical accuracy estimate
+    pub v_acc: Option<f64>,
+    /// Speed over ground (km/h)
+    pub sog_kmh: Option<f64>,
+    /// Course over ground (degrees)
+    pub cog: Option<f64>,
+    /// Vertical velocity, positive = downward (m/s)
+    pub vvel: Option<f64>,
+    /// HDOP, Horizontal Dilution of Precision
+    pub hdop: Option<f64>,
+    /// VDOP, Vertical dilution of precision
+    pub vdop: Option<f64>,
+    /// TDOP, Time dilution of precision
+    pub tdop: Option<f64>,
+    /// Number of satellites in view
+    pub satellites_count: u16,
+    /// Number of satellites used in the solution
+    pub satellites_used: u16,
+    /// Host monotonic time the last update was received (ns), see [crate::types::monotonic_time_ns].
+    pub monotonic_time_ns: u64,
+}
+
+/// [GPSSatellites::flags] bit, the satellite is used in the solution.
+pub const GPS_SAT_USED: u8 = 1 << 0;
+/// [GPSSatellites::flags] bit, the azimuth is valid.
+pub const GPS_SAT_AZIMUTH_VALID: u8 = 1 << 1;
+/// [GPSSatellites::flags] bit, the elevation is valid.
+pub const GPS_SAT_ELEVATION_VALID: u8 = 1 << 2;
+/// [GPSSatellites::flags] bit, the snr is valid.
+pub const GPS_SAT_SNR_VALID: u8 = 1 << 3;
+
+/// Satellites of a [GPSInfo] as one array per field, see [GPSInfo::satellites_soa]. Index i
+/// of every array describes the same satellite, invalid values are zero and flagged in flags.
+#[derive(Clone, Debug, Default, PartialEq)]
+pub struct GPSSatellites {
+    /// Satellite PRN number
+    pub prn: Vec<u16>,
+    /// Signal strength (C/N0, range 0-99)
+    pub snr: Vec<u8>,
+    /// Satellite elevation, range 00..90 (degrees)
+    pub elevation: Vec<u16>,
+    /// Satellite azimuth, range 000..359 (degrees)
+    pub azimuth: Vec<u16>,
+    /// GPS_SAT_* bits
+    pub flags: Vec<u8>,
+}
+
+impl GPSSatellites {
+    pub fn len(&self) -> usize {
+        self.prn.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.prn.is_empty()
+    }
+
+    fn push(&mut self, sat: &GPSSatInfo) {
+        let mut flags = 0;
+        for (set, flag) in [
+            (sat.used, GPS_SAT_USED),
+            (sat.azimuth.is_some(), GPS_SAT_AZIMUTH_VALID),
+            (sat.elevation.is_some(), GPS_SAT_ELEVATION_VALID),
+            (sat.snr.is_some(), GPS_SAT_SNR_VALID),
+        ] {
+            if set {
+                flags |= flag;
+            }
+        }
+        self.prn.push(sat.prn);
+        self.snr.push(sat.snr.unwrap_or(0));
+        self.elevation.push(sat.elevation.unwrap_or(0));
+        self.azimuth.push(sat.azimuth.unwrap_or(0));
+        self.flags.push(flags);
+    }
 }
 
 impl GPSInfo {
+    /// Returns the position, velocity and DOP without copying the satellites, see [GPSFix].
+    /// The position comes from latitude_deg/longitude_deg when they are set.
+    pub fn fix(&self) -> GPSFix {
+        let signed = |coordinate: &Option<(GPSDMS, char)>, negative: char| {
+            coordinate.map(|(dms, direction)| {
+                let decimal = dms.to_decimal(7);
+                if direction == negative {
+                    -decimal
+                } else {
+                    decimal
+                }
+            })
+        };
+        GPSFix {
+            current_time: self.current_time,
+            latitude: self.latitude_deg.or_else(|| signed(&self.latitude, 'S')),
+            longitude: self.longitude_deg.or_else(|| signed(&self.longitude, 'W')),
+            altitude: self.altitude,
+            nav_stat: self.nav_stat,
+            h_acc: self.h_acc,
+            v_acc: self.v_acc,
+            sog_kmh: self.sog_kmh,
+            cog: self.cog,
+            vvel: self.vvel,
+            hdop: self.hdop,
+            vdop: self.vdop,
+            tdop: self.tdop,
+            satellites_count: self.satellites.len().try_into().unwrap_or(u16::MAX),
+            satellites_used: self
+                .satellites
+                .iter()
+                .filter(|sat| sat.used)
+                .count()
+                .try_into()
+                .unwrap_or(u16::MAX),
+            monotonic_time_ns: self.monotonic_time_ns,
+        }
+    }
+
+    /// Returns the satellites as one array per field, see [GPSSatellites].
+    pub fn satellites_soa(&self) -> GPSSatellites {
+        let count = self.satellites.len();
+        let mut satellites = GPSSatellites {
+            prn: Vec::with_capacity(count),
+            snr: Vec::with_capacity(count),
+            elevation: Vec::with_capacity(count),
+            azimuth: Vec::with_capacity(count),
+            flags: Vec::with_capacity(count),
+        };
+        for sat in &self.satellites {
+            satellites.push(sat);
+        }
+        satellites
+    }
+
+    /// Returns the mapping between the host monotonic clock and current_time, None until
+    /// the time has been received.
+    pub fn clock_mapping(&self) -> Option<GPSClockMapping> {
+        if self.time_monotonic_ns == 0 {
+            return None;
+        }
+        Some(GPSClockMapping {
+            utc_time: self.current_time?,
+            monotonic_time_ns: self.time_monotonic_ns,
+            clock_bias_ns: self.clock_bias,
+            uncertainty_ns: self.timepulse_granularity,
+        })
+    }
+
     pub fn update_from_nmea_sentence(&mut self, sentence: &NMEASentenceType) {
         match &sentence {
             NMEASentenceType::PUBX00(data) => {
@@ -1197,6 +1440,8 @@ impl GPSInfo {
                 }
                 self.latitude = Some((data.latitude, data.n));
                 self.longitude = Some((data.longitude, data.e));
+                self.latitude_deg = Some(data.latitude_deg);
+                self.longitude_deg = Some(data.longitude_deg);
                 self.altitude = Some(data.altitude);
                 self.nav_stat = Some(data.nav_stat);
                 self.h_acc = Some(data.h_acc);
@@ -1223,6 +1468,94 @@ impl GPSInfo {
             }
         }
     }
+    /// Update from a binary UBX-NAV message, see [crate::ubx::NavMessage].
+    pub fn update_from_ubx_message(&mut self, message: &NavMessage) {
+        match message {
+            NavMessage::Pvt(pvt) => {
+                // validDate and validTime
+                if pvt.valid & 0x03 == 0x03 {
+                    self.current_time =
+                        NaiveDate::from_ymd_opt(pvt.year.into(), pvt.month.into(), pvt.day.into())
+                            .and_then(|d| {
+                                d.and_hms_opt(pvt.hour.into(), pvt.min.into(), pvt.sec.into())
+                            })
+                            .map(|t| t + chrono::Duration::nanoseconds(pvt.nano.into()))
+                            .or(self.current_time);
+                }
+                let latitude = pvt.lat as f64 * 1e-7;
+                let longitude = pvt.lon as f64 * 1e-7;
+                self.latitude = Some((
+                    dms_from_degrees(latitude),
+                    if latitude < 0.0 { 'S' } else { 'N' },
+                ));
+                self.longitude = Some((
+                    dms_from_degrees(longitude),
+                    if longitude < 0.0 { 'W' } else { 'E' },
+                ));
+                self.latitude_deg = Some(latitude);
+                self.longitude_deg = Some(longitude);
+                self.altitude = Some(pvt.height as f64 / 1000.0);
+                let gnss_fix_ok = pvt.flags & 0x01 != 0;
+                let differential = pvt.flags & 0x02 != 0;
+                self.nav_stat = Some(match (pvt.fix_type, gnss_fix_ok, differential) {
+                    (1, _, _) => GpsNavigationStatus::DeadReckoningOnly,
+                    (2, true, false) => GpsNavigationStatus::StandAlone2D,
+                    (2, true, true) => GpsNavigationStatus::Differential2D,
+                    (3, true, false) => GpsNavigationStatus::StandAlone3D,
+                    (3, true, true) => GpsNavigationStatus::Differential3D,
+                    (4, true, _) => GpsNavigationStatus::CombinedRKGPSDeadReckoning,
+                    (5, _, _) => GpsNavigationStatus::TimeOnly,
+                    _ => GpsNavigationStatus::NoFix,
+                });
+                self.h_acc = Some(pvt.h_acc as f64 / 1000.0);
+                self.v_acc = Some(pvt.v_acc as f64 / 1000.0);
+                // mm/s to km/h
+                self.sog_kmh = Some(pvt.g_speed as f64 * 0.0036);
+                self.cog = Some(pvt.head_mot as f64 * 1e-5);
+                self.vvel = Some(pvt.vel_d as f64 / 1000.0);
+            }
+            NavMessage::Dop(dop) => {
+                self.hdop = Some(dop.h_dop as f64 * 0.01);
+                self.vdop = Some(dop.v_dop as f64 * 0.01);
+                self.tdop = Some(dop.t_dop as f64 * 0.01);
+            }
+            NavMessage::Clock(clock) => {
+                self.clock_bias = Some(clock.clk_b.into());
+                self.clock_drift = Some(clock.clk_d.into());
+            }
+            NavMessage::Sat(sat) => {
+                self.satellites.clear();
+                self.satellites.extend(sat.satellites().map(|sv| {
+                    let elevation_valid = (-90..=90).contains(&sv.elev);
+                    GPSSatInfo {
+                        // Match the NMEA numbering, GLONASS is 65..96
+                        prn: if sv.gnss_id == 6 {
+                            sv.sv_id as u16 + 64
+                        } else {
+                            sv.sv_id.into()
+                        },
+                        used: sv.used(),
+                        azimuth: (elevation_valid && (0..=360).contains(&sv.azim))
+                            .then_some(sv.azim as u16),
+                        elevation: (0..=90).contains(&sv.elev).then_some(sv.elev as u16),
+                        snr: (sv.cno > 0).then_some(sv.cno),
+                        lock_time: 0,
+                    }
+                }));
+            }
+        }
+    }
+}
+
+/// Absolute decimal degrees to [GPSDMS], the sign is carried by the N/S E/W indicator. Rounded
+/// to the nearest arc-second, truncating would be off by up to a whole one.
+fn dms_from_degrees(decimal_degrees: f64) -> GPSDMS {
+    let seconds = (decimal_degrees.abs() * 3600.0).round() as u32;
+    GPSDMS::new(
+        (seconds / 3600) as u16,
+        (seconds / 60 % 60) as u8,
+        (seconds % 60) as u8,
+    )
 }
 
 #[cfg(test)]
@@ -1231,6 +1564,102 @@ mod tests {
 
     use super::*;
 
+    #[test]
+    fn test_clock_mapping() {
+        let mut gps_info = GPSInfo::default();
+        assert!(gps_info.clock_mapping().is_none());
+        let utc_time = NaiveDate::from_ymd_opt(2024, 6, 15)
+            .unwrap()
+            .and_hms_milli_opt(12, 30, 45, 0)
+            .unwrap();
+        gps_info.current_time = Some(utc_time);
+        gps_info.time_monotonic_ns = 5_000_000_000;
+        gps_info.timepulse_granularity = Some(21.0);
+        let mapping = gps_info.clock_mapping().unwrap();
+        assert_eq!(mapping.uncertainty_ns, Some(21.0));
+        assert_eq!(
+            mapping.utc_time_at(5_250_000_000),
+            utc_time + chrono::Duration::milliseconds(250)
+        );
+        assert_eq!(
+            mapping.utc_time_at(4_000_000_000),
+            utc_time - chrono::Duration::seconds(1)
+        );
+        assert_eq!(
+            mapping.monotonic_time_at(utc_time + chrono::Duration::microseconds(1500)),
+            5_001_500_000
+        );
+        assert_eq!(
+            mapping.monotonic_time_at(utc_time - chrono::Duration::seconds(10)),
+            0
+        );
+    }
+
+    #[test]
+    fn test_fix_and_satellites() {
+        let gps_info = GPSInfo {
+            latitude: Some((GPSDMS::new(42, 30, 0), 'S')),
+            longitude: Some((GPSDMS::new(83, 15, 0), 'E')),
+            hdop: Some(1.5),
+            satellites: vec![
+                GPSSatInfo {
+                    prn: 5,
+                    used: true,
+                    azimuth: Some(120),
+                    elevation: Some(45),
+                    snr: Some(38),
+                    lock_time: 64,
+                },
+                GPSSatInfo {
+                    prn: 12,
+                    used: false,
+                    azimuth: None,
+                    elevation: Some(10),
+                    snr: None,
+                    lock_time: 0,
+                },
+            ],
+            monotonic_time_ns: 42,
+            ..Default::default()
+        };
+        let fix = gps_info.fix();
+        assert_eq!(fix.latitude, Some(-42.5));
+        assert_eq!(fix.longitude, Some(83.25));
+        assert_eq!(fix.hdop, Some(1.5));
+        assert_eq!(fix.altitude, None);
+        assert_eq!((fix.satellites_count, fix.satellites_used), (2, 1));
+        assert_eq!(fix.monotonic_time_ns, 42);
+
+        let satellites = gps_info.satellites_soa();
+        assert_eq!(satellites.len(), 2);
+        assert_eq!(satellites.prn, [5, 12]);
+        assert_eq!(satellites.snr, [38, 0]);
+        assert_eq!(satellites.elevation, [45, 10]);
+        assert_eq!(satellites.azimuth, [120, 0]);
+        assert_eq!(
+            satellites.flags,
+            [
+                GPS_SAT_USED | GPS_SAT_AZIMUTH_VALID | GPS_SAT_ELEVATION_VALID | GPS_SAT_SNR_VALID,
+                GPS_SAT_ELEVATION_VALID
+            ]
+        );
+        assert!(GPSInfo::default().satellites_soa().is_empty());
+    }
+
+    #[test]
+    fn test_pubx00_degrees() {
+        let sentence = "$PUBX,00,081350.00,4717.112671,N,00833.914843,W,546.589,G3,2.1,2.0,0.007,77.52,0.007,,0.92,1.19,0.77,9,0,0*5F";
+        let data = Pubx00Data::from_nmea_str(sentence).unwrap();
+        assert!((data.latitude_deg - 47.285_211_18).abs() < 1e-8);
+        assert!((data.longitude_deg + 8.565_247_38).abs() < 1e-8);
+        let mut gps_info = GPSInfo::default();
+        gps_info.update_from_nmea_sentence(&NMEASentenceType::PUBX00(data));
+        let fix = gps_info.fix();
+        assert_eq!(fix.latitude, Some(data.latitude_deg));
+        assert_eq!(fix.longitude, Some(data.longitude_deg));
+        assert!(nmea_degrees("17.1", 'N', 'S').is_err());
+    }
+
     #[test]
     #[should_panic] // FIXME: not yet implemented
     fn test_gps_dms() {
@@ -1284,7 +1713,7 @@ mod tests {
             ("18099.70", GPSDMS::new(180, 99, 42)),
         ]);
         for (nmea_str, dms) in &nmea_str_map {
-            let new_dms = GPSDMS::from_nmea_str(nmea_str.to_string()).unwrap();
+            let new_dms = GPSDMS::from_nmea_str(nmea_str).unwrap();
             let degree = new_dms.to_decimal(3);
             assert_eq!(new_dms.degrees, dms.degrees);
             assert_eq!(new_dms.minutes, dms.minutes);
@@ -1307,4 +1736,16 @@ mod tests {
         assert!((dms.to_decimal() - 38.8897).abs() < f64::EPSILON, "{} is not approximately equal to {}", dms.to_decimal(), 38.8897);
         */
     }
+
+    #[test]
+    fn test_dms_from_degrees() {
+        // 59.9996 arc-seconds round up into the next minute and degree
+        assert_eq!(
+            dms_from_degrees(47.0 + 59.0 / 60.0 + 59.9996 / 3600.0),
+            GPSDMS::new(48, 0, 0)
+        );
+        assert_eq!(dms_from_degrees(-8.565247), GPSDMS::new(8, 33, 55));
+        assert_eq!(dms_from_degrees(0.0001), GPSDMS::new(0, 0, 0));
+        assert_eq!(dms_from_degrees(0.00015), GPSDMS::new(0, 0, 1));
+    }
 }
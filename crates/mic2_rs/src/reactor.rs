@@ -0,0 +1,555 @@
+//! Shared event loop servicing every GPS serial port and IO button monitor attached to it from
+//! one thread, instead of a thread per device. Opt-in, see [crate::mic::NeoVIMIC::set_reactor].
+//!
+//! Ports are waited on with poll(2) so an idle reactor sleeps until a port has data or a button
+//! monitor is due for its next sample. poll keeps this portable across Linux and macOS and is
+//! cheap at the handful of ports a host has. Windows has no readiness API for serial ports,
+//! [Reactor::new] fails with [Error::NotSupported] there and devices keep their own threads.
+use crate::types::{Error, Result};
+use std::{
+    sync::{Arc, Condvar, Mutex},
+    thread::{JoinHandle, ThreadId},
+    time::{Duration, Instant},
+};
+
+/// Called from the reactor thread when its source is ready, returns false to be removed.
+pub(crate) type ReactorHandler = Box<dyn FnMut() -> bool + Send>;
+
+type SourceId = u64;
+
+enum SourceKind {
+    /// Ready when the file descriptor is readable or hung up.
+    #[cfg(unix)]
+    Fd(std::os::unix::io::RawFd),
+    /// Ready every interval, late runs are not made up.
+    Timer { interval: Duration, next: Instant },
+}
+
+struct Source {
+    id: SourceId,
+    kind: SourceKind,
+    handler: ReactorHandler,
+}
+
+#[derive(Default)]
+struct ReactorState {
+    next_id: SourceId,
+    /// Sources not picked up by the reactor thread yet
+    added: Vec<Source>,
+    /// Sources to drop on the next loop
+    removing: Vec<SourceId>,
+    /// Every source that hasn't been dropped yet
+    live: Vec<SourceId>,
+    running: bool,
+}
+
+struct Shared {
+    state: Mutex<ReactorState>,
+    /// Signaled every time the reactor thread drops sources
+    dropped: Condvar,
+    waker: sys::Waker,
+    thread_id: Mutex<Option<ThreadId>>,
+}
+
+impl Shared {
+    fn on_reactor_thread(&self) -> bool {
+        *self.thread_id.lock().unwrap() == Some(std::thread::current().id())
+    }
+
+    /// Drop sources outside of the state lock, their handlers may close devices.
+    fn drop_sources(&self, sources: Vec<Source>) {
+        if sources.is_empty() {
+            return;
+        }
+        let ids: Vec<SourceId> = sources.iter().map(|s| s.id).collect();
+        drop(sources);
+        self.state
+            .lock()
+            .unwrap()
+            .live
+            .retain(|id| !ids.contains(id));
+        self.dropped.notify_all();
+    }
+}
+
+/// Owns the reactor thread, stopped when dropped. Sources still attached are dropped with it,
+/// their ports close and devices report not open.
+pub struct Reactor {
+    handle: ReactorHandle,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl std::fmt::Debug for Reactor {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("Reactor").finish_non_exhaustive()
+    }
+}
+
+/// Shared reference to a [Reactor] held by the devices attached to it. Sources can't be added
+/// once the reactor is dropped.
+#[derive(Clone)]
+pub struct ReactorHandle {
+    shared: Arc<Shared>,
+}
+
+impl std::fmt::Debug for ReactorHandle {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("ReactorHandle").finish_non_exhaustive()
+    }
+}
+
+/// Keeps a source attached to the reactor, removes it when dropped. Dropping waits for a
+/// running handler to return unless it is dropped from the reactor thread itself.
+pub(crate) struct Registration {
+    shared: Arc<Shared>,
+    id: SourceId,
+}
+
+impl std::fmt::Debug for Registration {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("Registration")
+            .field("id", &self.id)
+            .finish()
+    }
+}
+
+impl Drop for Registration {
+    fn drop(&mut self) {
+        let shared = &self.shared;
+        let mut state = shared.state.lock().unwrap();
+        if !state.live.contains(&self.id) {
+            return;
+        }
+        state.removing.push(self.id);
+        shared.waker.wake();
+        if shared.on_reactor_thread() {
+            return;
+        }
+        let _state = shared
+            .dropped
+            .wait_while(state, |s| s.running && s.live.contains(&self.id))
+            .unwrap();
+    }
+}
+
+impl Reactor {
+    /// Start the reactor thread.
+    pub fn new() -> Result<Self> {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(ReactorState {
+                running: true,
+                ..Default::default()
+            }),
+            dropped: Condvar::new(),
+            waker: sys::Waker::new()?,
+            thread_id: Mutex::new(None),
+        });
+        let thread = {
+            let shared = shared.clone();
+            std::thread::Builder::new()
+                .name("mic2-reactor".into())
+                .spawn(move || run(&shared))
+                .map_err(|e| Error::CriticalError(format!("Failed to start reactor: {e}")))?
+        };
+        *shared.thread_id.lock().unwrap() = Some(thread.thread().id());
+        Ok(Self {
+            handle: ReactorHandle { shared },
+            thread: Some(thread),
+        })
+    }
+
+    pub fn handle(&self) -> ReactorHandle {
+        self.handle.clone()
+    }
+}
+
+impl Drop for Reactor {
+    fn drop(&mut self) {
+        self.handle.shared.state.lock().unwrap().running = false;
+        self.handle.shared.waker.wake();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+impl ReactorHandle {
+    fn add(&self, kind: SourceKind, handler: ReactorHandler) -> Result<Registration> {
+        let mut state = self.shared.state.lock().unwrap();
+        if !state.running {
+            return Err(Error::InvalidDevice("Reactor has been stopped".into()));
+        }
+        let id = state.next_id;
+        state.next_id += 1;
+        state.added.push(Source { id, kind, handler });
+        state.live.push(id);
+        self.shared.waker.wake();
+        Ok(Registration {
+            shared: self.shared.clone(),
+            id,
+        })
+    }
+
+    /// Call handler every time fd is readable, hung up or in error.
+    #[cfg(unix)]
+    pub(crate) fn add_fd(
+        &self,
+        fd: std::os::unix::io::RawFd,
+        handler: ReactorHandler,
+    ) -> Result<Registration> {
+        self.add(SourceKind::Fd(fd), handler)
+    }
+
+    /// Call handler every interval, starting now.
+    pub(crate) fn add_timer(
+        &self,
+        interval: Duration,
+        handler: ReactorHandler,
+    ) -> Result<Registration> {
+        self.add(
+            SourceKind::Timer {
+                interval,
+                next: Instant::now(),
+            },
+            handler,
+        )
+    }
+}
+
+/// Stops the reactor when its thread exits, including by a handler panicking. Sources that
+/// were never picked up are dropped and anyone waiting in [Registration]'s drop is woken up.
+struct StopGuard<'a>(&'a Shared);
+
+impl Drop for StopGuard<'_> {
+    fn drop(&mut self) {
+        let shared = self.0;
+        let added = {
+            let mut state = shared.state.lock().unwrap_or_else(|e| e.into_inner());
+            state.running = false;
+            std::mem::take(&mut state.added)
+        };
+        drop(added);
+        shared
+            .state
+            .lock()
+            .unwrap_or_else(|e| e.into_inner())
+            .live
+            .clear();
+        shared.dropped.notify_all();
+    }
+}
+
+/// Reactor thread main loop.
+fn run(shared: &Shared) {
+    // Declared first so the sources are dropped before it runs
+    let _stop = StopGuard(shared);
+    let mut sources: Vec<Source> = Vec::new();
+    loop {
+        let removing = {
+            let mut state = shared.state.lock().unwrap();
+            if !state.running {
+                break;
+            }
+            sources.append(&mut state.added);
+            std::mem::take(&mut state.removing)
+        };
+        let (removed, kept): (Vec<_>, Vec<_>) =
+            sources.into_iter().partition(|s| removing.contains(&s.id));
+        sources = kept;
+        shared.drop_sources(removed);
+
+        let now = Instant::now();
+        let timeout = sources
+            .iter()
+            .filter_map(|s| match s.kind {
+                SourceKind::Timer { next, .. } => Some(next.saturating_duration_since(now)),
+                #[cfg(unix)]
+                SourceKind::Fd(_) => None,
+            })
+            .min();
+        let ready = shared.waker.wait(&sources, timeout);
+
+        let now = Instant::now();
+        let mut finished = Vec::new();
+        for (i, source) in sources.iter_mut().enumerate() {
+            let due = match &mut source.kind {
+                #[cfg(unix)]
+                SourceKind::Fd(_) => ready.contains(&i),
+                SourceKind::Timer { interval, next } => {
+                    let due = *next <= now;
+                    if due {
+                        // Keep a steady rate regardless of how long the handler takes
+                        *next += *interval;
+                        if *next <= now {
+                            *next = now;
+                        }
+                    }
+                    due
+                }
+            };
+            if due && !(source.handler)() {
+                finished.push(source.id);
+            }
+        }
+        if !finished.is_empty() {
+            let (finished, kept): (Vec<_>, Vec<_>) =
+                sources.into_iter().partition(|s| finished.contains(&s.id));
+            sources = kept;
+            shared.drop_sources(finished);
+        }
+    }
+    // Stopped, drop everything still attached. _stop drops the rest and wakes up anyone
+    // removing a source.
+    shared.drop_sources(sources);
+}
+
+#[cfg(unix)]
+mod sys {
+    use super::{Source, SourceKind};
+    use crate::types::{Error, Result};
+    use std::{os::unix::io::RawFd, time::Duration};
+
+    /// Self-pipe waking the reactor thread out of poll(2) when sources change.
+    pub(super) struct Waker {
+        read_fd: RawFd,
+        write_fd: RawFd,
+    }
+
+    impl Waker {
+        pub(super) fn new() -> Result<Self> {
+            let mut fds: [RawFd; 2] = [-1; 2];
+            if unsafe { libc::pipe(fds.as_mut_ptr()) } != 0 {
+                return Err(Error::CriticalError(format!(
+                    "Failed to create reactor pipe: {}",
+                    std::io::Error::last_os_error()
+                )));
+            }
+            // Neither end may block, a full pipe already means a wakeup is pending
+            for fd in fds {
+                unsafe {
+                    let flags = libc::fcntl(fd, libc::F_GETFL);
+                    libc::fcntl(fd, libc::F_SETFL, flags | libc::O_NONBLOCK);
+                    libc::fcntl(fd, libc::F_SETFD, libc::FD_CLOEXEC);
+                }
+            }
+            Ok(Self {
+                read_fd: fds[0],
+                write_fd: fds[1],
+            })
+        }
+
+        pub(super) fn wake(&self) {
+            let byte = 1u8;
+            unsafe { libc::write(self.write_fd, (&byte as *const u8).cast(), 1) };
+        }
+
+        /// Block until a wakeup, a file descriptor source is ready or timeout elapses, None
+        /// waits forever. Returns the indexes in sources that are ready.
+        pub(super) fn wait(&self, sources: &[Source], timeout: Option<Duration>) -> Vec<usize> {
+            let mut indexes = Vec::with_capacity(sources.len());
+            let mut fds = vec![libc::pollfd {
+                fd: self.read_fd,
+                events: libc::POLLIN,
+                revents: 0,
+            }];
+            for (i, source) in sources.iter().enumerate() {
+                if let SourceKind::Fd(fd) = source.kind {
+                    indexes.push(i);
+                    fds.push(libc::pollfd {
+                        fd,
+                        events: libc::POLLIN,
+                        revents: 0,
+                    });
+                }
+            }
+            // Round up so a timer isn't polled for just before it is due
+            let timeout_ms = timeout.map_or(-1, |t| {
+                t.as_nanos().div_ceil(1_000_000).min(i32::MAX as u128) as libc::c_int
+            });
+            let count =
+                unsafe { libc::poll(fds.as_mut_ptr(), fds.len() as libc::nfds_t, timeout_ms) };
+            if count <= 0 {
+                return Vec::new();
+            }
+            if fds[0].revents != 0 {
+                let mut buffer = [0u8; 64];
+                while unsafe { libc::read(self.read_fd, buffer.as_mut_ptr().cast(), buffer.len()) }
+                    > 0
+                {}
+            }
+            fds[1..]
+                .iter()
+                .zip(indexes)
+                .filter(|(fd, _)| fd.revents != 0)
+                .map(|(_, i)| i)
+                .collect()
+        }
+    }
+
+    impl Drop for Waker {
+        fn drop(&mut self) {
+            unsafe {
+                libc::close(self.read_fd);
+                libc::close(self.write_fd);
+            }
+        }
+    }
+}
+
+#[cfg(not(unix))]
+mod sys {
+    use super::Source;
+    use crate::types::{Error, Result};
+    use std::time::Duration;
+
+    pub(super) struct Waker;
+
+    impl Waker {
+        pub(super) fn new() -> Result<Self> {
+            Err(Error::NotSupported(
+                "The shared reactor is not supported on this platform".into(),
+            ))
+        }
+
+        pub(super) fn wake(&self) {}
+
+        pub(super) fn wait(&self, _sources: &[Source], _timeout: Option<Duration>) -> Vec<usize> {
+            Vec::new()
+        }
+    }
+}
+
+#[cfg(all(test, unix))]
+mod tests {
+    use super::*;
+    use std::sync::atomic::{AtomicU32, Ordering};
+
+    #[test]
+    fn test_reactor_timer() {
+        let reactor = Reactor::new().unwrap();
+        let count = Arc::new(AtomicU32::new(0));
+        let registration = {
+            let count = count.clone();
+            reactor
+                .handle()
+                .add_timer(
+                    Duration::from_millis(1),
+                    Box::new(move || count.fetch_add(1, Ordering::SeqCst) < 2),
+                )
+                .unwrap()
+        };
+        // Returning false removes the timer after its third run
+        let start = Instant::now();
+        while registration
+            .shared
+            .state
+            .lock()
+            .unwrap()
+            .live
+            .contains(&registration.id)
+        {
+            assert!(start.elapsed() < Duration::from_secs(5));
+            std::thread::sleep(Duration::from_millis(1));
+        }
+        assert_eq!(count.load(Ordering::SeqCst), 3);
+        drop(registration);
+
+        // Removal waits for the source to be dropped
+        let dropped = Arc::new(AtomicU32::new(0));
+        struct DropCount(Arc<AtomicU32>);
+        impl Drop for DropCount {
+            fn drop(&mut self) {
+                self.0.fetch_add(1, Ordering::SeqCst);
+            }
+        }
+        let guard = DropCount(dropped.clone());
+        let registration = reactor
+            .handle()
+            .add_timer(
+                Duration::from_secs(60),
+                Box::new(move || {
+                    let _ = &guard;
+                    true
+                }),
+            )
+            .unwrap();
+        drop(registration);
+        assert_eq!(dropped.load(Ordering::SeqCst), 1);
+
+        let handle = reactor.handle();
+        drop(reactor);
+        assert!(handle
+            .add_timer(Duration::from_millis(1), Box::new(|| true))
+            .is_err());
+    }
+
+    #[test]
+    fn test_reactor_handler_panic() {
+        let reactor = Reactor::new().unwrap();
+        let idle = reactor
+            .handle()
+            .add_timer(Duration::from_secs(60), Box::new(|| true))
+            .unwrap();
+        let panicking = reactor
+            .handle()
+            .add_timer(
+                Duration::from_millis(1),
+                Box::new(|| panic!("reactor handler panicked")),
+            )
+            .unwrap();
+        let start = Instant::now();
+        while reactor.handle.shared.state.lock().unwrap().running {
+            assert!(start.elapsed() < Duration::from_secs(5));
+            std::thread::sleep(Duration::from_millis(1));
+        }
+        // Removing sources doesn't wait on the dead reactor thread
+        drop(panicking);
+        drop(idle);
+        assert!(reactor
+            .handle()
+            .add_timer(Duration::from_millis(1), Box::new(|| true))
+            .is_err());
+    }
+
+    #[test]
+    fn test_reactor_fd() {
+        let reactor = Reactor::new().unwrap();
+        let mut fds: [libc::c_int; 2] = [-1; 2];
+        assert_eq!(unsafe { libc::pipe(fds.as_mut_ptr()) }, 0);
+        let [read_fd, write_fd] = fds;
+        let received = Arc::new(Mutex::new(Vec::new()));
+        let registration = {
+            let received = received.clone();
+            reactor
+                .handle()
+                .add_fd(
+                    read_fd,
+                    Box::new(move || {
+                        let mut buffer = [0u8; 16];
+                        let n = unsafe { libc::read(read_fd, buffer.as_mut_ptr().cast(), 16) };
+                        if n <= 0 {
+                            return false;
+                        }
+                        received
+                            .lock()
+                            .unwrap()
+                            .extend_from_slice(&buffer[..n as usize]);
+                        true
+                    }),
+                )
+                .unwrap()
+        };
+        unsafe { libc::write(write_fd, b"abc".as_ptr().cast(), 3) };
+        let start = Instant::now();
+        while received.lock().unwrap().len() < 3 {
+            assert!(start.elapsed() < Duration::from_secs(5));
+            std::thread::sleep(Duration::from_millis(1));
+        }
+        assert_eq!(*received.lock().unwrap(), b"abc");
+        drop(registration);
+        unsafe {
+            libc::close(read_fd);
+            libc::close(write_fd);
+        }
+    }
+}
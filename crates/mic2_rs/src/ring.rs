@@ -0,0 +1,232 @@
+//! Bounded lock-free single-producer / single-consumer ring buffer.
+//!
+//! Used to hand data from a reader thread (ie. the GPS serial thread) to exactly one
+//! consumer without either side ever blocking on the other.
+use std::{
+    cell::UnsafeCell,
+    fmt,
+    marker::PhantomData,
+    mem::MaybeUninit,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc,
+    },
+};
+
+struct Ring<T> {
+    slots: Box<[UnsafeCell<MaybeUninit<T>>]>,
+    /// Index of the next slot to read. Only written by the consumer.
+    head: AtomicUsize,
+    /// Index of the next slot to write. Only written by the producer.
+    tail: AtomicUsize,
+    /// Number of values rejected by [RingProducer::push] because the ring was full.
+    dropped: AtomicU64,
+}
+
+// Slots are only accessed by the single producer (between head and tail) or the single
+// consumer (between tail and head), the atomics order the hand-off between them.
+unsafe impl<T: Send> Send for Ring<T> {}
+unsafe impl<T: Send> Sync for Ring<T> {}
+
+impl<T> Ring<T> {
+    fn slot(&self, index: usize) -> *mut MaybeUninit<T> {
+        self.slots[index % self.slots.len()].get()
+    }
+}
+
+impl<T> Drop for Ring<T> {
+    fn drop(&mut self) {
+        let tail = *self.tail.get_mut();
+        let mut head = *self.head.get_mut();
+        while head != tail {
+            unsafe { (*self.slot(head)).assume_init_drop() };
+            head = head.wrapping_add(1);
+        }
+    }
+}
+
+/// Write half of a ring created with [channel].
+pub struct RingProducer<T> {
+    ring: Arc<Ring<T>>,
+    // Only one thread may use each half at a time.
+    _not_sync: PhantomData<*const ()>,
+}
+
+/// Read half of a ring created with [channel].
+pub struct RingConsumer<T> {
+    ring: Arc<Ring<T>>,
+    // Only one thread may use each half at a time.
+    _not_sync: PhantomData<*const ()>,
+}
+
+unsafe impl<T: Send> Send for RingProducer<T> {}
+unsafe impl<T: Send> Send for RingConsumer<T> {}
+
+/// Create a ring that holds up to `capacity` values. Panics if `capacity` is zero.
+pub fn channel<T>(capacity: usize) -> (RingProducer<T>, RingConsumer<T>) {
+    assert!(capacity > 0, "Ring capacity must be greater than zero");
+    let ring = Arc::new(Ring {
+        slots: (0..capacity)
+            .map(|_| UnsafeCell::new(MaybeUninit::uninit()))
+            .collect(),
+        head: AtomicUsize::new(0),
+        tail: AtomicUsize::new(0),
+        dropped: AtomicU64::new(0),
+    });
+    (
+        RingProducer {
+            ring: ring.clone(),
+            _not_sync: PhantomData,
+        },
+        RingConsumer {
+            ring,
+            _not_sync: PhantomData,
+        },
+    )
+}
+
+impl<T> RingProducer<T> {
+    /// Append a value to the ring. If the ring is full the value is discarded, counted in
+    /// [RingConsumer::dropped] and false is returned.
+    pub fn push(&mut self, value: T) -> bool {
+        let ring = &self.ring;
+        let tail = ring.tail.load(Ordering::Relaxed);
+        let head = ring.head.load(Ordering::Acquire);
+        if tail.wrapping_sub(head) == ring.slots.len() {
+            ring.dropped.fetch_add(1, Ordering::Relaxed);
+            return false;
+        }
+        unsafe { (*ring.slot(tail)).write(value) };
+        ring.tail.store(tail.wrapping_add(1), Ordering::Release);
+        true
+    }
+}
+
+impl<T> RingConsumer<T> {
+    /// Remove the oldest value from the ring, None if empty.
+    pub fn pop(&mut self) -> Option<T> {
+        let ring = &self.ring;
+        let head = ring.head.load(Ordering::Relaxed);
+        let tail = ring.tail.load(Ordering::Acquire);
+        if head == tail {
+            return None;
+        }
+        let value = unsafe { (*ring.slot(head)).assume_init_read() };
+        ring.head.store(head.wrapping_add(1), Ordering::Release);
+        Some(value)
+    }
+
+    /// Move up to `out.len()` of the oldest values into `out`, returns how many were written.
+    pub fn drain_into(&mut self, out: &mut [T]) -> usize {
+        let ring = &self.ring;
+        let head = ring.head.load(Ordering::Relaxed);
+        let tail = ring.tail.load(Ordering::Acquire);
+        let count = std::cmp::min(tail.wrapping_sub(head), out.len());
+        for (i, value) in out[..count].iter_mut().enumerate() {
+            *value = unsafe { (*ring.slot(head.wrapping_add(i))).assume_init_read() };
+        }
+        ring.head.store(head.wrapping_add(count), Ordering::Release);
+        count
+    }
+
+    /// Number of values currently waiting in the ring.
+    pub fn len(&self) -> usize {
+        let head = self.ring.head.load(Ordering::Relaxed);
+        self.ring.tail.load(Ordering::Acquire).wrapping_sub(head)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Maximum number of values the ring can hold.
+    pub fn capacity(&self) -> usize {
+        self.ring.slots.len()
+    }
+
+    /// Number of values discarded so far because the ring was full.
+    pub fn dropped(&self) -> u64 {
+        self.ring.dropped.load(Ordering::Relaxed)
+    }
+}
+
+impl<T> fmt::Debug for RingProducer<T> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("RingProducer")
+            .field("capacity", &self.ring.slots.len())
+            .finish()
+    }
+}
+
+impl<T> fmt::Debug for RingConsumer<T> {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("RingConsumer")
+            .field("capacity", &self.capacity())
+            .field("len", &self.len())
+            .field("dropped", &self.dropped())
+            .finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_push_pop() {
+        let (mut producer, mut consumer) = channel(3);
+        assert!(consumer.is_empty());
+        assert!(producer.push(1));
+        assert!(producer.push(2));
+        assert!(producer.push(3));
+        assert!(!producer.push(4));
+        assert_eq!(consumer.len(), 3);
+        assert_eq!(consumer.dropped(), 1);
+        assert_eq!(consumer.pop(), Some(1));
+        assert!(producer.push(5));
+
+        let mut out = [0; 8];
+        assert_eq!(consumer.drain_into(&mut out), 3);
+        assert_eq!(out[..3], [2, 3, 5]);
+        assert_eq!(consumer.pop(), None);
+    }
+
+    #[test]
+    fn test_threaded() {
+        let (mut producer, mut consumer) = channel::<u64>(16);
+        let writer = std::thread::spawn(move || {
+            let mut i = 0;
+            while i < 10_000 {
+                if producer.push(i) {
+                    i += 1;
+                } else {
+                    std::thread::yield_now();
+                }
+            }
+        });
+        let mut expected = 0;
+        let mut out = [0; 7];
+        while expected < 10_000 {
+            let count = consumer.drain_into(&mut out);
+            if count == 0 {
+                std::thread::yield_now();
+            }
+            for value in &out[..count] {
+                assert_eq!(*value, expected);
+                expected += 1;
+            }
+        }
+        writer.join().unwrap();
+    }
+
+    #[test]
+    fn test_drop_pending() {
+        let value = Arc::new(());
+        let (mut producer, consumer) = channel(4);
+        producer.push(value.clone());
+        producer.push(value.clone());
+        drop(producer);
+        drop(consumer);
+        assert_eq!(Arc::strong_count(&value), 1);
+    }
+}
@@ -0,0 +1,298 @@
+//! Counters and latency histograms filled by the GPS reader thread and the IO and audio paths,
+//! see [crate::mic::NeoVIMIC::stats].
+//!
+//! Everything is a relaxed atomic so recording never takes a lock and can stay enabled in
+//! production. A snapshot reads each counter on its own, counters updated while it is taken
+//! can be off by the updates in flight.
+use std::sync::atomic::{AtomicU64, Ordering};
+
+/// Number of buckets in a [Histogram].
+pub const HISTOGRAM_BUCKETS: usize = 24;
+
+/// Log2 histogram of durations in microseconds. Bucket 0 counts durations under 1us, bucket
+/// i counts [2^(i-1), 2^i) us and the last bucket everything from 2^22 us (about 4 s) up.
+#[derive(Debug, Default)]
+pub struct Histogram {
+    buckets: [AtomicU64; HISTOGRAM_BUCKETS],
+    count: AtomicU64,
+    sum_us: AtomicU64,
+    max_us: AtomicU64,
+}
+
+/// Copy of a [Histogram], see [Histogram::snapshot].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct HistogramSnapshot {
+    pub buckets: [u64; HISTOGRAM_BUCKETS],
+    /// Number of durations recorded
+    pub count: u64,
+    /// Sum of all durations recorded (us)
+    pub sum_us: u64,
+    /// Longest duration recorded (us)
+    pub max_us: u64,
+}
+
+impl Histogram {
+    /// Index of the bucket counting `duration_us`.
+    pub fn bucket(duration_us: u64) -> usize {
+        ((u64::BITS - duration_us.leading_zeros()) as usize).min(HISTOGRAM_BUCKETS - 1)
+    }
+
+    pub fn record_ns(&self, duration_ns: u64) {
+        let duration_us = duration_ns / 1000;
+        self.buckets[Self::bucket(duration_us)].fetch_add(1, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+        self.sum_us.fetch_add(duration_us, Ordering::Relaxed);
+        self.max_us.fetch_max(duration_us, Ordering::Relaxed);
+    }
+
+    pub fn snapshot(&self) -> HistogramSnapshot {
+        HistogramSnapshot {
+            buckets: std::array::from_fn(|i| self.buckets[i].load(Ordering::Relaxed)),
+            count: self.count.load(Ordering::Relaxed),
+            sum_us: self.sum_us.load(Ordering::Relaxed),
+            max_us: self.max_us.load(Ordering::Relaxed),
+        }
+    }
+
+    pub fn reset(&self) {
+        for bucket in &self.buckets {
+            bucket.store(0, Ordering::Relaxed);
+        }
+        self.count.store(0, Ordering::Relaxed);
+        self.sum_us.store(0, Ordering::Relaxed);
+        self.max_us.store(0, Ordering::Relaxed);
+    }
+}
+
+impl HistogramSnapshot {
+    /// Exclusive upper bound of bucket `index` in microseconds, None for the last bucket.
+    pub fn bucket_upper_bound_us(index: usize) -> Option<u64> {
+        (index < HISTOGRAM_BUCKETS - 1).then(|| 1 << index)
+    }
+
+    /// Smallest bucket upper bound at or above the `quantile` (0.0 to 1.0) of the recorded
+    /// durations. None if nothing was recorded or it falls in the last bucket.
+    pub fn quantile_upper_bound_us(&self, quantile: f64) -> Option<u64> {
+        let target = (self.count as f64 * quantile.clamp(0.0, 1.0))
+            .ceil()
+            .max(1.0) as u64;
+        let mut seen = 0;
+        for (index, count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= target {
+                return Self::bucket_upper_bound_us(index);
+            }
+        }
+        None
+    }
+}
+
+/// Adds `value` to a counter.
+pub(crate) fn add(counter: &AtomicU64, value: u64) {
+    counter.fetch_add(value, Ordering::Relaxed);
+}
+
+/// Filled by the GPS reader thread, see [crate::gps::GPSDevice::stats].
+#[derive(Debug, Default)]
+pub struct GPSStats {
+    pub(crate) bytes_read: AtomicU64,
+    pub(crate) reads: AtomicU64,
+    pub(crate) read_timeouts: AtomicU64,
+    pub(crate) partial_reads: AtomicU64,
+    pub(crate) nmea_sentences: AtomicU64,
+    pub(crate) ubx_messages: AtomicU64,
+    pub(crate) unsupported: AtomicU64,
+    pub(crate) invalid_frames: AtomicU64,
+    pub(crate) fixes: AtomicU64,
+    pub(crate) lock_wait_ns: AtomicU64,
+    pub(crate) tap_write_errors: AtomicU64,
+    pub(crate) fix_log_errors: AtomicU64,
+    pub(crate) fix_interval: Histogram,
+    pub(crate) parse_latency: Histogram,
+}
+
+/// Copy of [GPSStats], see [GPSStats::snapshot].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct GPSStatsSnapshot {
+    /// Bytes read from the serial port
+    pub bytes_read: u64,
+    /// Reads that returned data
+    pub reads: u64,
+    /// Reads that timed out without data
+    pub read_timeouts: u64,
+    /// Reads that ended inside a frame, the rest of it is reassembled from the next read
+    pub partial_reads: u64,
+    /// NMEA sentences framed
+    pub nmea_sentences: u64,
+    /// UBX packets framed
+    pub ubx_messages: u64,
+    /// Framed messages that were dropped because they aren't supported or failed to parse
+    pub unsupported: u64,
+    /// Frames dropped by the framer, ie. bad checksums or oversized frames
+    pub invalid_frames: u64,
+    /// Position updates, PUBX00 or UBX-NAV-PVT
+    pub fixes: u64,
+    /// Time the reader thread waited for readers of the GPS info to release it (ns)
+    pub lock_wait_ns: u64,
+    /// Failed writes of [crate::gps::GPSDevice::raw_tap_to_file], the bytes are lost
+    pub tap_write_errors: u64,
+    /// Failed writes of [crate::gps::GPSDevice::fix_log_start], each one stops the log
+    pub fix_log_errors: u64,
+    /// Time between position updates
+    pub fix_interval: HistogramSnapshot,
+    /// Time from a read returning to its frames being parsed and published
+    pub parse_latency: HistogramSnapshot,
+}
+
+impl GPSStats {
+    pub fn snapshot(&self) -> GPSStatsSnapshot {
+        let load = |counter: &AtomicU64| counter.load(Ordering::Relaxed);
+        GPSStatsSnapshot {
+            bytes_read: load(&self.bytes_read),
+            reads: load(&self.reads),
+            read_timeouts: load(&self.read_timeouts),
+            partial_reads: load(&self.partial_reads),
+            nmea_sentences: load(&self.nmea_sentences),
+            ubx_messages: load(&self.ubx_messages),
+            unsupported: load(&self.unsupported),
+            invalid_frames: load(&self.invalid_frames),
+            fixes: load(&self.fixes),
+            lock_wait_ns: load(&self.lock_wait_ns),
+            tap_write_errors: load(&self.tap_write_errors),
+            fix_log_errors: load(&self.fix_log_errors),
+            fix_interval: self.fix_interval.snapshot(),
+            parse_latency: self.parse_latency.snapshot(),
+        }
+    }
+
+    pub fn reset(&self) {
+        for counter in [
+            &self.bytes_read,
+            &self.reads,
+            &self.read_timeouts,
+            &self.partial_reads,
+            &self.nmea_sentences,
+            &self.ubx_messages,
+            &self.unsupported,
+            &self.invalid_frames,
+            &self.fixes,
+            &self.lock_wait_ns,
+            &self.tap_write_errors,
+            &self.fix_log_errors,
+        ] {
+            counter.store(0, Ordering::Relaxed);
+        }
+        self.fix_interval.reset();
+        self.parse_latency.reset();
+    }
+}
+
+/// Filled by every FT245R transfer, see [crate::io::IO::stats].
+#[derive(Debug, Default)]
+pub struct IOStats {
+    pub(crate) transfers: AtomicU64,
+    pub(crate) lock_wait_ns: AtomicU64,
+}
+
+/// Copy of [IOStats], see [IOStats::snapshot].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct IOStatsSnapshot {
+    /// libftdi calls made
+    pub transfers: u64,
+    /// Time spent waiting for another thread's transfer to finish (ns)
+    pub lock_wait_ns: u64,
+}
+
+impl IOStats {
+    pub fn snapshot(&self) -> IOStatsSnapshot {
+        IOStatsSnapshot {
+            transfers: self.transfers.load(Ordering::Relaxed),
+            lock_wait_ns: self.lock_wait_ns.load(Ordering::Relaxed),
+        }
+    }
+
+    pub fn reset(&self) {
+        self.transfers.store(0, Ordering::Relaxed);
+        self.lock_wait_ns.store(0, Ordering::Relaxed);
+    }
+}
+
+/// Filled by the audio capture thread, see [crate::audio::Audio::stats].
+#[derive(Debug, Default)]
+pub struct AudioStats {
+    pub(crate) samples: AtomicU64,
+    pub(crate) chunks: AtomicU64,
+    pub(crate) dropped_chunks: AtomicU64,
+}
+
+/// Copy of [AudioStats], see [AudioStats::snapshot].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct AudioStatsSnapshot {
+    /// Samples received from the capture device while streaming or recording
+    pub samples: u64,
+    /// Chunks handed to the stream callback
+    pub chunks: u64,
+    /// Chunks dropped because writing a recording to disk fell behind
+    pub dropped_chunks: u64,
+}
+
+impl AudioStats {
+    pub fn snapshot(&self) -> AudioStatsSnapshot {
+        AudioStatsSnapshot {
+            samples: self.samples.load(Ordering::Relaxed),
+            chunks: self.chunks.load(Ordering::Relaxed),
+            dropped_chunks: self.dropped_chunks.load(Ordering::Relaxed),
+        }
+    }
+
+    pub fn reset(&self) {
+        self.samples.store(0, Ordering::Relaxed);
+        self.chunks.store(0, Ordering::Relaxed);
+        self.dropped_chunks.store(0, Ordering::Relaxed);
+    }
+}
+
+/// Counters of every subsystem of a neoVI MIC2, None if it doesn't have that subsystem. See
+/// [crate::mic::NeoVIMIC::stats].
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct DeviceStats {
+    pub gps: Option<GPSStatsSnapshot>,
+    pub io: Option<IOStatsSnapshot>,
+    pub audio: Option<AudioStatsSnapshot>,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_histogram() {
+        assert_eq!(Histogram::bucket(0), 0);
+        assert_eq!(Histogram::bucket(1), 1);
+        assert_eq!(Histogram::bucket(3), 2);
+        assert_eq!(Histogram::bucket(4), 3);
+        assert_eq!(Histogram::bucket(u64::MAX), HISTOGRAM_BUCKETS - 1);
+
+        let histogram = Histogram::default();
+        // 1 Hz fixes with one late one
+        for _ in 0..9 {
+            histogram.record_ns(1_000_000_000);
+        }
+        histogram.record_ns(1_900_000_000);
+        let snapshot = histogram.snapshot();
+        assert_eq!(snapshot.count, 10);
+        assert_eq!(snapshot.sum_us, 10_900_000);
+        assert_eq!(snapshot.max_us, 1_900_000);
+        assert_eq!(snapshot.buckets[20], 9);
+        assert_eq!(snapshot.buckets[21], 1);
+        assert_eq!(snapshot.quantile_upper_bound_us(0.5), Some(1 << 20));
+        assert_eq!(snapshot.quantile_upper_bound_us(1.0), Some(1 << 21));
+        assert_eq!(
+            HistogramSnapshot::default().quantile_upper_bound_us(0.5),
+            None
+        );
+
+        histogram.reset();
+        assert_eq!(histogram.snapshot(), HistogramSnapshot::default());
+    }
+}
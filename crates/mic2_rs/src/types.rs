@@ -1,5 +1,5 @@
 use serialport;
-use std::fmt;
+use std::{fmt, sync::OnceLock, time::Instant};
 
 #[derive(Debug, Clone)]
 pub enum Error {
@@ -42,3 +42,10 @@ impl From<std::io::Error> for Error {
 
 /// Generic crate Result object
 pub type Result<T> = std::result::Result<T, Error>;
+
+/// Nanoseconds elapsed on the host monotonic clock since the first call in this process.
+/// Used to timestamp received data independently of wall clock adjustments.
+pub fn monotonic_time_ns() -> u64 {
+    static EPOCH: OnceLock<Instant> = OnceLock::new();
+    EPOCH.get_or_init(Instant::now).elapsed().as_nanos() as u64
+}
@@ -1,11 +1,16 @@
 use nom::{bytes::complete::take, number::complete::be_u8, IResult};
 use serde::{Deserialize, Serialize};
-use std::fmt;
+use std::{
+    collections::{HashMap, VecDeque},
+    fmt,
+};
 
 #[derive(Debug)]
 pub enum Error {
     MalformedHeader(String),
     InvalidChecksum,
+    /// Payload is shorter than the message requires, contains the payload length.
+    InvalidPayloadLength(usize),
 }
 
 impl std::error::Error for Error {}
@@ -17,6 +22,7 @@ impl fmt::Display for Error {
         match &self {
             Self::MalformedHeader(s) => write!(f, "Malformed GPS ubx header: {:#?}", s),
             Self::InvalidChecksum => write!(f, "Invalid Checksum"),
+            Self::InvalidPayloadLength(len) => write!(f, "Invalid payload length: {len}"),
         }
     }
 }
@@ -170,14 +176,453 @@ impl PacketHeader {
         // including the CLASS field, up until, but excluding, the
         // Checksum Field
         let bytes = self.data(false);
-        let mut ck_a: u8 = 0;
-        let mut ck_b: u8 = 0;
         // Don't calculate the checksum over the header
-        for byte in bytes[2..].iter() {
-            ck_a = ck_a.wrapping_add(*byte);
-            ck_b = ck_b.wrapping_add(ck_a);
+        fletcher_checksum(&bytes[2..])
+    }
+}
+
+/// 8-Bit Fletcher checksum over `bytes`, returned as (ck_a, ck_b). `bytes` should start at
+/// the CLASS field and end right before the checksum.
+pub fn fletcher_checksum(bytes: &[u8]) -> (u8, u8) {
+    let mut ck_a: u8 = 0;
+    let mut ck_b: u8 = 0;
+    for byte in bytes {
+        ck_a = ck_a.wrapping_add(*byte);
+        ck_b = ck_b.wrapping_add(ck_a);
+    }
+    (ck_a, ck_b)
+}
+
+/// 32.17.4 UBX-NAV-DOP message id
+pub const NAV_DOP: u8 = 0x04;
+/// 32.17.14 UBX-NAV-PVT message id
+pub const NAV_PVT: u8 = 0x07;
+/// 32.17.10 UBX-NAV-CLOCK message id
+pub const NAV_CLOCK: u8 = 0x22;
+/// 32.17.20 UBX-NAV-SAT message id
+pub const NAV_SAT: u8 = 0x35;
+
+fn read_u16(payload: &[u8], offset: usize) -> u16 {
+    u16::from_le_bytes([payload[offset], payload[offset + 1]])
+}
+
+fn read_i16(payload: &[u8], offset: usize) -> i16 {
+    read_u16(payload, offset) as i16
+}
+
+fn read_u32(payload: &[u8], offset: usize) -> u32 {
+    u32::from_le_bytes(payload[offset..offset + 4].try_into().unwrap())
+}
+
+fn read_i32(payload: &[u8], offset: usize) -> i32 {
+    read_u32(payload, offset) as i32
+}
+
+/// 32.17.14 UBX-NAV-PVT Navigation Position Velocity Time Solution
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct NavPvt {
+    /// GPS time of week of the navigation epoch (ms)
+    pub itow: u32,
+    /// Year (UTC)
+    pub year: u16,
+    /// Month, range 1..12 (UTC)
+    pub month: u8,
+    /// Day of month, range 1..31 (UTC)
+    pub day: u8,
+    /// Hour of day, range 0..23 (UTC)
+    pub hour: u8,
+    /// Minute of hour, range 0..59 (UTC)
+    pub min: u8,
+    /// Seconds of minute, range 0..60 (UTC)
+    pub sec: u8,
+    /// Validity flags, bit 0 validDate, bit 1 validTime
+    pub valid: u8,
+    /// Time accuracy estimate (ns)
+    pub t_acc: u32,
+    /// Fraction of second, range -1e9..1e9 (ns)
+    pub nano: i32,
+    /// 0 no fix, 1 dead reckoning only, 2 2D, 3 3D, 4 GNSS + dead reckoning, 5 time only
+    pub fix_type: u8,
+    /// Fix status flags, bit 0 gnssFixOK, bit 1 diffSoln
+    pub flags: u8,
+    /// Number of satellites used in Nav Solution
+    pub num_sv: u8,
+    /// Longitude (1e-7 degrees)
+    pub lon: i32,
+    /// Latitude (1e-7 degrees)
+    pub lat: i32,
+    /// Height above ellipsoid (mm)
+    pub height: i32,
+    /// Height above mean sea level (mm)
+    pub h_msl: i32,
+    /// Horizontal accuracy estimate (mm)
+    pub h_acc: u32,
+    /// Vertical accuracy estimate (mm)
+    pub v_acc: u32,
+    /// NED north velocity (mm/s)
+    pub vel_n: i32,
+    /// NED east velocity (mm/s)
+    pub vel_e: i32,
+    /// NED down velocity (mm/s)
+    pub vel_d: i32,
+    /// Ground Speed (2-D) (mm/s)
+    pub g_speed: i32,
+    /// Heading of motion (2-D) (1e-5 degrees)
+    pub head_mot: i32,
+    /// Speed accuracy estimate (mm/s)
+    pub s_acc: u32,
+    /// Heading accuracy estimate (1e-5 degrees)
+    pub head_acc: u32,
+    /// Position DOP (0.01)
+    pub p_dop: u16,
+}
+
+impl NavPvt {
+    /// Older protocol versions send 84 bytes, newer ones append reserved fields up to 92.
+    pub const MIN_PAYLOAD_LENGTH: usize = 84;
+
+    pub fn from_payload(payload: &[u8]) -> Result<Self> {
+        if payload.len() < Self::MIN_PAYLOAD_LENGTH {
+            return Err(Error::InvalidPayloadLength(payload.len()));
+        }
+        Ok(Self {
+            itow: read_u32(payload, 0),
+            year: read_u16(payload, 4),
+            month: payload[6],
+            day: payload[7],
+            hour: payload[8],
+            min: payload[9],
+            sec: payload[10],
+            valid: payload[11],
+            t_acc: read_u32(payload, 12),
+            nano: read_i32(payload, 16),
+            fix_type: payload[20],
+            flags: payload[21],
+            num_sv: payload[23],
+            lon: read_i32(payload, 24),
+            lat: read_i32(payload, 28),
+            height: read_i32(payload, 32),
+            h_msl: read_i32(payload, 36),
+            h_acc: read_u32(payload, 40),
+            v_acc: read_u32(payload, 44),
+            vel_n: read_i32(payload, 48),
+            vel_e: read_i32(payload, 52),
+            vel_d: read_i32(payload, 56),
+            g_speed: read_i32(payload, 60),
+            head_mot: read_i32(payload, 64),
+            s_acc: read_u32(payload, 68),
+            head_acc: read_u32(payload, 72),
+            p_dop: read_u16(payload, 76),
+        })
+    }
+}
+
+/// 32.17.4 UBX-NAV-DOP Dilution of precision, all values are scaled by 0.01
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct NavDop {
+    /// GPS time of week of the navigation epoch (ms)
+    pub itow: u32,
+    pub g_dop: u16,
+    pub p_dop: u16,
+    pub t_dop: u16,
+    pub v_dop: u16,
+    pub h_dop: u16,
+    pub n_dop: u16,
+    pub e_dop: u16,
+}
+
+impl NavDop {
+    pub const PAYLOAD_LENGTH: usize = 18;
+
+    pub fn from_payload(payload: &[u8]) -> Result<Self> {
+        if payload.len() < Self::PAYLOAD_LENGTH {
+            return Err(Error::InvalidPayloadLength(payload.len()));
+        }
+        Ok(Self {
+            itow: read_u32(payload, 0),
+            g_dop: read_u16(payload, 4),
+            p_dop: read_u16(payload, 6),
+            t_dop: read_u16(payload, 8),
+            v_dop: read_u16(payload, 10),
+            h_dop: read_u16(payload, 12),
+            n_dop: read_u16(payload, 14),
+            e_dop: read_u16(payload, 16),
+        })
+    }
+}
+
+/// 32.17.10 UBX-NAV-CLOCK Clock Solution
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct NavClock {
+    /// GPS time of week of the navigation epoch (ms)
+    pub itow: u32,
+    /// Clock bias (ns)
+    pub clk_b: i32,
+    /// Clock drift (ns/s)
+    pub clk_d: i32,
+    /// Time accuracy estimate (ns)
+    pub t_acc: u32,
+    /// Frequency accuracy estimate (ps/s)
+    pub f_acc: u32,
+}
+
+impl NavClock {
+    pub const PAYLOAD_LENGTH: usize = 20;
+
+    pub fn from_payload(payload: &[u8]) -> Result<Self> {
+        if payload.len() < Self::PAYLOAD_LENGTH {
+            return Err(Error::InvalidPayloadLength(payload.len()));
+        }
+        Ok(Self {
+            itow: read_u32(payload, 0),
+            clk_b: read_i32(payload, 4),
+            clk_d: read_i32(payload, 8),
+            t_acc: read_u32(payload, 12),
+            f_acc: read_u32(payload, 16),
+        })
+    }
+}
+
+/// One satellite of a [NavSat] message.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct NavSatSv {
+    /// GNSS identifier, 0 GPS, 1 SBAS, 2 Galileo, 3 BeiDou, 5 QZSS, 6 GLONASS
+    pub gnss_id: u8,
+    /// Satellite identifier
+    pub sv_id: u8,
+    /// Carrier to noise ratio (dBHz)
+    pub cno: u8,
+    /// Elevation, range +/-90 (degrees). Unknown if out of range.
+    pub elev: i8,
+    /// Azimuth, range 0..360 (degrees). Unknown if elevation is out of range.
+    pub azim: i16,
+    /// Pseudorange residual (0.1 m)
+    pub pr_res: i16,
+    /// Bitmask, bit 3 svUsed
+    pub flags: u32,
+}
+
+impl NavSatSv {
+    /// Signal used for navigation
+    pub fn used(&self) -> bool {
+        self.flags & 0x08 != 0
+    }
+}
+
+/// 32.17.20 UBX-NAV-SAT Satellite Information. Satellites are decoded lazily from the
+/// borrowed payload, see [NavSat::satellites].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct NavSat<'a> {
+    /// GPS time of week of the navigation epoch (ms)
+    pub itow: u32,
+    /// Message version
+    pub version: u8,
+    /// Number of satellites
+    pub num_svs: u8,
+    payload: &'a [u8],
+}
+
+impl<'a> NavSat<'a> {
+    const HEADER_LENGTH: usize = 8;
+    const SV_LENGTH: usize = 12;
+
+    pub fn from_payload(payload: &'a [u8]) -> Result<Self> {
+        if payload.len() < Self::HEADER_LENGTH {
+            return Err(Error::InvalidPayloadLength(payload.len()));
+        }
+        let num_svs = payload[5];
+        if payload.len() < Self::HEADER_LENGTH + num_svs as usize * Self::SV_LENGTH {
+            return Err(Error::InvalidPayloadLength(payload.len()));
+        }
+        Ok(Self {
+            itow: read_u32(payload, 0),
+            version: payload[4],
+            num_svs,
+            payload,
+        })
+    }
+
+    pub fn satellites(&self) -> impl Iterator<Item = NavSatSv> + 'a {
+        let payload = self.payload;
+        (0..self.num_svs as usize).map(move |i| {
+            let sv = &payload[Self::HEADER_LENGTH + i * Self::SV_LENGTH..];
+            NavSatSv {
+                gnss_id: sv[0],
+                sv_id: sv[1],
+                cno: sv[2],
+                elev: sv[3] as i8,
+                azim: read_i16(sv, 4),
+                pr_res: read_i16(sv, 6),
+                flags: read_u32(sv, 8),
+            }
+        })
+    }
+}
+
+/// Decoded UBX-NAV messages used to update [crate::nmea::types::GPSInfo].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum NavMessage<'a> {
+    Pvt(NavPvt),
+    Dop(NavDop),
+    Clock(NavClock),
+    Sat(NavSat<'a>),
+}
+
+impl<'a> NavMessage<'a> {
+    /// Decode a UBX packet. Returns Ok(None) for messages that aren't handled.
+    pub fn from_packet(class: u8, id: u8, payload: &'a [u8]) -> Result<Option<Self>> {
+        if class != ClassField::NAV as u8 {
+            return Ok(None);
+        }
+        Ok(Some(match id {
+            NAV_PVT => Self::Pvt(NavPvt::from_payload(payload)?),
+            NAV_DOP => Self::Dop(NavDop::from_payload(payload)?),
+            NAV_CLOCK => Self::Clock(NavClock::from_payload(payload)?),
+            NAV_SAT => Self::Sat(NavSat::from_payload(payload)?),
+            _ => return Ok(None),
+        }))
+    }
+}
+
+/// 32.9.1 UBX-ACK-NAK message id
+pub const ACK_NAK: u8 = 0x00;
+/// 32.9.2 UBX-ACK-ACK message id
+pub const ACK_ACK: u8 = 0x01;
+/// 32.10.13 UBX-CFG-MSG message id
+pub const CFG_MSG: u8 = 0x01;
+/// 32.10.25 UBX-CFG-PRT message id
+pub const CFG_PRT: u8 = 0x00;
+/// 32.10.29 UBX-CFG-RST message id
+pub const CFG_RST: u8 = 0x04;
+/// 32.10.27 UBX-CFG-RATE message id
+pub const CFG_RATE: u8 = 0x08;
+
+/// 32.9 UBX-ACK-ACK / UBX-ACK-NAK reply to a CFG input message.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct Ack {
+    /// Class of the acknowledged message
+    pub class: u8,
+    /// Id of the acknowledged message
+    pub id: u8,
+    /// true for ACK-ACK, false for ACK-NAK (message rejected)
+    pub accepted: bool,
+}
+
+impl Ack {
+    /// Decode a UBX packet. Returns Ok(None) if it isn't an ACK message.
+    pub fn from_packet(class: u8, id: u8, payload: &[u8]) -> Result<Option<Self>> {
+        if class != ClassField::ACK as u8 || !matches!(id, ACK_ACK | ACK_NAK) {
+            return Ok(None);
+        }
+        if payload.len() < 2 {
+            return Err(Error::InvalidPayloadLength(payload.len()));
+        }
+        Ok(Some(Self {
+            class: payload[0],
+            id: payload[1],
+            accepted: id == ACK_ACK,
+        }))
+    }
+}
+
+/// Answer to a message of a [Transaction].
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum AckState {
+    /// Not answered yet
+    Pending,
+    /// UBX-ACK-ACK received
+    Accepted,
+    /// UBX-ACK-NAK received, the receiver rejected the message
+    Rejected,
+}
+
+/// CFG messages sent to the receiver in a single write, see [Transaction::begin], with their
+/// ACKs resolved as they stream in. An ACK only names the class and id it answers and the
+/// receiver answers in the order the messages arrived, so each ACK resolves the oldest
+/// outstanding message with that class and id.
+#[derive(Debug, Default, Clone)]
+pub struct Transaction {
+    /// Encoded packet of every message, checksum included
+    packets: Vec<Vec<u8>>,
+    /// (class, id) of every message
+    keys: Vec<(u8, u8)>,
+    states: Vec<AckState>,
+    /// Indices of the messages sent by the last [Transaction::begin] that are still waiting
+    /// for an ACK, oldest first
+    outstanding: HashMap<(u8, u8), VecDeque<usize>>,
+}
+
+impl Transaction {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Queue `packet`, returns its index in [Transaction::states]. Only CFG messages are
+    /// acknowledged by the receiver, anything else would keep the transaction pending until it
+    /// times out.
+    pub fn push(&mut self, packet: &PacketHeader) -> usize {
+        debug_assert_eq!(
+            packet.class,
+            ClassField::CFG,
+            "only CFG messages are acknowledged"
+        );
+        self.packets.push(packet.data(true));
+        self.keys.push((packet.class as u8, packet.id));
+        self.states.push(AckState::Pending);
+        self.packets.len() - 1
+    }
+
+    pub fn len(&self) -> usize {
+        self.packets.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.packets.is_empty()
+    }
+
+    /// Every message still pending coalesced into one buffer to write to the receiver, empty
+    /// once all of them are answered. Messages sent before that weren't answered are sent
+    /// again, ie. when the receiver dropped them while restarting.
+    pub fn begin(&mut self) -> Vec<u8> {
+        self.outstanding.clear();
+        let mut data = Vec::new();
+        for (index, packet) in self.packets.iter().enumerate() {
+            if self.states[index] == AckState::Pending {
+                self.outstanding
+                    .entry(self.keys[index])
+                    .or_default()
+                    .push_back(index);
+                data.extend_from_slice(packet);
+            }
         }
-        (ck_a, ck_b)
+        data
+    }
+
+    /// Resolve the oldest outstanding message `ack` answers. Returns false if it doesn't
+    /// answer any, ie. it belongs to a message sent outside this transaction.
+    pub fn resolve(&mut self, ack: &Ack) -> bool {
+        let Some(index) = self
+            .outstanding
+            .get_mut(&(ack.class, ack.id))
+            .and_then(VecDeque::pop_front)
+        else {
+            return false;
+        };
+        self.states[index] = match ack.accepted {
+            true => AckState::Accepted,
+            false => AckState::Rejected,
+        };
+        true
+    }
+
+    /// True once every message is answered.
+    pub fn is_complete(&self) -> bool {
+        !self.states.contains(&AckState::Pending)
+    }
+
+    /// Answer of every message, in the order they were pushed.
+    pub fn states(&self) -> &[AckState] {
+        &self.states
     }
 }
 
@@ -321,6 +766,98 @@ mod tests {
         //assert!(header.verify_checksum().is_err());
     }
 
+    #[test]
+    fn test_nav_sat() {
+        let mut payload = vec![0x10, 0x27, 0, 0, 1, 2, 0, 0];
+        // GPS 12, 40dBHz, 45 degrees elevation, 180 degrees azimuth, used
+        payload.extend_from_slice(&[0, 12, 40, 45, 180, 0, 0, 0, 0x08, 0, 0, 0]);
+        // GLONASS 3 with unknown elevation
+        payload.extend_from_slice(&[6, 3, 0, 0x80, 0, 0, 0, 0, 0, 0, 0, 0]);
+        let message = NavMessage::from_packet(ClassField::NAV as u8, NAV_SAT, &payload)
+            .unwrap()
+            .unwrap();
+        let NavMessage::Sat(sat) = message else {
+            panic!("Expected NAV-SAT, got {message:?}");
+        };
+        assert_eq!(sat.itow, 10000);
+        let satellites: Vec<NavSatSv> = sat.satellites().collect();
+        assert_eq!(satellites.len(), 2);
+        assert_eq!(satellites[0].sv_id, 12);
+        assert_eq!(satellites[0].elev, 45);
+        assert_eq!(satellites[0].azim, 180);
+        assert!(satellites[0].used());
+        assert_eq!(satellites[1].gnss_id, 6);
+        assert_eq!(satellites[1].elev, -128);
+        assert!(!satellites[1].used());
+
+        // Truncated satellite table
+        assert!(NavSat::from_payload(&payload[..20]).is_err());
+        // Not a NAV message
+        assert!(
+            NavMessage::from_packet(ClassField::ACK as u8, 0x01, &payload)
+                .unwrap()
+                .is_none()
+        );
+    }
+
+    #[test]
+    fn test_ack() {
+        let ack = Ack::from_packet(ClassField::ACK as u8, ACK_ACK, &[0x06, CFG_RATE]).unwrap();
+        assert_eq!(
+            ack,
+            Some(Ack {
+                class: 0x06,
+                id: CFG_RATE,
+                accepted: true
+            })
+        );
+        let nak = Ack::from_packet(ClassField::ACK as u8, ACK_NAK, &[0x06, CFG_MSG]).unwrap();
+        assert!(!nak.unwrap().accepted);
+        assert!(Ack::from_packet(ClassField::ACK as u8, ACK_ACK, &[0x06]).is_err());
+        assert!(
+            Ack::from_packet(ClassField::NAV as u8, ACK_ACK, &[0x06, CFG_MSG])
+                .unwrap()
+                .is_none()
+        );
+    }
+
+    #[test]
+    fn test_transaction() {
+        let mut transaction = Transaction::new();
+        let msg = |payload: Vec<u8>| PacketHeader::new(ClassField::CFG, CFG_MSG, payload, true);
+        let rate = PacketHeader::new(ClassField::CFG, CFG_RATE, vec![100, 0, 1, 0, 1, 0], true);
+        assert_eq!(transaction.push(&msg(vec![0xF0, 0x00, 0])), 0);
+        assert_eq!(transaction.push(&rate), 1);
+        assert_eq!(transaction.push(&msg(vec![0x01, NAV_PVT, 1])), 2);
+        assert_eq!(transaction.len(), 3);
+
+        let data = transaction.begin();
+        let lengths = [11, 14, 11];
+        assert_eq!(data.len(), lengths.iter().sum::<usize>());
+        assert_eq!(&data[..11], &msg(vec![0xF0, 0x00, 0]).data(true)[..]);
+        let ack = |id: u8, accepted: bool| Ack {
+            class: ClassField::CFG as u8,
+            id,
+            accepted,
+        };
+        // Answers resolve the oldest message with their class and id
+        assert!(transaction.resolve(&ack(CFG_MSG, false)));
+        assert!(transaction.resolve(&ack(CFG_MSG, true)));
+        assert!(!transaction.resolve(&ack(CFG_MSG, true)));
+        assert!(!transaction.resolve(&ack(CFG_PRT, true)));
+        assert!(!transaction.is_complete());
+        assert_eq!(
+            transaction.states(),
+            [AckState::Rejected, AckState::Pending, AckState::Accepted]
+        );
+
+        // Only the unanswered message is sent again
+        assert_eq!(transaction.begin(), rate.data(true));
+        assert!(transaction.resolve(&ack(CFG_RATE, true)));
+        assert!(transaction.is_complete());
+        assert!(transaction.begin().is_empty());
+    }
+
     #[test]
     fn test_class_field_values() {
         // Make sure all valid values pass
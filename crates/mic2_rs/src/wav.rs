@@ -0,0 +1,370 @@
+//! Incremental 16-bit PCM WAV writer used for long recordings, see [crate::audio::Audio::record_start].
+//!
+//! Samples are appended as they arrive and the RIFF header sizes are patched when the file
+//! is finished, so nothing but the write buffer is kept in memory.
+use std::{
+    fs::File,
+    io::{self, BufWriter, Seek, SeekFrom, Write},
+    path::{Path, PathBuf},
+};
+
+/// Size of the RIFF/fmt/data headers in front of the samples.
+const HEADER_LENGTH: u32 = 44;
+/// Most sample data the 32-bit RIFF size (data + 36 bytes of header) can describe.
+const MAX_DATA_LENGTH: u64 = (u32::MAX - (HEADER_LENGTH - 8)) as u64 & !1;
+/// Most mono samples a file holds, [SegmentedWavWriter] and [EventWavWriter] continue in the
+/// next file.
+const MAX_FILE_SAMPLES: u64 = MAX_DATA_LENGTH / 2;
+/// Large writes keep SD cards doing steady sequential writes.
+const WRITE_BUFFER_SIZE: usize = 256 * 1024;
+
+/// Writes a 16-bit PCM WAV stream to `W`. Call [WavWriter::finish] to patch the header,
+/// otherwise the header sizes are left at zero.
+#[derive(Debug)]
+pub struct WavWriter<W: Write + Seek> {
+    inner: W,
+    /// Bytes of sample data written so far
+    data_length: u64,
+}
+
+impl<W: Write + Seek> WavWriter<W> {
+    /// Write the header and return a writer ready for samples.
+    pub fn new(mut inner: W, sample_rate: u32, channel_count: u16) -> io::Result<Self> {
+        let invalid = || {
+            io::Error::new(
+                io::ErrorKind::InvalidInput,
+                "WAV sample rate or channel count is too large",
+            )
+        };
+        let block_align = channel_count.checked_mul(2).ok_or_else(invalid)?;
+        let byte_rate = sample_rate
+            .checked_mul(block_align as u32)
+            .ok_or_else(invalid)?;
+        let mut header = Vec::with_capacity(HEADER_LENGTH as usize);
+        header.extend_from_slice(b"RIFF");
+        // Patched in finish()
+        header.extend_from_slice(&0u32.to_le_bytes());
+        header.extend_from_slice(b"WAVEfmt ");
+        header.extend_from_slice(&16u32.to_le_bytes());
+        // PCM
+        header.extend_from_slice(&1u16.to_le_bytes());
+        header.extend_from_slice(&channel_count.to_le_bytes());
+        header.extend_from_slice(&sample_rate.to_le_bytes());
+        header.extend_from_slice(&byte_rate.to_le_bytes());
+        header.extend_from_slice(&block_align.to_le_bytes());
+        // Bits per sample
+        header.extend_from_slice(&16u16.to_le_bytes());
+        header.extend_from_slice(b"data");
+        // Patched in finish()
+        header.extend_from_slice(&0u32.to_le_bytes());
+        inner.write_all(&header)?;
+        Ok(Self {
+            inner,
+            data_length: 0,
+        })
+    }
+
+    /// Append interleaved samples.
+    pub fn write_samples(&mut self, samples: &[i16]) -> io::Result<()> {
+        let mut bytes = [0u8; 4096];
+        for block in samples.chunks(bytes.len() / 2) {
+            for (dst, sample) in bytes.chunks_exact_mut(2).zip(block) {
+                dst.copy_from_slice(&sample.to_le_bytes());
+            }
+            self.inner.write_all(&bytes[..block.len() * 2])?;
+        }
+        self.data_length += samples.len() as u64 * 2;
+        Ok(())
+    }
+
+    /// Number of samples written so far.
+    pub fn samples_written(&self) -> u64 {
+        self.data_length / 2
+    }
+
+    /// Patch the header sizes and return the inner writer. Sizes saturate once the data is
+    /// over the 4 GiB the format allows.
+    pub fn finish(mut self) -> io::Result<W> {
+        let data_length = self.data_length.min(MAX_DATA_LENGTH) as u32;
+        self.inner.seek(SeekFrom::Start(4))?;
+        self.inner
+            .write_all(&(data_length + (HEADER_LENGTH - 8)).to_le_bytes())?;
+        self.inner.seek(SeekFrom::Start(40))?;
+        self.inner.write_all(&data_length.to_le_bytes())?;
+        self.inner.seek(SeekFrom::End(0))?;
+        self.inner.flush()?;
+        Ok(self.inner)
+    }
+}
+
+/// "rec.wav" with `index` 1 becomes "rec_0001.wav".
+fn numbered_path(path: &Path, index: u32) -> PathBuf {
+    let stem = path.file_stem().unwrap_or_default().to_string_lossy();
+    let name = match path.extension() {
+        Some(extension) => format!("{stem}_{index:04}.{}", extension.to_string_lossy()),
+        None => format!("{stem}_{index:04}"),
+    };
+    path.with_file_name(name)
+}
+
+/// Creates a mono 16-bit WAV file at `path`.
+fn create_wav(path: &Path, sample_rate: u32) -> io::Result<WavWriter<BufWriter<File>>> {
+    let file = File::create(path)?;
+    WavWriter::new(
+        BufWriter::with_capacity(WRITE_BUFFER_SIZE, file),
+        sample_rate,
+        1,
+    )
+}
+
+/// Writes mono samples to `path`, or to numbered segment files when a segment length is set.
+/// "rec.wav" with segments becomes "rec_0000.wav", "rec_0001.wav", ...
+#[derive(Debug)]
+pub struct SegmentedWavWriter {
+    path: PathBuf,
+    sample_rate: u32,
+    /// Samples per file, None to write a single file
+    segment_length: Option<u64>,
+    /// Index of the next segment file
+    index: u32,
+    current: Option<WavWriter<BufWriter<File>>>,
+}
+
+impl SegmentedWavWriter {
+    /// Create the first file. `segment_length` is in samples, zero is treated as None. Segments
+    /// are capped at the 4 GiB a WAV file can hold, a single file saturates its header sizes.
+    pub fn new(
+        path: impl AsRef<Path>,
+        sample_rate: u32,
+        segment_length: Option<u64>,
+    ) -> io::Result<Self> {
+        let mut writer = Self {
+            path: path.as_ref().to_path_buf(),
+            sample_rate,
+            segment_length: segment_length
+                .filter(|length| *length > 0)
+                .map(|length| length.min(MAX_FILE_SAMPLES)),
+            index: 0,
+            current: None,
+        };
+        writer.rotate()?;
+        Ok(writer)
+    }
+
+    /// Path of segment `index`, or the path itself without segments.
+    pub fn segment_path(&self, index: u32) -> PathBuf {
+        match self.segment_length {
+            Some(_) => numbered_path(&self.path, index),
+            None => self.path.clone(),
+        }
+    }
+
+    /// Finish the current file and start the next one.
+    fn rotate(&mut self) -> io::Result<()> {
+        if let Some(current) = self.current.take() {
+            current.finish()?;
+        }
+        self.current = Some(create_wav(
+            &self.segment_path(self.index),
+            self.sample_rate,
+        )?);
+        self.index += 1;
+        Ok(())
+    }
+
+    /// Append samples, starting new segments at exact segment boundaries.
+    pub fn write_samples(&mut self, mut samples: &[i16]) -> io::Result<()> {
+        while !samples.is_empty() {
+            let current = self.current.as_mut().expect("writer is already finished");
+            let count = match self.segment_length {
+                Some(length) => {
+                    let remaining = length - current.samples_written();
+                    if remaining == 0 {
+                        self.rotate()?;
+                        continue;
+                    }
+                    samples.len().min(remaining as usize)
+                }
+                None => samples.len(),
+            };
+            current.write_samples(&samples[..count])?;
+            samples = &samples[count..];
+        }
+        Ok(())
+    }
+
+    /// Patch the header of the last file and flush it.
+    pub fn finish(mut self) -> io::Result<()> {
+        match self.current.take() {
+            Some(current) => current.finish().map(|_| ()),
+            None => Ok(()),
+        }
+    }
+}
+
+/// Writes each event to its own numbered file, see [crate::audio::Audio::trigger_record_start].
+/// "rec.wav" becomes "rec_0000.wav", "rec_0001.wav", ... Files are only created once an event
+/// has samples, so nothing is written while it's quiet.
+#[derive(Debug)]
+pub struct EventWavWriter {
+    path: PathBuf,
+    sample_rate: u32,
+    /// Index of the next event file
+    index: u32,
+    current: Option<WavWriter<BufWriter<File>>>,
+}
+
+impl EventWavWriter {
+    pub fn new(path: impl AsRef<Path>, sample_rate: u32) -> Self {
+        Self {
+            path: path.as_ref().to_path_buf(),
+            sample_rate,
+            index: 0,
+            current: None,
+        }
+    }
+
+    /// Path of event `index`.
+    pub fn event_path(&self, index: u32) -> PathBuf {
+        numbered_path(&self.path, index)
+    }
+
+    /// Number of event files started so far.
+    pub fn events(&self) -> u32 {
+        self.index
+    }
+
+    /// Append samples to the current event, starting a new file if there is none. An event
+    /// over the 4 GiB a WAV file can hold continues in the next file.
+    pub fn write_samples(&mut self, mut samples: &[i16]) -> io::Result<()> {
+        while !samples.is_empty() {
+            let current = match &mut self.current {
+                Some(current) => current,
+                None => {
+                    let index = self.index;
+                    self.index += 1;
+                    self.current
+                        .insert(create_wav(&self.event_path(index), self.sample_rate)?)
+                }
+            };
+            let remaining = MAX_FILE_SAMPLES - current.samples_written();
+            if remaining == 0 {
+                self.end_event()?;
+                continue;
+            }
+            let count = samples.len().min(remaining as usize);
+            current.write_samples(&samples[..count])?;
+            samples = &samples[count..];
+        }
+        Ok(())
+    }
+
+    /// Finish the file of the current event, the next samples start a new one.
+    pub fn end_event(&mut self) -> io::Result<()> {
+        match self.current.take() {
+            Some(current) => current.finish().map(|_| ()),
+            None => Ok(()),
+        }
+    }
+
+    /// Finish the file of an event that is still being written.
+    pub fn finish(mut self) -> io::Result<()> {
+        self.end_event()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Cursor;
+
+    #[test]
+    fn test_wav_writer() {
+        let mut writer = WavWriter::new(Cursor::new(Vec::new()), 44_100, 1).unwrap();
+        writer.write_samples(&[1, -1, 0x1234]).unwrap();
+        assert_eq!(writer.samples_written(), 3);
+        let bytes = writer.finish().unwrap().into_inner();
+        assert_eq!(bytes.len(), 44 + 6);
+        assert_eq!(&bytes[0..4], b"RIFF");
+        assert_eq!(u32::from_le_bytes(bytes[4..8].try_into().unwrap()), 36 + 6);
+        assert_eq!(&bytes[8..16], b"WAVEfmt ");
+        assert_eq!(
+            u32::from_le_bytes(bytes[24..28].try_into().unwrap()),
+            44_100
+        );
+        assert_eq!(
+            u32::from_le_bytes(bytes[28..32].try_into().unwrap()),
+            88_200
+        );
+        assert_eq!(&bytes[36..40], b"data");
+        assert_eq!(u32::from_le_bytes(bytes[40..44].try_into().unwrap()), 6);
+        assert_eq!(&bytes[44..], [0x01, 0x00, 0xFF, 0xFF, 0x34, 0x12]);
+    }
+
+    #[test]
+    fn test_wav_writer_limits() {
+        assert!(WavWriter::new(Cursor::new(Vec::new()), u32::MAX, 1).is_err());
+        assert!(WavWriter::new(Cursor::new(Vec::new()), 8000, u16::MAX).is_err());
+        // Sizes saturate instead of overflowing past 4 GiB
+        for data_length in [MAX_DATA_LENGTH, u32::MAX as u64 - 2, 5 << 30] {
+            let mut writer = WavWriter::new(Cursor::new(Vec::new()), 8000, 1).unwrap();
+            writer.data_length = data_length;
+            let bytes = writer.finish().unwrap().into_inner();
+            assert_eq!(
+                u32::from_le_bytes(bytes[4..8].try_into().unwrap()),
+                u32::MAX - 1
+            );
+            assert_eq!(
+                u32::from_le_bytes(bytes[40..44].try_into().unwrap()),
+                u32::MAX - 37
+            );
+        }
+    }
+
+    #[test]
+    fn test_segmented_wav_writer() {
+        let dir = std::env::temp_dir().join(format!("mic2_wav_test_{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("rec.wav");
+        let mut writer = SegmentedWavWriter::new(&path, 8000, Some(4)).unwrap();
+        assert_eq!(writer.segment_path(1), dir.join("rec_0001.wav"));
+        writer.write_samples(&[0; 3]).unwrap();
+        writer.write_samples(&[1; 6]).unwrap();
+        writer.finish().unwrap();
+        let lengths: Vec<u64> = (0..3)
+            .map(|i| {
+                let path = dir.join(format!("rec_{i:04}.wav"));
+                std::fs::metadata(path).unwrap().len() - 44
+            })
+            .collect();
+        assert_eq!(lengths, [8, 8, 2]);
+        assert!(!dir.join("rec_0003.wav").exists());
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_event_wav_writer() {
+        let dir = std::env::temp_dir().join(format!("mic2_event_test_{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let mut writer = EventWavWriter::new(dir.join("events.wav"), 8000);
+        assert_eq!(writer.event_path(2), dir.join("events_0002.wav"));
+        // Ending without samples doesn't create a file
+        writer.end_event().unwrap();
+        assert_eq!(writer.events(), 0);
+        writer.write_samples(&[0; 3]).unwrap();
+        writer.write_samples(&[1; 2]).unwrap();
+        writer.end_event().unwrap();
+        writer.write_samples(&[2; 4]).unwrap();
+        assert_eq!(writer.events(), 2);
+        writer.finish().unwrap();
+        let lengths: Vec<u64> = (0..2)
+            .map(|i| {
+                let path = dir.join(format!("events_{i:04}.wav"));
+                std::fs::metadata(path).unwrap().len() - 44
+            })
+            .collect();
+        assert_eq!(lengths, [10, 8]);
+        assert!(!dir.join("events_0002.wav").exists());
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+}
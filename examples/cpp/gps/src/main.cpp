@@ -4,6 +4,38 @@
 #include <thread>
 #include <vector>
 
+static void print_gps_info(const CGPSInfo& info) {
+  time_t current_time = info.current_time;
+  printf("Timestamp: %s\n", asctime(gmtime(&current_time)));
+  printf("Longitude: %d°%c %d' %d\"  (Valid: %d)\n", info.latitude.degrees,
+        info.latitude.minutes, info.latitude.seconds,
+        info.latitude_direction, info.latitude_valid);
+  printf("Longitude: %d°%c %d' %d\"  (Valid: %d)\n", info.longitude.degrees,
+        info.longitude.minutes, info.longitude.seconds,
+        info.longitude_direction, info.longitude_valid);
+  printf("Altitude: %f\n", info.altitude);
+  printf("NavStat: %d\n", info.nav_stat);
+  printf("h_acc: %f\n", info.h_acc);
+  printf("v_acc: %f\n", info.v_acc);
+  printf("sog_kmh: %f\n", info.sog_kmh);
+  printf("cog: %f\n", info.cog);
+  printf("vvel: %f\n", info.vvel);
+  printf("age_c: %f\n", info.age_c);
+  printf("hdop: %f\n", info.hdop);
+  printf("vdop: %f\n", info.vdop);
+  printf("tdop: %f\n", info.tdop);
+  printf("Satellite count: %d\n", info.satellites_count);
+  for (uint8_t i = 0; i < info.satellites_count; i++) {
+    printf("\t%d. Satellite PRN: %d: SNR: %d SNR valid: %d\n", i,
+          info.satellites[i].prn, info.satellites[i].snr,
+          info.satellites[i].snr_valid);
+  }
+  printf("Clock Bias: %f\n", info.clock_bias);
+  printf("Clock Drift: %f\n", info.clock_drift);
+  printf("Timepulse granularity: %f\n", info.timepulse_granularity);
+  printf("\n\n");
+}
+
 int main(int argc, char* argv[]) {
   (void)argc;
   (void)argv;
@@ -20,67 +52,39 @@ int main(int argc, char* argv[]) {
     return 1;
   }
   auto& device = devices.value().at(0);
-  // Open GPS
-  if (auto result = device.gps_open(); !result.has_value()) {
+  // Open GPS with 5 Hz UBX position updates and satellite info, nothing else
+  auto config = mic2::gps_config_default(CGpsProtocolUbx);
+  config.measurement_rate_ms = 200;
+  config.messages = MIC2_GPS_MESSAGE_NAV_PVT | MIC2_GPS_MESSAGE_NAV_SAT;
+  if (auto result = device.gps_open(config); !result.has_value()) {
     std::cerr << "Failed to open " << device.get_serial_number() << ": "
               << result.error() << "\n";
   } else {
     std::cout << "Opened " << device.get_serial_number() << "\n";
   }
   bool gps_has_lock = false;
-  while (!gps_has_lock) {
+  for (int i = 0; i < 120 && !gps_has_lock; ++i) {
     std::cout << "Waiting for GPS lock...\n";
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    if (auto result = device.gps_has_lock(); !result.has_value()) {
-      std::cerr << "Failed to see if gps has lock(): " << result.error() << "\n";
-      continue;
+    if (auto result = device.gps_wait_for_lock(std::chrono::seconds(1));
+        !result.has_value()) {
+      std::cerr << "Failed to wait for gps lock: " << result.error() << "\n";
+      return 1;
     } else {
       gps_has_lock = result.value();
     }
-  };
+  }
   if (!gps_has_lock) {
     std::cerr << "Failed to get lock\n";
     return 1;
   }
+  // Print every update as the reader thread receives it
+  if (auto result = device.gps_subscribe(print_gps_info); !result.has_value()) {
+    std::cerr << "Failed to subscribe to GPS info: " << result.error() << "\n";
+    return 1;
+  }
   while (true) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    if (auto result = device.gps_info(); !result.has_value()) {
-      std::cerr << "Failed to get GPS info: " << result.error() << "\n";
-      continue;
-    } else {
-      auto& info = result.value();
-      time_t current_time = info.current_time;
-      printf("Timestamp: %s\n", asctime(gmtime(&current_time)));
-      printf("Longitude: %d°%c %d' %d\"  (Valid: %d)\n", info.latitude.degrees,
-            info.latitude.minutes, info.latitude.seconds,
-            info.latitude_direction, info.latitude_valid);
-      printf("Longitude: %d°%c %d' %d\"  (Valid: %d)\n", info.longitude.degrees,
-            info.longitude.minutes, info.longitude.seconds,
-            info.longitude_direction, info.longitude_valid);
-      printf("Altitude: %f\n", info.altitude);
-      printf("NavStat: %d\n", info.nav_stat);
-      printf("h_acc: %f\n", info.h_acc);
-      printf("v_acc: %f\n", info.v_acc);
-      printf("sog_kmh: %f\n", info.sog_kmh);
-      printf("cog: %f\n", info.cog);
-      printf("vvel: %f\n", info.vvel);
-      printf("age_c: %f\n", info.age_c);
-      printf("hdop: %f\n", info.hdop);
-      printf("vdop: %f\n", info.vdop);
-      printf("tdop: %f\n", info.tdop);
-      printf("Satellite count: %d\n", info.satellites_count);
-      for (uint8_t i = 0; i < info.satellites_count; i++) {
-        printf("\t%d. Satellite PRN: %d: SNR: %d SNR valid: %d\n", i,
-              info.satellites[i].prn, info.satellites[i].snr,
-              info.satellites[i].snr_valid);
-      }
-      printf("Clock Bias: %f\n", info.clock_bias);
-      printf("Clock Drift: %f\n", info.clock_drift);
-      printf("Timepulse granularity: %f\n", info.timepulse_granularity);
-      printf("\n\n");
-    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
   }
 
-
   return 0;
 }